@@ -0,0 +1,739 @@
+/* bench.c - reproducible benchmark of encode, scale-out and decode.
+ *
+ *   bench [-t reed_sol_van,cauchy_good] [-k 24] [-m 6] [-w 8] [-b 1048576]
+ *         [-s 67108864] [-p 64] [-n 6] [-g 3] [-e 0,1,2] [-r 5] [-W 1]
+ *         [-S none|file|segment|mem] [-d /dev/shm/swifter-bench] [-x seed] [-c]
+ *         [-T threads]
+ *
+ * Every combination of the comma-separated technique, k, m, w and
+ * buffersize lists is run on an object of -s bytes of seeded random data,
+ * split into stripes of buffersize bytes as the encoder does.  k and m are
+ * the real code parameters: the encoder's "8 2" is -k 24 -m 6.  For each
+ * combination bench times
+ *
+ *   encode      coding every stripe, and storing the k+m fragments
+ *   scaleout    -n new parities (Reed-Solomon and Cauchy): partial parities over
+ *               the -g fragments each node holds, then their aggregation
+ *   decode      rebuilding the stripes with e data fragments erased, for
+ *               each e of -e (default 0..m)
+ *
+ * -W warm-up runs are discarded, then -r runs are timed and summarized as
+ * the median, mean, standard deviation, minimum and maximum MB/s of object
+ * data.  Decoded data is checked against the input, and the new parities
+ * against rows m..m+n-1 of the coding matrix applied directly, on every
+ * run.
+ *
+ * With -S none fragments stay in place and only the coding is timed.
+ * Otherwise they go through that fragment store, on nodes under -d (tmpfs
+ * by default), which is emptied before and after the run.  -S mem copies
+ * fragments in and out of the in-memory store, and SWIFTER_THROTTLE slows
+ * any store down to a given disk or network (see frag_store.h), to
+ * separate compute scaling from I/O scaling.  -c prints CSV.
+ *
+ * -T codes with that many threads (default SWIFTER_THREADS, else 1), each
+ * stripe cut into column slices as in the encoder (see slices.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <gf_rand.h>
+#include "jerasure.h"
+#include "reed_sol.h"
+#include "galois.h"
+#include "cauchy.h"
+#include "liberation.h"
+#include "frag_store.h"
+#include "placement.h"
+#include "elastic.h"
+#include "instr.h"
+#include "buf_pool.h"
+#include "topo.h"
+#include "workers.h"
+#include "slices.h"
+#include "rebuild.h"
+#include "tile_encode.h"
+#include "xor_sched.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define BENCH_MAX_LIST   32
+#define BENCH_ROOT       "/dev/shm/swifter-bench"
+#define BENCH_NO_STORE   (-1)
+
+enum Coding_Technique {Reed_Sol_Van, Reed_Sol_R6_Op, Cauchy_Orig, Cauchy_Good, Liberation, Blaum_Roth, Liber8tion, RDP, EVENODD, No_Coding};
+
+static const char *tech_names[] = {"reed_sol_van", "reed_sol_r6_op", "cauchy_orig", "cauchy_good",
+                                   "liberation", "blaum_roth", "liber8tion"};
+#define NTECHS  (int) (sizeof(tech_names)/sizeof(tech_names[0]))
+
+/* One combination of the sweep */
+struct bench {
+  int tech, k, m, w, packetsize;
+  int nnew;                    /* scale-out parities, 0 if the code has none */
+  int fpn;                     /* fragments per node */
+  int blocksize, buffersize, stripes;
+  int64_t size;                /* object bytes, padded to whole stripes */
+
+  int *matrix;                 /* m+nnew rows for Reed-Solomon */
+  int *bitmatrix;
+  int **schedule;
+  tile_code_t *tc;             /* blocked kernel for the first m rows */
+  xor_sched_t *xs;             /* vector executor for the schedule */
+
+  char *obj;                   /* stripes*buffersize bytes of input */
+  char *code;                  /* stripes*m*blocksize bytes of coding */
+  char **data, **coding;       /* pointers for one stripe */
+  char **stripe;               /* data then coding, for slices_run() */
+  char **rbuf;                 /* k+m fragment buffers for store reads */
+  char **parts;                /* partial parities, one per data node */
+  elastic_partial_t **plans;   /* ... and their plans for one new parity */
+  char **srcs;                 /* sources of one partial parity */
+  int *coefs;
+  int *erased;                 /* k+m erasure flags for rebuild_plan() */
+  char *newpar;
+  char *newcode;               /* stripes*nnew*blocksize bytes: what scale-out must build */
+
+  frag_store_t *fs;
+  struct placement *pl;
+  int store;
+};
+
+static int reps = 5, warmup = 1, csv = 0;
+static workers_t *pool;
+static char root[PLACEMENT_PATH_MAX] = BENCH_ROOT;
+
+static int parse_list(const char *s, int *list)
+{
+  char *copy, *tok, *save;
+  int n;
+
+  copy = strdup(s);
+  n = 0;
+  for (tok = strtok_r(copy, ",", &save); tok != NULL && n < BENCH_MAX_LIST; tok = strtok_r(NULL, ",", &save)) {
+    if (sscanf(tok, "%d", list+n) != 1) {
+      fprintf(stderr, "bench: bad number %s\n", tok);
+      exit(1);
+    }
+    n++;
+  }
+  free(copy);
+  return n;
+}
+
+static int parse_techs(const char *s, int *list)
+{
+  char *copy, *tok, *save;
+  int n, t;
+
+  copy = strdup(s);
+  n = 0;
+  for (tok = strtok_r(copy, ",", &save); tok != NULL && n < BENCH_MAX_LIST; tok = strtok_r(NULL, ",", &save)) {
+    for (t = 0; t < NTECHS && strcmp(tok, tech_names[t]) != 0; t++) ;
+    if (t == NTECHS) {
+      fprintf(stderr, "bench: unknown technique %s\n", tok);
+      exit(1);
+    }
+    list[n++] = t;
+  }
+  free(copy);
+  return n;
+}
+
+static int is_bitmatrix(int tech)
+{
+  return tech != Reed_Sol_Van && tech != Reed_Sol_R6_Op;
+}
+
+/* Node of fragment f: data, parity and new parity fragments fill -g slots
+   per node, each role starting on a fresh node, like the built-in map. */
+static int frag_node(struct bench *b, int f)
+{
+  int dnodes, pnodes;
+
+  dnodes = (b->k + b->fpn - 1) / b->fpn;
+  pnodes = (b->m + b->fpn - 1) / b->fpn;
+  if (f < b->k) return f / b->fpn + 1;
+  if (f < b->k + b->m) return dnodes + (f - b->k) / b->fpn + 1;
+  return dnodes + pnodes + (f - b->k - b->m) / b->fpn + 1;
+}
+
+static void frag_key(char *key, int f)
+{
+  sprintf(key, "bench_f%03d", f);
+}
+
+/* Empties and removes the node directories under root */
+static void clean_root(void)
+{
+  char node[PLACEMENT_PATH_MAX+256], path[PLACEMENT_PATH_MAX+512];
+  struct dirent *de, *fe;
+  DIR *d, *nd;
+
+  d = opendir(root);
+  if (d == NULL) return;
+  while ((de = readdir(d)) != NULL) {
+    if (strncmp(de->d_name, "node", 4) != 0) continue;
+    sprintf(node, "%s/%s", root, de->d_name);
+    nd = opendir(node);
+    if (nd == NULL) continue;
+    while ((fe = readdir(nd)) != NULL) {
+      if (fe->d_name[0] == '.') continue;
+      sprintf(path, "%s/%s", node, fe->d_name);
+      unlink(path);
+    }
+    closedir(nd);
+    rmdir(node);
+  }
+  closedir(d);
+}
+
+static int setup_code(struct bench *b)
+{
+  int *ext;
+
+  b->matrix = NULL;
+  b->bitmatrix = NULL;
+  b->schedule = NULL;
+  b->tc = NULL;
+  b->xs = NULL;
+  switch (b->tech) {
+    case Reed_Sol_Van:
+      /* The matrix the encoder, decoder and scale-out use: hand-built for
+         the 24-fragment stripe, Cauchy for the others */
+      b->matrix = reed_sol_vandermonde_decoding_matrix(b->k, b->m, b->m + b->nnew, b->w);
+      if (b->matrix == NULL) return -1;
+      b->tc = tile_code_new(b->k, b->m, b->w, b->matrix);
+      break;
+    case Reed_Sol_R6_Op:
+      if (b->m != 2) return -1;
+      b->matrix = reed_sol_r6_coding_matrix(b->k, b->w);
+      break;
+    case Cauchy_Orig:
+    case Cauchy_Good:
+      if (b->tech == Cauchy_Orig) b->matrix = cauchy_original_coding_matrix(b->k, b->m, b->w);
+      else b->matrix = cauchy_good_general_coding_matrix(b->k, b->m, b->w);
+      /* The scale-out rows follow the coding rows, as for Reed-Solomon */
+      if (b->matrix != NULL && b->nnew > 0) {
+        ext = elastic_cauchy_extension(b->k, b->m, b->nnew, b->w, b->matrix, b->tech == Cauchy_Good);
+        if (ext == NULL) return -1;
+        b->matrix = (int *) realloc(b->matrix, sizeof(int) * (b->m + b->nnew) * b->k);
+        memcpy(b->matrix + b->m*b->k, ext, sizeof(int) * b->nnew * b->k);
+        free(ext);
+      }
+      break;
+    case Liberation:
+      if (b->m != 2) return -1;
+      b->bitmatrix = liberation_coding_bitmatrix(b->k, b->w);
+      break;
+    case Blaum_Roth:
+      if (b->m != 2) return -1;
+      b->bitmatrix = blaum_roth_coding_bitmatrix(b->k, b->w);
+      break;
+    case Liber8tion:
+      if (b->m != 2 || b->w != 8) return -1;
+      b->bitmatrix = liber8tion_coding_bitmatrix(b->k);
+      break;
+  }
+  if (is_bitmatrix(b->tech)) {
+    if (b->bitmatrix == NULL && b->matrix != NULL) {
+      b->bitmatrix = jerasure_matrix_to_bitmatrix(b->k, b->m, b->w, b->matrix);
+    }
+    if (b->bitmatrix == NULL) return -1;
+    b->schedule = jerasure_smart_bitmatrix_to_schedule(b->k, b->m, b->w, b->bitmatrix);
+    b->xs = xor_sched_new(b->k, b->m, b->w, b->packetsize, b->schedule);
+  }
+  return (b->matrix == NULL && b->bitmatrix == NULL) ? -1 : 0;
+}
+
+static void free_code(struct bench *b)
+{
+  if (b->schedule != NULL) jerasure_free_schedule(b->schedule);
+  free(b->matrix);
+  free(b->bitmatrix);
+  tile_code_free(b->tc);
+  xor_sched_free(b->xs);
+}
+
+static void encode_slice(void *arg, char **ptrs, int len)
+{
+  struct bench *b;
+
+  b = (struct bench *) arg;
+  switch (b->tech) {
+    case Reed_Sol_Van:
+      if (b->tc != NULL) tile_encode(b->tc, ptrs, ptrs+b->k, len);
+      else jerasure_matrix_encode(b->k, b->m, b->w, b->matrix, ptrs, ptrs+b->k, len);
+      break;
+    case Reed_Sol_R6_Op:
+      reed_sol_r6_encode(b->k, b->w, ptrs, ptrs+b->k, len);
+      break;
+    default:
+      if (b->xs != NULL) xor_sched_encode(b->xs, ptrs, ptrs+b->k, len);
+      else jerasure_schedule_encode(b->k, b->m, b->w, b->schedule, ptrs, ptrs+b->k, len, b->packetsize);
+      break;
+  }
+}
+
+static void encode_stripe(struct bench *b)
+{
+  int i;
+
+  for (i = 0; i < b->k; i++) b->stripe[i] = b->data[i];
+  for (i = 0; i < b->m; i++) b->stripe[b->k+i] = b->coding[i];
+  slices_run(pool, b->stripe, b->k+b->m, b->blocksize,
+             sizeof(long) * b->w * (is_bitmatrix(b->tech) ? b->packetsize : 1), encode_slice, b);
+}
+
+static void point_stripe(struct bench *b, int s)
+{
+  int i;
+
+  for (i = 0; i < b->k; i++) b->data[i] = b->obj + (int64_t) s*b->buffersize + (int64_t) i*b->blocksize;
+  for (i = 0; i < b->m; i++) b->coding[i] = b->code + ((int64_t) s*b->m + i) * b->blocksize;
+}
+
+static void store_io(struct bench *b, int write, int f, int s, char *buf)
+{
+  char key[FRAG_KEY_MAX];
+  int64_t rv;
+
+  frag_key(key, f);
+  if (write) {
+    rv = b->fs->write(b->fs, frag_node(b, f), key, (int64_t) s*b->blocksize, buf, b->blocksize);
+  } else {
+    rv = b->fs->read(b->fs, frag_node(b, f), key, (int64_t) s*b->blocksize, buf, b->blocksize);
+  }
+  if (rv != b->blocksize) {
+    fprintf(stderr, "bench: unable to %s fragment %d of stripe %d on node %d\n",
+            write ? "write" : "read", f, s, frag_node(b, f));
+    exit(1);
+  }
+}
+
+static void run_encode(struct bench *b)
+{
+  int s, i;
+
+  for (s = 0; s < b->stripes; s++) {
+    point_stripe(b, s);
+    encode_stripe(b);
+    if (b->fs == NULL) continue;
+    for (i = 0; i < b->k; i++) store_io(b, 1, i, s, b->data[i]);
+    for (i = 0; i < b->m; i++) store_io(b, 1, b->k+i, s, b->coding[i]);
+  }
+  if (b->fs != NULL && b->fs->sync(b->fs) != 0) {
+    fprintf(stderr, "bench: unable to sync the fragment store\n");
+    exit(1);
+  }
+}
+
+/* The new parities straight from rows m..m+nnew-1 of the matrix, once,
+   for run_scaleout() to check its aggregates against */
+static void expect_scaleout(struct bench *b)
+{
+  int *bits;
+  char *dst;
+  int z, s;
+
+  for (z = 0; z < b->nnew; z++) {
+    bits = is_bitmatrix(b->tech) ? jerasure_matrix_to_bitmatrix(b->k, 1, b->w, b->matrix + (b->m+z)*b->k) : NULL;
+    for (s = 0; s < b->stripes; s++) {
+      point_stripe(b, s);
+      dst = b->newcode + ((int64_t) s*b->nnew + z) * b->blocksize;
+      if (bits != NULL) jerasure_bitmatrix_dotprod(b->k, b->w, bits, NULL, b->k, b->data, &dst, b->blocksize, b->packetsize);
+      else jerasure_matrix_dotprod(b->k, b->w, b->matrix + (b->m+z)*b->k, NULL, b->k, b->data, &dst, b->blocksize);
+    }
+    free(bits);
+  }
+}
+
+/* Every data node builds the partial parity of its own fragments, the
+   new parity's node XORs them.  Through a store, partials are written to
+   and read back from the new node, as in the encoder, which also plans
+   each node's partial once per new parity.  Returns 0 if every new parity
+   matches expect_scaleout(). */
+static int run_scaleout(struct bench *b)
+{
+  char key[FRAG_KEY_MAX];
+  int z, s, j, i, n, nnodes, newnode, f, bad;
+
+  nnodes = (b->k + b->fpn - 1) / b->fpn;
+  bad = 0;
+  for (z = 0; z < b->nnew; z++) {
+    f = b->k + b->m + z;
+    newnode = frag_node(b, f);
+    for (j = 0; j < nnodes; j++) {
+      n = 0;
+      for (i = j*b->fpn; i < b->k && i < (j+1)*b->fpn; i++) b->coefs[n++] = b->matrix[(b->m+z)*b->k + i];
+      b->plans[j] = elastic_partial_new(b->w, is_bitmatrix(b->tech) ? b->packetsize : 0, n, b->coefs);
+      if (b->plans[j] == NULL) {
+        fprintf(stderr, "bench: unable to plan the partial parities\n");
+        exit(1);
+      }
+    }
+    for (s = 0; s < b->stripes; s++) {
+      point_stripe(b, s);
+      for (j = 0; j < nnodes; j++) {
+        n = 0;
+        for (i = j*b->fpn; i < b->k && i < (j+1)*b->fpn; i++) {
+          if (b->fs != NULL) {
+            store_io(b, 0, i, s, b->rbuf[n]);
+            b->srcs[n] = b->rbuf[n];
+          } else {
+            b->srcs[n] = b->data[i];
+          }
+          n++;
+        }
+        elastic_partial_run(b->plans[j], b->srcs, b->parts[j], b->blocksize);
+        if (b->fs != NULL) {
+          sprintf(key, "bench_p%03d_%03d", j, z);
+          if (b->fs->write(b->fs, newnode, key, (int64_t) s*b->blocksize, b->parts[j], b->blocksize) != b->blocksize ||
+              b->fs->read(b->fs, newnode, key, (int64_t) s*b->blocksize, b->parts[j], b->blocksize) != b->blocksize) {
+            fprintf(stderr, "bench: unable to move a partial parity to node %d\n", newnode);
+            exit(1);
+          }
+        }
+      }
+      elastic_aggregate(nnodes, b->parts, b->newpar, b->blocksize);
+      if (memcmp(b->newpar, b->newcode + ((int64_t) s*b->nnew + z) * b->blocksize, b->blocksize) != 0) bad++;
+      if (b->fs != NULL) store_io(b, 1, f, s, b->newpar);
+    }
+    for (j = 0; j < nnodes; j++) elastic_partial_free(b->plans[j]);
+  }
+  return bad ? -1 : 0;
+}
+
+/* Rebuilds every stripe with fragments 0..e-1 erased, which are data
+   fragments unless e > k, the way the decoder does: one plan for the
+   erasure pattern, then slices of every stripe on the pool.  Returns 0 if
+   the rebuilt data matches the input. */
+static int run_decode(struct bench *b, int e)
+{
+  struct rebuild *rb;
+  int *erased;
+  int s, i, bad;
+
+  erased = b->erased;
+  for (i = 0; i < b->k + b->m; i++) erased[i] = (i < e);
+  rb = rebuild_plan(b->k, b->m, b->w, is_bitmatrix(b->tech) ? NULL : b->matrix, b->bitmatrix,
+                    b->packetsize, erased);
+  if (rb == NULL) return -1;
+  bad = 0;
+  for (s = 0; s < b->stripes; s++) {
+    point_stripe(b, s);
+    for (i = 0; i < b->k + b->m; i++) {
+      if (i < e) {
+        if (i < b->k) b->data[i] = b->rbuf[i];
+        else b->coding[i-b->k] = b->rbuf[i];
+      } else if (b->fs != NULL) {
+        store_io(b, 0, i, s, b->rbuf[i]);
+        if (i < b->k) b->data[i] = b->rbuf[i];
+        else b->coding[i-b->k] = b->rbuf[i];
+      }
+    }
+    rebuild_run(rb, pool, b->data, b->coding, b->blocksize);
+    for (i = 0; i < b->k && !bad; i++) {
+      if (memcmp(b->data[i], b->obj + (int64_t) s*b->buffersize + (int64_t) i*b->blocksize, b->blocksize) != 0) bad = 1;
+    }
+  }
+  rebuild_free(rb);
+  return bad ? -1 : 0;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+
+  return (x < y) ? -1 : (x > y);
+}
+
+static void report(struct bench *b, const char *op, int erased, double *mbs)
+{
+  double mean, var, med;
+  int i;
+
+  qsort(mbs, reps, sizeof(double), compare_double);
+  mean = 0;
+  for (i = 0; i < reps; i++) mean += mbs[i];
+  mean /= reps;
+  var = 0;
+  for (i = 0; i < reps; i++) var += (mbs[i]-mean) * (mbs[i]-mean);
+  var = (reps > 1) ? var / (reps-1) : 0;
+  med = (reps % 2) ? mbs[reps/2] : (mbs[reps/2-1] + mbs[reps/2]) / 2;
+
+  if (csv) {
+    printf("%s,%d,%d,%d,%d,%d,%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n", tech_names[b->tech], b->k, b->m, b->w,
+           b->buffersize, b->blocksize, op, erased, reps, med, mean, sqrt(var), mbs[0], mbs[reps-1]);
+  } else {
+    printf("%-14s %3d %3d %3d %9d %8d %-9s %3d %4d %10.1f %10.1f %8.1f %10.1f %10.1f\n", tech_names[b->tech],
+           b->k, b->m, b->w, b->buffersize, b->blocksize, op, erased, reps, med, mean, sqrt(var), mbs[0], mbs[reps-1]);
+  }
+  fflush(stdout);
+}
+
+/* Runs op warmup+reps times and reports MB/s of object data */
+static void measure(struct bench *b, const char *op, int erased)
+{
+  double *mbs;
+  uint64_t t0, t1;
+  int r;
+
+  mbs = talloc(double, reps);
+  for (r = -warmup; r < reps; r++) {
+    t0 = instr_now();
+    if (strcmp(op, "encode") == 0) {
+      run_encode(b);
+    } else if (strcmp(op, "scaleout") == 0) {
+      if (run_scaleout(b) != 0) {
+        fprintf(stderr, "bench: %s k=%d m=%d w=%d: scale-out built wrong parities\n",
+                tech_names[b->tech], b->k, b->m, b->w);
+        free(mbs);
+        return;
+      }
+    } else if (run_decode(b, erased) != 0) {
+      fprintf(stderr, "bench: %s k=%d m=%d w=%d: decoding with %d erasures failed or was wrong\n",
+              tech_names[b->tech], b->k, b->m, b->w, erased);
+      free(mbs);
+      return;
+    }
+    t1 = instr_now();
+    if (r >= 0) mbs[r] = (b->size / 1048576.0) / ((t1 - t0) / 1e9);
+  }
+  report(b, op, erased, mbs);
+  free(mbs);
+}
+
+static struct placement *bench_placement(int nnodes)
+{
+  struct placement *pl;
+  int i;
+
+  pl = talloc(struct placement, 1);
+  memset(pl, 0, sizeof(*pl));
+  pl->store = -1;
+  pl->nnodes = nnodes;
+  for (i = 0; i < nnodes; i++) {
+    pl->nodes[i].id = i+1;
+    pl->nodes[i].slots = 1;
+    sprintf(pl->nodes[i].root, "%s/node%d", root, i+1);
+    mkdir(pl->nodes[i].root, 0755);
+    pl->nodes[i].numa = topo_path_node(pl->nodes[i].root);
+  }
+  strcpy(pl->output, root);
+  return pl;
+}
+
+static void run_one(struct bench *b, int64_t size, int *erased, int nerased)
+{
+  int64_t align, pos;
+  int i, nnodes, nbuf;
+
+  /* Fragment sizes must be whole words, and whole packets for schedules */
+  align = sizeof(long) * b->w * (is_bitmatrix(b->tech) ? b->packetsize : 1);
+  b->blocksize = (int) (((b->buffersize / b->k + align - 1) / align) * align);
+  b->buffersize = b->k * b->blocksize;
+  b->stripes = (int) ((size + b->buffersize - 1) / b->buffersize);
+  b->size = (int64_t) b->stripes * b->buffersize;
+  if (b->tech != Reed_Sol_Van && b->tech != Cauchy_Orig && b->tech != Cauchy_Good) b->nnew = 0;
+
+  if (setup_code(b) != 0) {
+    fprintf(stderr, "bench: %s does not support k=%d m=%d w=%d; skipped\n", tech_names[b->tech], b->k, b->m, b->w);
+    free_code(b);
+    return;
+  }
+  /* The pool's threads must not each build the multiply tables */
+  if (!is_bitmatrix(b->tech)) galois_init_default_field(b->w);
+
+  nnodes = (b->k + b->fpn - 1) / b->fpn;
+  nbuf = b->k + b->m;
+  b->obj = buf_pool_get(b->size);
+  b->code = buf_pool_get((int64_t) b->stripes * b->m * b->blocksize);
+  b->data = talloc(char *, b->k);
+  b->coding = talloc(char *, b->m);
+  b->stripe = talloc(char *, b->k + b->m);
+  b->rbuf = talloc(char *, nbuf);
+  b->parts = talloc(char *, nnodes);
+  b->plans = talloc(elastic_partial_t *, nnodes);
+  b->srcs = talloc(char *, b->fpn);
+  b->coefs = talloc(int, b->fpn);
+  b->erased = talloc(int, b->k + b->m + 1);
+  b->newpar = buf_pool_get(b->blocksize);
+  b->newcode = (b->nnew > 0) ? buf_pool_get((int64_t) b->stripes * b->nnew * b->blocksize) : NULL;
+  if (b->obj == NULL || b->code == NULL || b->newpar == NULL || (b->nnew > 0 && b->newcode == NULL)) {
+    fprintf(stderr, "bench: out of memory for %lld bytes\n", (long long) b->size);
+    exit(1);
+  }
+  for (i = 0; i < nbuf; i++) b->rbuf[i] = buf_pool_get(b->blocksize);
+  for (i = 0; i < nnodes; i++) b->parts[i] = buf_pool_get(b->blocksize);
+  /* MOA_Fill_Random_Region() takes an int size */
+  for (pos = 0; pos < b->size; pos += 1 << 30) {
+    MOA_Fill_Random_Region(b->obj + pos, (int) ((b->size - pos < (1 << 30)) ? b->size - pos : (1 << 30)));
+  }
+  if (b->nnew > 0) expect_scaleout(b);
+
+  b->fs = NULL;
+  if (b->store != BENCH_NO_STORE) {
+    b->pl = bench_placement(frag_node(b, b->k + b->m + b->nnew - 1));
+    b->fs = frag_store_open(b->store, b->pl);
+    if (b->fs == NULL) {
+      fprintf(stderr, "bench: unable to open the %s store under %s\n", frag_store_kind_name(b->store), root);
+      exit(1);
+    }
+  }
+
+  measure(b, "encode", 0);
+  if (b->nnew > 0) measure(b, "scaleout", 0);
+  for (i = 0; i < nerased; i++) {
+    if (erased[i] > b->m) continue;
+    measure(b, "decode", erased[i]);
+  }
+
+  if (b->fs != NULL) {
+    b->fs->close(b->fs);
+    placement_free(b->pl);
+    clean_root();
+  }
+  for (i = 0; i < nbuf; i++) buf_pool_put(b->rbuf[i]);
+  for (i = 0; i < nnodes; i++) buf_pool_put(b->parts[i]);
+  free(b->rbuf);
+  free(b->parts);
+  free(b->plans);
+  free(b->srcs);
+  free(b->coefs);
+  free(b->erased);
+  buf_pool_put(b->newpar);
+  buf_pool_put(b->newcode);
+  free(b->data);
+  free(b->coding);
+  free(b->stripe);
+  buf_pool_put(b->obj);
+  buf_pool_put(b->code);
+  free_code(b);
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: bench [-t techniques] [-k list] [-m list] [-w list] [-b buffersizes]\n"
+                  "             [-s size] [-p packetsize] [-n new-parities] [-g fragments-per-node]\n"
+                  "             [-e erasures] [-r reps] [-W warmup] [-S none|file|segment|mem] [-d dir]\n"
+                  "             [-x seed] [-c] [-T threads]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  int techs[BENCH_MAX_LIST], ks[BENCH_MAX_LIST], ms[BENCH_MAX_LIST], ws[BENCH_MAX_LIST];
+  int bufs[BENCH_MAX_LIST], erased[BENCH_MAX_LIST], all[BENCH_MAX_LIST];
+  int ntechs, nk, nm, nw, nbufs, nerased;
+  int packetsize, nnew, fpn, store, threads, c, it, ik, im, iw, ib, i;
+  int64_t size;
+  unsigned seed;
+  struct bench b;
+
+  ntechs = parse_techs("reed_sol_van", techs);
+  nk = parse_list("24", ks);
+  nm = parse_list("6", ms);
+  nw = parse_list("8", ws);
+  nbufs = parse_list("1048576", bufs);
+  nerased = -1;
+  size = 64LL << 20;
+  packetsize = 64;
+  nnew = 6;
+  fpn = 3;
+  store = BENCH_NO_STORE;
+  seed = 1;
+  threads = 0;
+
+  while ((c = getopt(argc, argv, "t:k:m:w:b:s:p:n:g:e:r:W:S:d:x:cT:")) != -1) {
+    switch (c) {
+      case 't': ntechs = parse_techs(optarg, techs); break;
+      case 'k': nk = parse_list(optarg, ks); break;
+      case 'm': nm = parse_list(optarg, ms); break;
+      case 'w': nw = parse_list(optarg, ws); break;
+      case 'b': nbufs = parse_list(optarg, bufs); break;
+      case 'e': nerased = parse_list(optarg, erased); break;
+      case 's': size = atoll(optarg); break;
+      case 'p': packetsize = atoi(optarg); break;
+      case 'n': nnew = atoi(optarg); break;
+      case 'g': fpn = atoi(optarg); break;
+      case 'r': reps = atoi(optarg); break;
+      case 'W': warmup = atoi(optarg); break;
+      case 'x': seed = (unsigned) strtoul(optarg, NULL, 0); break;
+      case 'c': csv = 1; break;
+      case 'T': threads = atoi(optarg); break;
+      case 'd':
+        if (strlen(optarg) >= PLACEMENT_PATH_MAX-16) usage();
+        strcpy(root, optarg);
+        break;
+      case 'S':
+        if (strcmp(optarg, "none") == 0) {
+          store = BENCH_NO_STORE;
+        } else if ((store = frag_store_kind_by_name(optarg)) < 0) {
+          fprintf(stderr, "bench: unknown store %s\n", optarg);
+          exit(1);
+        }
+        break;
+      default: usage();
+    }
+  }
+  if (optind != argc || size <= 0 || packetsize <= 0 || nnew < 0 || fpn <= 0 || reps <= 0 || warmup < 0) usage();
+
+  if (store != BENCH_NO_STORE && mkdir(root, 0755) != 0 && access(root, W_OK) != 0) {
+    perror(root);
+    exit(1);
+  }
+  clean_root();
+  pool = workers_start(threads);
+
+  printf("# bench size=%lld packetsize=%d new=%d per-node=%d reps=%d warmup=%d store=%s root=%s seed=%u threads=%d\n",
+         (long long) size, packetsize, nnew, fpn, reps, warmup,
+         (store == BENCH_NO_STORE) ? "none" : frag_store_kind_name(store), root, seed, workers_threads(pool));
+  printf("# MB/s of object data; decode erases fragments 0..erased-1\n");
+  if (csv) {
+    printf("technique,k,m,w,buffersize,blocksize,op,erased,reps,median,mean,stddev,min,max\n");
+  } else {
+    printf("%-14s %3s %3s %3s %9s %8s %-9s %3s %4s %10s %10s %8s %10s %10s\n", "technique", "k", "m", "w",
+           "buffer", "block", "op", "era", "reps", "median", "mean", "stddev", "min", "max");
+  }
+
+  for (it = 0; it < ntechs; it++) {
+    for (ik = 0; ik < nk; ik++) {
+      for (im = 0; im < nm; im++) {
+        for (iw = 0; iw < nw; iw++) {
+          for (ib = 0; ib < nbufs; ib++) {
+            memset(&b, 0, sizeof(b));
+            b.tech = techs[it];
+            b.k = ks[ik];
+            b.m = ms[im];
+            b.w = ws[iw];
+            b.buffersize = bufs[ib];
+            b.packetsize = packetsize;
+            b.nnew = nnew;
+            b.fpn = fpn;
+            b.store = store;
+            if (b.k <= 0 || b.m <= 0 || (!is_bitmatrix(b.tech) && b.w != 8 && b.w != 16 && b.w != 32)) {
+              fprintf(stderr, "bench: k=%d m=%d w=%d skipped\n", b.k, b.m, b.w);
+              continue;
+            }
+            /* Same data for every combination */
+            MOA_Seed(seed);
+            if (nerased < 0) {
+              for (i = 0; i <= b.m && i < BENCH_MAX_LIST; i++) all[i] = i;
+              run_one(&b, size, all, i);
+            } else {
+              run_one(&b, size, erased, nerased);
+            }
+          }
+        }
+      }
+    }
+  }
+  if (store != BENCH_NO_STORE) rmdir(root);
+  workers_stop(pool);
+  return 0;
+}
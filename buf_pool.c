@@ -0,0 +1,264 @@
+/* buf_pool.c - size-classed buffer pool.  See buf_pool.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "buf_pool.h"
+#include "topo.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define POOL_CLASSES   160
+#define POOL_HASH      4096
+
+enum pool_backing { BACK_HEAP, BACK_THP, BACK_HUGETLB };
+
+/* One buffer the pool owns, idle or handed out */
+struct pool_buf {
+  char            *ptr;
+  int64_t          size;                 /* class size */
+  int              cls;
+  int              in_use;
+  int              backing;              /* enum pool_backing */
+  int              node;                 /* NUMA node bound to, or -1 */
+  int64_t          map_len;              /* mmap()ed bytes unless BACK_HEAP */
+  struct pool_buf *hnext;                /* hash chain by ptr */
+  struct pool_buf *fnext;                /* free list of the class */
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct pool_buf *free_lists[TOPO_MAX_NODES+1][POOL_CLASSES];   /* by node+1 */
+static struct pool_buf *hash[POOL_HASH];
+static struct buf_pool_stats stats;
+static int64_t idle_max = -1;
+static int huge_mode = -1;               /* BACK_HEAP: off */
+static int64_t huge_min;
+static int hugetlb_warned;
+
+/* Sizes up to 64 are one class; above, four classes per power of two */
+static int size_class(int64_t size)
+{
+  int e;
+
+  if (size <= BUF_POOL_LINE) return 0;
+  e = 63 - __builtin_clzll((uint64_t) (size-1));
+  return 4*(e-5) - 3 + (int) (((size-1) >> (e-2)) & 3);
+}
+
+static int64_t class_size(int cls)
+{
+  int e;
+
+  if (cls == 0) return BUF_POOL_LINE;
+  e = (cls + 3) / 4 + 5;
+  return (int64_t) (4 + (cls+3) % 4 + 1) << (e-2);
+}
+
+static unsigned ptr_hash(char *p)
+{
+  uintptr_t x;
+
+  x = (uintptr_t) p / BUF_POOL_LINE;
+  return (unsigned) ((x ^ (x >> 13)) % POOL_HASH);
+}
+
+static void load_config(void)
+{
+  char mode[16];
+  char *s;
+  int n;
+
+  s = getenv("SWIFTER_POOL_IDLE");
+  idle_max = (s == NULL || *s == '\0') ? 1024 : atoll(s);
+  idle_max <<= 20;
+
+  huge_mode = BACK_HEAP;
+  huge_min = BUF_POOL_HUGE;
+  s = getenv("SWIFTER_POOL_HUGE");
+  if (s == NULL || *s == '\0') return;
+  mode[0] = '\0';
+  n = sscanf(s, "%15[a-z]:%lld", mode, (long long *) &huge_min);
+  if (n == 2) huge_min <<= 20;
+  if (strcmp(mode, "thp") == 0) {
+    huge_mode = BACK_THP;
+  } else if (strcmp(mode, "explicit") == 0) {
+    huge_mode = BACK_HUGETLB;
+  } else if (strcmp(mode, "off") != 0) {
+    fprintf(stderr, "Warning: SWIFTER_POOL_HUGE=%s is not off, thp or explicit[:<min MB>]; using off\n", s);
+  }
+}
+
+/* Maps b->size bytes on huge pages: reserved ones (MAP_HUGETLB) if asked
+   for and available, else 2 MiB-aligned memory advised for transparent
+   huge pages.  Returns -1 if mmap() fails altogether. */
+static int map_huge(struct pool_buf *b)
+{
+  char *p, *aligned;
+  int64_t len, head;
+
+  len = (b->size + BUF_POOL_HUGE - 1) / BUF_POOL_HUGE * BUF_POOL_HUGE;
+#ifdef MAP_HUGETLB
+  if (huge_mode == BACK_HUGETLB) {
+    p = (char *) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+      b->ptr = p;
+      b->map_len = len;
+      b->backing = BACK_HUGETLB;
+      return 0;
+    }
+    if (!hugetlb_warned) {
+      fprintf(stderr, "Note: no reserved huge pages left; using transparent huge pages\n");
+      hugetlb_warned = 1;
+    }
+  }
+#endif
+  /* Over-map by a huge page and trim, so the buffer starts on a huge page */
+  p = (char *) mmap(NULL, len + BUF_POOL_HUGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) return -1;
+  aligned = (char *) (((uintptr_t) p + BUF_POOL_HUGE - 1) & ~(uintptr_t) (BUF_POOL_HUGE - 1));
+  head = aligned - p;
+  if (head > 0) munmap(p, head);
+  munmap(aligned + len, BUF_POOL_HUGE - head);
+#ifdef MADV_HUGEPAGE
+  madvise(aligned, len, MADV_HUGEPAGE);
+#endif
+  b->ptr = aligned;
+  b->map_len = len;
+  b->backing = BACK_THP;
+  return 0;
+}
+
+/* Allocates b->size bytes, on b->node if it is set.  The pages are bound
+   before anything touches them, so they are placed there, not wherever
+   the allocating thread runs. */
+static int back(struct pool_buf *b)
+{
+  b->backing = BACK_HEAP;
+  b->map_len = 0;
+  if (huge_mode != BACK_HEAP && b->size >= huge_min && map_huge(b) == 0) {
+    stats.huge += b->map_len;
+  } else if (posix_memalign((void **) &b->ptr, (b->size >= BUF_POOL_PAGE) ? BUF_POOL_PAGE : BUF_POOL_LINE, b->size) != 0) {
+    return -1;
+  }
+  if (b->node >= 0) topo_bind_memory(b->ptr, b->size, b->node);
+  return 0;
+}
+
+/* Unhooks and frees an idle buffer.  Called with the lock held. */
+static void release(struct pool_buf *b)
+{
+  struct pool_buf **pp;
+
+  for (pp = &hash[ptr_hash(b->ptr)]; *pp != b; pp = &(*pp)->hnext) ;
+  *pp = b->hnext;
+  stats.idle -= b->size;
+  if (b->backing == BACK_HEAP) {
+    free(b->ptr);
+  } else {
+    munmap(b->ptr, b->map_len);
+    stats.huge -= b->map_len;
+  }
+  free(b);
+}
+
+char *buf_pool_get(int64_t size)
+{
+  return buf_pool_get_on(size, topo_thread_node());
+}
+
+char *buf_pool_get_on(int64_t size, int node)
+{
+  struct pool_buf *b;
+  unsigned h;
+  int cls;
+
+  if (size <= 0) size = 1;
+  cls = size_class(size);
+  if (cls >= POOL_CLASSES) return NULL;
+  if (node < 0 || node >= TOPO_MAX_NODES || topo_nodes() == 1) node = -1;
+
+  pthread_mutex_lock(&pool_lock);
+  if (idle_max < 0) load_config();
+  stats.gets++;
+  b = free_lists[node+1][cls];
+  if (b != NULL) {
+    free_lists[node+1][cls] = b->fnext;
+    stats.hits++;
+    stats.idle -= b->size;
+  } else {
+    b = talloc(struct pool_buf, 1);
+    if (b == NULL) {
+      pthread_mutex_unlock(&pool_lock);
+      return NULL;
+    }
+    b->cls = cls;
+    b->size = class_size(cls);
+    b->node = node;
+    if (back(b) != 0) {
+      free(b);
+      pthread_mutex_unlock(&pool_lock);
+      return NULL;
+    }
+    h = ptr_hash(b->ptr);
+    b->hnext = hash[h];
+    hash[h] = b;
+  }
+  b->in_use = 1;
+  b->fnext = NULL;
+  stats.in_use += b->size;
+  if (stats.in_use + stats.idle > stats.peak) stats.peak = stats.in_use + stats.idle;
+  pthread_mutex_unlock(&pool_lock);
+  return b->ptr;
+}
+
+void buf_pool_put(char *buf)
+{
+  struct pool_buf *b;
+
+  if (buf == NULL) return;
+  pthread_mutex_lock(&pool_lock);
+  for (b = hash[ptr_hash(buf)]; b != NULL && b->ptr != buf; b = b->hnext) ;
+  if (b == NULL || !b->in_use) {
+    pthread_mutex_unlock(&pool_lock);
+    fprintf(stderr, "buf_pool_put: %p is not a buffer in use\n", (void *) buf);
+    exit(1);
+  }
+  b->in_use = 0;
+  stats.in_use -= b->size;
+  stats.idle += b->size;
+  if (stats.idle > idle_max) {
+    release(b);
+  } else {
+    b->fnext = free_lists[b->node+1][b->cls];
+    free_lists[b->node+1][b->cls] = b;
+  }
+  pthread_mutex_unlock(&pool_lock);
+}
+
+void buf_pool_trim(void)
+{
+  struct pool_buf *b;
+  int node, cls;
+
+  pthread_mutex_lock(&pool_lock);
+  for (node = 0; node <= TOPO_MAX_NODES; node++) {
+    for (cls = 0; cls < POOL_CLASSES; cls++) {
+      while ((b = free_lists[node][cls]) != NULL) {
+        free_lists[node][cls] = b->fnext;
+        release(b);
+      }
+    }
+  }
+  pthread_mutex_unlock(&pool_lock);
+}
+
+void buf_pool_stats(struct buf_pool_stats *st)
+{
+  pthread_mutex_lock(&pool_lock);
+  *st = stats;
+  pthread_mutex_unlock(&pool_lock);
+}
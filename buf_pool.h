@@ -0,0 +1,62 @@
+/* buf_pool.h - reusable, aligned stripe and fragment buffers.
+ *
+ * Buffers come in size classes, four per power of two, so a buffer is at
+ * most 25% larger than asked for.  Buffers of a page or more are page
+ * aligned, smaller ones cache-line aligned.  buf_pool_put() puts a buffer
+ * on its class's free list and the next buf_pool_get() of that class
+ * hands it out again, so encoding and decoding object after object does
+ * not go back to malloc.  Idle buffers are kept up to SWIFTER_POOL_IDLE
+ * megabytes (default 1024); beyond that, returned buffers are freed, so
+ * long batch jobs stay at a flat footprint.  Thread safe.
+ *
+ * SWIFTER_POOL_HUGE puts buffers of 2 MiB and up on huge pages, which
+ * saves TLB misses when the GF kernels stream over many large fragments:
+ *   thp       2 MiB-aligned mappings advised with MADV_HUGEPAGE
+ *   explicit  MAP_HUGETLB pages from the reserved pool (vm.nr_hugepages),
+ *             falling back to thp when none are left
+ *   off       (default) plain aligned heap memory
+ * ":<MB>" after the mode changes the 2 MiB threshold, e.g. "thp:1".
+ *
+ * On a NUMA machine every node has its own free lists.  A buffer asked
+ * for by a thread pinned to a node (see workers.h), or asked for on a
+ * node with buf_pool_get_on(), has its pages placed on that node.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BUF_POOL_LINE   64
+#define BUF_POOL_PAGE   4096
+#define BUF_POOL_HUGE   (2 << 20)
+
+struct buf_pool_stats {
+  int64_t gets;                          /* buf_pool_get() calls */
+  int64_t hits;                          /* ... served from a free list */
+  int64_t in_use;                        /* bytes handed out and not returned */
+  int64_t idle;                          /* bytes on the free lists */
+  int64_t peak;                          /* most in_use + idle so far */
+  int64_t huge;                          /* bytes mapped for huge pages */
+};
+
+/* A buffer of at least size bytes, or NULL */
+extern char *buf_pool_get(int64_t size);
+
+/* Same, with the memory on NUMA node node (-1: anywhere) */
+extern char *buf_pool_get_on(int64_t size, int node);
+
+/* Returns a buffer from buf_pool_get(); NULL is ignored */
+extern void buf_pool_put(char *buf);
+
+/* Frees every idle buffer */
+extern void buf_pool_trim(void);
+
+extern void buf_pool_stats(struct buf_pool_stats *st);
+
+#ifdef __cplusplus
+}
+#endif
@@ -68,12 +68,20 @@ same arguments, and encoder.c does error check.
 #include <sys/stat.h>
 #include <signal.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "jerasure.h"
 #include "reed_sol.h"
 #include "galois.h"
 #include "cauchy.h"
 #include "liberation.h"
-#include "timing.h"
+#include "meta_store.h"
+#include "frag_store.h"
+#include "placement.h"
+#include "instr.h"
+#include "buf_pool.h"
+#include "workers.h"
+#include "rebuild.h"
+#include "elastic.h"
 
 #define N 10
 
@@ -88,6 +96,74 @@ int readins, n;
 /* Function prototype */
 void ctrl_bs_handler(int dummy);
 
+/* Writes the data of one stripe, leaving out the padding past origsize.
+   Returns the bytes written. */
+int write_stripe(FILE *fp, char **data, int k, int blocksize, int origsize, int *total)
+{
+	int i, j, start;
+
+	start = *total;
+	for (i = 0; i < k; i++) {
+		if (*total+blocksize <= origsize) {
+			fwrite(data[i], sizeof(char), blocksize, fp);
+			*total += blocksize;
+		}
+		else {
+			for (j = 0; j < blocksize; j++) {
+				if (*total < origsize) {
+					fprintf(fp, "%c", data[i][j]);
+					(*total)++;
+				}
+				else {
+					break;
+				}
+			}
+		}
+	}
+	return *total - start;
+}
+
+/* With a worker pool, decoded stripes go to a writer thread in read-in
+   order, so writing one stripe overlaps reading and decoding the next.
+   Stripes alternate between two sets of data buffers. */
+struct writer {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t tid;
+	FILE *fp;
+	char **stripes[2];
+	int posted;			/* stripes handed to the writer */
+	int written;			/* ... and written */
+	int done;
+	int k, blocksize, origsize, total;
+	int ph_write;
+};
+
+void *writer_main(void *arg)
+{
+	struct writer *wr;
+	struct instr_scope sc;
+	int n;
+
+	wr = (struct writer *) arg;
+	pthread_mutex_lock(&wr->lock);
+	for (;;) {
+		while (wr->written == wr->posted && !wr->done) pthread_cond_wait(&wr->cond, &wr->lock);
+		if (wr->written == wr->posted) break;
+		n = wr->written;
+		pthread_mutex_unlock(&wr->lock);
+
+		instr_begin(&sc, wr->ph_write, -1, -1);
+		instr_end_bytes(&sc, write_stripe(wr->fp, wr->stripes[n%2], wr->k, wr->blocksize, wr->origsize, &wr->total));
+
+		pthread_mutex_lock(&wr->lock);
+		wr->written++;
+		pthread_cond_broadcast(&wr->cond);
+	}
+	pthread_mutex_unlock(&wr->lock);
+	return NULL;
+}
+
 int main (int argc, char **argv) {
 	FILE *fp;				// File pointer
 
@@ -98,17 +174,16 @@ int main (int argc, char **argv) {
 	int *erased;
 	int *matrix;
 	int *bitmatrix;
+	int *ext;
 	
 	/* Parameters */
 	int k, m, w, packetsize, buffersize;
 	int tech;
-	char *c_tech;
 	
-	int i, j;				// loop control variable, s
+	int i;					// loop control variable, s
 	int blocksize = 0;			// size of individual files
 	int origsize;			// size of file before padding
 	int total;				// used to write data, not padding to file
-	struct stat status;		// used to find size of individual files
 	int numerased;			// number of erased files
 		
 	/* Used to recreate file names */
@@ -118,8 +193,26 @@ int main (int argc, char **argv) {
 	int md;
 	char *curdir;
 
+	/* Metadata index */
+	struct meta_record meta;
+	meta_store_t *mstore;
+
+	/* Fragment store and placement map */
+	frag_store_t *fstore;
+	struct placement *pl;
+	int64_t fsize;
+
+	/* Parallel decoding: SWIFTER_THREADS threads rebuild slices */
+	workers_t *wk;
+	struct rebuild *rb;
+	int *plan_erased;
+	struct writer wr;
+	char **dslot[2];
+	int nslots, slot;
+
 	/* Used to time decoding */
-	struct timing t1, t2, t3, t4;
+	struct instr_scope sc, sc_total;
+	int ph_total, ph_setup, ph_read, ph_compute, ph_write;
 	double tsec;
 	double totalsec;
 
@@ -127,21 +220,19 @@ int main (int argc, char **argv) {
 //whcho add
 int integer;
 
-// whcho add	
-struct timing t_read_start, t_read_end , t_write_start , t_write_end;
-double total_read, total_write;
-total_read =0.0;
-total_write =0.0;
-
 	
 	signal(SIGQUIT, ctrl_bs_handler);
 
 	matrix = NULL;
 	bitmatrix = NULL;
-	totalsec = 0.0;
 	
 	/* Start timing */
-	timing_set(&t1);
+	ph_total = instr_phase("decode.total");
+	ph_setup = instr_phase("decode.setup");
+	ph_read = instr_phase("decode.read");
+	ph_compute = instr_phase("decode.compute");
+	ph_write = instr_phase("decode.write");
+	instr_begin(&sc_total, ph_total, -1, -1);
 
 	/* Error checking parameters */
 	if (argc != 2) {
@@ -170,51 +261,53 @@ total_write =0.0;
         }	
 	fname = (char *)malloc(sizeof(char*)*(100+strlen(argv[1])+20));
 
-	/* Read in parameters from metadata file */
-	sprintf(fname, "%s/Coding/%s_meta.txt", curdir, cs1);
-
-	fp = fopen(fname, "rb");
-        if (fp == NULL) {
-          fprintf(stderr, "Error: no metadata file %s\n", fname);
-          exit(1);
-        }
-	temp = (char *)malloc(sizeof(char)*(strlen(argv[1])+20));
-	if (fscanf(fp, "%s", temp) != 1) {
-		fprintf(stderr, "Metadata file - bad format\n");
-		exit(0);
+	/* Read in parameters from the metadata index */
+	sprintf(fname, "%s/%s", curdir, META_STORE_FILE);
+	mstore = meta_store_open(fname, 0);
+	if (mstore == NULL) {
+		fprintf(stderr, "Error: no metadata index %s\n", fname);
+		exit(1);
 	}
-	
-	if (fscanf(fp, "%d", &origsize) != 1) {
-		fprintf(stderr, "Original size is not valid\n");
-		exit(0);
+	if (meta_store_get(mstore, cs1, &meta) != 0) {
+		fprintf(stderr, "Error: %s is not in metadata index %s\n", cs1, fname);
+		exit(1);
 	}
-	if (fscanf(fp, "%d %d %d %d %d", &k, &m, &w, &packetsize, &buffersize) != 5) {
-		fprintf(stderr, "Parameters are not correct\n");
-		exit(0);
+	meta_store_close(mstore);
+
+	origsize = meta.origsize;
+	k = meta.k;
+	/* Parities added by scale-out are part of the stripe from now on */
+	m = meta.m_total;
+	w = meta.w;
+	packetsize = meta.packetsize;
+	buffersize = meta.buffersize;
+	tech = meta.tech;
+	method = tech;
+	readins = meta.readins;
+	temp = (char *)malloc(sizeof(char)*(strlen(argv[1])+20));
+
+	pl = placement_load(NULL);
+	if (pl == NULL) {
+		fprintf(stderr, "Error: unable to load the placement map\n");
+		exit(1);
 	}
-	c_tech = (char *)malloc(sizeof(char)*(strlen(argv[1])+20));
-	if (fscanf(fp, "%s", c_tech) != 1) {
-		fprintf(stderr, "Metadata file - bad format\n");
-		exit(0);
+	if (meta.store == FRAG_STORE_MEM) {
+		fprintf(stderr, "Error: %s was encoded into the in-memory fragment store, which does not outlive the encoder\n", cs1);
+		exit(1);
 	}
-	if (fscanf(fp, "%d", &tech) != 1) {
-		fprintf(stderr, "Metadata file - bad format\n");
-		exit(0);
+	fstore = frag_store_open(meta.store, pl);
+	if (fstore == NULL) {
+		fprintf(stderr, "Error: unable to open %s fragment store\n", frag_store_kind_name(meta.store));
+		exit(1);
 	}
-	method = tech;
-	if (fscanf(fp, "%d", &readins) != 1) {
-		fprintf(stderr, "Metadata file - bad format\n");
-		exit(0);
+	/* "io agent": move fragments of nodes with an agent over the network */
+	if (pl->io == PLACE_IO_AGENT) {
+		fstore = frag_remote_open(fstore, pl);
+		if (fstore == NULL) {
+			fprintf(stderr, "Error: unable to open %s fragment store\n", "remote");
+			exit(1);
+		}
 	}
-	fclose(fp);
-
-
-//whcho add
-//Now, thanks to encoder.c  k=24 remain unchanged but m=6 -> 12 should be changed !!!!
-
-m=m+6;
-
-	
 
 	/* Allocate memory */
 	erased = (int *)malloc(sizeof(int)*(k+m));
@@ -222,21 +315,34 @@ m=m+6;
 		erased[i] = 0;
 	erasures = (int *)malloc(sizeof(int)*(k+m));
 
-	data = (char **)malloc(sizeof(char *)*k);
+	plan_erased = (int *)malloc(sizeof(int)*(k+m));
+	rb = NULL;
+	wk = workers_start(0);
+	if (wk != NULL) printf("Decoding on %d threads\n", workers_threads(wk));
+	if (tech == Reed_Sol_Van || tech == Reed_Sol_R6_Op) galois_init_default_field(w);
+	nslots = (wk != NULL && buffersize != origsize && readins > 1) ? 2 : 1;
+	for (slot = 0; slot < 2; slot++) {
+		dslot[slot] = (char **)malloc(sizeof(char *)*k);
+		memset(dslot[slot], 0, sizeof(char *)*k);
+	}
+	data = dslot[0];
 	coding = (char **)malloc(sizeof(char *)*m);
+	memset(coding, 0, sizeof(char *)*m);
 	if (buffersize != origsize) {
-		for (i = 0; i < k; i++) {
-			data[i] = (char *)malloc(sizeof(char)*(buffersize/k));
+		for (slot = 0; slot < nslots; slot++) {
+			for (i = 0; i < k; i++) {
+				dslot[slot][i] = buf_pool_get(buffersize/k);
+			}
 		}
 		for (i = 0; i < m; i++) {
-			coding[i] = (char *)malloc(sizeof(char)*(buffersize/k));
+			coding[i] = buf_pool_get(buffersize/k);
 		}
 		blocksize = buffersize/k;
 	}
 
 	sprintf(temp, "%d", k);
 	md = strlen(temp);
-	timing_set(&t3);
+	instr_begin(&sc, ph_setup, -1, -1);
 
 	/* Create coding matrix or bitmatrix */
 	switch(tech) {
@@ -244,17 +350,30 @@ m=m+6;
 			break;
 		case Reed_Sol_Van:
 			//matrix = reed_sol_vandermonde_coding_matrix(k, m, w);
-			matrix = reed_sol_vandermonde_decoding_matrix(k, m, w);
+			matrix = reed_sol_vandermonde_decoding_matrix(k, meta.m, m, w);
+			if (matrix == NULL) {
+				fprintf(stderr, "Error: unable to rebuild the coding matrix of %s\n", cs1);
+				exit(1);
+			}
 			break;
 		case Reed_Sol_R6_Op:
 			matrix = reed_sol_r6_coding_matrix(k, w);
 			break;
 		case Cauchy_Orig:
-			matrix = cauchy_original_coding_matrix(k, m, w);
-			bitmatrix = jerasure_matrix_to_bitmatrix(k, m, w, matrix);
-			break;
 		case Cauchy_Good:
-			matrix = cauchy_good_general_coding_matrix(k, m, w);
+			/* The encoder's m rows, then any rows scale-out added */
+			if (tech == Cauchy_Orig) matrix = cauchy_original_coding_matrix(k, meta.m, w);
+			else matrix = cauchy_good_general_coding_matrix(k, meta.m, w);
+			if (matrix != NULL && m > meta.m) {
+				ext = elastic_cauchy_extension(k, meta.m, m-meta.m, w, matrix, tech == Cauchy_Good);
+				if (ext == NULL) {
+					fprintf(stderr, "Error: unable to rebuild the scale-out rows of %s\n", cs1);
+					exit(1);
+				}
+				matrix = (int *)realloc(matrix, sizeof(int)*m*k);
+				memcpy(matrix+meta.m*k, ext, sizeof(int)*(m-meta.m)*k);
+				free(ext);
+			}
 			bitmatrix = jerasure_matrix_to_bitmatrix(k, m, w, matrix);
 			break;
 		case Liberation:
@@ -266,124 +385,133 @@ m=m+6;
 		case Liber8tion:
 			bitmatrix = liber8tion_coding_bitmatrix(k);
 	}
-	timing_set(&t4);
-	totalsec += timing_delta(&t3, &t4);
+	instr_end(&sc);
 
 
-// whcho added
-//timing_set(&t_read_start);
-
+	/* Create decoded file */
+	sprintf(fname, "%s/%s_decoded%s", pl->output, cs1, extension);
+	fp = fopen(fname, "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "Error: unable to create %s\n", fname);
+		exit(1);
+	}
+	if (nslots == 2) {
+		memset(&wr, 0, sizeof(wr));
+		pthread_mutex_init(&wr.lock, NULL);
+		pthread_cond_init(&wr.cond, NULL);
+		wr.fp = fp;
+		wr.stripes[0] = dslot[0];
+		wr.stripes[1] = dslot[1];
+		wr.k = k;
+		wr.blocksize = blocksize;
+		wr.origsize = origsize;
+		wr.ph_write = ph_write;
+		if (pthread_create(&wr.tid, NULL, writer_main, &wr) != 0) {
+			fprintf(stderr, "Error: unable to start the writer thread\n");
+			exit(1);
+		}
+	}
 
-	
 	/* Begin decoding process */
 	total = 0;
 	n = 1;	
 	while (n <= readins) {
 		numerased = 0;
-		
-// whcho added
-timing_set(&t_read_start);
+		for (i = 0; i < k+m; i++) erased[i] = 0;
+
+		/* Wait for the writer to finish with this slot's last stripe */
+		slot = (n-1) % nslots;
+		data = dslot[slot];
+		if (nslots == 2) {
+			pthread_mutex_lock(&wr.lock);
+			while (wr.written < n-2) pthread_cond_wait(&wr.cond, &wr.lock);
+			pthread_mutex_unlock(&wr.lock);
+		}
 
 		/* Open files, check for erasures, read in data/coding */	
 		for (i = 1; i <= k; i++) {
-			
 
 //whcho add
 /* /mnt/node1 ~ /mnt/node8  */
 
 //integer=(i+1)/2;
-integer=(i+2)/3;
+integer=meta.location[i-1];
 printf("y= %d\n",integer);
+			instr_begin(&sc, ph_read, integer, i-1);
 
 
 			//sprintf(fname, "%s/Coding/%s_k%0*d%s", curdir, cs1, md, i, extension);
 			//sprintf(fname, "%s/Coding/Node%d/%s_k%0*d%s", curdir, integer, cs1, md, i, extension);
-//whcho add			
-sprintf(fname, "/mnt/node%d/%s_k%0*d%s",  integer, cs1, md, i, extension);
+			sprintf(fname, "%s_k%0*d%s", cs1, md, i, extension);
 
-			fp = fopen(fname, "rb");
-			if (fp == NULL) {
+			/* A failed or short read is an erasure, as a missing fragment is */
+			fsize = fstore->size(fstore, integer, fname);
+			if (fsize >= 0) {
+				if (buffersize == origsize) {
+					blocksize = fsize;
+					data[i-1] = buf_pool_get(blocksize);
+					if (fstore->read(fstore, integer, fname, 0, data[i-1], blocksize) != blocksize) fsize = -1;
+				}
+				else if (fstore->read(fstore, integer, fname, (int64_t) blocksize*(n-1), data[i-1], buffersize/k) != buffersize/k) {
+					fsize = -1;
+				}
+			}
+			if (fsize < 0) {
 				erased[i-1] = 1;
 				erasures[numerased] = i-1;
 				numerased++;
 				//printf("%s failed\n", fname);
 			}
-			else {
-				if (buffersize == origsize) {
-					stat(fname, &status);
-					blocksize = status.st_size;
-					data[i-1] = (char *)malloc(sizeof(char)*blocksize);
-					assert(blocksize == fread(data[i-1], sizeof(char), blocksize, fp));
-				}
-				else {
-					fseek(fp, blocksize*(n-1), SEEK_SET); 
-					assert(buffersize/k == fread(data[i-1], sizeof(char), buffersize/k, fp));
-				}
-				fclose(fp);
-			}
+			instr_end_bytes(&sc, (fsize < 0) ? 0 : blocksize);
 		}
-// whcho added
-timing_set(&t_read_end);   /* Assumption : in case of all data fragments are alive */
-	
 
 
-	
 		for (i = 1; i <= m; i++) {
 			
 //whcho added
 /* /mnt/node9  /mnt/node10  */
 
 //integer=(k+1+i)/2;
-integer=(k+2+i)/3;
+integer=meta.location[k+i-1];
 printf("y= %d\n",integer);
+			instr_begin(&sc, ph_read, integer, k+i-1);
 				
 				//sprintf(fname, "%s/Coding/%s_m%0*d%s", curdir, cs1, md, i, extension);
 				//sprintf(fname, "%s/Coding/Node%d/%s_m%0*d%s", curdir, integer, cs1, md, i, extension);
 
 
-				sprintf(fname, "/mnt/node%d/%s_m%0*d%s",  integer    , cs1, md, i, extension);
-
+				sprintf(fname, "%s_m%0*d%s", cs1, md, i, extension);
 
-				
-
-				fp = fopen(fname, "rb");
-			if (fp == NULL) {
+			fsize = fstore->size(fstore, integer, fname);
+			if (fsize >= 0) {
+				if (buffersize == origsize) {
+					blocksize = fsize;
+					coding[i-1] = buf_pool_get(blocksize);
+					if (fstore->read(fstore, integer, fname, 0, coding[i-1], blocksize) != blocksize) fsize = -1;
+				}
+				else if (fstore->read(fstore, integer, fname, (int64_t) blocksize*(n-1), coding[i-1], blocksize) != blocksize) {
+					fsize = -1;
+				}
+			}
+			if (fsize < 0) {
 				erased[k+(i-1)] = 1;
 				erasures[numerased] = k+i-1;
 				numerased++;
 				//printf("%s failed\n", fname);
 			}
-			else {
-				if (buffersize == origsize) {
-					stat(fname, &status);
-					blocksize = status.st_size;
-					coding[i-1] = (char *)malloc(sizeof(char)*blocksize);
-					assert(blocksize == fread(coding[i-1], sizeof(char), blocksize, fp));
-				}
-				else {
-					fseek(fp, blocksize*(n-1), SEEK_SET);
-					assert(blocksize == fread(coding[i-1], sizeof(char), blocksize, fp));
-				}	
-				fclose(fp);
-			}
+			instr_end_bytes(&sc, (fsize < 0) ? 0 : blocksize);
 		}
 
 //whcho added
 printf("Number of Erased Node = %d \n",numerased);
 
-// whcho added
-//timing_set(&t_read_end);
-
 		/* Finish allocating data/coding if needed */
-		if (n == 1) {
+		if (n <= nslots) {
 			for (i = 0; i < numerased; i++) {
 				if (erasures[i] < k) {
-					data[erasures[i]] = (char *)malloc(sizeof(char)*blocksize);
+					if (data[erasures[i]] == NULL) data[erasures[i]] = buf_pool_get(blocksize);
 				}
 				else {
-					coding[erasures[i]-k] = (char *)malloc(sizeof(char)*blocksize);
-	
-
 //whcoh added
 printf("must exist Erased node\n");
 
@@ -391,90 +519,82 @@ printf("must exist Erased node\n");
 
 			}
 		}
-		
-// whcho added
-//timing_set(&t_read_end);
-		
 
 		erasures[numerased] = -1;
-		timing_set(&t3);
-	
-		/* Choose proper decoding method */
-		if (tech == Reed_Sol_Van || tech == Reed_Sol_R6_Op) {
-			i = jerasure_matrix_decode(k, m, w, matrix, 1, erasures, data, coding, blocksize);
-		}
-		else if (tech == Cauchy_Orig || tech == Cauchy_Good || tech == Liberation || tech == Blaum_Roth || tech == Liber8tion) {
-			i = jerasure_schedule_decode_lazy(k, m, w, bitmatrix, erasures, data, coding, blocksize, packetsize, 1);
-		}
-		else {
+		if (tech != Reed_Sol_Van && tech != Reed_Sol_R6_Op && tech != Cauchy_Orig && tech != Cauchy_Good &&
+		    tech != Liberation && tech != Blaum_Roth && tech != Liber8tion) {
 			fprintf(stderr, "Not a valid coding technique.\n");
 			exit(0);
 		}
-		timing_set(&t4);
-	
+
+		/* One inverted matrix per erasure pattern, normally the first
+		   read-in's.  Only the lost data is rebuilt; nothing reads the
+		   lost parity. */
+		instr_begin(&sc, ph_setup, -1, -1);
+		if (rb == NULL || memcmp(plan_erased, erased, sizeof(int)*(k+m)) != 0) {
+			rebuild_free(rb);
+			rb = rebuild_plan(k, m, w, matrix, bitmatrix, packetsize, erased);
+			memcpy(plan_erased, erased, sizeof(int)*(k+m));
+		}
+		instr_end(&sc);
+
 		/* Exit if decoding was unsuccessful */
-		if (i == -1) {
+		if (rb == NULL) {
 			fprintf(stderr, "Unsuccessful!\n");
 			exit(0);
 		}
 
+		instr_begin(&sc, ph_compute, -1, -1);
+		rebuild_run(rb, wk, data, coding, blocksize);
+		instr_end_bytes(&sc, (int64_t) rb->nlost*blocksize);
 
-
-	
-		/* Create decoded file */
-//whcho added
-
-		//sprintf(fname, "%s/Coding/%s_decoded%s", curdir, cs1, extension);
-		sprintf(fname, "/mnt/node11/%s_decoded%s", cs1, extension);
-		if (n == 1) {
-			fp = fopen(fname, "wb");
+		/* Hand the stripe to the writer, or write it here */
+		if (nslots == 2) {
+			pthread_mutex_lock(&wr.lock);
+			wr.posted = n;
+			pthread_cond_broadcast(&wr.cond);
+			pthread_mutex_unlock(&wr.lock);
 		}
 		else {
-			fp = fopen(fname, "ab");
-		}
-
-
-//whcho add
-timing_set(&t_write_start);
-
-		for (i = 0; i < k; i++) {
-			if (total+blocksize <= origsize) {
-				fwrite(data[i], sizeof(char), blocksize, fp);
-				total+= blocksize;
-			}
-			else {
-				for (j = 0; j < blocksize; j++) {
-					if (total < origsize) {
-						fprintf(fp, "%c", data[i][j]);
-						total++;
-					}
-					else {
-						break;
-					}
-					
-				}
-			}
+			instr_begin(&sc, ph_write, -1, -1);
+			instr_end_bytes(&sc, write_stripe(fp, data, k, blocksize, origsize, &total));
 		}
 		n++;
-		fclose(fp);
-//whcho add
-timing_set(&t_write_end);
-
-		totalsec += timing_delta(&t3, &t4);
 	}
+	if (nslots == 2) {
+		pthread_mutex_lock(&wr.lock);
+		wr.done = 1;
+		pthread_cond_broadcast(&wr.cond);
+		pthread_mutex_unlock(&wr.lock);
+		pthread_join(wr.tid, NULL);
+		pthread_cond_destroy(&wr.cond);
+		pthread_mutex_destroy(&wr.lock);
+	}
+	fclose(fp);
 	
 	/* Free allocated memory */
+	fstore->close(fstore);
+	placement_free(pl);
 	free(cs1);
 	free(extension);
 	free(fname);
-	free(data);
+	for (slot = 0; slot < 2; slot++) {
+		for (i = 0; i < k; i++) buf_pool_put(dslot[slot][i]);
+		free(dslot[slot]);
+	}
+	for (i = 0; i < m; i++) buf_pool_put(coding[i]);
 	free(coding);
+	rebuild_free(rb);
+	free(plan_erased);
+	workers_stop(wk);
 	free(erasures);
 	free(erased);
 	
-	/* Stop timing and print time */
-	timing_set(&t2);
-	tsec = timing_delta(&t1, &t2);
+	/* Stop timing and print time.  Decoding time counts building the
+	   matrix as well as the decode calls. */
+	instr_end(&sc_total);
+	tsec = instr_seconds(ph_total);
+	totalsec = instr_seconds(ph_setup) + instr_seconds(ph_compute);
 	printf("Decoding (MB/sec): %0.6f\n", (((double) origsize)/1024.0/1024.0)/totalsec);
 	printf("De_Total (MB/sec): %0.6f\n\n", (((double) origsize)/1024.0/1024.0)/tsec);
 
@@ -482,14 +602,13 @@ timing_set(&t_write_end);
 printf("De_Total Time (sec): %0.6f\n\n", totalsec);
 printf("De_Total Time (sec): %0.6f\n\n", tsec);
 
+printf("Total Read  Time (sec): %0.6f\n\n", instr_seconds(ph_read));
+printf("Total Write  Time (sec): %0.6f\n\n", instr_seconds(ph_write));
 
-// whcho added
-total_read += timing_delta(&t_read_start, &t_read_end);
-printf("Total Read  Time (sec): %0.6f\n\n", total_read);
-
-total_write += timing_delta(&t_write_start, &t_write_end);
-printf("Total Write  Time (sec): %0.6f\n\n", total_write);
-
+	/* Bytes read per node and reconstructed, against the object size */
+	instr_output("decode", origsize);
+	instr_summary(stdout, "decode");
+	instr_finish();
 
 	return 0;
 }	
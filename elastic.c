@@ -0,0 +1,239 @@
+/* elastic.c - partial-parity scale-out.  See elastic.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "galois.h"
+#include "jerasure.h"
+#include "cauchy.h"
+#include "reed_sol.h"
+#include "elastic.h"
+#include "gf_kernel.h"
+#include "xor_sched.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+int *elastic_extension_matrix(int k, int m, int m_new, int w)
+{
+  int *full, *ext;
+
+  full = reed_sol_vandermonde_decoding_matrix(k, m, m+m_new, w);
+  if (full == NULL) return NULL;
+  ext = talloc(int, m_new*k);
+  if (ext == NULL) {
+    free(full);
+    return NULL;
+  }
+  memcpy(ext, full+m*k, sizeof(int)*m_new*k);
+  free(full);
+  return ext;
+}
+
+/* Bit matrix ones of row times c */
+static int row_ones(int k, int w, const int *row, int c)
+{
+  int j, n;
+
+  n = 0;
+  for (j = 0; j < k; j++) n += cauchy_n_ones(galois_single_multiply(row[j], c, w), w);
+  return n;
+}
+
+int *elastic_cauchy_extension(int k, int m, int m_new, int w, int *matrix, int improve)
+{
+  int *col, *ext, *row;
+  int i, j, z, r, x, t, best, ones, c;
+
+  if (w < 31 && k+m+m_new > (1 << w)) return NULL;
+  col = talloc(int, k);
+  ext = talloc(int, m_new*k);
+  if (col == NULL || ext == NULL) {
+    free(col);
+    free(ext);
+    return NULL;
+  }
+
+  /* matrix[i][j] = r_i * col[j] / (i ^ (m+j)), as jerasure builds it
+     with points 0..m-1 for the rows and m..m+k-1 for the columns.
+     Row 0 is never rescaled, which gives col[], and then each r_i. */
+  for (j = 0; j < k; j++) col[j] = galois_single_multiply(matrix[j], m+j, w);
+  for (i = 0; i < m; i++) {
+    r = galois_single_divide(galois_single_multiply(matrix[i*k], i ^ m, w), col[0], w);
+    for (j = 0; j < k; j++) {
+      if (matrix[i*k+j] != galois_single_divide(galois_single_multiply(r, col[j], w), i ^ (m+j), w)) {
+        free(col);
+        free(ext);
+        return NULL;
+      }
+    }
+  }
+
+  /* New rows take the points m+k.. that neither side uses.  As
+     cauchy_improve_coding_matrix() does, a row may be scaled so that one
+     of its elements is 1 if that leaves fewer ones in its bit matrix. */
+  for (z = 0; z < m_new; z++) {
+    row = ext + z*k;
+    x = m+k+z;
+    for (j = 0; j < k; j++) row[j] = galois_single_divide(col[j], x ^ (m+j), w);
+    if (!improve) continue;
+    best = 1;
+    ones = row_ones(k, w, row, 1);
+    for (j = 0; j < k; j++) {
+      if (row[j] == 1) continue;
+      c = galois_single_divide(1, row[j], w);
+      t = row_ones(k, w, row, c);
+      if (t < ones) {
+        ones = t;
+        best = c;
+      }
+    }
+    for (j = 0; j < k; j++) row[j] = galois_single_multiply(row[j], best, w);
+  }
+  free(col);
+  return ext;
+}
+
+/* The region kernels, one source at a time: what w=32 and a failed plan
+   of the faster forms come down to */
+static void partial_regions(int w, int nsrc, const int *coefs, char **srcs, char *dst, int size)
+{
+  int i, started;
+
+  /* Coefficients of 0 cost nothing and of 1 only an XOR */
+  started = 0;
+  for (i = 0; i < nsrc; i++) {
+    if (coefs[i] == 0) continue;
+    if (coefs[i] == 1) {
+      if (started) galois_region_xor(srcs[i], dst, size); else memcpy(dst, srcs[i], size);
+      started = 1;
+      continue;
+    }
+    switch (w) {
+      case 8:  galois_w08_region_multiply(srcs[i], coefs[i], size, dst, started); break;
+      case 16: galois_w16_region_multiply(srcs[i], coefs[i], size, dst, started); break;
+      default: galois_w32_region_multiply(srcs[i], coefs[i], size, dst, started); break;
+    }
+    started = 1;
+  }
+  if (!started) memset(dst, 0, size);
+}
+
+void elastic_partial_parity(int w, int nsrc, int *coefs, char **srcs, char *dst, int size)
+{
+  elastic_partial_t *ep;
+
+  ep = elastic_partial_new(w, 0, nsrc, coefs);
+  if (ep == NULL) {
+    fprintf(stderr, "elastic_partial_parity: w=%d is not supported\n", w);
+    exit(1);
+  }
+  elastic_partial_run(ep, srcs, dst, size);
+  elastic_partial_free(ep);
+}
+
+struct elastic_partial {
+  int w, packetsize, nsrc;
+  int *coefs;
+  int zero;                      /* every coefficient is 0 */
+  int *bitmatrix;
+  int **schedule;
+  xor_sched_t *xs;               /* NULL: jerasure runs the schedule */
+  gf_rows_t *gr;                 /* w=8: the row on the gf_kernel.h kernel */
+  struct gf16_coef *gc;          /* w=16: the row for the dot kernel */
+};
+
+elastic_partial_t *elastic_partial_new(int w, int packetsize, int nsrc, const int *coefs)
+{
+  elastic_partial_t *ep;
+  int i;
+
+  if (packetsize <= 0 && w != 8 && w != 16 && w != 32) return NULL;
+  ep = talloc(elastic_partial_t, 1);
+  if (ep == NULL) return NULL;
+  memset(ep, 0, sizeof(*ep));
+  ep->w = w;
+  ep->packetsize = packetsize;
+  ep->nsrc = nsrc;
+  ep->coefs = talloc(int, (nsrc > 0) ? nsrc : 1);
+  if (ep->coefs == NULL) {
+    free(ep);
+    return NULL;
+  }
+  memcpy(ep->coefs, coefs, sizeof(int) * nsrc);
+
+  /* Any nonzero coefficient has a bit matrix with no zero row, so the
+     schedule writes all of dst unless every coefficient is 0 */
+  for (i = 0; i < nsrc && coefs[i] == 0; i++) ;
+  ep->zero = (i == nsrc);
+  if (packetsize > 0 && !ep->zero) {
+    ep->bitmatrix = jerasure_matrix_to_bitmatrix(nsrc, 1, w, ep->coefs);
+    ep->schedule = (ep->bitmatrix == NULL) ? NULL : jerasure_smart_bitmatrix_to_schedule(nsrc, 1, w, ep->bitmatrix);
+    if (ep->schedule == NULL) {
+      elastic_partial_free(ep);
+      return NULL;
+    }
+    ep->xs = xor_sched_new(nsrc, 1, w, packetsize, ep->schedule);
+  }
+
+  /* w=8: one pass over all sources, multiplying each distinct coefficient
+     once; w=16 likewise, as one row of the dot kernel */
+  if (packetsize <= 0 && !ep->zero && w == 8) ep->gr = gf_rows_new(nsrc, 1, ep->coefs);
+  if (packetsize <= 0 && !ep->zero && w == 16) {
+    ep->gc = talloc(struct gf16_coef, nsrc);
+    for (i = 0; ep->gc != NULL && i < nsrc; i++) gf16_coef_init(ep->gc + i, coefs[i]);
+  }
+  return ep;
+}
+
+void elastic_partial_run(elastic_partial_t *ep, char **srcs, char *dst, int size)
+{
+  if (ep->zero) {
+    memset(dst, 0, size);
+  } else if (ep->xs != NULL) {
+    xor_sched_encode(ep->xs, srcs, &dst, size);
+  } else if (ep->schedule != NULL) {
+    jerasure_schedule_encode(ep->nsrc, 1, ep->w, ep->schedule, srcs, &dst, size, ep->packetsize);
+  } else if (ep->gr != NULL) {
+    gf_rows_run(ep->gr, srcs, &dst, 0, size, 0);
+  } else if (ep->gc != NULL) {
+    gf_kernel()->dot16(ep->nsrc, 1, ep->gc, srcs, &dst, 0, size, 0);
+  } else {
+    partial_regions(ep->w, ep->nsrc, ep->coefs, srcs, dst, size);
+  }
+}
+
+void elastic_partial_free(elastic_partial_t *ep)
+{
+  if (ep == NULL) return;
+  xor_sched_free(ep->xs);
+  if (ep->schedule != NULL) jerasure_free_schedule(ep->schedule);
+  free(ep->bitmatrix);
+  if (ep->gr != NULL) gf_rows_free(ep->gr);
+  free(ep->gc);
+  free(ep->coefs);
+  free(ep);
+}
+
+void elastic_partial_xor(int w, int packetsize, int nsrc, int *coefs, char **srcs, char *dst, int size)
+{
+  elastic_partial_t *ep;
+
+  ep = elastic_partial_new(w, packetsize, nsrc, coefs);
+  if (ep == NULL) {
+    fprintf(stderr, "elastic_partial_xor: unable to plan the partial parity\n");
+    exit(1);
+  }
+  elastic_partial_run(ep, srcs, dst, size);
+  elastic_partial_free(ep);
+}
+
+/* One pass over all the partials, whatever w, since they are only XORed */
+void elastic_aggregate(int nparts, char **parts, char *dst, int size)
+{
+  if (nparts <= 0) {
+    memset(dst, 0, size);
+    return;
+  }
+  gf_kernel()->xors(nparts, parts, dst, 0, size);
+}
@@ -0,0 +1,58 @@
+/* elastic.h - partial-parity scale-out for Reed-Solomon and Cauchy stripes.
+ *
+ * A new parity row P = sum_j c_j * D_j is computed without moving data:
+ * each node that holds data fragments computes the partial parity over
+ * its own fragments, and the node that will hold P XORs the partials.
+ *
+ * The Cauchy techniques extend their matrix with rows 1/(x ^ y_j) for
+ * new points x, scaled as the encoder's rows were, so the stripe stays
+ * MDS and the parities already written stay valid.  Their partials are
+ * computed as jerasure does: each coefficient becomes a w x w bit
+ * matrix, and the partial parity an XOR schedule over the node's packets.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Rows m..m+m_new-1 of the extended coding matrix, as an m_new x k
+   matrix.  These are the rows the decoder uses for the new parities. */
+extern int *elastic_extension_matrix(int k, int m, int m_new, int w);
+
+/* Rows m..m+m_new-1 of the Cauchy matrix that matrix, the m x k result
+   of cauchy_original_coding_matrix() (improve = 0) or
+   cauchy_good_general_coding_matrix() (improve = 1), is the top of.  NULL
+   if matrix is not of that form or k+m+m_new > 2^w. */
+extern int *elastic_cauchy_extension(int k, int m, int m_new, int w, int *matrix, int improve);
+
+/* A node's partial parity for one new row, planned once and run for
+   every read-in: the bitmatrix, XOR schedule and compiled schedule of a
+   bitmatrix code (packetsize > 0), or the gf_kernel.h plan of the row
+   for the others.  NULL if it cannot be planned, or w is not 8, 16 or
+   32 for a code that is not a bitmatrix one. */
+typedef struct elastic_partial elastic_partial_t;
+
+extern elastic_partial_t *elastic_partial_new(int w, int packetsize, int nsrc, const int *coefs);
+
+/* dst = the planned row times srcs, over size bytes (a multiple of
+   w*packetsize for a bitmatrix code) */
+extern void elastic_partial_run(elastic_partial_t *ep, char **srcs, char *dst, int size);
+extern void elastic_partial_free(elastic_partial_t *ep);
+
+/* One-shot forms of the above, which plan on every call */
+
+/* dst = sum coefs[i] * srcs[i] over nsrc regions of size bytes */
+extern void elastic_partial_parity(int w, int nsrc, int *coefs, char **srcs, char *dst, int size);
+
+/* The same for a bitmatrix code, with XORs only: size is a multiple of
+   w*packetsize, and srcs[i] is multiplied by the bit matrix of coefs[i] */
+extern void elastic_partial_xor(int w, int packetsize, int nsrc, int *coefs, char **srcs, char *dst, int size);
+
+/* dst = XOR of the nparts partial parities */
+extern void elastic_aggregate(int nparts, char **parts, char *dst, int size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -62,21 +62,36 @@ is the file name with "_k#" or "_m#" and then the extension.
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <unistd.h>
 #include <signal.h>
+#include <pthread.h>
 #include <gf_rand.h>
 #include "jerasure.h"
 #include "reed_sol.h"
 #include "cauchy.h"
 #include "liberation.h"
+#include "meta_store.h"
+#include "frag_store.h"
+#include "placement.h"
+#include "transport.h"
+#include "elastic.h"
+#include "instr.h"
+#include "buf_pool.h"
+#include "workers.h"
+#include "slices.h"
+#include "tile_encode.h"
+#include "xor_sched.h"
 
 //whcho added
 #include "galois.h" 
 #include <math.h>
-#include "timing.h" 
 
 
 #define N 10
 
+/* Parities added to every object by scale-out */
+#define NEW_PARITIES 6
+
 
 
 enum Coding_Technique {Reed_Sol_Van, Reed_Sol_R6_Op, Cauchy_Orig, Cauchy_Good, Liberation, Blaum_Roth, Liber8tion, RDP, EVENODD, No_Coding};
@@ -101,9 +116,108 @@ int jfread(void *ptr, int size, int nmembers, FILE *stream)
   return size;
 }
 
+/* What encode_slice() needs to code one column slice of a stripe */
+struct encode_ctx {
+	enum Coding_Technique tech;
+	int k, m, w, packetsize;
+	int *matrix;
+	int **schedule;
+	tile_code_t *tc;		/* blocked kernel for reed_sol_van */
+	xor_sched_t *xs;		/* vector executor for the schedule */
+};
+
+/* ptrs[0..k-1] are the data and ptrs[k..k+m-1] the coding slices */
+void encode_slice(void *arg, char **ptrs, int len)
+{
+	struct encode_ctx *ec;
+
+	ec = (struct encode_ctx *) arg;
+	switch(ec->tech) {	
+		case No_Coding:
+			break;
+		case Reed_Sol_Van:
+			if (ec->tc != NULL) tile_encode(ec->tc, ptrs, ptrs+ec->k, len);
+			else jerasure_matrix_encode(ec->k, ec->m, ec->w, ec->matrix, ptrs, ptrs+ec->k, len);
+			break;
+		case Reed_Sol_R6_Op:
+			reed_sol_r6_encode(ec->k, ec->w, ptrs, ptrs+ec->k, len);
+			break;
+		case Cauchy_Orig:
+		case Cauchy_Good:
+		case Liberation:
+		case Blaum_Roth:
+		case Liber8tion:
+			if (ec->xs != NULL) xor_sched_encode(ec->xs, ptrs, ptrs+ec->k, len);
+			else jerasure_schedule_encode(ec->k, ec->m, ec->w, ec->schedule, ptrs, ptrs+ec->k, len, ec->packetsize);
+			break;
+		default:
+			break;
+	}
+}
+
+/* Scale-out work of one data node for one read-in: read its data
+   fragments, multiply them into a partial parity and hand that to the
+   new parity's node.  Runs on a worker near the node's disk. */
+struct partial_job {
+	frag_store_t *fstore;
+	const char *s1, *extension;
+	int md;
+	int node;			/* data node */
+	int group;			/* its index among the data nodes */
+	int newnode, newfrag, z;	/* new parity z: its node and fragment */
+	int nsrc;
+	int *frags;			/* data fragments on node */
+	elastic_partial_t *plan;	/* ... times their coefficients in row z */
+	char **srcs;
+	char *dst;
+	int blocksize;
+	int64_t offset;
+	int random;			/* no input file: unreadable data is random */
+};
+
+int ph_so_read, ph_so_partial, ph_so_transfer;
+pthread_mutex_t random_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void partial_job_run(void *arg)
+{
+	struct partial_job *pj;
+	struct instr_scope sc;
+	char fname[FRAG_KEY_MAX];
+	int g, i;
+
+	pj = (struct partial_job *) arg;
+	for (g = 0; g < pj->nsrc; g++) {
+		i = pj->frags[g];
+		instr_begin(&sc, ph_so_read, pj->node, i);
+		snprintf(fname, sizeof(fname), "%s_k%0*d%s", pj->s1, pj->md, i+1, pj->extension);
+		if (pj->fstore->read(pj->fstore, pj->node, fname, pj->offset, pj->srcs[g], pj->blocksize) != pj->blocksize) {
+			if (!pj->random) {
+				fprintf(stderr, "Unable to read %s from node %d\n", fname, pj->node);
+				exit(1);
+			}
+			pthread_mutex_lock(&random_lock);
+			MOA_Fill_Random_Region(pj->srcs[g], pj->blocksize);
+			pthread_mutex_unlock(&random_lock);
+		}
+		instr_end_bytes(&sc, pj->blocksize);
+	}
+
+	instr_begin(&sc, ph_so_partial, pj->node, -1);
+	elastic_partial_run(pj->plan, pj->srcs, pj->dst, pj->blocksize);
+	instr_end_bytes(&sc, pj->blocksize);
+
+	instr_begin(&sc, ph_so_transfer, pj->newnode, pj->newfrag);
+	snprintf(fname, sizeof(fname), "%s_parity_%02d_%d%s", pj->s1, pj->group+1, pj->z+1, pj->extension);
+	if (pj->fstore->write(pj->fstore, pj->newnode, fname, pj->offset, pj->dst, pj->blocksize) != pj->blocksize) {
+		fprintf(stderr, "Unable to write %s to node %d\n", fname, pj->newnode);
+		exit(1);
+	}
+	instr_end_bytes(&sc, (pj->node != pj->newnode) ? pj->blocksize : 0);
+}
+
 
 int main (int argc, char **argv) {
-	FILE *fp, *fp2;				// file pointers
+	FILE *fp;				// file pointer
 	char *memblock;				// reading in file
 	char *block;				// padding file
 	int size, newsize;			// size of file and temp size 
@@ -114,6 +228,9 @@ int main (int argc, char **argv) {
 	int k, m, w, packetsize;		// parameters
 	int buffersize;					// paramter
 	int i, j;						// loop control variables
+	int mi;							// parities written at ingest
+	int scaleout;					// add NEW_PARITIES after encoding
+	char *env;
 	int blocksize;					// size of k+m files
 	int total;
 	int extra;
@@ -134,44 +251,45 @@ int main (int argc, char **argv) {
 	int md;
 	char *curdir;
 	
+	/* Parallel encoding: SWIFTER_THREADS threads code column slices */
+	workers_t *wk;
+	struct encode_ctx ec;
+	char **stripe;
+	int align;
+
 	/* Timing variables */
-	struct timeval t1, t2, t3, t4;
-	struct timezone tz;
+	struct instr_scope sc, sc_total;
+	int ph_total, ph_setup, ph_read, ph_compute, ph_write;
 	double tsec;
 	double totalsec;
-	struct timeval start, stop;
 
 	/* Find buffersize */
 	int up, down;
 
+	/* Metadata index */
+	struct meta_record meta;
+	meta_store_t *mstore;
+	char *meta_path;
 
-//whcho added
-int integer;
-struct timeval t_bus_start, t_bus_end;
-struct timeval t_read_start, t_read_end;
-struct timeval t_write_start, t_write_end;
-struct timeval t_cal_start, t_cal_end;
-struct timeval t_whcho_start, t_whcho_end;
-double t_total_time;
-double t_total_read ;
-double t_total_write ;
-double t_total_cal ;
-struct timing t_en_read_start, t_en_read_end ;
-struct timing t_en_write_start, t_en_write_end ;
-double t_total_en_read ;
-double t_total_en_write ;
-double t_whcho ;
-
+	/* Fragment store and placement map */
+	frag_store_t *fstore;
+	struct placement *pl;
 
 
 	signal(SIGQUIT, ctrl_bs_handler);
 
 	/* Start timing */
-	gettimeofday(&t1, &tz);
-	totalsec = 0.0;
+	ph_total = instr_phase("encode.total");
+	ph_setup = instr_phase("encode.setup");
+	ph_read = instr_phase("encode.read");
+	ph_compute = instr_phase("encode.compute");
+	ph_write = instr_phase("encode.write");
+	instr_begin(&sc_total, ph_total, -1, -1);
 	matrix = NULL;
 	bitmatrix = NULL;
 	schedule = NULL;
+	mstore = NULL;
+	meta_path = NULL;
 	
 	/* Error check Arguments*/
 	if (argc != 8) {
@@ -224,6 +342,11 @@ double t_whcho ;
 	k=3*k;
 	m=3*m;
 
+	/* Scale-out below adds parities, all of which the index must describe */
+	if (k+m+NEW_PARITIES > META_MAX_FRAGMENTS) {
+		fprintf(stderr, "k+m+%d must be at most %d\n", NEW_PARITIES, META_MAX_FRAGMENTS);
+		exit(0);
+	}
 
 
 	/* Determine proper buffersize by finding the closest valid buffersize to the input value  */
@@ -364,6 +487,23 @@ double t_whcho ;
 	/* Set global variable method for signal handler */
 	method = tech;
 
+	/* SWIFTER_PARITIES=m+NEW_PARITIES: the object is known to need the
+	   scaled-out parity count, so all of it is encoded from the input in
+	   one pass and scale-out does not run */
+	mi = m;
+	env = getenv("SWIFTER_PARITIES");
+	if (env != NULL) {
+		mi = atoi(env);
+		if (mi != m && mi != m+NEW_PARITIES) {
+			fprintf(stderr, "SWIFTER_PARITIES must be %d or %d\n", m, m+NEW_PARITIES);
+			exit(0);
+		}
+		if (mi > m && tech != Reed_Sol_Van) {
+			fprintf(stderr, "SWIFTER_PARITIES needs reed_sol_van\n");
+			exit(0);
+		}
+	}
+
 	/* Get current working directory for construction of file names */
 	curdir = (char*)malloc(sizeof(char)*1000);	
 	getcwd(curdir, 1000);
@@ -524,13 +664,13 @@ double t_whcho ;
 		else {
 			readins = newsize/buffersize;
 		}
-		block = (char *)malloc(sizeof(char)*buffersize);
+		block = buf_pool_get(buffersize);
 		blocksize = buffersize/k;
 	}
 	else {
 		readins = 1;
 		buffersize = size;
-		block = (char *)malloc(sizeof(char)*newsize);
+		block = buf_pool_get(newsize);
 	}
 
 //whcho added
@@ -558,31 +698,49 @@ double t_whcho ;
         }
 	
 	/* Allocate for full file name */
-	fname = (char*)malloc(sizeof(char)*(strlen(argv[1])+strlen(curdir)+20));
+	fname = (char*)malloc(sizeof(char)*(strlen(argv[1])+strlen(curdir)+FRAG_KEY_MAX));
 	sprintf(temp, "%d", k);
 	md = strlen(temp);
+
+	/* Every fragment key must fit in FRAG_KEY_MAX: the last scale-out
+	   parity and the intermediates of the last data node are the longest */
+	if (snprintf(NULL, 0, "%s_m%0*d%s", s1, md, m+NEW_PARITIES, extension) >= FRAG_KEY_MAX ||
+	    snprintf(NULL, 0, "%s_parity_%02d_%d%s", s1, k, NEW_PARITIES, extension) >= FRAG_KEY_MAX) {
+		fprintf(stderr, "%s: file name too long\n", argv[1]);
+		exit(0);
+	}
+
+	/* ... and the metadata index keys objects by name, which it must not cut */
+	if (strlen(s1) >= META_NAME_MAX || strlen(extension) >= META_EXT_MAX) {
+		fprintf(stderr, "%s: name must be under %d characters and extension under %d\n",
+		        argv[1], META_NAME_MAX, META_EXT_MAX);
+		exit(0);
+	}
 	
 	/* Allocate data and coding */
 	data = (char **)malloc(sizeof(char*)*k);
-	coding = (char **)malloc(sizeof(char*)*m);
-	for (i = 0; i < m; i++) {
-		coding[i] = (char *)malloc(sizeof(char)*blocksize);
+	coding = (char **)malloc(sizeof(char*)*mi);
+	for (i = 0; i < mi; i++) {
+		coding[i] = buf_pool_get(blocksize);
                 if (coding[i] == NULL) { perror("malloc"); exit(1); }
 	}
 
 	
 
 	/* Create coding matrix or bitmatrix and schedule */
-	gettimeofday(&t3, &tz);
+	instr_begin(&sc, ph_setup, -1, -1);
 	switch(tech) {
 		case No_Coding:
 			break;
 		case Reed_Sol_Van:
-			matrix = reed_sol_vandermonde_coding_matrix(k, m, w);
+			/* The extended rows are those the decoder and scale-out use;
+			   the first m are the coding matrix */
+			if (mi > m) matrix = reed_sol_vandermonde_decoding_matrix(k, m, mi, w);
+			else matrix = reed_sol_vandermonde_coding_matrix(k, m, w);
 			
 			//whcho added
 
-			jerasure_print_matrix(matrix, m, k, w);
+			jerasure_print_matrix(matrix, mi, k, w);
 			printf("\n\n\n");
 			break;
 
@@ -609,22 +767,74 @@ double t_whcho ;
 			schedule = jerasure_smart_bitmatrix_to_schedule(k, m, w, bitmatrix);
 			break;
 	}
-	gettimeofday(&start, &tz);	
-	gettimeofday(&t4, &tz);
-	tsec = 0.0;
-	tsec += t4.tv_usec;
-	tsec -= t3.tv_usec;
-	tsec /= 1000000.0;
-	tsec += t4.tv_sec;
-	tsec -= t3.tv_sec;
-	totalsec += tsec;
+	instr_end(&sc);
+
+	/* Describe the object for the metadata index */
+	memset(&meta, 0, sizeof(meta));
+	strncpy(meta.name, s1, META_NAME_MAX-1);
+	strncpy(meta.extension, extension, META_EXT_MAX-1);
+	strncpy(meta.technique, argv[4], META_TECH_MAX-1);
+	meta.origsize = size;
+	meta.fragment_size = (int64_t) blocksize * readins;
+	meta.k = k;
+	meta.m = m;
+	meta.w = w;
+	meta.packetsize = packetsize;
+	meta.buffersize = buffersize;
+	meta.tech = tech;
+	meta.readins = readins;
+	meta.blocksize = blocksize;
+	meta.m_total = mi;
+	meta.generation = 0;
+	meta.nfragments = k+mi;
+	/* SWIFTER_FRAG_STORE overrides the store named in the config */
+	pl = placement_load(NULL);
+	if (pl == NULL) {
+		fprintf(stderr, "Unable to load the placement map\n");
+		exit(1);
+	}
+	meta.store = frag_store_default_kind();
+	if (getenv("SWIFTER_FRAG_STORE") == NULL && pl->store >= 0) meta.store = pl->store;
 
-//whcho added
-t_total_en_read=0.0;
-t_total_en_write=0.0;
+	/* Scale-out parities are placed now too, so the map decides where they go */
+	if (placement_place(pl, k, m, NEW_PARITIES, meta.location) != 0) {
+		exit(1);
+	}
 
+	fstore = frag_store_open(meta.store, pl);
+	if (fstore == NULL) {
+		fprintf(stderr, "Unable to open %s fragment store\n", frag_store_kind_name(meta.store));
+		exit(1);
+	}
+	/* "io agent": move fragments of nodes with an agent over the network */
+	if (pl->io == PLACE_IO_AGENT) {
+		fstore = frag_remote_open(fstore, pl);
+		if (fstore == NULL) {
+			fprintf(stderr, "Unable to open %s fragment store\n", "remote");
+			exit(1);
+		}
+	}
 
-	
+	/* Bitmatrix codes slice on packet groups; the others on words */
+	ec.tech = tech;
+	ec.k = k;
+	ec.m = mi;
+	ec.w = w;
+	ec.packetsize = packetsize;
+	ec.matrix = matrix;
+	ec.schedule = schedule;
+	ec.tc = (tech == Reed_Sol_Van) ? tile_code_new(k, mi, w, matrix) : NULL;
+	ec.xs = (schedule != NULL) ? xor_sched_new(k, m, w, packetsize, schedule) : NULL;
+	align = (tech == Reed_Sol_Van || tech == Reed_Sol_R6_Op) ? w*(int)sizeof(long) : w*packetsize;
+	if (align <= 0) align = sizeof(long);
+	stripe = (char **)malloc(sizeof(char*)*(k+mi));
+	for (i = 0; i < mi; i++) stripe[k+i] = coding[i];
+	wk = workers_start(0);
+	if (wk != NULL) printf("Encoding on %d threads\n", workers_threads(wk));
+
+	/* galois builds its multiply tables on first use, which is not safe
+	   from several threads at once; the hand-typed matrix never made it */
+	if (tech == Reed_Sol_Van || tech == Reed_Sol_R6_Op) galois_init_default_field(w);
 
 	/* Read in data until finished */
 	n = 1;
@@ -634,10 +844,7 @@ t_total_en_write=0.0;
 
 
 	while (n <= readins) {
-
-//whcho added
-timing_set(&t_en_read_start);
-		
+		instr_begin(&sc, ph_read, -1, -1);
 
 		/* Check if padding is needed, if so, add appropriate 
 		   number of zeros */
@@ -660,136 +867,62 @@ timing_set(&t_en_read_start);
 		for (i = 0; i < k; i++) {
 			data[i] = block+(i*blocksize);
 		}
+		instr_end_bytes(&sc, buffersize);
 
-//whcho added
-timing_set(&t_en_read_end);
-
-
-
- 	 	gettimeofday(&t3, &tz);
-		/* Encode according to coding method */
-		switch(tech) {	
-			case No_Coding:
-				break;
-			case Reed_Sol_Van:
-				jerasure_matrix_encode(k, m, w, matrix, data, coding, blocksize);
-				break;
-			case Reed_Sol_R6_Op:
-				reed_sol_r6_encode(k, w, data, coding, blocksize);
-				break;
-			case Cauchy_Orig:
-				jerasure_schedule_encode(k, m, w, schedule, data, coding, blocksize, packetsize);
-				break;
-			case Cauchy_Good:
-				jerasure_schedule_encode(k, m, w, schedule, data, coding, blocksize, packetsize);
-				break;
-			case Liberation:
-				jerasure_schedule_encode(k, m, w, schedule, data, coding, blocksize, packetsize);
-				break;
-			case Blaum_Roth:
-				jerasure_schedule_encode(k, m, w, schedule, data, coding, blocksize, packetsize);
-				break;
-			case Liber8tion:
-				jerasure_schedule_encode(k, m, w, schedule, data, coding, blocksize, packetsize);
-				break;
-		}
-		gettimeofday(&t4, &tz);
-
-
-//whcho added
-timing_set(&t_en_write_start);
+		/* Encode according to coding method, a column slice per job */
+		instr_begin(&sc, ph_compute, -1, -1);
+		for (i = 0; i < k; i++) stripe[i] = data[i];
+		slices_run(wk, stripe, k+mi, blocksize, align, encode_slice, &ec);
+		instr_end_bytes(&sc, (tech == No_Coding) ? 0 : (int64_t) mi*blocksize);
 
-	
 		/* Write data and encoded data to k+m files */
 		for	(i = 1; i <= k; i++) {
+			instr_begin(&sc, ph_write, meta.location[i-1], i-1);
 			if (fp == NULL) {
 				bzero(data[i-1], blocksize);
  			} else {
-//whcho added
-/* /mnt/node1 ~ /mnt/node8  */
-/* Now,  3 data fragments in 1 node */
-
-
-//integer=(i+1)/2;
-integer=(i+2)/3;
-printf("integer= %d\n",integer);
-
-
-				//sprintf(fname, "%s/Coding/Node%d/%s_k%0*d%s", curdir, integer , s1, md, i, extension);
-				sprintf(fname, "/mnt/node%d/%s_k%0*d%s",  integer    , s1, md, i, extension);
-				if (n == 1) {
-					fp2 = fopen(fname, "wb");
-				}
-				else {
-					fp2 = fopen(fname, "ab");
+				sprintf(fname, "%s_k%0*d%s", s1, md, i, extension);
+				if (fstore->write(fstore, meta.location[i-1], fname, (int64_t) blocksize*(n-1), data[i-1], blocksize) != blocksize) {
+					fprintf(stderr, "Unable to write %s to node %d\n", fname, meta.location[i-1]);
+					exit(1);
 				}
-				fwrite(data[i-1], sizeof(char), blocksize, fp2);
-				fclose(fp2);
 			}
-			
+			instr_end_bytes(&sc, blocksize);
 		}
 
-		for	(i = 1; i <= m; i++) {
-			if (fp == NULL) {
-				bzero(data[i-1], blocksize);
- 			} else {
-//whcho added
-/* /mnt/node9 ~ /mnt/node10 for parity */
-				
-/* Now,  3 data fragments in 1 node */
-
-//integer=(k+1+i)/2;
-integer=(k+2+i)/3;
-printf("integer= %d\n",integer);
-
-				//sprintf(fname, "%s/Coding/Node%d/%s_m%0*d%s", curdir, integer , s1, md, i, extension);
-				sprintf(fname, "/mnt/node%d/%s_m%0*d%s", integer , s1, md, i, extension);
-				if (n == 1) {
-					fp2 = fopen(fname, "wb");
-				}
-				else {
-					fp2 = fopen(fname, "ab");
+		for	(i = 1; i <= mi; i++) {
+			instr_begin(&sc, ph_write, meta.location[k+i-1], k+i-1);
+			/* Random input writes nothing; data has only k regions to clear */
+			if (fp != NULL) {
+				sprintf(fname, "%s_m%0*d%s", s1, md, i, extension);
+				if (fstore->write(fstore, meta.location[k+i-1], fname, (int64_t) blocksize*(n-1), coding[i-1], blocksize) != blocksize) {
+					fprintf(stderr, "Unable to write %s to node %d\n", fname, meta.location[k+i-1]);
+					exit(1);
 				}
-				fwrite(coding[i-1], sizeof(char), blocksize, fp2);
-				fclose(fp2);
 			}
-		
-		
+			instr_end_bytes(&sc, blocksize);
 		}
 		n++;
 
-
-//whcho added
-timing_set(&t_en_write_end);
-
-
-
 //whcho added
 		//printf("n=%d\n",n);
 		//printf("total=%d\n",total);
 		printf("while() performed %d times \n",n-1);
-
-		/* Calculate encoding time */
-		tsec = 0.0;
-		tsec += t4.tv_usec;
-		tsec -= t3.tv_usec;
-		tsec /= 1000000.0;
-		tsec += t4.tv_sec;
-		tsec -= t3.tv_sec;
-		totalsec += tsec;
 	}
 
-	/* Create metadata file */
+	/* Record the object in the metadata index */
         if (fp != NULL) {
-		sprintf(fname, "%s/Coding/%s_meta.txt", curdir, s1);
-		fp2 = fopen(fname, "wb");
-		fprintf(fp2, "%s\n", argv[1]);
-		fprintf(fp2, "%d\n", size);
-		fprintf(fp2, "%d %d %d %d %d\n", k, m, w, packetsize, buffersize);
-		fprintf(fp2, "%s\n", argv[4]);
-		fprintf(fp2, "%d\n", tech);
-		fprintf(fp2, "%d\n", readins);
-		fclose(fp2);
+		if (fstore->sync(fstore) != 0) {
+			fprintf(stderr, "Unable to sync fragment store\n");
+			exit(1);
+		}
+		meta_path = (char *)malloc(sizeof(char)*(strlen(curdir)+strlen(META_STORE_FILE)+2));
+		sprintf(meta_path, "%s/%s", curdir, META_STORE_FILE);
+		mstore = meta_store_open(meta_path, 1);
+		if (mstore == NULL || meta_store_put(mstore, &meta) != 0) {
+			fprintf(stderr, "Unable to update metadata index %s\n", meta_path);
+			exit(1);
+		}
 	}
 
 
@@ -800,1569 +933,362 @@ timing_set(&t_en_write_end);
 	//free(block);
 	//free(curdir);
 	
-	/* Calculate rate in MB/sec and print */
-	gettimeofday(&t2, &tz);
-	tsec = 0.0;
-	tsec += t2.tv_usec;
-	tsec -= t1.tv_usec;
-	tsec /= 1000000.0;
-	tsec += t2.tv_sec;
-	tsec -= t1.tv_sec;
+	/* Calculate rate in MB/sec and print.  Encoding time counts building
+	   the coding matrix as well as the encode calls. */
+	instr_end(&sc_total);
+	tsec = instr_seconds(ph_total);
+	totalsec = instr_seconds(ph_setup) + instr_seconds(ph_compute);
 	printf("Encoding (MB/sec): %0.10f\n", (((double) size)/1024.0/1024.0)/totalsec);
 	printf("En_Total (MB/sec): %0.10f\n", (((double) size)/1024.0/1024.0)/tsec);
 //whcho added
 	printf("Encoding Time (sec): %0.5f\n", totalsec);
 	printf("En_Total Time (sec): %0.5f\n", tsec);
 
+	printf("Encoding Read Time (sec): %0.6f\n", instr_seconds(ph_read));
+	printf("Encoding Write Time (sec): %0.6f\n", instr_seconds(ph_write));
 
-//whcho added
-	t_total_en_read += timing_delta(&t_en_read_start, &t_en_read_end);
-	t_total_en_write += timing_delta(&t_en_write_start, &t_en_write_end);
-
-	printf("Encoding Read Time (sec): %0.6f\n", t_total_en_read);
-	printf("Encoding Write Time (sec): %0.6f\n", t_total_en_write);
-
-
-
-//whcho added 
-/*********************** Multipying factor and XOR     ***********************/
-///******************* 1. k1, k2 file open and open parity file *************************************/
-///******************* 2. allocate memory for k1, k2 */
-
-	
-/* Start timing */
-struct timeval t5,t6;
-gettimeofday(&t5, &tz);
-tsec = 0.0;
-	
-	
-char fname1[100];
-char fname2[100];
-char fname3[100];
-char p_fname[100];
-char *block1;
-char *block2;
-char **ori_data;
-char **p_coding;
-int counter=0;
-FILE *f_p1, *f_p2 , *f_p3, *p_fp ;
-
-int transfer_counter=0;
-FILE *src_fp , *dst_fp ;
-char t_fname[100];
-
-
-
-/* for XOR parity 8 times at the end */
-char *block3;
-char *block4;
-char *block5;
-char *block6;
-char *block7;
-char *block8;
-char **par_data;
-
-int index;
-
-//int buf[4][k];
-int buf[6][k];
-
-int buf_index;
-int z;
-//int integer;
-
-
-char *trans_block1;
-char *trans_block2;
-char *trans_block3;
-char *trans_block4;
-char *trans_block5;
-char *trans_block6;
-char *trans_block7;
-char *trans_block8;
-
-
-
-block3 = (char *)malloc(sizeof(char)*blocksize);
-block4 = (char *)malloc(sizeof(char)*blocksize);
-block5 = (char *)malloc(sizeof(char)*blocksize);
-block6 = (char *)malloc(sizeof(char)*blocksize);
-block7 = (char *)malloc(sizeof(char)*blocksize);
-block8 = (char *)malloc(sizeof(char)*blocksize);
-
-
-//ori_data = (char **)malloc(sizeof(char*)*2);
-ori_data = (char **)malloc(sizeof(char*)*3);
-block1 = (char *)malloc(sizeof(char)*blocksize);
-block2 = (char *)malloc(sizeof(char)*blocksize);
-
-
-p_coding = (char **)malloc(sizeof(char*)*8);
-
-
-trans_block1 = (char *)malloc(sizeof(char)*blocksize);
-trans_block2 = (char *)malloc(sizeof(char)*blocksize);
-trans_block3 = (char *)malloc(sizeof(char)*blocksize);
-trans_block4 = (char *)malloc(sizeof(char)*blocksize);
-trans_block5 = (char *)malloc(sizeof(char)*blocksize);
-trans_block6 = (char *)malloc(sizeof(char)*blocksize);
-trans_block7 = (char *)malloc(sizeof(char)*blocksize);
-trans_block8 = (char *)malloc(sizeof(char)*blocksize);
-
-
-char *dptr , *sptr; 
-
-
-
-/* Now, coefficients for 6 new parity m07 m08 m09 m10 m11 m12   */
-/* m07 parity */
-buf[0][0]=30;
-buf[0][1]=48;
-buf[0][2]=30;
-
-buf[0][3]=28;
-buf[0][4]=29;
-buf[0][5]=42;
-
-buf[0][6]=52;
-buf[0][7]=45;
-buf[0][8]=58;
-
-buf[0][9]=74;
-buf[0][10]=61;
-buf[0][11]=61;
-
-buf[0][12]=52;
-buf[0][13]=55;
-buf[0][14]=48;
-
-buf[0][15]=57;
-buf[0][16]=54;
-buf[0][17]=46;
-
-buf[0][18]=28;
-buf[0][19]=38;
-buf[0][20]=37;
-
-buf[0][21]=51;
-buf[0][22]=51;
-buf[0][23]=60;
+	/* Bytes moved per phase and node, against the size of the input */
+	instr_output("encode", size);
+	instr_summary(stdout, "encode");
 
-/* m08 parity */
-buf[1][0]=3;
-buf[1][1]=5;
-buf[1][2]=5;
 
-buf[1][3]=13;
-buf[1][4]=11;
-buf[1][5]=17;
 
-buf[1][6]=13;
-buf[1][7]=11;
-buf[1][8]=13;
-
-buf[1][9]=26;
-buf[1][10]=16;
-buf[1][11]=17;
-
-buf[1][12]=17;
-buf[1][13]=18;
-buf[1][14]=14;
-
-buf[1][15]=13;
-buf[1][16]=9;
-buf[1][17]=15;
-
-buf[1][18]=15;
-buf[1][19]=14;
-buf[1][20]=19;
-
-buf[1][21]=19;
-buf[1][22]=19;
-buf[1][23]=25;
-
-
-/* m09 parity */
-buf[2][0]=27;
-buf[2][1]=43;
-buf[2][2]=28;
-
-buf[2][3]=31;
-buf[2][4]=31;
-buf[2][5]=45;
-
-buf[2][6]=58;
-buf[2][7]=57;
-buf[2][8]=67;
-
-buf[2][9]=65;
-buf[2][10]=55;
-buf[2][11]=55;
-
-buf[2][12]=62;
-buf[2][13]=75;
-buf[2][14]=63;
-
-buf[2][15]=63;
-buf[2][16]=58;
-buf[2][17]=54;
-
-buf[2][18]=36;
-buf[2][19]=42;
-buf[2][20]=41;
-
-buf[2][21]=55;
-buf[2][22]=57;
-buf[2][23]=66;
-
-
-
-
-
-/* m10 parity */
-buf[3][0]=24;
-buf[3][1]=37;
-buf[3][2]=34;
-
-buf[3][3]=31;
-buf[3][4]=35;
-buf[3][5]=43;
-
-buf[3][6]=44;
-buf[3][7]=29;
-buf[3][8]=46;
-
-buf[3][9]=65;
-buf[3][10]=53;
-buf[3][11]=62;
-
-buf[3][12]=58;
-buf[3][13]=70;
-buf[3][14]=57;
-
-buf[3][15]=58;
-buf[3][16]=52;
-buf[3][17]=42;
-
-buf[3][18]=36;
-buf[3][19]=54;
-buf[3][20]=45;
-
-buf[3][21]=56;
-buf[3][22]=48;
-buf[3][23]=66;
-
-
-
-
-/* m11 parity */
-buf[4][0]=26;
-buf[4][1]=40;
-buf[4][2]=38;
-
-buf[4][3]=40;
-buf[4][4]=47;
-buf[4][5]=49;
-
-buf[4][6]=53;
-buf[4][7]=41;
-buf[4][8]=61;
-
-buf[4][9]=61;
-buf[4][10]=51;
-buf[4][11]=57;
-
-buf[4][12]=60;
-buf[4][13]=75;
-buf[4][14]=60;
-
-buf[4][15]=68;
-buf[4][16]=56;
-buf[4][17]=50;
-
-buf[4][18]=28;
-buf[4][19]=44;
-buf[4][20]=39;
-
-buf[4][21]=51;
-buf[4][22]=44;
-buf[4][23]=59;
-
-
-
-/* m12 parity */
-buf[5][0]=15;
-buf[5][1]=23;
-buf[5][2]=17;
-
-buf[5][3]=30;
-buf[5][4]=34;
-buf[5][5]=37;
-
-buf[5][6]=41;
-buf[5][7]=34;
-buf[5][8]=49;
-
-buf[5][9]=62;
-buf[5][10]=51;
-buf[5][11]=65;
-
-buf[5][12]=43;
-buf[5][13]=54;
-buf[5][14]=64;
-
-buf[5][15]=63;
-buf[5][16]=51;
-buf[5][17]=43;
-
-buf[5][18]=29;
-buf[5][19]=41;
-buf[5][20]=29;
-
-buf[5][21]=50;
-buf[5][22]=45;
-buf[5][23]=60;
-
-
-
-
-
-
-
-
-buf_index=0;
-
-
-
-
-
-/******************************* start line for Video_m05.mp4, m06 , m07 , m08.mp4 **********************************************************************/
-
-
-
-
-
-z=0;
-
-integer=0;
-
-tsec = 0.0;
-t_total_time =0.0;
-t_total_read =0.0;
-t_total_write =0.0;
-t_total_cal =0.0;
-
-t_whcho =0.0;
-
-
-//for(z=0;z<4;z++){ /* 4 times loop because there is 4 parity files at /mnt/NewNode1 , /mnt/NewNode2 */
-for(z=0;z<6;z++){ /* Now, 6 times loop because there is 6 parity files at /mnt/NewNode1 , /mnt/NewNode2 */
-
-//for(z=0;z<1;z++){
-
-//integer=(z+2)/2;
-integer=(z+3)/3;
-//for debugging 
-//printf("y= %d\n",integer);
-
-
-// 1. K01 & K02 & k03  
-
-//sprintf(fname1, "%s/Coding/Node1/%s_k01.mp4",curdir,s1);
-sprintf(fname1, "/mnt/node1/%s_k01.mp4",s1);
-f_p1 = fopen(fname1, "rb");
-
-//sprintf(fname2, "%s/Coding/Node1/%s_k02.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node1/%s_k02.mp4",s1);
-f_p2 = fopen(fname2, "rb");
-
-//sprintf(fname3, "%s/Coding/Node1/%s_k03.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node1/%s_k03.mp4",s1);
-f_p3 = fopen(fname3, "rb");
-
-
-gettimeofday(&t_read_start, &tz);
-
-counter += jfread(block1, sizeof(char), blocksize, f_p1);
-//fclose(f_p1); // causing Segmentation Fault !!
-
-counter += jfread(block2, sizeof(char), blocksize, f_p2);
-//fclose(f_p2); // causing Segmentation Fault !!
-
-counter += jfread(block3, sizeof(char), blocksize, f_p3);
-
-
-gettimeofday(&t_read_end, &tz);
-
-tsec = 0.0;
-tsec += t_read_end.tv_usec;
-tsec -= t_read_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_read_end.tv_sec;
-tsec -= t_read_start.tv_sec;
-t_total_read = t_total_read + tsec;
-
-
-// do measurement of bus transfer !!
-gettimeofday(&t_bus_start, &tz);
-
-
-ori_data[0] = block1 ;
-ori_data[1] = block2 ;
-ori_data[2] = block3 ;
-
-for (i = 0; i < 2; i++) {
-p_coding[i] = (char *)malloc(sizeof(char)*blocksize);
-if (p_coding[i] == NULL) { perror("malloc"); exit(1); }
-}
-
-
-gettimeofday(&t_bus_end, &tz);
-tsec = 0.0;
-tsec += t_bus_end.tv_usec;
-tsec -= t_bus_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_bus_end.tv_sec;
-tsec -= t_bus_start.tv_sec;
-//printf("Transfer Time (sec): %0.6f\n", tsec);
-t_total_time = t_total_time + tsec;
-//printf("Total_Transfer Time (sec): %0.6f\n", t_total_time);
-
-
-
-//printf(" counter = %d\n",counter);
-
-// parity file
-//sprintf(p_fname, "%s/Coding/NewNode%d/%s_parity_01.mp4",curdir,integer, s1);
-//sprintf(p_fname, "/mnt/NewNode%d/%s_parity_01_%d.mp4",integer, s1 , z+1);
-sprintf(p_fname, "/mnt/node%d/%s_parity_01_%d.mp4",integer+10, s1 , z+1);
-p_fp = fopen(p_fname, "wb");
-
-gettimeofday(&t_cal_start, &tz);
+	/* Objects encoded with every parity at ingest skip scale-out, and so
+	   do the RAID-6 bitmatrix codes, which have no larger code to grow into */
+	scaleout = (mi == m);
+	if (scaleout && (tech == Liberation || tech == Blaum_Roth || tech == Liber8tion)) {
+		printf("Scale-out skipped: %s has only two parities\n", argv[4]);
+		scaleout = 0;
+	}
+	if (scaleout) {
+		/* Scale-out: add NEW_PARITIES parities m(m+1)..m(m+NEW_PARITIES).
+		   Every node holding data fragments multiplies its own fragments by
+		   their coefficients in the new parity row and ships only that partial
+		   parity to the new parity's node, which XORs the partials together.
+		   For the Cauchy techniques the new rows extend the Cauchy matrix
+		   and the partials are XOR schedules over the bit matrices.
+		   When every node involved runs a node_agent, that work happens on the
+		   agents and this process only sends them requests. */
+
+		int ph_so_total, ph_so_collect, ph_so_aggregate, ph_so_write;
+
+		int *ext;				/* NEW_PARITIES x k extension rows */
+		int nnodes;				/* nodes holding data fragments */
+		int *src_node, *grp_start, *grp_frag;	/* fragments grouped by node */
+		int *coefs;
+		char **ori_data, **par_data;
+		char *dptr;
+		int z, g, newnode;
+		int64_t offset;
+		int *agent_fd;				/* per source node, then per new parity */
+		struct transport_src *xsrc;
+		struct transport_msg reply;
+		const char *addr;
+		struct partial_job *pjobs;
+		elastic_partial_t **plans;		/* per new parity, then per data node */
+		int *src_numa;
+
+		/* read/partial happen on the data nodes, the rest on the new node */
+		ph_so_total = instr_phase("scaleout.total");
+		ph_so_read = instr_phase("scaleout.read");
+		ph_so_partial = instr_phase("scaleout.partial");
+		ph_so_transfer = instr_phase("scaleout.transfer");
+		ph_so_collect = instr_phase("scaleout.collect");
+		ph_so_aggregate = instr_phase("scaleout.aggregate");
+		ph_so_write = instr_phase("scaleout.write");
+		instr_begin(&sc_total, ph_so_total, -1, -1);
+
+		if (tech == Cauchy_Orig || tech == Cauchy_Good) {
+			ext = elastic_cauchy_extension(k, m, NEW_PARITIES, w, matrix, tech == Cauchy_Good);
+		} else {
+			ext = elastic_extension_matrix(k, m, NEW_PARITIES, w);
+		}
+		if (ext == NULL) {
+			fprintf(stderr, "Unable to build the scale-out coding rows\n");
+			exit(1);
+		}
 
-galois_w08_region_multiply(ori_data[0], buf[z][0] , blocksize, p_coding[0], 0);
-galois_w08_region_multiply(ori_data[1], buf[z][1] , blocksize, p_coding[0], 1);
-//printf("galois_w08_region_multiply()!!\n");
-galois_w08_region_multiply(ori_data[2], buf[z][2] , blocksize, p_coding[0], 1);
+		/* Group data fragments by the node that holds them */
+		src_node = (int *)malloc(sizeof(int)*k);
+		grp_start = (int *)malloc(sizeof(int)*(k+1));
+		grp_frag = (int *)malloc(sizeof(int)*k);
+		nnodes = 0;
+		for (i = 0; i < k; i++) {
+			for (j = 0; j < nnodes && src_node[j] != meta.location[i]; j++) ;
+			if (j == nnodes) src_node[nnodes++] = meta.location[i];
+		}
+		g = 0;
+		for (j = 0; j < nnodes; j++) {
+			grp_start[j] = g;
+			for (i = 0; i < k; i++) {
+				if (meta.location[i] == src_node[j]) grp_frag[g++] = i;
+			}
+		}
+		grp_start[nnodes] = g;
+
+		/* A data node's fragments and partial parity live in the memory of
+		   the socket nearest its disk, where its job runs */
+		src_numa = (int *)malloc(sizeof(int)*nnodes);
+		coefs = (int *)malloc(sizeof(int)*k);
+		ori_data = (char **)malloc(sizeof(char*)*k);
+		par_data = (char **)malloc(sizeof(char*)*nnodes);
+		for (j = 0; j < nnodes; j++) {
+			src_numa[j] = placement_node_numa(pl, src_node[j]);
+			for (g = grp_start[j]; g < grp_start[j+1]; g++) {
+				ori_data[g] = buf_pool_get_on(blocksize, src_numa[j]);
+			}
+			par_data[j] = buf_pool_get_on(blocksize, src_numa[j]);
+		}
+		dptr = buf_pool_get(blocksize);
+
+		/* Use the node agents only if every node taking part has one */
+		agent_fd = NULL;
+		xsrc = NULL;
+		for (j = 0; j < nnodes && placement_node_agent(pl, src_node[j]) != NULL; j++) ;
+		for (z = 0; j == nnodes && z < NEW_PARITIES && placement_node_agent(pl, meta.location[k+m+z]) != NULL; z++) ;
+		if (j == nnodes && z == NEW_PARITIES) {
+			agent_fd = (int *)malloc(sizeof(int)*(nnodes+NEW_PARITIES));
+			xsrc = (struct transport_src *)malloc(sizeof(struct transport_src)*k);
+			for (j = 0; j < nnodes+NEW_PARITIES; j++) {
+				i = (j < nnodes) ? src_node[j] : meta.location[k+m+j-nnodes];
+				addr = placement_node_agent(pl, i);
+				agent_fd[j] = transport_connect(addr);
+				if (agent_fd[j] < 0 || transport_ping(agent_fd[j]) != 0) {
+					fprintf(stderr, "Unable to reach the agent of node %d at %s\n", i, addr);
+					exit(1);
+				}
+			}
+			printf("Scale-out through %d node agents\n", nnodes+NEW_PARITIES);
+		}
 
+		/* With a pool the data nodes' jobs run in parallel */
+		pjobs = NULL;
+		plans = NULL;
+		if (agent_fd == NULL) {
+			pjobs = (struct partial_job *)malloc(sizeof(struct partial_job)*nnodes);
+			for (j = 0; j < nnodes; j++) {
+				pjobs[j].fstore = fstore;
+				pjobs[j].s1 = s1;
+				pjobs[j].extension = extension;
+				pjobs[j].md = md;
+				pjobs[j].node = src_node[j];
+				pjobs[j].group = j;
+				pjobs[j].nsrc = grp_start[j+1]-grp_start[j];
+				pjobs[j].frags = grp_frag+grp_start[j];
+				pjobs[j].srcs = ori_data+grp_start[j];
+				pjobs[j].dst = par_data[j];
+				pjobs[j].blocksize = blocksize;
+				pjobs[j].random = (fp == NULL);
+			}
 
+			/* A node's partial for a new row is planned once, not per read-in */
+			plans = (elastic_partial_t **)malloc(sizeof(elastic_partial_t*)*nnodes*NEW_PARITIES);
+			for (z = 0; z < NEW_PARITIES; z++) {
+				for (j = 0; j < nnodes; j++) {
+					for (g = grp_start[j]; g < grp_start[j+1]; g++) {
+						coefs[g] = ext[z*k+grp_frag[g]];
+					}
+					plans[z*nnodes+j] = elastic_partial_new(w, (bitmatrix != NULL) ? packetsize : 0,
+					                                       grp_start[j+1]-grp_start[j], coefs+grp_start[j]);
+					if (plans[z*nnodes+j] == NULL) {
+						fprintf(stderr, "Unable to plan the partial parities\n");
+						exit(1);
+					}
+				}
+			}
+		}
 
-gettimeofday(&t_cal_end, &tz);
-tsec = 0.0;
-tsec += t_cal_end.tv_usec;
-tsec -= t_cal_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_cal_end.tv_sec;
-tsec -= t_cal_start.tv_sec;
-t_total_cal = t_total_cal + tsec;
+		for (z = 0; z < NEW_PARITIES; z++) {
+			newnode = meta.location[k+m+z];
+
+			for (n = 1; n <= readins; n++) {
+				offset = (int64_t) blocksize*(n-1);
+
+				if (agent_fd != NULL) {
+					/* 1. Every source agent computes its partial parity and PUTs it
+					      to the new node's agent.  All requests go out before any
+					      reply is awaited, so the agents work in parallel. */
+					instr_begin(&sc, ph_so_transfer, newnode, k+m+z);
+					addr = placement_node_agent(pl, newnode);
+					for (j = 0; j < nnodes; j++) {
+						for (g = grp_start[j]; g < grp_start[j+1]; g++) {
+							i = grp_frag[g];
+							xsrc[g-grp_start[j]].coef = ext[z*k+i];
+							snprintf(xsrc[g-grp_start[j]].key, FRAG_KEY_MAX, "%s_k%0*d%s", s1, md, i+1, extension);
+						}
+						snprintf(fname, FRAG_KEY_MAX, "%s_parity_%02d_%d%s", s1, j+1, z+1, extension);
+						if (transport_partial_start(agent_fd[j], meta.store, src_node[j], w,
+						                            (bitmatrix != NULL) ? packetsize : 0, offset, blocksize,
+						                            grp_start[j+1]-grp_start[j], xsrc, addr, newnode, fname) != 0) {
+							fprintf(stderr, "Unable to send a partial parity request to node %d\n", src_node[j]);
+							exit(1);
+						}
+					}
+					g = 0;
+					for (j = 0; j < nnodes; j++) {
+						if (src_node[j] != newnode) g++;
+						if (transport_finish(agent_fd[j], &reply) != 0) {
+							fprintf(stderr, "Node %d failed to build partial parity %d\n", src_node[j], z+1);
+							exit(1);
+						}
+						instr_record(ph_so_read, src_node[j], -1, reply.read_ns, (int64_t) (grp_start[j+1]-grp_start[j])*blocksize);
+						instr_record(ph_so_partial, src_node[j], -1, reply.cal_ns, blocksize);
+					}
+					instr_end_bytes(&sc, (int64_t) g*blocksize);
+
+					/* 2. The new node's agent XORs the partials into the new parity */
+					for (j = 0; j < nnodes; j++) {
+						snprintf(xsrc[j].key, FRAG_KEY_MAX, "%s_parity_%02d_%d%s", s1, j+1, z+1, extension);
+					}
+					snprintf(fname, FRAG_KEY_MAX, "%s_m%0*d%s", s1, md, m+1+z, extension);
+					if (transport_aggregate_start(agent_fd[nnodes+z], meta.store, newnode, offset, blocksize, nnodes, xsrc, fname) != 0 ||
+					    transport_finish(agent_fd[nnodes+z], &reply) != 0) {
+						fprintf(stderr, "Node %d failed to aggregate parity %d\n", newnode, z+1);
+						exit(1);
+					}
+					instr_record(ph_so_collect, newnode, k+m+z, reply.read_ns, (int64_t) nnodes*blocksize);
+					instr_record(ph_so_aggregate, newnode, k+m+z, reply.cal_ns, blocksize);
+					instr_record(ph_so_write, newnode, k+m+z, reply.io_ns, blocksize);
+					continue;
+				}
 
+				/* 1. Each data node builds its partial parity and sends it to
+				      newnode, all of them at once when there is a pool */
+				for (j = 0; j < nnodes; j++) {
+					pjobs[j].plan = plans[z*nnodes+j];
+					pjobs[j].newnode = newnode;
+					pjobs[j].newfrag = k+m+z;
+					pjobs[j].z = z;
+					pjobs[j].offset = offset;
+					workers_submit(wk, src_numa[j], partial_job_run, &pjobs[j]);
+				}
+				workers_wait(wk);
+
+				/* 2. newnode reads the partial parities back ... */
+				instr_begin(&sc, ph_so_collect, newnode, k+m+z);
+				for (j = 0; j < nnodes; j++) {
+					sprintf(fname, "%s_parity_%02d_%d%s", s1, j+1, z+1, extension);
+					if (fstore->read(fstore, newnode, fname, offset, par_data[j], blocksize) != blocksize) {
+						fprintf(stderr, "Unable to read %s from node %d\n", fname, newnode);
+						exit(1);
+					}
+				}
+				instr_end_bytes(&sc, (int64_t) nnodes*blocksize);
+
+				/* 3. ... and XORs them into the new parity */
+				instr_begin(&sc, ph_so_aggregate, newnode, k+m+z);
+				elastic_aggregate(nnodes, par_data, dptr, blocksize);
+				instr_end_bytes(&sc, blocksize);
+
+				instr_begin(&sc, ph_so_write, newnode, k+m+z);
+				sprintf(fname, "%s_m%0*d%s", s1, md, m+1+z, extension);
+				if (fstore->write(fstore, newnode, fname, offset, dptr, blocksize) != blocksize) {
+					fprintf(stderr, "Unable to write %s to node %d\n", fname, newnode);
+					exit(1);
+				}
+				instr_end_bytes(&sc, blocksize);
+			}
 
-fwrite(p_coding[0], sizeof(char), blocksize, p_fp);
-fclose(p_fp);
+			/* Every read-in is aggregated, so the partial parities are spent */
+			for (j = 0; j < nnodes; j++) {
+				snprintf(fname, FRAG_KEY_MAX, "%s_parity_%02d_%d%s", s1, j+1, z+1, extension);
+				if ((agent_fd != NULL) ? transport_delete(agent_fd[nnodes+z], meta.store, newnode, fname) != 0
+				                       : fstore->remove(fstore, newnode, fname) != 0) {
+					fprintf(stderr, "Warning: unable to remove %s from node %d\n", fname, newnode);
+				}
+			}
+		}
 
+		/* The new parities now exist; publish them as the next generation */
+		if (mstore != NULL) {
+			if (fstore->sync(fstore) != 0) {
+				fprintf(stderr, "Unable to sync fragment store\n");
+				exit(1);
+			}
+			for (z = 0; agent_fd != NULL && z < NEW_PARITIES; z++) {
+				if (transport_sync(agent_fd[nnodes+z], meta.store, meta.location[k+m+z]) != 0) {
+					fprintf(stderr, "Unable to sync the fragment store of node %d\n", meta.location[k+m+z]);
+					exit(1);
+				}
+			}
+			meta.m_total = m+NEW_PARITIES;
+			meta.nfragments = k+m+NEW_PARITIES;
+			meta.generation++;
+			if (meta_store_put(mstore, &meta) != 0) {
+				fprintf(stderr, "Unable to update metadata index %s\n", meta_path);
+				exit(1);
+			}
+			meta_store_close(mstore);
+			free(meta_path);
+		}
 
-fclose(f_p1); // causing Segmentation Fault !!
-
-fclose(f_p2); // causing Segmentation Fault !!
-
-
-
-// 2. K04 & K05 & k06
-
-//sprintf(fname1, "%s/Coding/Node2/%s_k04.mp4",curdir,s1);
-sprintf(fname1, "/mnt/node2/%s_k04.mp4",s1);
-f_p1 = fopen(fname1, "rb");
-
-//sprintf(fname2, "%s/Coding/Node2/%s_k05.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node2/%s_k05.mp4",s1);
-f_p2 = fopen(fname2, "rb");
-
-//sprintf(fname3, "%s/Coding/Node2/%s_k06.mp4",curdir,s1);
-sprintf(fname3, "/mnt/node2/%s_k06.mp4",s1);
-f_p3 = fopen(fname3, "rb");
-
-
-gettimeofday(&t_read_start, &tz);
-
-counter += jfread(block1, sizeof(char), blocksize, f_p1);
-
-counter += jfread(block2, sizeof(char), blocksize, f_p2);
-
-counter += jfread(block3, sizeof(char), blocksize, f_p3);
-
-
-gettimeofday(&t_read_end, &tz);
-tsec = 0.0;
-tsec += t_read_end.tv_usec;
-tsec -= t_read_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_read_end.tv_sec;
-tsec -= t_read_start.tv_sec;
-t_total_read = t_total_read + tsec;
-
-
-
-gettimeofday(&t_bus_start, &tz);
-
-ori_data[0] = block1 ;
-ori_data[1] = block2 ;
-ori_data[2] = block3 ;
-
-for (i = 0; i < 2; i++) {
-p_coding[i] = (char *)malloc(sizeof(char)*blocksize);
-if (p_coding[i] == NULL) { perror("malloc"); exit(1); }
-}
-
-gettimeofday(&t_bus_end, &tz);
-tsec=0.0;
-tsec += t_bus_end.tv_usec;
-tsec -= t_bus_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_bus_end.tv_sec;
-tsec -= t_bus_start.tv_sec;
-//printf("Transfer Time (sec): %0.6f\n", tsec);
-t_total_time = t_total_time + tsec;
-//printf("Total_Transfer Time (sec): %0.6f\n", t_total_time);
-
-
-
-//printf(" counter = %d\n",counter);
-
-// parity file
-//sprintf(p_fname, "%s/Coding/%s_parity_02.mp4",curdir,s1);
-//sprintf(p_fname, "%s/Coding/NewNode%d/%s_parity_02.mp4",curdir,integer, s1);
-//sprintf(p_fname, "/mnt/NewNode%d/%s_parity_02_%d.mp4", integer ,s1, z+1);
-sprintf(p_fname, "/mnt/node%d/%s_parity_02_%d.mp4", integer+10 ,s1, z+1);
-p_fp = fopen(p_fname, "wb");
-
-gettimeofday(&t_cal_start, &tz);
-
-galois_w08_region_multiply(ori_data[0], buf[z][3] , blocksize, p_coding[0], 0);
-galois_w08_region_multiply(ori_data[1], buf[z][4] , blocksize, p_coding[0], 1);
-//printf("galois_w08_region_multiply()!!\n");
-
-galois_w08_region_multiply(ori_data[2], buf[z][5] , blocksize, p_coding[0], 1);
-
-
-gettimeofday(&t_cal_end, &tz);
-tsec = 0.0;
-tsec += t_cal_end.tv_usec;
-tsec -= t_cal_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_cal_end.tv_sec;
-tsec -= t_cal_start.tv_sec;
-t_total_cal = t_total_cal + tsec;
-
-fwrite(p_coding[0], sizeof(char), blocksize, p_fp);
-fclose(p_fp);
-
-
-
-
-
-// 3. k07 , k08 , k09  
-
-//sprintf(fname1, "%s/Coding/Node3/%s_k07.mp4",curdir,s1);
-sprintf(fname1, "/mnt/node3/%s_k07.mp4",s1);
-f_p1 = fopen(fname1, "rb");
-
-//sprintf(fname2, "%s/Coding/Node3/%s_k08.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node3/%s_k08.mp4",s1);
-f_p2 = fopen(fname2, "rb");
-
-//sprintf(fname3, "%s/Coding/Node3/%s_k09.mp4",curdir,s1);
-sprintf(fname3, "/mnt/node3/%s_k09.mp4",s1);
-f_p3 = fopen(fname3, "rb");
-
-
-
-gettimeofday(&t_read_start, &tz);
-
-counter += jfread(block1, sizeof(char), blocksize, f_p1);
-counter += jfread(block2, sizeof(char), blocksize, f_p2);
-
-counter += jfread(block3, sizeof(char), blocksize, f_p3);
-
-gettimeofday(&t_read_end, &tz);
-tsec = 0.0;
-tsec += t_read_end.tv_usec;
-tsec -= t_read_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_read_end.tv_sec;
-tsec -= t_read_start.tv_sec;
-t_total_read = t_total_read + tsec;
-
-
-
-
-gettimeofday(&t_bus_start, &tz);
-
-ori_data[0] = block1 ;
-ori_data[1] = block2 ;
-ori_data[2] = block3 ;
-
-for (i = 0; i < 2; i++) {
-p_coding[i] = (char *)malloc(sizeof(char)*blocksize);
-if (p_coding[i] == NULL) { perror("malloc"); exit(1); }
-}
-gettimeofday(&t_bus_end, &tz);
-tsec=0.0;
-tsec += t_bus_end.tv_usec;
-tsec -= t_bus_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_bus_end.tv_sec;
-tsec -= t_bus_start.tv_sec;
-//printf("Transfer Time (sec): %0.6f\n", tsec);
-t_total_time = t_total_time + tsec;
-//printf("Total_Transfer Time (sec): %0.6f\n", t_total_time);
-
-//printf(" counter = %d\n",counter);
-
-// parity file
-//sprintf(p_fname, "%s/Coding/%s_parity_03.mp4",curdir,s1);
-//sprintf(p_fname, "%s/Coding/NewNode%d/%s_parity_03.mp4",curdir,integer, s1);
-//sprintf(p_fname, "/mnt/NewNode%d/%s_parity_03_%d.mp4",integer, s1, z+1);
-sprintf(p_fname, "/mnt/node%d/%s_parity_03_%d.mp4",integer+10, s1, z+1);
-p_fp = fopen(p_fname, "wb");
-
-gettimeofday(&t_cal_start, &tz);
-
-galois_w08_region_multiply(ori_data[0], buf[z][6] , blocksize, p_coding[0], 0);
-galois_w08_region_multiply(ori_data[1], buf[z][7] , blocksize, p_coding[0], 1);
-//printf("galois_w08_region_multiply()!!\n");
-
-galois_w08_region_multiply(ori_data[2], buf[z][8] , blocksize, p_coding[0], 1);
-
-gettimeofday(&t_cal_end, &tz);
-tsec = 0.0;
-tsec += t_cal_end.tv_usec;
-tsec -= t_cal_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_cal_end.tv_sec;
-tsec -= t_cal_start.tv_sec;
-t_total_cal = t_total_cal + tsec;
-
-fwrite(p_coding[0], sizeof(char), blocksize, p_fp);
-fclose(p_fp);
-
-
-
-
-// 4. k10 , k11 , k12  
-
-//sprintf(fname1, "%s/Coding/Node4/%s_k10.mp4",curdir,s1);
-sprintf(fname1, "/mnt/node4/%s_k10.mp4",s1);
-f_p1 = fopen(fname1, "rb");
-
-//sprintf(fname2, "%s/Coding/Node4/%s_k11.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node4/%s_k11.mp4",s1);
-f_p2 = fopen(fname2, "rb");
-
-//sprintf(fname3, "%s/Coding/Node4/%s_k12.mp4",curdir,s1);
-sprintf(fname3, "/mnt/node4/%s_k12.mp4",s1);
-f_p3 = fopen(fname3, "rb");
-
-gettimeofday(&t_read_start, &tz);
-
-counter += jfread(block1, sizeof(char), blocksize, f_p1);
-counter += jfread(block2, sizeof(char), blocksize, f_p2);
-
-counter += jfread(block3, sizeof(char), blocksize, f_p3);
-
-gettimeofday(&t_read_end, &tz);
-tsec = 0.0;
-tsec += t_read_end.tv_usec;
-tsec -= t_read_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_read_end.tv_sec;
-tsec -= t_read_start.tv_sec;
-t_total_read = t_total_read + tsec;
-
-
-
-
-gettimeofday(&t_bus_start, &tz);
-
-ori_data[0] = block1 ;
-ori_data[1] = block2 ;
-
-ori_data[2] = block3 ;
-
-for (i = 0; i < 2; i++) {
-p_coding[i] = (char *)malloc(sizeof(char)*blocksize);
-if (p_coding[i] == NULL) { perror("malloc"); exit(1); }
-}
-
-gettimeofday(&t_bus_end, &tz);
-tsec=0.0;
-tsec += t_bus_end.tv_usec;
-tsec -= t_bus_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_bus_end.tv_sec;
-tsec -= t_bus_start.tv_sec;
-//printf("Transfer Time (sec): %0.6f\n", tsec);
-t_total_time = t_total_time + tsec;
-//printf("Total_Transfer Time (sec): %0.6f\n", t_total_time);
-
-//printf(" counter = %d\n",counter);
-
-// parity file
-//sprintf(p_fname, "%s/Coding/%s_parity_04.mp4",curdir,s1);
-//sprintf(p_fname, "%s/Coding/NewNode%d/%s_parity_04.mp4",curdir,integer, s1);
-//sprintf(p_fname, "/mnt/NewNode%d/%s_parity_04_%d.mp4",integer, s1 , z+1);
-sprintf(p_fname, "/mnt/node%d/%s_parity_04_%d.mp4",integer+10, s1 , z+1);
-p_fp = fopen(p_fname, "wb");
-
-gettimeofday(&t_cal_start, &tz);
-
-galois_w08_region_multiply(ori_data[0], buf[z][9] , blocksize, p_coding[0], 0);
-galois_w08_region_multiply(ori_data[1], buf[z][10] , blocksize, p_coding[0], 1);
-//printf("galois_w08_region_multiply()!!\n");
-galois_w08_region_multiply(ori_data[2], buf[z][11] , blocksize, p_coding[0], 1);
-
-gettimeofday(&t_cal_end, &tz);
-tsec = 0.0;
-tsec += t_cal_end.tv_usec;
-tsec -= t_cal_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_cal_end.tv_sec;
-tsec -= t_cal_start.tv_sec;
-t_total_cal = t_total_cal + tsec;
-
-fwrite(p_coding[0], sizeof(char), blocksize, p_fp);
-fclose(p_fp);
-
-
-
-// 5. k13 , k14 , k15  
-
-//sprintf(fname1, "%s/Coding/Node5/%s_k13.mp4",curdir,s1);
-sprintf(fname1, "/mnt/node5/%s_k13.mp4",s1);
-f_p1 = fopen(fname1, "rb");
-
-//sprintf(fname2, "%s/Coding/Node5/%s_k14.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node5/%s_k14.mp4",s1);
-f_p2 = fopen(fname2, "rb");
-
-//sprintf(fname3, "%s/Coding/Node5/%s_k15.mp4",curdir,s1);
-sprintf(fname3, "/mnt/node5/%s_k15.mp4",s1);
-f_p3 = fopen(fname3, "rb");
-
-
-
-
-gettimeofday(&t_read_start, &tz);
-
-counter += jfread(block1, sizeof(char), blocksize, f_p1);
-counter += jfread(block2, sizeof(char), blocksize, f_p2);
-
-counter += jfread(block3, sizeof(char), blocksize, f_p3);
-
-
-gettimeofday(&t_read_end, &tz);
-tsec = 0.0;
-tsec += t_read_end.tv_usec;
-tsec -= t_read_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_read_end.tv_sec;
-tsec -= t_read_start.tv_sec;
-t_total_read = t_total_read + tsec;
-
-
-gettimeofday(&t_bus_start, &tz);
-
-ori_data[0] = block1 ;
-ori_data[1] = block2 ;
-
-ori_data[2] = block3 ;
-
-
-for (i = 0; i < 2; i++) {
-p_coding[i] = (char *)malloc(sizeof(char)*blocksize);
-if (p_coding[i] == NULL) { perror("malloc"); exit(1); }
-}
-gettimeofday(&t_bus_end, &tz);
-tsec=0.0;
-tsec += t_bus_end.tv_usec;
-tsec -= t_bus_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_bus_end.tv_sec;
-tsec -= t_bus_start.tv_sec;
-//printf("Transfer Time (sec): %0.6f\n", tsec);
-t_total_time = t_total_time + tsec;
-//printf("Total_Transfer Time (sec): %0.6f\n", t_total_time);
-
-//printf(" counter = %d\n",counter);
-
-// parity file
-//sprintf(p_fname, "%s/Coding/%s_parity_05.mp4",curdir,s1);
-//sprintf(p_fname, "%s/Coding/NewNode%d/%s_parity_05.mp4",curdir,integer, s1);
-//sprintf(p_fname, "/mnt/NewNode%d/%s_parity_05_%d.mp4",integer, s1, z+1);
-sprintf(p_fname, "/mnt/node%d/%s_parity_05_%d.mp4",integer+10, s1, z+1);
-p_fp = fopen(p_fname, "wb");
-
-gettimeofday(&t_cal_start, &tz);
-galois_w08_region_multiply(ori_data[0], buf[z][12] , blocksize, p_coding[0], 0);
-galois_w08_region_multiply(ori_data[1], buf[z][13] , blocksize, p_coding[0], 1);
-//printf("galois_w08_region_multiply()!!\n");
-galois_w08_region_multiply(ori_data[2], buf[z][14] , blocksize, p_coding[0], 1);
-
-
-gettimeofday(&t_cal_end, &tz);
-tsec = 0.0;
-tsec += t_cal_end.tv_usec;
-tsec -= t_cal_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_cal_end.tv_sec;
-tsec -= t_cal_start.tv_sec;
-t_total_cal = t_total_cal + tsec;
-
-fwrite(p_coding[0], sizeof(char), blocksize, p_fp);
-fclose(p_fp);
-
-
-
-
-// 6. k16 , k17 , k18
-
-//sprintf(fname1, "%s/Coding/Node6/%s_k16.mp4",curdir,s1);
-sprintf(fname1, "/mnt/node6/%s_k16.mp4",s1);
-f_p1 = fopen(fname1, "rb");
-
-//sprintf(fname2, "%s/Coding/Node6/%s_k17.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node6/%s_k17.mp4",s1);
-f_p2 = fopen(fname2, "rb");
-
-//sprintf(fname3, "%s/Coding/Node6/%s_k18.mp4",curdir,s1);
-sprintf(fname3, "/mnt/node6/%s_k18.mp4",s1);
-f_p3 = fopen(fname3, "rb");
-
-gettimeofday(&t_read_start, &tz);
-
-counter += jfread(block1, sizeof(char), blocksize, f_p1);
-counter += jfread(block2, sizeof(char), blocksize, f_p2);
-
-counter += jfread(block3, sizeof(char), blocksize, f_p3);
-
-
-gettimeofday(&t_read_end, &tz);
-tsec = 0.0;
-tsec += t_read_end.tv_usec;
-tsec -= t_read_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_read_end.tv_sec;
-tsec -= t_read_start.tv_sec;
-t_total_read = t_total_read + tsec;
-
-gettimeofday(&t_bus_start, &tz);
-
-ori_data[0] = block1 ;
-ori_data[1] = block2 ;
-
-ori_data[2] = block3 ;
-
-
-for (i = 0; i < 2; i++) {
-p_coding[i] = (char *)malloc(sizeof(char)*blocksize);
-if (p_coding[i] == NULL) { perror("malloc"); exit(1); }
-}
-
-gettimeofday(&t_bus_end, &tz);
-tsec=0.0;
-tsec += t_bus_end.tv_usec;
-tsec -= t_bus_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_bus_end.tv_sec;
-tsec -= t_bus_start.tv_sec;
-//printf("Transfer Time (sec): %0.6f\n", tsec);
-t_total_time = t_total_time + tsec;
-//printf("Total_Transfer Time (sec): %0.6f\n", t_total_time);
-
-//printf(" counter = %d\n",counter);
-
-// parity file
-//sprintf(p_fname, "%s/Coding/%s_parity_06.mp4",curdir,s1);
-//sprintf(p_fname, "%s/Coding/NewNode%d/%s_parity_06.mp4",curdir,integer, s1);
-//sprintf(p_fname, "/mnt/NewNode%d/%s_parity_06_%d.mp4",integer, s1, z+1);
-sprintf(p_fname, "/mnt/node%d/%s_parity_06_%d.mp4",integer+10, s1, z+1);
-p_fp = fopen(p_fname, "wb");
-
-gettimeofday(&t_cal_start, &tz);
-galois_w08_region_multiply(ori_data[0], buf[z][15] , blocksize, p_coding[0], 0);
-galois_w08_region_multiply(ori_data[1], buf[z][16] , blocksize, p_coding[0], 1);
-//printf("galois_w08_region_multiply()!!\n");
-galois_w08_region_multiply(ori_data[2], buf[z][17] , blocksize, p_coding[0], 1);
-
-gettimeofday(&t_cal_end, &tz);
-tsec = 0.0;
-tsec += t_cal_end.tv_usec;
-tsec -= t_cal_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_cal_end.tv_sec;
-tsec -= t_cal_start.tv_sec;
-t_total_cal = t_total_cal + tsec;
-
-fwrite(p_coding[0], sizeof(char), blocksize, p_fp);
-fclose(p_fp);
-
-
-
-//7. k19 , k20 , k21
-
-//sprintf(fname1, "%s/Coding/Node7/%s_k19.mp4",curdir,s1);
-sprintf(fname1, "/mnt/node7/%s_k19.mp4",s1);
-f_p1 = fopen(fname1, "rb");
-
-//sprintf(fname2, "%s/Coding/Node7/%s_k20.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node7/%s_k20.mp4",s1);
-f_p2 = fopen(fname2, "rb");
-
-//sprintf(fname3, "%s/Coding/Node7/%s_k21.mp4",curdir,s1);
-sprintf(fname3, "/mnt/node7/%s_k21.mp4",s1);
-f_p3 = fopen(fname3, "rb");
-
-
-gettimeofday(&t_read_start, &tz);
-
-counter += jfread(block1, sizeof(char), blocksize, f_p1);
-counter += jfread(block2, sizeof(char), blocksize, f_p2);
-
-counter += jfread(block3, sizeof(char), blocksize, f_p3);
-
-
-gettimeofday(&t_read_end, &tz);
-tsec = 0.0;
-tsec += t_read_end.tv_usec;
-tsec -= t_read_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_read_end.tv_sec;
-tsec -= t_read_start.tv_sec;
-t_total_read = t_total_read + tsec;
-
-
-gettimeofday(&t_bus_start, &tz);
-
-ori_data[0] = block1 ;
-ori_data[1] = block2 ;
-
-ori_data[2] = block3 ;
-
-for (i = 0; i < 2; i++) {
-p_coding[i] = (char *)malloc(sizeof(char)*blocksize);
-if (p_coding[i] == NULL) { perror("malloc"); exit(1); }
-}
-
-gettimeofday(&t_bus_end, &tz);
-tsec=0.0;
-tsec += t_bus_end.tv_usec;
-tsec -= t_bus_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_bus_end.tv_sec;
-tsec -= t_bus_start.tv_sec;
-//printf("Transfer Time (sec): %0.6f\n", tsec);
-t_total_time = t_total_time + tsec;
-//printf("Total_Transfer Time (sec): %0.6f\n", t_total_time);
-
-//printf(" counter = %d\n",counter);
-
-// parity file
-//sprintf(p_fname, "%s/Coding/%s_parity_07.mp4",curdir,s1);
-//sprintf(p_fname, "%s/Coding/NewNode%d/%s_parity_07.mp4",curdir,integer, s1);
-//sprintf(p_fname, "/mnt/NewNode%d/%s_parity_07_%d.mp4",integer, s1, z+1);
-sprintf(p_fname, "/mnt/node%d/%s_parity_07_%d.mp4",integer+10, s1, z+1);
-p_fp = fopen(p_fname, "wb");
-
-gettimeofday(&t_cal_start, &tz);
-galois_w08_region_multiply(ori_data[0], buf[z][18] , blocksize, p_coding[0], 0);
-galois_w08_region_multiply(ori_data[1], buf[z][19] , blocksize, p_coding[0], 1);
-//printf("galois_w08_region_multiply()!!\n");
-galois_w08_region_multiply(ori_data[2], buf[z][20] , blocksize, p_coding[0], 1);
-
-
-gettimeofday(&t_cal_end, &tz);
-tsec = 0.0;
-tsec += t_cal_end.tv_usec;
-tsec -= t_cal_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_cal_end.tv_sec;
-tsec -= t_cal_start.tv_sec;
-t_total_cal = t_total_cal + tsec;
-
-fwrite(p_coding[0], sizeof(char), blocksize, p_fp);
-fclose(p_fp);
-
-
-
-
-// 8. k22 , k23 , k24
-
-
-//sprintf(fname1, "%s/Coding/Node8/%s_k22.mp4",curdir,s1);
-sprintf(fname1, "/mnt/node8/%s_k22.mp4",s1);
-f_p1 = fopen(fname1, "rb");
-
-//sprintf(fname2, "%s/Coding/Node8/%s_k23.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node8/%s_k23.mp4",s1);
-f_p2 = fopen(fname2, "rb");
-
-//sprintf(fname3, "%s/Coding/Node8/%s_k24.mp4",curdir,s1);
-sprintf(fname3, "/mnt/node8/%s_k24.mp4",s1);
-f_p3 = fopen(fname3, "rb");
-
-
-
-gettimeofday(&t_read_start, &tz);
-
-counter += jfread(block1, sizeof(char), blocksize, f_p1);
-counter += jfread(block2, sizeof(char), blocksize, f_p2);
-
-counter += jfread(block3, sizeof(char), blocksize, f_p3);
-
-
-gettimeofday(&t_read_end, &tz);
-tsec = 0.0;
-tsec += t_read_end.tv_usec;
-tsec -= t_read_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_read_end.tv_sec;
-tsec -= t_read_start.tv_sec;
-t_total_read = t_total_read + tsec;
-
-
-gettimeofday(&t_bus_start, &tz);
-
-ori_data[0] = block1 ;
-ori_data[1] = block2 ;
-
-ori_data[2] = block3 ;
-
-for (i = 0; i < 2; i++) {
-p_coding[i] = (char *)malloc(sizeof(char)*blocksize);
-if (p_coding[i] == NULL) { perror("malloc"); exit(1); }
-}
-
-gettimeofday(&t_bus_end, &tz);
-tsec=0.0;
-tsec += t_bus_end.tv_usec;
-tsec -= t_bus_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_bus_end.tv_sec;
-tsec -= t_bus_start.tv_sec;
-//printf("Transfer Time (sec): %0.6f\n", tsec);
-t_total_time = t_total_time + tsec;
-//printf("Total_Transfer Time (sec): %0.6f\n", t_total_time);
-
-//printf(" counter = %d\n",counter);
-
-// parity file
-//sprintf(p_fname, "%s/Coding/%s_parity_08.mp4",curdir,s1);
-//sprintf(p_fname, "%s/Coding/NewNode%d/%s_parity_08.mp4",curdir,integer, s1);
-//sprintf(p_fname, "/mnt/NewNode%d/%s_parity_08_%d.mp4",integer, s1, z+1);
-sprintf(p_fname, "/mnt/node%d/%s_parity_08_%d.mp4",integer+10, s1, z+1);
-p_fp = fopen(p_fname, "wb");
-
-gettimeofday(&t_cal_start, &tz);
-galois_w08_region_multiply(ori_data[0], buf[z][21] , blocksize, p_coding[0], 0);
-galois_w08_region_multiply(ori_data[1], buf[z][22] , blocksize, p_coding[0], 1);
-//printf("galois_w08_region_multiply()!!\n");
-galois_w08_region_multiply(ori_data[2], buf[z][23] , blocksize, p_coding[0], 1);
-
-
-
-gettimeofday(&t_cal_end, &tz);
-tsec = 0.0;
-tsec += t_cal_end.tv_usec;
-tsec -= t_cal_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_cal_end.tv_sec;
-tsec -= t_cal_start.tv_sec;
-t_total_cal = t_total_cal + tsec;
-
-fwrite(p_coding[0], sizeof(char), blocksize, p_fp);
-fclose(p_fp);
-
-
-
-
-
-// 9. m01 & m02 & m03  
-
-//sprintf(fname1, "%s/Coding/Node9/%s_m01.mp4",curdir,s1);
-sprintf(fname1, "/mnt/node9/%s_m01.mp4",s1);
-f_p1 = fopen(fname1, "rb");
-
-//sprintf(fname2, "%s/Coding/Node9/%s_m02.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node9/%s_m02.mp4",s1);
-f_p2 = fopen(fname2, "rb");
-
-//sprintf(fname3, "%s/Coding/Node9/%s_m03.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node9/%s_m03.mp4",s1);
-f_p3 = fopen(fname3, "rb");
-
-
-gettimeofday(&t_read_start, &tz);
-
-counter += jfread(block1, sizeof(char), blocksize, f_p1);
-//fclose(f_p1); // causing Segmentation Fault !!
-
-counter += jfread(block2, sizeof(char), blocksize, f_p2);
-//fclose(f_p2); // causing Segmentation Fault !!
-
-counter += jfread(block3, sizeof(char), blocksize, f_p3);
-
-
-gettimeofday(&t_read_end, &tz);
-
-tsec = 0.0;
-tsec += t_read_end.tv_usec;
-tsec -= t_read_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_read_end.tv_sec;
-tsec -= t_read_start.tv_sec;
-t_total_read = t_total_read + tsec;
-
-
-// do measurement of bus transfer !!
-gettimeofday(&t_bus_start, &tz);
-
-
-ori_data[0] = block1 ;
-ori_data[1] = block2 ;
-ori_data[2] = block3 ;
-
-for (i = 0; i < 2; i++) {
-p_coding[i] = (char *)malloc(sizeof(char)*blocksize);
-if (p_coding[i] == NULL) { perror("malloc"); exit(1); }
-}
-
-
-gettimeofday(&t_bus_end, &tz);
-tsec = 0.0;
-tsec += t_bus_end.tv_usec;
-tsec -= t_bus_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_bus_end.tv_sec;
-tsec -= t_bus_start.tv_sec;
-//printf("Transfer Time (sec): %0.6f\n", tsec);
-t_total_time = t_total_time + tsec;
-//printf("Total_Transfer Time (sec): %0.6f\n", t_total_time);
-
-
-
-//printf(" counter = %d\n",counter);
-
-// parity file
-//sprintf(p_fname, "%s/Coding/NewNode%d/%s_parity_09.mp4",curdir,integer, s1);
-//sprintf(p_fname, "/mnt/NewNode%d/%s_parity_09_%d.mp4",integer, s1 , z+1);
-sprintf(p_fname, "/mnt/node%d/%s_parity_09_%d.mp4",integer+10, s1 , z+1);
-p_fp = fopen(p_fname, "wb");
-
-gettimeofday(&t_cal_start, &tz);
-
-galois_w08_region_multiply(ori_data[0], 1 , blocksize, p_coding[0], 0);
-galois_w08_region_multiply(ori_data[1], 1 , blocksize, p_coding[0], 1);
-//printf("galois_w08_region_multiply()!!\n");
-galois_w08_region_multiply(ori_data[2], 1 , blocksize, p_coding[0], 1);
-
-
-
-gettimeofday(&t_cal_end, &tz);
-tsec = 0.0;
-tsec += t_cal_end.tv_usec;
-tsec -= t_cal_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_cal_end.tv_sec;
-tsec -= t_cal_start.tv_sec;
-t_total_cal = t_total_cal + tsec;
-
-
-fwrite(p_coding[0], sizeof(char), blocksize, p_fp);
-fclose(p_fp);
-
-
-fclose(f_p1); // causing Segmentation Fault !!
-
-fclose(f_p2); // causing Segmentation Fault !!
-
-
-
-
-
-
-// 10. m04 & m05 & m06 
-
-//sprintf(fname1, "%s/Coding/Node10/%s_m04.mp4",curdir,s1);
-sprintf(fname1, "/mnt/node10/%s_m04.mp4",s1);
-f_p1 = fopen(fname1, "rb");
-
-//sprintf(fname2, "%s/Coding/Node10/%s_m05.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node10/%s_m05.mp4",s1);
-f_p2 = fopen(fname2, "rb");
-
-//sprintf(fname3, "%s/Coding/Node10/%s_m06.mp4",curdir,s1);
-sprintf(fname2, "/mnt/node10/%s_m06.mp4",s1);
-f_p3 = fopen(fname3, "rb");
-
-
-gettimeofday(&t_read_start, &tz);
-
-counter += jfread(block1, sizeof(char), blocksize, f_p1);
-//fclose(f_p1); // causing Segmentation Fault !!
-
-counter += jfread(block2, sizeof(char), blocksize, f_p2);
-//fclose(f_p2); // causing Segmentation Fault !!
-
-counter += jfread(block3, sizeof(char), blocksize, f_p3);
-
-
-gettimeofday(&t_read_end, &tz);
-
-tsec = 0.0;
-tsec += t_read_end.tv_usec;
-tsec -= t_read_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_read_end.tv_sec;
-tsec -= t_read_start.tv_sec;
-t_total_read = t_total_read + tsec;
-
-
-// do measurement of bus transfer !!
-gettimeofday(&t_bus_start, &tz);
-
-
-ori_data[0] = block1 ;
-ori_data[1] = block2 ;
-ori_data[2] = block3 ;
-
-for (i = 0; i < 2; i++) {
-p_coding[i] = (char *)malloc(sizeof(char)*blocksize);
-if (p_coding[i] == NULL) { perror("malloc"); exit(1); }
-}
-
-
-gettimeofday(&t_bus_end, &tz);
-tsec = 0.0;
-tsec += t_bus_end.tv_usec;
-tsec -= t_bus_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_bus_end.tv_sec;
-tsec -= t_bus_start.tv_sec;
-//printf("Transfer Time (sec): %0.6f\n", tsec);
-t_total_time = t_total_time + tsec;
-//printf("Total_Transfer Time (sec): %0.6f\n", t_total_time);
-
-
-
-//printf(" counter = %d\n",counter);
-
-// parity file
-//sprintf(p_fname, "%s/Coding/NewNode%d/%s_parity_10.mp4",curdir,integer, s1);
-//sprintf(p_fname, "/mnt/NewNode%d/%s_parity_10_%d.mp4",integer, s1 , z+1);
-sprintf(p_fname, "/mnt/node%d/%s_parity_10_%d.mp4",integer+10, s1 , z+1);
-p_fp = fopen(p_fname, "wb");
-
-gettimeofday(&t_cal_start, &tz);
-
-galois_w08_region_multiply(ori_data[0], 1 , blocksize, p_coding[0], 0);
-galois_w08_region_multiply(ori_data[1], 1 , blocksize, p_coding[0], 1);
-//printf("galois_w08_region_multiply()!!\n");
-galois_w08_region_multiply(ori_data[2], 1 , blocksize, p_coding[0], 1);
-
-
-
-gettimeofday(&t_cal_end, &tz);
-tsec = 0.0;
-tsec += t_cal_end.tv_usec;
-tsec -= t_cal_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_cal_end.tv_sec;
-tsec -= t_cal_start.tv_sec;
-t_total_cal = t_total_cal + tsec;
-
-
-fwrite(p_coding[0], sizeof(char), blocksize, p_fp);
-fclose(p_fp);
-
-
-fclose(f_p1); // causing Segmentation Fault !!
-
-fclose(f_p2); // causing Segmentation Fault !!
-
-
-
-
-
-
-
-
-
-///////////////////////////////////////  NOW , 10 new parity made! /////////////////////////////////
-////////////////////////////////////// and then, transfered them into NewNode1 , NewNode2 /////////////////
-
-
-//////////////////////////////////////    NOW, xor between all parities !!!! ////////////////////////////////
-/////////////////////////////    parity_01.mp4 ~ parity_08 at once !!    /////////////////////////////////
-
-gettimeofday(&t_whcho_start, &tz);
-
-
-int bit_counter;
-//char *dptr , *sptr; 
-
-counter=0;
-
-par_data = (char **)malloc(sizeof(char*)*8);
-
-//printf(" counter = %d\n",counter);
-
-/////////////////// 1. read 8 parities into memory ////////////////////////
-//sprintf(fname1, "%s/Coding/NewNode%d/%s_parity_01.mp4",curdir,integer,s1);
-//sprintf(fname1, "/mnt/NewNode%d/%s_parity_01_%d.mp4",integer,s1,z+1);
-sprintf(fname1, "/mnt/node%d/%s_parity_01_%d.mp4",integer+10,s1,z+1);
-f_p1 = fopen(fname1, "rb");
-counter += jfread(block1, sizeof(char), blocksize, f_p1);
-par_data[0]= block1;
-
-//sprintf(fname1, "%s/Coding/NewNode%d/%s_parity_02.mp4",curdir,integer,s1);
-//sprintf(fname1, "/mnt/NewNode%d/%s_parity_02_%d.mp4",integer,s1,z+1);
-sprintf(fname1, "/mnt/node%d/%s_parity_02_%d.mp4",integer+10,s1,z+1);
-f_p1 = fopen(fname1, "rb");
-counter += jfread(block2, sizeof(char), blocksize, f_p1);
-par_data[1]= block2;
-
-//sprintf(fname1, "%s/Coding/NewNode%d/%s_parity_03.mp4",curdir,integer,s1);
-//sprintf(fname1, "/mnt/NewNode%d/%s_parity_03_%d.mp4",integer,s1,z+1);
-sprintf(fname1, "/mnt/node%d/%s_parity_03_%d.mp4",integer+10,s1,z+1);
-f_p1 = fopen(fname1, "rb");
-counter += jfread(block3, sizeof(char), blocksize, f_p1);
-par_data[2]= block3;
-
-//sprintf(fname1, "%s/Coding/NewNode%d/%s_parity_04.mp4",curdir,integer,s1);
-//sprintf(fname1, "/mnt/NewNode%d/%s_parity_04_%d.mp4",integer,s1,z+1);
-sprintf(fname1, "/mnt/node%d/%s_parity_04_%d.mp4",integer+10,s1,z+1);
-f_p1 = fopen(fname1, "rb");
-counter += jfread(block4, sizeof(char), blocksize, f_p1);
-par_data[3]= block4;
-
-//sprintf(fname1, "%s/Coding/NewNode%d/%s_parity_05.mp4",curdir,integer,s1);
-//sprintf(fname1, "/mnt/NewNode%d/%s_parity_05_%d.mp4",integer,s1,z+1);
-sprintf(fname1, "/mnt/node%d/%s_parity_05_%d.mp4",integer+10,s1,z+1);
-f_p1 = fopen(fname1, "rb");
-counter += jfread(block5, sizeof(char), blocksize, f_p1);
-par_data[4]= block5;
-
-//sprintf(fname1, "%s/Coding/NewNode%d/%s_parity_06.mp4",curdir,integer,s1);
-//sprintf(fname1, "/mnt/NewNode%d/%s_parity_06_%d.mp4",integer,s1,z+1);
-sprintf(fname1, "/mnt/node%d/%s_parity_06_%d.mp4",integer+10,s1,z+1);
-f_p1 = fopen(fname1, "rb");
-counter += jfread(block6, sizeof(char), blocksize, f_p1);
-par_data[5]= block6;
-
-//sprintf(fname1, "%s/Coding/NewNode%d/%s_parity_07.mp4",curdir,integer,s1);
-//sprintf(fname1, "/mnt/NewNode%d/%s_parity_07_%d.mp4",integer,s1,z+1);
-sprintf(fname1, "/mnt/node%d/%s_parity_07_%d.mp4",integer+10,s1,z+1);
-f_p1 = fopen(fname1, "rb");
-counter += jfread(block7, sizeof(char), blocksize, f_p1);
-par_data[6]= block7;
-
-//sprintf(fname1, "%s/Coding/NewNode%d/%s_parity_08.mp4",curdir,integer,s1);
-//sprintf(fname1, "/mnt/NewNode%d/%s_parity_08_%d.mp4",integer,s1,z+1);
-sprintf(fname1, "/mnt/node%d/%s_parity_08_%d.mp4",integer+10,s1,z+1);
-f_p1 = fopen(fname1, "rb");
-counter += jfread(block8, sizeof(char), blocksize, f_p1);
-par_data[7]= block8;
-
-// for debugging
-//printf(" counter = %d!!!\n",counter);
-
-gettimeofday(&t_whcho_end, &tz);
-tsec = 0.0;
-tsec += t_whcho_end.tv_usec;
-tsec -= t_whcho_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_whcho_end.tv_sec;
-tsec -= t_whcho_start.tv_sec;
-t_whcho = t_whcho + tsec;
-
-
-
-
-bit_counter=0;
-
-dptr=p_coding[0];
-
-gettimeofday(&t_cal_start, &tz);
-
-for(i=0;i<8;i++){
-
-sptr=par_data[i];
-
-if(bit_counter == 0){
-memcpy(dptr , sptr , blocksize);
-bit_counter=1;
-}
-else {
-galois_region_xor(sptr, dptr, blocksize);
-}
-
-}
-
-
-
-
-
-gettimeofday(&t_cal_end, &tz);
-tsec = 0.0;
-tsec += t_cal_end.tv_usec;
-tsec -= t_cal_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_cal_end.tv_sec;
-tsec -= t_cal_start.tv_sec;
-t_total_cal = t_total_cal + tsec;
-
-
-
-//sprintf(p_fname, "%s/Coding/NewNode%d/%s_m%0*d%s", curdir, integer, s1, md, m+1+z, extension);
-//sprintf(p_fname, "/mnt/NewNode%d/%s_m%0*d%s", integer, s1, md, m+1+z, extension);
-sprintf(p_fname, "/mnt/node%d/%s_m%0*d%s", integer+10, s1, md, m+1+z, extension);
-
-//sprintf(p_fname, "%s/Coding/%s_parity_final.mp4",curdir,s1);
-p_fp = fopen(p_fname, "wb");
-
-gettimeofday(&t_write_start, &tz);
-
-fwrite(dptr, sizeof(char), blocksize, p_fp);
-fclose(p_fp);
-
-gettimeofday(&t_write_end, &tz);
-tsec = 0.0;
-tsec += t_write_end.tv_usec;
-tsec -= t_write_start.tv_usec;
-tsec /= 1000000.0;
-tsec += t_write_end.tv_sec;
-tsec -= t_write_start.tv_sec;
-t_total_write = t_total_write + tsec;
-
-
-}// for (z=0;z<4;z++) at LOC 900  
-
-
-
-
-//fclose(p_fp);
-
-
-
-printf("Total_Transfer Time (sec): %0.6f\n", t_total_time);
-//printf("transger_throughput  (MB/sec): %0.6f\n", (((double) size)/1024.0/1024.0)/t_total_time);
-
-printf("Total_Read Time (sec): %0.6f\n", t_total_read);
-//printf("read_throughput (MB/sec): %0.6f\n", (((double) size)/1024.0/1024.0)/t_total_read);
-
-printf("Total_Calculation Time (sec): %0.6f\n", t_total_cal);
-//printf("cal_throughput (MB/sec): %0.6f\n", (((double) size)/1024.0/1024.0)/t_total_cal);
-
-printf("Total_Write Time (sec): %0.6f\n", t_total_write);
-//printf("write_throughput (MB/sec): %0.6f\n", (((double) size)/1024.0/1024.0)/t_total_write);
-
-printf("whcho Time (sec): %0.6f\n", t_whcho);
-//printf("whcho (MB/sec): %0.6f\n", (((double) size)/1024.0/1024.0)/t_whcho);
-
-
-
-
-
-
-
-/* Calculate rate in MB/sec and print */
-
-
-
-gettimeofday(&t6, &tz);
-tsec = 0.0;
-tsec += t6.tv_usec;
-tsec -= t5.tv_usec;
-tsec /= 1000000.0;
-tsec += t6.tv_sec;
-tsec -= t5.tv_sec;
-printf("Calculate_Parity_Total Time (sec): %0.6f\n", tsec);
-
-
-
-
-
-//fclose(f_p1);
-//fclose(f_p2);
-
-//fclose(src_fp);
-//fclose(dst_fp);
-
-
-
-
-//whcho added for testing !!!!
-
-
-/*sprintf(fname1, "/mnt/NewNode1/%s_m05.mp4",s1);
-f_p1 = fopen(fname1, "rb");
-counter += jfread(block1, sizeof(char), blocksize, f_p1);
-par_data[0]= block1;
-
-sprintf(fname1, "/mnt/NewNode1/%s_m06.mp4",s1);
-f_p1 = fopen(fname1, "rb");
-counter += jfread(block2, sizeof(char), blocksize, f_p1);
-par_data[1]= block2;
-
-
-dptr=par_data[0];
-sptr=par_data[1];
-
-
-galois_region_xor(sptr, dptr, blocksize);
-
-
-sprintf(p_fname, "/mnt/NewNode1/%s_m_whcho", s1);
-p_fp = fopen(p_fname, "wb");
-fwrite(dptr, sizeof(char), blocksize, p_fp);
-fclose(p_fp);
-*/
-
-
-
-
-
-
-
-free(block1);
-free(block2);
-free(block3);
-free(block4);
-free(block5);
-free(block6);
-free(block7);
-free(block8);
-
-free(ori_data);
-free(p_coding);
-free(par_data);
-
-
-
-
-free(trans_block1);
-free(trans_block2);
-free(trans_block3);
-free(trans_block4);
-free(trans_block5);
-free(trans_block6);
-free(trans_block7);
-free(trans_block8);
-
+		instr_end(&sc_total);
+		printf("Total_Transfer Time (sec): %0.6f\n", instr_seconds(ph_so_transfer));
+		printf("Total_Read Time (sec): %0.6f\n", instr_seconds(ph_so_read));
+		printf("Total_Calculation Time (sec): %0.6f\n", instr_seconds(ph_so_partial) + instr_seconds(ph_so_aggregate));
+		printf("Total_Write Time (sec): %0.6f\n", instr_seconds(ph_so_write));
+		printf("whcho Time (sec): %0.6f\n", instr_seconds(ph_so_collect));
+		printf("Calculate_Parity_Total Time (sec): %0.6f\n", instr_seconds(ph_so_total));
+		printf("Scale-out (MB/sec): %0.6f\n", ((double) NEW_PARITIES*readins*blocksize/1024.0/1024.0)/instr_seconds(ph_so_total));
+
+		/* What crossed the network, against re-encoding the new parities
+		   from the data, which ships every data fragment held elsewhere to
+		   each new parity's node */
+		instr_output("scaleout", (int64_t) NEW_PARITIES*readins*blocksize);
+		instr_summary(stdout, "scaleout");
+		offset = 0;
+		for (z = 0; z < NEW_PARITIES; z++) {
+			for (i = 0; i < k; i++) {
+				if (meta.location[i] != meta.location[k+m+z]) offset += (int64_t) readins*blocksize;
+			}
+		}
+		printf("Scale-out network bytes: %lld (%.3f per new parity byte); re-encoding would move %lld (%.3f)\n",
+		       (long long) instr_bytes(ph_so_transfer),
+		       (double) instr_bytes(ph_so_transfer) / ((double) NEW_PARITIES*readins*blocksize),
+		       (long long) offset, (double) offset / ((double) NEW_PARITIES*readins*blocksize));
+
+		for (i = 0; i < k; i++) buf_pool_put(ori_data[i]);
+		for (j = 0; j < nnodes; j++) buf_pool_put(par_data[j]);
+		free(ori_data);
+		free(par_data);
+		buf_pool_put(dptr);
+		free(coefs);
+		free(src_node);
+		free(grp_start);
+		free(grp_frag);
+		free(ext);
+		free(src_numa);
+		if (pjobs != NULL) {
+			for (j = 0; j < nnodes*NEW_PARITIES; j++) elastic_partial_free(plans[j]);
+			free(plans);
+		}
+		free(pjobs);
+		if (agent_fd != NULL) {
+			for (j = 0; j < nnodes+NEW_PARITIES; j++) close(agent_fd[j]);
+			free(agent_fd);
+			free(xsrc);
+		}
+	}
+	else if (mstore != NULL) {
+		meta_store_close(mstore);
+		free(meta_path);
+	}
+	instr_finish();
+
+	for (i = 0; i < mi; i++) buf_pool_put(coding[i]);
+	free(coding);
+	free(data);
+	free(stripe);
+	tile_code_free(ec.tc);
+	xor_sched_free(ec.xs);
+	workers_stop(wk);
+	fstore->close(fstore);
+	placement_free(pl);
 
 	/* Free allocated memory */
 free(s1);
 free(fname);
-free(block);
+buf_pool_put(block);
 free(curdir);
 
 
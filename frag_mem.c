@@ -0,0 +1,196 @@
+/* frag_mem.c - fragments kept in the memory of the process.
+ *
+ * A hash table of (node, key) -> growable buffer.  Nothing outlives the
+ * process, so the store is for the benchmark and for timing the encoder
+ * and scale-out without I/O; the decoder cannot read what an encoder
+ * process kept in memory.  Safe to use from several threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "frag_store.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define MEM_HASH   1024
+
+struct mem_frag {
+  int      node;
+  char     key[FRAG_KEY_MAX];
+  char    *data;
+  int64_t  size;
+  int64_t  cap;
+  struct mem_frag *next;
+};
+
+struct mem_store {
+  pthread_mutex_t  lock;
+  struct mem_frag *heads[MEM_HASH];
+};
+
+static unsigned mem_hash(int node, const char *key)
+{
+  unsigned h;
+
+  h = (unsigned) node;
+  while (*key != '\0') h = h * 31u + (unsigned char) *key++;
+  return h % MEM_HASH;
+}
+
+/* The fragment, created if create is set.  Called with the lock held. */
+static struct mem_frag *mem_find(struct mem_store *ms, int node, const char *key, int create)
+{
+  struct mem_frag *f;
+  unsigned h;
+
+  h = mem_hash(node, key);
+  for (f = ms->heads[h]; f != NULL; f = f->next) {
+    if (f->node == node && strcmp(f->key, key) == 0) return f;
+  }
+  if (!create || strlen(key) >= FRAG_KEY_MAX) return NULL;
+  f = talloc(struct mem_frag, 1);
+  if (f == NULL) return NULL;
+  memset(f, 0, sizeof(*f));
+  f->node = node;
+  strcpy(f->key, key);
+  f->next = ms->heads[h];
+  ms->heads[h] = f;
+  return f;
+}
+
+static int64_t mem_write(frag_store_t *fs, int node, const char *key, int64_t offset, const char *buf, int64_t len)
+{
+  struct mem_store *ms;
+  struct mem_frag *f;
+  int64_t cap;
+  char *data;
+
+  ms = (struct mem_store *) fs->priv;
+  pthread_mutex_lock(&ms->lock);
+  f = mem_find(ms, node, key, 1);
+  if (f == NULL) {
+    pthread_mutex_unlock(&ms->lock);
+    return -1;
+  }
+  if (offset == 0) f->size = 0;
+  if (offset + len > f->cap) {
+    cap = (f->cap == 0) ? len : f->cap;
+    while (cap < offset + len) cap *= 2;
+    data = (char *) realloc(f->data, cap);
+    if (data == NULL) {
+      pthread_mutex_unlock(&ms->lock);
+      return -1;
+    }
+    f->data = data;
+    f->cap = cap;
+  }
+  /* A write past the end leaves a hole, which reads as zeros */
+  if (offset > f->size) memset(f->data + f->size, 0, offset - f->size);
+  memcpy(f->data + offset, buf, len);
+  if (offset + len > f->size) f->size = offset + len;
+  pthread_mutex_unlock(&ms->lock);
+  return len;
+}
+
+static int64_t mem_read(frag_store_t *fs, int node, const char *key, int64_t offset, char *buf, int64_t len)
+{
+  struct mem_store *ms;
+  struct mem_frag *f;
+  int64_t n;
+
+  ms = (struct mem_store *) fs->priv;
+  pthread_mutex_lock(&ms->lock);
+  f = mem_find(ms, node, key, 0);
+  if (f == NULL) {
+    pthread_mutex_unlock(&ms->lock);
+    return -1;
+  }
+  n = (offset >= f->size) ? 0 : f->size - offset;
+  if (n > len) n = len;
+  memcpy(buf, f->data + offset, n);
+  pthread_mutex_unlock(&ms->lock);
+  return n;
+}
+
+static int64_t mem_size(frag_store_t *fs, int node, const char *key)
+{
+  struct mem_store *ms;
+  struct mem_frag *f;
+  int64_t size;
+
+  ms = (struct mem_store *) fs->priv;
+  pthread_mutex_lock(&ms->lock);
+  f = mem_find(ms, node, key, 0);
+  size = (f == NULL) ? -1 : f->size;
+  pthread_mutex_unlock(&ms->lock);
+  return size;
+}
+
+static int mem_remove(frag_store_t *fs, int node, const char *key)
+{
+  struct mem_store *ms;
+  struct mem_frag **fp, *f;
+
+  ms = (struct mem_store *) fs->priv;
+  pthread_mutex_lock(&ms->lock);
+  for (fp = &ms->heads[mem_hash(node, key)]; *fp != NULL; fp = &(*fp)->next) {
+    f = *fp;
+    if (f->node == node && strcmp(f->key, key) == 0) {
+      *fp = f->next;
+      pthread_mutex_unlock(&ms->lock);
+      free(f->data);
+      free(f);
+      return 0;
+    }
+  }
+  pthread_mutex_unlock(&ms->lock);
+  return -1;
+}
+
+static int mem_sync(frag_store_t *fs)
+{
+  (void) fs;
+  return 0;
+}
+
+static void mem_close(frag_store_t *fs)
+{
+  struct mem_store *ms;
+  struct mem_frag *f, *next;
+  int h;
+
+  ms = (struct mem_store *) fs->priv;
+  for (h = 0; h < MEM_HASH; h++) {
+    for (f = ms->heads[h]; f != NULL; f = next) {
+      next = f->next;
+      free(f->data);
+      free(f);
+    }
+  }
+  pthread_mutex_destroy(&ms->lock);
+  free(ms);
+  free(fs);
+}
+
+int frag_mem_init(frag_store_t *fs)
+{
+  struct mem_store *ms;
+
+  ms = talloc(struct mem_store, 1);
+  if (ms == NULL) return -1;
+  memset(ms, 0, sizeof(*ms));
+  pthread_mutex_init(&ms->lock, NULL);
+
+  fs->write = mem_write;
+  fs->read = mem_read;
+  fs->size = mem_size;
+  fs->locate = NULL;
+  fs->remove = mem_remove;
+  fs->sync = mem_sync;
+  fs->close = mem_close;
+  fs->priv = ms;
+  return 0;
+}
@@ -0,0 +1,219 @@
+/* frag_remote.c - fragment store that reaches nodes through their agents.
+ *
+ * Wraps a local store.  Fragments on nodes with an agent address in the
+ * placement map are written with PUT (MSG_ZEROCOPY for large buffers) and
+ * read with GET, which the agent answers with sendfile() when it can.
+ * Nodes without an agent go to the local store.  A node whose agent
+ * cannot be reached is not retried: its fragments read as missing, which
+ * the decoder treats as erasures.  Requests to one agent share its
+ * connection, so threads take turns on it; a request that fails part way
+ * closes the connection, since later replies would be paired with the
+ * wrong requests, and the node then reads as unreachable too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "frag_store.h"
+#include "placement.h"
+#include "transport.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define REMOTE_UNREACHABLE  (-2)
+
+struct remote_conn {
+  int node;
+  int fd;                                /* REMOTE_UNREACHABLE after a failed connect or request */
+  pthread_mutex_t lock;                  /* one request at a time on fd */
+};
+
+struct remote_store {
+  frag_store_t       *local;
+  struct placement   *pl;
+  pthread_mutex_t     lock;              /* conns[], nconns */
+  int                 nconns;
+  struct remote_conn  conns[PLACEMENT_MAX_NODES];
+};
+
+/* Connection to node's agent, NULL if the node has none.  Its fd is
+   REMOTE_UNREACHABLE if the agent cannot be reached. */
+static struct remote_conn *remote_conn(struct remote_store *rs, int node)
+{
+  struct remote_conn *c;
+  const char *addr;
+  int i;
+
+  pthread_mutex_lock(&rs->lock);
+  for (i = 0; i < rs->nconns; i++) {
+    if (rs->conns[i].node == node) {
+      pthread_mutex_unlock(&rs->lock);
+      return &rs->conns[i];
+    }
+  }
+  addr = placement_node_agent(rs->pl, node);
+  if (addr == NULL || rs->nconns == PLACEMENT_MAX_NODES) {
+    pthread_mutex_unlock(&rs->lock);
+    return NULL;
+  }
+
+  c = &rs->conns[i];
+  c->node = node;
+  c->fd = transport_connect(addr);
+  if (c->fd < 0) {
+    fprintf(stderr, "Warning: agent of node %d at %s is unreachable\n", node, addr);
+    c->fd = REMOTE_UNREACHABLE;
+  }
+  pthread_mutex_init(&c->lock, NULL);
+  rs->nconns++;
+  pthread_mutex_unlock(&rs->lock);
+  return c;
+}
+
+/* rv of a transport call on c, with c->lock held.  A broken connection
+   is closed and the call fails. */
+static int64_t remote_check(struct remote_conn *c, int64_t rv)
+{
+  if (rv != TRANSPORT_BROKEN) return rv;
+  fprintf(stderr, "Warning: lost the agent of node %d\n", c->node);
+  close(c->fd);
+  c->fd = REMOTE_UNREACHABLE;
+  return -1;
+}
+
+static int64_t remote_write(frag_store_t *fs, int node, const char *key, int64_t offset, const char *buf, int64_t len)
+{
+  struct remote_store *rs;
+  struct remote_conn *c;
+  int64_t rv;
+
+  rs = (struct remote_store *) fs->priv;
+  c = remote_conn(rs, node);
+  if (c == NULL) return rs->local->write(rs->local, node, key, offset, buf, len);
+  pthread_mutex_lock(&c->lock);
+  rv = (c->fd < 0) ? -1 : remote_check(c, transport_put(c->fd, fs->kind, node, key, offset, buf, len));
+  pthread_mutex_unlock(&c->lock);
+  return rv;
+}
+
+static int64_t remote_read(frag_store_t *fs, int node, const char *key, int64_t offset, char *buf, int64_t len)
+{
+  struct remote_store *rs;
+  struct remote_conn *c;
+  int64_t rv;
+
+  rs = (struct remote_store *) fs->priv;
+  c = remote_conn(rs, node);
+  if (c == NULL) return rs->local->read(rs->local, node, key, offset, buf, len);
+  pthread_mutex_lock(&c->lock);
+  rv = (c->fd < 0) ? -1 : remote_check(c, transport_get(c->fd, fs->kind, node, key, offset, buf, len));
+  pthread_mutex_unlock(&c->lock);
+  return rv;
+}
+
+static int64_t remote_size(frag_store_t *fs, int node, const char *key)
+{
+  struct remote_store *rs;
+  struct remote_conn *c;
+  int64_t rv;
+
+  rs = (struct remote_store *) fs->priv;
+  c = remote_conn(rs, node);
+  if (c == NULL) return rs->local->size(rs->local, node, key);
+  pthread_mutex_lock(&c->lock);
+  rv = (c->fd < 0) ? -1 : remote_check(c, transport_size(c->fd, fs->kind, node, key));
+  pthread_mutex_unlock(&c->lock);
+  return rv;
+}
+
+static int remote_locate(frag_store_t *fs, int node, const char *key, int64_t offset, int64_t len,
+                         int64_t *file_offset, int64_t *contig)
+{
+  struct remote_store *rs;
+
+  rs = (struct remote_store *) fs->priv;
+  if (remote_conn(rs, node) != NULL || rs->local->locate == NULL) return -1;
+  return rs->local->locate(rs->local, node, key, offset, len, file_offset, contig);
+}
+
+static int remote_remove(frag_store_t *fs, int node, const char *key)
+{
+  struct remote_store *rs;
+  struct remote_conn *c;
+  int rv;
+
+  rs = (struct remote_store *) fs->priv;
+  c = remote_conn(rs, node);
+  if (c == NULL) return rs->local->remove(rs->local, node, key);
+  pthread_mutex_lock(&c->lock);
+  rv = (c->fd < 0) ? -1 : (int) remote_check(c, transport_delete(c->fd, fs->kind, node, key));
+  pthread_mutex_unlock(&c->lock);
+  return rv;
+}
+
+static int remote_sync(frag_store_t *fs)
+{
+  struct remote_store *rs;
+  struct remote_conn *c;
+  int i, rv;
+
+  rs = (struct remote_store *) fs->priv;
+  rv = rs->local->sync(rs->local);
+  for (i = 0; i < rs->nconns; i++) {
+    c = &rs->conns[i];
+    pthread_mutex_lock(&c->lock);
+    if (c->fd >= 0 && remote_check(c, transport_sync(c->fd, fs->kind, c->node)) != 0) rv = -1;
+    pthread_mutex_unlock(&c->lock);
+  }
+  return rv;
+}
+
+static void remote_close(frag_store_t *fs)
+{
+  struct remote_store *rs;
+  int i;
+
+  rs = (struct remote_store *) fs->priv;
+  for (i = 0; i < rs->nconns; i++) {
+    if (rs->conns[i].fd >= 0) close(rs->conns[i].fd);
+    pthread_mutex_destroy(&rs->conns[i].lock);
+  }
+  pthread_mutex_destroy(&rs->lock);
+  rs->local->close(rs->local);
+  free(rs);
+  free(fs);
+}
+
+frag_store_t *frag_remote_open(frag_store_t *local, struct placement *pl)
+{
+  struct remote_store *rs;
+  frag_store_t *fs;
+
+  fs = talloc(frag_store_t, 1);
+  rs = talloc(struct remote_store, 1);
+  if (fs == NULL || rs == NULL) {
+    free(fs);
+    free(rs);
+    return NULL;
+  }
+  memset(fs, 0, sizeof(*fs));
+  memset(rs, 0, sizeof(*rs));
+  rs->local = local;
+  rs->pl = pl;
+  pthread_mutex_init(&rs->lock, NULL);
+
+  fs->kind = local->kind;
+  fs->placement = pl;
+  fs->write = remote_write;
+  fs->read = remote_read;
+  fs->size = remote_size;
+  fs->locate = remote_locate;
+  fs->remove = remote_remove;
+  fs->sync = remote_sync;
+  fs->close = remote_close;
+  fs->priv = rs;
+  return fs;
+}
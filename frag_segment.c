@@ -0,0 +1,705 @@
+/* frag_segment.c - log-structured fragment store.
+ *
+ * Each node root holds
+ *
+ *   seg_000001.dat, seg_000002.dat, ...   fragment bytes, appended
+ *   seg.idx                               one seg_entry per append
+ *
+ * A segment is closed once it would grow past FRAG_SEGMENT_MAX.  The index
+ * is replayed into a hash table of extents on first use and re-read from
+ * where we left off whenever another process may have appended to it.
+ * Appends take flock() on seg.idx, write the data, then the index entry,
+ * so an entry never points at bytes that were not written.  A torn entry
+ * at the tail of the index fails its checksum and is truncated away by
+ * the next writer.  flock() does not keep threads of one process apart,
+ * so each node also has a mutex; threads working on different nodes do
+ * not wait for each other.
+ *
+ * Removing a fragment appends a tombstone, an entry for segment 0, which
+ * no data lives in.  Overwritten and removed fragments keep their bytes
+ * until frag_segment_compact() copies the live extents into new segments,
+ * writes a fresh index naming only those, and deletes the old segments.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include "frag_store.h"
+#include "meta_store.h"
+#include "placement.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define SEG_INDEX_FILE   "seg.idx"
+#define SEG_COMPACT_FILE "seg.idx.new"
+#define SEG_COPY_BUF     (1 << 20)
+#define SEG_BUCKETS      4096
+#define SEG_MAX_NODES    (PLACEMENT_MAX_NODE_ID + 1)
+
+struct seg_entry {
+  uint32_t crc;
+  uint32_t segment;
+  uint64_t seg_offset;
+  uint64_t frag_offset;
+  uint64_t length;
+  char     key[FRAG_KEY_MAX];
+};
+
+struct seg_extent {
+  int64_t  frag_offset;
+  int64_t  length;
+  uint32_t segment;
+  int64_t  seg_offset;
+};
+
+struct seg_object {
+  char               key[FRAG_KEY_MAX];
+  int                nextents;
+  int                maxextents;
+  struct seg_extent *ext;
+  struct seg_object *next;
+};
+
+struct seg_node {
+  pthread_mutex_t     lock;           /* everything below, and the fds */
+  char                root[FRAG_KEY_MAX];
+  int                 idx_fd;
+  off_t               idx_pos;        /* index bytes replayed so far */
+  uint32_t            last_segment;   /* highest segment id seen */
+  int                 nfds;
+  int                *fds;            /* fds[id], opened lazily */
+  struct seg_object  *buckets[SEG_BUCKETS];
+};
+
+struct seg_store {
+  frag_store_t    *fs;
+  pthread_mutex_t  lock;              /* nodes[] */
+  struct seg_node *nodes[SEG_MAX_NODES];
+};
+
+static uint32_t entry_crc(const struct seg_entry *e)
+{
+  return meta_store_crc32(0, &e->segment, sizeof(*e) - sizeof(e->crc));
+}
+
+static unsigned key_bucket(const char *key)
+{
+  uint32_t h;
+
+  h = 2166136261U;
+  while (*key != '\0') {
+    h ^= (unsigned char) *key++;
+    h *= 16777619U;
+  }
+  return h % SEG_BUCKETS;
+}
+
+static struct seg_object *object_find(struct seg_node *sn, const char *key, int create)
+{
+  struct seg_object *o;
+  unsigned b;
+
+  b = key_bucket(key);
+  for (o = sn->buckets[b]; o != NULL; o = o->next) {
+    if (strcmp(o->key, key) == 0) return o;
+  }
+  if (!create) return NULL;
+
+  o = talloc(struct seg_object, 1);
+  if (o == NULL) return NULL;
+  memset(o, 0, sizeof(*o));
+  snprintf(o->key, FRAG_KEY_MAX, "%s", key);
+  o->next = sn->buckets[b];
+  sn->buckets[b] = o;
+  return o;
+}
+
+static void object_drop(struct seg_node *sn, const char *key)
+{
+  struct seg_object **op, *o;
+
+  for (op = &sn->buckets[key_bucket(key)]; *op != NULL; op = &(*op)->next) {
+    o = *op;
+    if (strcmp(o->key, key) == 0) {
+      *op = o->next;
+      free(o->ext);
+      free(o);
+      return;
+    }
+  }
+}
+
+/* Applies one index entry to the in-memory table.  A write at fragment
+   offset 0 starts the fragment over, matching the file backend; a
+   tombstone removes it. */
+
+static int object_apply(struct seg_node *sn, const struct seg_entry *e)
+{
+  struct seg_object *o;
+  struct seg_extent *x;
+
+  if (e->segment == 0) {
+    object_drop(sn, e->key);
+    return 0;
+  }
+  o = object_find(sn, e->key, 1);
+  if (o == NULL) return -1;
+  if (e->frag_offset == 0) o->nextents = 0;
+  if (o->nextents == o->maxextents) {
+    o->maxextents = (o->maxextents == 0) ? 4 : o->maxextents * 2;
+    x = (struct seg_extent *) realloc(o->ext, sizeof(struct seg_extent) * o->maxextents);
+    if (x == NULL) return -1;
+    o->ext = x;
+  }
+  x = &o->ext[o->nextents++];
+  x->frag_offset = e->frag_offset;
+  x->length = e->length;
+  x->segment = e->segment;
+  x->seg_offset = e->seg_offset;
+  if (e->segment > sn->last_segment) sn->last_segment = e->segment;
+  return 0;
+}
+
+/* Replays index entries appended since the last call. */
+
+static int node_catch_up(struct seg_node *sn)
+{
+  struct seg_entry e;
+  ssize_t rv;
+
+  for (;;) {
+    rv = pread(sn->idx_fd, &e, sizeof(e), sn->idx_pos);
+    if (rv != sizeof(e)) return 0;
+    if (e.crc != entry_crc(&e)) return 0;
+    e.key[FRAG_KEY_MAX-1] = '\0';
+    if (object_apply(sn, &e) != 0) return -1;
+    sn->idx_pos += sizeof(e);
+  }
+}
+
+static int segment_fd(struct seg_node *sn, uint32_t id, int create)
+{
+  char path[FRAG_KEY_MAX+32];
+  int *fds;
+  int i;
+
+  if ((int) id >= sn->nfds) {
+    fds = (int *) realloc(sn->fds, sizeof(int) * (id + 16));
+    if (fds == NULL) return -1;
+    for (i = sn->nfds; i < (int) id + 16; i++) fds[i] = -1;
+    sn->fds = fds;
+    sn->nfds = id + 16;
+  }
+  if (sn->fds[id] < 0) {
+    sprintf(path, "%s/seg_%06u.dat", sn->root, id);
+    sn->fds[id] = open(path, O_RDWR | (create ? O_CREAT : 0), 0644);
+    if (sn->fds[id] < 0 && !create) sn->fds[id] = open(path, O_RDONLY);
+  }
+  return sn->fds[id];
+}
+
+static struct seg_node *node_get(struct seg_store *ss, int node)
+{
+  struct seg_node *sn;
+  char path[FRAG_KEY_MAX+32];
+
+  if (node < 0 || node >= SEG_MAX_NODES) return NULL;
+  pthread_mutex_lock(&ss->lock);
+  if (ss->nodes[node] != NULL) {
+    pthread_mutex_unlock(&ss->lock);
+    return ss->nodes[node];
+  }
+
+  sn = talloc(struct seg_node, 1);
+  if (sn == NULL) {
+    pthread_mutex_unlock(&ss->lock);
+    return NULL;
+  }
+  memset(sn, 0, sizeof(*sn));
+  frag_store_node_root(ss->fs, node, sn->root);
+
+  sprintf(path, "%s/%s", sn->root, SEG_INDEX_FILE);
+  sn->idx_fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (sn->idx_fd < 0) sn->idx_fd = open(path, O_RDONLY);
+  if (sn->idx_fd < 0) {
+    free(sn);
+    pthread_mutex_unlock(&ss->lock);
+    return NULL;
+  }
+  pthread_mutex_init(&sn->lock, NULL);
+  flock(sn->idx_fd, LOCK_SH);
+  node_catch_up(sn);
+  flock(sn->idx_fd, LOCK_UN);
+
+  ss->nodes[node] = sn;
+  pthread_mutex_unlock(&ss->lock);
+  return sn;
+}
+
+static int write_all(int fd, const char *buf, int64_t len, int64_t offset)
+{
+  int64_t done;
+  ssize_t rv;
+
+  done = 0;
+  while (done < len) {
+    rv = pwrite(fd, buf+done, len-done, offset+done);
+    if (rv < 0 && errno == EINTR) continue;
+    if (rv <= 0) return -1;
+    done += rv;
+  }
+  return 0;
+}
+
+/* Appends e to the index and applies it, with the index locked */
+static int entry_append(struct seg_node *sn, struct seg_entry *e)
+{
+  e->crc = entry_crc(e);
+  if (write_all(sn->idx_fd, (char *) e, sizeof(*e), sn->idx_pos) != 0) return -1;
+  sn->idx_pos += sizeof(*e);
+  return object_apply(sn, e);
+}
+
+/* Locks the node and its index, caught up and without a torn tail */
+static int node_lock(struct seg_node *sn)
+{
+  struct stat st;
+
+  pthread_mutex_lock(&sn->lock);
+  if (flock(sn->idx_fd, LOCK_EX) != 0) {
+    pthread_mutex_unlock(&sn->lock);
+    return -1;
+  }
+
+  /* Drop a torn entry left at the tail by a writer that died */
+  if (node_catch_up(sn) != 0 || fstat(sn->idx_fd, &st) != 0 ||
+      (st.st_size > sn->idx_pos && ftruncate(sn->idx_fd, sn->idx_pos) != 0)) {
+    flock(sn->idx_fd, LOCK_UN);
+    pthread_mutex_unlock(&sn->lock);
+    return -1;
+  }
+  return 0;
+}
+
+static void node_unlock(struct seg_node *sn)
+{
+  flock(sn->idx_fd, LOCK_UN);
+  pthread_mutex_unlock(&sn->lock);
+}
+
+static int64_t seg_write(frag_store_t *fs, int node, const char *key, int64_t offset, const char *buf, int64_t len)
+{
+  struct seg_store *ss;
+  struct seg_node *sn;
+  struct seg_entry e;
+  off_t end;
+  int fd;
+
+  ss = (struct seg_store *) fs->priv;
+  sn = node_get(ss, node);
+  if (sn == NULL || strlen(key) >= FRAG_KEY_MAX) return -1;
+  if (node_lock(sn) != 0) return -1;
+
+  if (sn->last_segment == 0) sn->last_segment = 1;
+  fd = segment_fd(sn, sn->last_segment, 1);
+  if (fd < 0) goto fail;
+  end = lseek(fd, 0, SEEK_END);
+  if (end > 0 && end + len > FRAG_SEGMENT_MAX) {
+    sn->last_segment++;
+    fd = segment_fd(sn, sn->last_segment, 1);
+    if (fd < 0) goto fail;
+    end = lseek(fd, 0, SEEK_END);
+  }
+  if (end < 0 || write_all(fd, buf, len, end) != 0) goto fail;
+
+  memset(&e, 0, sizeof(e));
+  e.segment = sn->last_segment;
+  e.seg_offset = end;
+  e.frag_offset = offset;
+  e.length = len;
+  strcpy(e.key, key);
+  if (entry_append(sn, &e) != 0) goto fail;
+
+  node_unlock(sn);
+  return len;
+
+fail:
+  node_unlock(sn);
+  return -1;
+}
+
+static int seg_remove(frag_store_t *fs, int node, const char *key)
+{
+  struct seg_store *ss;
+  struct seg_node *sn;
+  struct seg_entry e;
+  int rv;
+
+  ss = (struct seg_store *) fs->priv;
+  sn = node_get(ss, node);
+  if (sn == NULL || strlen(key) >= FRAG_KEY_MAX) return -1;
+  if (node_lock(sn) != 0) return -1;
+
+  rv = -1;
+  if (object_find(sn, key, 0) != NULL) {
+    memset(&e, 0, sizeof(e));
+    strcpy(e.key, key);
+    rv = entry_append(sn, &e);
+  }
+  node_unlock(sn);
+  return rv;
+}
+
+/* Returns with the node locked if the object exists */
+static struct seg_object *seg_lookup(struct seg_store *ss, int node, const char *key, struct seg_node **snp)
+{
+  struct seg_node *sn;
+  struct seg_object *o;
+
+  struct stat st;
+
+  sn = node_get(ss, node);
+  if (sn == NULL) return NULL;
+  *snp = sn;
+  pthread_mutex_lock(&sn->lock);
+
+  /* Another process (another encoder, a node agent) may have appended
+     to the index since we last looked, adding or replacing extents */
+  if (fstat(sn->idx_fd, &st) == 0 && st.st_size > sn->idx_pos) {
+    flock(sn->idx_fd, LOCK_SH);
+    node_catch_up(sn);
+    flock(sn->idx_fd, LOCK_UN);
+  }
+  o = object_find(sn, key, 0);
+  if (o == NULL) pthread_mutex_unlock(&sn->lock);
+  return o;
+}
+
+static int64_t seg_read(frag_store_t *fs, int node, const char *key, int64_t offset, char *buf, int64_t len)
+{
+  struct seg_node *sn;
+  struct seg_object *o;
+  struct seg_extent *x;
+  int64_t done, pos, n;
+  ssize_t rv;
+  int i, fd;
+
+  o = seg_lookup((struct seg_store *) fs->priv, node, key, &sn);
+  if (o == NULL) return -1;
+
+  /* Extents are almost always in fragment order, one per read-in */
+  done = 0;
+  while (done < len) {
+    pos = offset + done;
+    x = NULL;
+    for (i = o->nextents - 1; i >= 0; i--) {
+      if (o->ext[i].frag_offset <= pos && pos < o->ext[i].frag_offset + o->ext[i].length) {
+        x = &o->ext[i];
+        break;
+      }
+    }
+    if (x == NULL) break;
+
+    n = x->frag_offset + x->length - pos;
+    if (n > len - done) n = len - done;
+    fd = segment_fd(sn, x->segment, 0);
+    if (fd < 0) {
+      done = -1;
+      break;
+    }
+    rv = pread(fd, buf+done, n, x->seg_offset + (pos - x->frag_offset));
+    if (rv < 0 && errno == EINTR) continue;
+    if (rv <= 0) {
+      if (done == 0) done = -1;
+      break;
+    }
+    done += rv;
+  }
+  pthread_mutex_unlock(&sn->lock);
+  return done;
+}
+
+static int64_t seg_size(frag_store_t *fs, int node, const char *key)
+{
+  struct seg_node *sn;
+  struct seg_object *o;
+  int64_t size;
+  int i;
+
+  o = seg_lookup((struct seg_store *) fs->priv, node, key, &sn);
+  if (o == NULL) return -1;
+  size = 0;
+  for (i = 0; i < o->nextents; i++) {
+    if (o->ext[i].frag_offset + o->ext[i].length > size) size = o->ext[i].frag_offset + o->ext[i].length;
+  }
+  pthread_mutex_unlock(&sn->lock);
+  return size;
+}
+
+static int seg_locate(frag_store_t *fs, int node, const char *key, int64_t offset, int64_t len,
+                      int64_t *file_offset, int64_t *contig)
+{
+  struct seg_node *sn;
+  struct seg_object *o;
+  struct seg_extent *x;
+  int i, fd;
+
+  o = seg_lookup((struct seg_store *) fs->priv, node, key, &sn);
+  if (o == NULL) return -1;
+  fd = -1;
+  for (i = o->nextents - 1; i >= 0; i--) {
+    x = &o->ext[i];
+    if (x->frag_offset <= offset && offset < x->frag_offset + x->length) {
+      fd = segment_fd(sn, x->segment, 0);
+      if (fd < 0) break;
+      *file_offset = x->seg_offset + (offset - x->frag_offset);
+      *contig = x->frag_offset + x->length - offset;
+      if (*contig > len) *contig = len;
+      fd = dup(fd);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&sn->lock);
+  return fd;
+}
+
+static int seg_sync(frag_store_t *fs)
+{
+  struct seg_store *ss;
+  struct seg_node *sn;
+  int i, j, rv;
+
+  ss = (struct seg_store *) fs->priv;
+  rv = 0;
+  for (i = 0; i < SEG_MAX_NODES; i++) {
+    sn = ss->nodes[i];
+    if (sn == NULL) continue;
+    pthread_mutex_lock(&sn->lock);
+    for (j = 0; j < sn->nfds; j++) {
+      if (sn->fds[j] >= 0 && fdatasync(sn->fds[j]) != 0 && errno != EBADF && errno != EINVAL) rv = -1;
+    }
+    if (fdatasync(sn->idx_fd) != 0 && errno != EBADF && errno != EINVAL) rv = -1;
+    pthread_mutex_unlock(&sn->lock);
+  }
+  return rv;
+}
+
+static void node_clear(struct seg_node *sn)
+{
+  struct seg_object *o, *next;
+  int j;
+
+  for (j = 0; j < SEG_BUCKETS; j++) {
+    for (o = sn->buckets[j]; o != NULL; o = next) {
+      next = o->next;
+      free(o->ext);
+      free(o);
+    }
+    sn->buckets[j] = NULL;
+  }
+}
+
+/* An extent whose bytes a later extent of the object all replace */
+static int extent_dead(const struct seg_object *o, int i)
+{
+  const struct seg_extent *x, *y;
+  int j;
+
+  x = &o->ext[i];
+  if (x->length == 0) return 0;
+  for (j = i+1; j < o->nextents; j++) {
+    y = &o->ext[j];
+    if (y->frag_offset <= x->frag_offset && x->frag_offset + x->length <= y->frag_offset + y->length) return 1;
+  }
+  return 0;
+}
+
+/* Copies extent x to the end of segment *seg at *end, starting a new
+   segment when it would not fit.  The new segments come after every old
+   one, so an extent is never copied over live bytes. */
+static int extent_copy(struct seg_node *sn, const struct seg_extent *x, uint32_t *seg, int64_t *end, char *buf)
+{
+  int64_t done, n;
+  ssize_t rv;
+  int in, out;
+
+  if (*end > 0 && *end + x->length > FRAG_SEGMENT_MAX) {
+    (*seg)++;
+    *end = 0;
+  }
+  out = segment_fd(sn, *seg, 1);
+  in = segment_fd(sn, x->segment, 0);
+  if (out < 0 || in < 0) return -1;
+  if (*end == 0 && ftruncate(out, 0) != 0) return -1;
+
+  done = 0;
+  while (done < x->length) {
+    n = x->length - done;
+    if (n > SEG_COPY_BUF) n = SEG_COPY_BUF;
+    rv = pread(in, buf, n, x->seg_offset + done);
+    if (rv < 0 && errno == EINTR) continue;
+    if (rv <= 0 || write_all(out, buf, rv, *end + done) != 0) return -1;
+    done += rv;
+  }
+  return 0;
+}
+
+int frag_segment_compact(frag_store_t *fs, int node)
+{
+  struct seg_store *ss;
+  struct seg_node *sn;
+  struct seg_object *o;
+  struct seg_extent *x;
+  struct seg_entry e;
+  char path[FRAG_KEY_MAX+32], tmp[FRAG_KEY_MAX+32];
+  uint32_t old_last, seg, id;
+  int64_t end, pos;
+  char *buf;
+  int b, i, fd, dfd, rv;
+
+  if (fs->write != seg_write) return -1;
+  ss = (struct seg_store *) fs->priv;
+  sn = node_get(ss, node);
+  if (sn == NULL) return -1;
+  buf = talloc(char, SEG_COPY_BUF);
+  if (buf == NULL) return -1;
+  if (node_lock(sn) != 0) {
+    free(buf);
+    return -1;
+  }
+
+  sprintf(path, "%s/%s", sn->root, SEG_INDEX_FILE);
+  sprintf(tmp, "%s/%s", sn->root, SEG_COMPACT_FILE);
+  fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  old_last = sn->last_segment;
+  seg = old_last + 1;
+  end = 0;
+  pos = 0;
+  rv = (fd < 0) ? -1 : 0;
+
+  /* 1. The live extents go to new segments, and their entries to a new
+        index, in the order replaying them rebuilds each object */
+  for (b = 0; rv == 0 && b < SEG_BUCKETS; b++) {
+    for (o = sn->buckets[b]; rv == 0 && o != NULL; o = o->next) {
+      for (i = 0; rv == 0 && i < o->nextents; i++) {
+        x = &o->ext[i];
+        if (extent_dead(o, i)) continue;
+        if (x->length > 0 && extent_copy(sn, x, &seg, &end, buf) != 0) {
+          rv = -1;
+          break;
+        }
+        memset(&e, 0, sizeof(e));
+        e.segment = seg;
+        e.seg_offset = end;
+        e.frag_offset = x->frag_offset;
+        e.length = x->length;
+        strcpy(e.key, o->key);
+        e.crc = entry_crc(&e);
+        if (write_all(fd, (char *) &e, sizeof(e), pos) != 0) rv = -1;
+        pos += sizeof(e);
+        end += x->length;
+      }
+    }
+  }
+
+  /* 2. Both are on disk before the new index replaces the old one */
+  for (id = old_last + 1; rv == 0 && id <= seg; id++) {
+    if ((int) id < sn->nfds && sn->fds[id] >= 0 && fdatasync(sn->fds[id]) != 0) rv = -1;
+  }
+  if (rv == 0 && fdatasync(fd) != 0) rv = -1;
+  if (rv == 0 && rename(tmp, path) != 0) rv = -1;
+  if (rv == 0) {
+    dfd = open(sn->root, O_RDONLY | O_DIRECTORY);
+    if (dfd < 0 || fsync(dfd) != 0) rv = -1;
+    if (dfd >= 0) close(dfd);
+  }
+
+  if (rv != 0) {
+    /* The old index and segments still hold everything */
+    if (fd >= 0) {
+      close(fd);
+      unlink(tmp);
+    }
+    for (id = old_last + 1; id <= seg; id++) {
+      if ((int) id >= sn->nfds || sn->fds[id] < 0) continue;
+      close(sn->fds[id]);
+      sn->fds[id] = -1;
+      sprintf(tmp, "%s/seg_%06u.dat", sn->root, id);
+      unlink(tmp);
+    }
+    node_unlock(sn);
+    free(buf);
+    return -1;
+  }
+
+  /* 3. The old segments hold nothing the new index names */
+  for (id = 1; id <= old_last; id++) {
+    if ((int) id < sn->nfds && sn->fds[id] >= 0) {
+      close(sn->fds[id]);
+      sn->fds[id] = -1;
+    }
+    sprintf(tmp, "%s/seg_%06u.dat", sn->root, id);
+    unlink(tmp);
+  }
+
+  flock(sn->idx_fd, LOCK_UN);
+  close(sn->idx_fd);
+  sn->idx_fd = fd;
+  node_clear(sn);
+  sn->idx_pos = 0;
+  sn->last_segment = 0;
+  rv = node_catch_up(sn);
+  pthread_mutex_unlock(&sn->lock);
+  free(buf);
+  return rv;
+}
+
+static void seg_close(frag_store_t *fs)
+{
+  struct seg_store *ss;
+  struct seg_node *sn;
+  int i, j;
+
+  ss = (struct seg_store *) fs->priv;
+  for (i = 0; i < SEG_MAX_NODES; i++) {
+    sn = ss->nodes[i];
+    if (sn == NULL) continue;
+    for (j = 0; j < sn->nfds; j++) if (sn->fds[j] >= 0) close(sn->fds[j]);
+    node_clear(sn);
+    close(sn->idx_fd);
+    pthread_mutex_destroy(&sn->lock);
+    free(sn->fds);
+    free(sn);
+  }
+  pthread_mutex_destroy(&ss->lock);
+  free(ss);
+  free(fs);
+}
+
+int frag_segment_init(frag_store_t *fs)
+{
+  struct seg_store *ss;
+
+  ss = talloc(struct seg_store, 1);
+  if (ss == NULL) return -1;
+  memset(ss, 0, sizeof(*ss));
+  ss->fs = fs;
+  pthread_mutex_init(&ss->lock, NULL);
+
+  fs->write = seg_write;
+  fs->read = seg_read;
+  fs->size = seg_size;
+  fs->locate = seg_locate;
+  fs->remove = seg_remove;
+  fs->sync = seg_sync;
+  fs->close = seg_close;
+  fs->priv = ss;
+  return 0;
+}
@@ -0,0 +1,299 @@
+/* frag_store.c - fragment store selection and the one-file-per-fragment
+   backend.  See frag_store.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include "frag_store.h"
+#include "placement.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+static const char *kind_names[] = { "file", "segment", "mem" };
+
+int frag_store_kind_by_name(const char *name)
+{
+  int i;
+
+  for (i = 0; i < (int) (sizeof(kind_names)/sizeof(kind_names[0])); i++) {
+    if (strcmp(name, kind_names[i]) == 0) return i;
+  }
+  return -1;
+}
+
+const char *frag_store_kind_name(int kind)
+{
+  if (kind < 0 || kind >= (int) (sizeof(kind_names)/sizeof(kind_names[0]))) return "unknown";
+  return kind_names[kind];
+}
+
+int frag_store_default_kind(void)
+{
+  char *s;
+  int kind;
+
+  s = getenv("SWIFTER_FRAG_STORE");
+  if (s == NULL || *s == '\0') return FRAG_STORE_FILE;
+  kind = frag_store_kind_by_name(s);
+  if (kind < 0) {
+    fprintf(stderr, "Error: SWIFTER_FRAG_STORE=%s is not one of file, segment, mem\n", s);
+    exit(1);
+  }
+  return kind;
+}
+
+void frag_store_node_root(frag_store_t *fs, int node, char *path)
+{
+  placement_node_root(fs->placement, node, path);
+}
+
+frag_store_t *frag_store_open(int kind, struct placement *pl)
+{
+  frag_store_t *fs, *slow;
+  char *spec;
+  int rv;
+
+  fs = talloc(frag_store_t, 1);
+  if (fs == NULL) return NULL;
+  memset(fs, 0, sizeof(*fs));
+  fs->kind = kind;
+  fs->placement = pl;
+
+  switch (kind) {
+    case FRAG_STORE_FILE:    rv = frag_file_init(fs); break;
+    case FRAG_STORE_SEGMENT: rv = frag_segment_init(fs); break;
+    case FRAG_STORE_MEM:     rv = frag_mem_init(fs); break;
+    default:                 rv = -1; break;
+  }
+  if (rv != 0) {
+    free(fs);
+    return NULL;
+  }
+
+  spec = getenv("SWIFTER_THROTTLE");
+  if (spec != NULL && *spec != '\0') {
+    slow = frag_throttle_open(fs, spec);
+    if (slow == NULL) fs->close(fs);
+    return slow;
+  }
+  return fs;
+}
+
+/* ---------------------------------------------------------------------- */
+/* One file per fragment: <root of node>/<key>                             */
+
+#define FILE_PATH_MAX   (PLACEMENT_PATH_MAX + FRAG_KEY_MAX + 2)
+
+/* -1 if the path would not fit in FILE_PATH_MAX */
+static int file_path(frag_store_t *fs, int node, const char *key, char *path)
+{
+  char root[PLACEMENT_PATH_MAX];
+  int n;
+
+  frag_store_node_root(fs, node, root);
+  n = snprintf(path, FILE_PATH_MAX, "%s/%s", root, key);
+  return (n < 0 || n >= FILE_PATH_MAX) ? -1 : 0;
+}
+
+/* The files written since the last sync: file_sync() makes exactly those
+   durable, then the directories that name them */
+struct file_store {
+  pthread_mutex_t lock;
+  int ndirty, maxdirty;
+  char (*dirty)[FILE_PATH_MAX];
+};
+
+static int file_dirty(frag_store_t *fs, const char *path)
+{
+  struct file_store *fst;
+  char (*d)[FILE_PATH_MAX];
+  int i, n;
+
+  fst = (struct file_store *) fs->priv;
+  pthread_mutex_lock(&fst->lock);
+  for (i = fst->ndirty-1; i >= 0 && strcmp(fst->dirty[i], path) != 0; i--) ;
+  if (i < 0) {
+    if (fst->ndirty == fst->maxdirty) {
+      n = (fst->maxdirty == 0) ? 64 : fst->maxdirty * 2;
+      d = (char (*)[FILE_PATH_MAX]) realloc(fst->dirty, sizeof(*d) * n);
+      if (d == NULL) {
+        pthread_mutex_unlock(&fst->lock);
+        return -1;
+      }
+      fst->dirty = d;
+      fst->maxdirty = n;
+    }
+    strcpy(fst->dirty[fst->ndirty++], path);
+  }
+  pthread_mutex_unlock(&fst->lock);
+  return 0;
+}
+
+static int64_t file_write(frag_store_t *fs, int node, const char *key, int64_t offset, const char *buf, int64_t len)
+{
+  char path[FILE_PATH_MAX];
+  int64_t done;
+  ssize_t rv;
+  int fd;
+
+  if (file_path(fs, node, key, path) != 0) return -1;
+  fd = open(path, O_WRONLY | O_CREAT | (offset == 0 ? O_TRUNC : 0), 0644);
+  if (fd < 0) return -1;
+
+  done = 0;
+  while (done < len) {
+    rv = pwrite(fd, buf+done, len-done, offset+done);
+    if (rv < 0 && errno == EINTR) continue;
+    if (rv <= 0) { close(fd); return -1; }
+    done += rv;
+  }
+  close(fd);
+  if (file_dirty(fs, path) != 0) return -1;
+  return done;
+}
+
+static int64_t file_read(frag_store_t *fs, int node, const char *key, int64_t offset, char *buf, int64_t len)
+{
+  char path[FILE_PATH_MAX];
+  int64_t done;
+  ssize_t rv;
+  int fd;
+
+  if (file_path(fs, node, key, path) != 0) return -1;
+  fd = open(path, O_RDONLY);
+  if (fd < 0) return -1;
+
+  done = 0;
+  while (done < len) {
+    rv = pread(fd, buf+done, len-done, offset+done);
+    if (rv < 0 && errno == EINTR) continue;
+    if (rv < 0) { close(fd); return -1; }
+    if (rv == 0) break;
+    done += rv;
+  }
+  close(fd);
+  return done;
+}
+
+static int64_t file_size(frag_store_t *fs, int node, const char *key)
+{
+  char path[FILE_PATH_MAX];
+  struct stat st;
+
+  if (file_path(fs, node, key, path) != 0) return -1;
+  if (stat(path, &st) != 0) return -1;
+  return st.st_size;
+}
+
+static int file_locate(frag_store_t *fs, int node, const char *key, int64_t offset, int64_t len,
+                       int64_t *file_offset, int64_t *contig)
+{
+  char path[FILE_PATH_MAX];
+  struct stat st;
+  int fd;
+
+  if (file_path(fs, node, key, path) != 0) return -1;
+  fd = open(path, O_RDONLY);
+  if (fd < 0) return -1;
+  if (fstat(fd, &st) != 0 || offset > st.st_size) {
+    close(fd);
+    return -1;
+  }
+  *file_offset = offset;
+  *contig = (st.st_size - offset < len) ? st.st_size - offset : len;
+  return fd;
+}
+
+/* A removed file is no longer file_sync()'s to sync */
+static int file_remove(frag_store_t *fs, int node, const char *key)
+{
+  struct file_store *fst;
+  char path[FILE_PATH_MAX];
+  int i;
+
+  if (file_path(fs, node, key, path) != 0) return -1;
+  if (unlink(path) != 0) return -1;
+
+  fst = (struct file_store *) fs->priv;
+  pthread_mutex_lock(&fst->lock);
+  for (i = 0; i < fst->ndirty; i++) {
+    if (strcmp(fst->dirty[i], path) == 0) {
+      strcpy(fst->dirty[i], fst->dirty[--fst->ndirty]);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&fst->lock);
+  return 0;
+}
+
+static int sync_path(const char *path, int dir)
+{
+  int fd, rv;
+
+  fd = open(path, dir ? (O_RDONLY | O_DIRECTORY) : O_WRONLY);
+  if (fd < 0) return -1;
+  rv = dir ? fsync(fd) : fdatasync(fd);
+  close(fd);
+  return rv;
+}
+
+static int file_sync(frag_store_t *fs)
+{
+  struct file_store *fst;
+  char *slash;
+  int i, j, rv;
+
+  fst = (struct file_store *) fs->priv;
+  pthread_mutex_lock(&fst->lock);
+  rv = 0;
+  for (i = 0; i < fst->ndirty; i++) {
+    if (sync_path(fst->dirty[i], 0) != 0) rv = -1;
+  }
+
+  /* A new file is only there after a crash once its directory entry is */
+  for (i = 0; i < fst->ndirty; i++) {
+    slash = strrchr(fst->dirty[i], '/');
+    if (slash != NULL) *slash = '\0';
+    for (j = 0; j < i && strcmp(fst->dirty[j], fst->dirty[i]) != 0; j++) ;
+    if (j == i && sync_path(fst->dirty[i], 1) != 0) rv = -1;
+  }
+  fst->ndirty = 0;
+  pthread_mutex_unlock(&fst->lock);
+  return rv;
+}
+
+static void file_close(frag_store_t *fs)
+{
+  struct file_store *fst;
+
+  fst = (struct file_store *) fs->priv;
+  pthread_mutex_destroy(&fst->lock);
+  free(fst->dirty);
+  free(fst);
+  free(fs);
+}
+
+int frag_file_init(frag_store_t *fs)
+{
+  struct file_store *fst;
+
+  fst = talloc(struct file_store, 1);
+  if (fst == NULL) return -1;
+  memset(fst, 0, sizeof(*fst));
+  pthread_mutex_init(&fst->lock, NULL);
+  fs->write = file_write;
+  fs->read = file_read;
+  fs->size = file_size;
+  fs->locate = file_locate;
+  fs->remove = file_remove;
+  fs->sync = file_sync;
+  fs->close = file_close;
+  fs->priv = fst;
+  return 0;
+}
@@ -0,0 +1,110 @@
+/* frag_store.h - where fragments live.
+ *
+ * A fragment is addressed by (node, key), where key is the name the
+ * fragment file has always had, e.g. "video_k01.mp4".  Each backend fills
+ * in the function pointers of a frag_store_t, the same way gf-complete
+ * fills in a gf_t:
+ *
+ *   FRAG_STORE_FILE    - one file per fragment under the node's root
+ *                        directory (the original layout).
+ *   FRAG_STORE_SEGMENT - fragments of many objects appended to large
+ *                        per-node segment files, with an append-only
+ *                        index mapping (key, offset) to (segment, offset).
+ *   FRAG_STORE_MEM     - fragments in the memory of the process, for the
+ *                        benchmark and for timing coding without I/O.
+ *
+ * frag_remote_open() puts a store in front of the node agents, for
+ * encoders and decoders that move fragments over the network.
+ *
+ * SWIFTER_THROTTLE="<latency-us>:<MB/s>[:<write MB/s>]" makes
+ * frag_store_open() wrap the store with frag_throttle_open(), which
+ * slows every node down to a device of that latency and bandwidth.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAG_STORE_ROOT      "/mnt/node%d"
+#define FRAG_KEY_MAX         192
+#define FRAG_SEGMENT_MAX     (256LL << 20)
+
+enum frag_store_kind { FRAG_STORE_FILE = 0, FRAG_STORE_SEGMENT = 1, FRAG_STORE_MEM = 2 };
+
+typedef struct frag_store frag_store_t;
+struct placement;
+
+struct frag_store {
+  int kind;
+  struct placement *placement;         /* node roots; NULL means /mnt/node<n> */
+
+  /* Writing at offset 0 starts the fragment over; larger offsets extend it.
+     Both return the number of bytes transferred, or -1. */
+  int64_t (*write)(frag_store_t *fs, int node, const char *key, int64_t offset, const char *buf, int64_t len);
+  int64_t (*read)(frag_store_t *fs, int node, const char *key, int64_t offset, char *buf, int64_t len);
+
+  /* Size of the fragment, or -1 if it does not exist */
+  int64_t (*size)(frag_store_t *fs, int node, const char *key);
+
+  /* Optional (may be NULL): an fd the caller must close, positioned so
+     that *contig bytes of the fragment starting at offset lie at
+     *file_offset.  Lets senders hand fragments to sendfile/splice. */
+  int (*locate)(frag_store_t *fs, int node, const char *key, int64_t offset, int64_t len,
+                int64_t *file_offset, int64_t *contig);
+
+  /* Deletes the fragment.  0, or -1 if it does not exist or could not
+     be deleted.  The segment backend only records the deletion; the
+     space comes back when frag_segment_compact() runs. */
+  int (*remove)(frag_store_t *fs, int node, const char *key);
+
+  /* Everything written so far is on disk, new fragments' names included,
+     when this returns 0.  The encoder calls it before publishing an
+     object's metadata. */
+  int (*sync)(frag_store_t *fs);
+  void (*close)(frag_store_t *fs);
+
+  void *priv;
+};
+
+/* kind is one of enum frag_store_kind; pl supplies the node root
+   directories and may be NULL.  Returns NULL on failure. */
+extern frag_store_t *frag_store_open(int kind, struct placement *pl);
+
+/* Reads SWIFTER_FRAG_STORE ("file", "segment" or "mem"); defaults to file. */
+extern int frag_store_default_kind(void);
+extern int frag_store_kind_by_name(const char *name);
+extern const char *frag_store_kind_name(int kind);
+
+/* Root directory of a node, e.g. "/mnt/node3" */
+extern void frag_store_node_root(frag_store_t *fs, int node, char *path);
+
+/* Wraps local so that nodes with an agent in pl are reached through
+   their node_agent; other nodes still use local.  Closing the wrapper
+   closes local.  Returns NULL on failure. */
+extern frag_store_t *frag_remote_open(frag_store_t *local, struct placement *pl);
+
+/* Wraps inner so that each node behaves like a device of the given
+   "<latency-us>:<MB/s>[:<write MB/s>]".  Closing the wrapper closes
+   inner.  Returns NULL on a bad spec. */
+extern frag_store_t *frag_throttle_open(frag_store_t *inner, const char *spec);
+
+/* Rewrites the live extents of node's segment store into new segments
+   and deletes the old ones, reclaiming what overwritten and removed
+   fragments held.  fs must be a FRAG_STORE_SEGMENT store.  No other
+   process may have the node's store open meanwhile (stop its agent), so
+   it is run off-line, by seg_compact.  0, or -1 with the old segments
+   still in place. */
+extern int frag_segment_compact(frag_store_t *fs, int node);
+
+/* Backend constructors, called by frag_store_open() */
+extern int frag_file_init(frag_store_t *fs);
+extern int frag_segment_init(frag_store_t *fs);
+extern int frag_mem_init(frag_store_t *fs);
+
+#ifdef __cplusplus
+}
+#endif
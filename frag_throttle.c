@@ -0,0 +1,180 @@
+/* frag_throttle.c - a fragment store slowed down to a given device.
+ *
+ * Wraps another store and makes every read and write take at least
+ * latency + len / bandwidth.  Each node is one device: requests to the
+ * same node queue behind each other, requests to different nodes
+ * overlap, so one box can stand in for a cluster of slow disks or links.
+ * The spec is "<latency-us>:<MB/s>[:<write MB/s>]"; a bandwidth of 0 is
+ * unlimited.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "frag_store.h"
+#include "placement.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define THROTTLE_NODES   (PLACEMENT_MAX_NODE_ID + 1)
+
+struct throttle_store {
+  frag_store_t    *inner;
+  uint64_t         latency_ns;
+  double           read_bw, write_bw;     /* bytes per ns, 0 = unlimited */
+  pthread_mutex_t  lock;
+  uint64_t         busy[THROTTLE_NODES];  /* when each node's queue drains */
+};
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Books the request on the node's queue and returns when it finishes */
+static uint64_t throttle_book(struct throttle_store *ts, int node, int64_t len, double bw)
+{
+  uint64_t start, finish;
+
+  /* Every placement id has its own queue; anything else shares slot 0,
+     which no node has */
+  if (node < 0 || node >= THROTTLE_NODES) node = 0;
+  pthread_mutex_lock(&ts->lock);
+  start = now_ns();
+  if (ts->busy[node] > start) start = ts->busy[node];
+  finish = start + ts->latency_ns + ((bw > 0 && len > 0) ? (uint64_t) (len / bw) : 0);
+  ts->busy[node] = finish;
+  pthread_mutex_unlock(&ts->lock);
+  return finish;
+}
+
+static void throttle_wait(uint64_t until)
+{
+  struct timespec ts;
+
+  ts.tv_sec = until / 1000000000ULL;
+  ts.tv_nsec = until % 1000000000ULL;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) ;
+}
+
+static int64_t throttle_write(frag_store_t *fs, int node, const char *key, int64_t offset, const char *buf, int64_t len)
+{
+  struct throttle_store *ts;
+  uint64_t until;
+  int64_t rv;
+
+  ts = (struct throttle_store *) fs->priv;
+  until = throttle_book(ts, node, len, ts->write_bw);
+  rv = ts->inner->write(ts->inner, node, key, offset, buf, len);
+  throttle_wait(until);
+  return rv;
+}
+
+static int64_t throttle_read(frag_store_t *fs, int node, const char *key, int64_t offset, char *buf, int64_t len)
+{
+  struct throttle_store *ts;
+  uint64_t until;
+  int64_t rv;
+
+  ts = (struct throttle_store *) fs->priv;
+  until = throttle_book(ts, node, len, ts->read_bw);
+  rv = ts->inner->read(ts->inner, node, key, offset, buf, len);
+  throttle_wait(until);
+  return rv;
+}
+
+/* Metadata lookups and deletions cost one latency */
+static int64_t throttle_size(frag_store_t *fs, int node, const char *key)
+{
+  struct throttle_store *ts;
+  uint64_t until;
+  int64_t rv;
+
+  ts = (struct throttle_store *) fs->priv;
+  until = throttle_book(ts, node, 0, 0);
+  rv = ts->inner->size(ts->inner, node, key);
+  throttle_wait(until);
+  return rv;
+}
+
+static int throttle_remove(frag_store_t *fs, int node, const char *key)
+{
+  struct throttle_store *ts;
+  uint64_t until;
+  int rv;
+
+  ts = (struct throttle_store *) fs->priv;
+  until = throttle_book(ts, node, 0, 0);
+  rv = ts->inner->remove(ts->inner, node, key);
+  throttle_wait(until);
+  return rv;
+}
+
+static int throttle_sync(frag_store_t *fs)
+{
+  struct throttle_store *ts;
+
+  ts = (struct throttle_store *) fs->priv;
+  return ts->inner->sync(ts->inner);
+}
+
+static void throttle_close(frag_store_t *fs)
+{
+  struct throttle_store *ts;
+
+  ts = (struct throttle_store *) fs->priv;
+  ts->inner->close(ts->inner);
+  pthread_mutex_destroy(&ts->lock);
+  free(ts);
+  free(fs);
+}
+
+frag_store_t *frag_throttle_open(frag_store_t *inner, const char *spec)
+{
+  struct throttle_store *ts;
+  frag_store_t *fs;
+  double lat, rbw, wbw;
+  int n;
+
+  n = sscanf(spec, "%lf:%lf:%lf", &lat, &rbw, &wbw);
+  if (n < 2 || lat < 0 || rbw < 0 || (n == 3 && wbw < 0)) {
+    fprintf(stderr, "Error: throttle \"%s\" is not <latency-us>:<MB/s>[:<write MB/s>]\n", spec);
+    return NULL;
+  }
+  if (n == 2) wbw = rbw;
+
+  fs = talloc(frag_store_t, 1);
+  ts = talloc(struct throttle_store, 1);
+  if (fs == NULL || ts == NULL) {
+    free(fs);
+    free(ts);
+    return NULL;
+  }
+  memset(fs, 0, sizeof(*fs));
+  memset(ts, 0, sizeof(*ts));
+  ts->inner = inner;
+  ts->latency_ns = (uint64_t) (lat * 1000);
+  ts->read_bw = rbw * 1048576.0 / 1e9;
+  ts->write_bw = wbw * 1048576.0 / 1e9;
+  pthread_mutex_init(&ts->lock, NULL);
+
+  /* No locate: sendfile would bypass the throttle */
+  fs->kind = inner->kind;
+  fs->placement = inner->placement;
+  fs->write = throttle_write;
+  fs->read = throttle_read;
+  fs->size = throttle_size;
+  fs->locate = NULL;
+  fs->remove = throttle_remove;
+  fs->sync = throttle_sync;
+  fs->close = throttle_close;
+  fs->priv = ts;
+  return fs;
+}
@@ -0,0 +1,357 @@
+/* gf_bench.c - microbenchmark of the Galois-field region kernels.
+ *
+ *   gf_bench [-k kernels] [-s sizes] [-a alignments] [-c coefficients]
+ *            [-t seconds] [-r trials] [-x seed] [-C]
+ *
+ * Times each region kernel on its own, for every region size (default
+ * 4 KiB to 64 MiB in powers of two), misalignment from a 64-byte
+ * boundary (default 0 and 1) and coefficient (default 2, 3 and 0xa5;
+ * kernels with a fixed coefficient ignore -c).  Each measurement repeats
+ * the kernel for at least -t seconds (default 0.1) after one warm-up call;
+ * the median of -r trials (default 3) is reported as GB/s of region bytes
+ * and, on x86-64, TSC cycles per byte.  Steps in GB/s as the size grows
+ * mark where the working set leaves L1, L2 and L3.
+ *
+ * Kernels (-k, comma-separated, default all):
+ *   xor            galois_region_xor
+ *   w08_mult       galois_w08_region_multiply, add = 0 and add = 1
+ *   w08_by2        reed_sol_galois_w08_region_multby_2
+ *   w16_mult, w16_by2, w32_mult, w32_by2
+ *
+ * Each multiply kernel runs through the default galois_* entry point and
+ * through every gf-complete implementation this build offers: SIMD and
+ * non-SIMD split tables, and the full table for w=8.  w08_mult also runs
+ * on each gf_kernel.h kernel (paths gfk-avx512-gfni ... gfk-scalar).
+ * Paths gf_init_hard() rejects, and kernels the CPU lacks, are skipped,
+ * so the report shows which ones the machine has.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <gf_complete.h>
+#include <gf_rand.h>
+#include "galois.h"
+#include "reed_sol.h"
+#include "instr.h"
+#include "gf_kernel.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define GFB_MAX_LIST   64
+#define GFB_ALIGN      64
+
+enum gfb_op { GFB_XOR, GFB_MULT, GFB_BY2 };
+
+/* One implementation of a kernel */
+struct gfb_path {
+  const char *name;
+  int mult_type, region_type, arg1, arg2;     /* gf_init_hard(); mult_type -1: galois_* */
+  const char *kernel;                         /* gf_kernel_named(), if not NULL */
+};
+
+static struct gfb_path paths08[] = {
+  { "galois",       -1, 0, 0, 0, NULL },
+  { "split84-simd", GF_MULT_SPLIT_TABLE, GF_REGION_SIMD, 8, 4, NULL },
+  { "split84",      GF_MULT_SPLIT_TABLE, GF_REGION_NOSIMD, 8, 4, NULL },
+  { "table",        GF_MULT_TABLE, GF_REGION_DEFAULT, 0, 0, NULL },
+  { "gfk-avx512-gfni", -1, 0, 0, 0, "avx512-gfni" },
+  { "gfk-avx2-gfni", -1, 0, 0, 0, "avx2-gfni" },
+  { "gfk-avx2",     -1, 0, 0, 0, "avx2" },
+  { "gfk-ssse3",    -1, 0, 0, 0, "ssse3" },
+  { "gfk-scalar",   -1, 0, 0, 0, "scalar" },
+};
+
+static struct gfb_path paths16[] = {
+  { "galois",       -1, 0, 0, 0, NULL },
+  { "split164-simd", GF_MULT_SPLIT_TABLE, GF_REGION_SIMD, 16, 4, NULL },
+  { "split164",     GF_MULT_SPLIT_TABLE, GF_REGION_NOSIMD, 16, 4, NULL },
+};
+
+static struct gfb_path paths32[] = {
+  { "galois",       -1, 0, 0, 0, NULL },
+  { "split324-simd", GF_MULT_SPLIT_TABLE, GF_REGION_SIMD, 32, 4, NULL },
+  { "split324",     GF_MULT_SPLIT_TABLE, GF_REGION_NOSIMD, 32, 4, NULL },
+};
+
+static struct gfb_path path_plain[] = {
+  { "galois",       -1, 0, 0, 0, NULL },
+};
+
+struct gfb_kernel {
+  const char *name;
+  int op, w;
+  struct gfb_path *paths;
+  int npaths;
+};
+
+#define NPATHS(p)  (int) (sizeof(p)/sizeof(p[0]))
+
+static struct gfb_kernel kernels[] = {
+  { "xor",      GFB_XOR,  8,  path_plain, NPATHS(path_plain) },
+  { "w08_mult", GFB_MULT, 8,  paths08,    NPATHS(paths08) },
+  { "w08_by2",  GFB_BY2,  8,  path_plain, NPATHS(path_plain) },
+  { "w16_mult", GFB_MULT, 16, paths16,    NPATHS(paths16) },
+  { "w16_by2",  GFB_BY2,  16, path_plain, NPATHS(path_plain) },
+  { "w32_mult", GFB_MULT, 32, paths32,    NPATHS(paths32) },
+  { "w32_by2",  GFB_BY2,  32, path_plain, NPATHS(path_plain) },
+};
+#define NKERNELS  (int) (sizeof(kernels)/sizeof(kernels[0]))
+
+static double min_seconds = 0.1;
+static const struct gf_kernel *gfk;             /* kernel of the current gfk path */
+static struct gf_coef gfk_coef;
+static int gfk_c = -1;
+static int trials = 3, csv = 0;
+
+#if defined(__x86_64__)
+static uint64_t cycles(void)
+{
+  uint32_t lo, hi;
+
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+#else
+static uint64_t cycles(void)
+{
+  return 0;
+}
+#endif
+
+static int parse_list(const char *s, int *list)
+{
+  char *copy, *tok, *save;
+  int n;
+
+  copy = strdup(s);
+  n = 0;
+  for (tok = strtok_r(copy, ",", &save); tok != NULL && n < GFB_MAX_LIST; tok = strtok_r(NULL, ",", &save)) {
+    list[n++] = (int) strtol(tok, NULL, 0);
+  }
+  free(copy);
+  return n;
+}
+
+/* Sizes accept K and M suffixes */
+static int parse_sizes(const char *s, int64_t *list)
+{
+  char *copy, *tok, *save, *end;
+  int n;
+
+  copy = strdup(s);
+  n = 0;
+  for (tok = strtok_r(copy, ",", &save); tok != NULL && n < GFB_MAX_LIST; tok = strtok_r(NULL, ",", &save)) {
+    list[n] = strtoll(tok, &end, 0);
+    if (*end == 'K' || *end == 'k') list[n] <<= 10;
+    if (*end == 'M' || *end == 'm') list[n] <<= 20;
+    n++;
+  }
+  free(copy);
+  return n;
+}
+
+/* One call of the kernel on size bytes */
+static void run_kernel(struct gfb_kernel *kn, struct gfb_path *p, gf_t *gf, char *src, char *dst,
+                       int coef, int add, int size)
+{
+  if (kn->op == GFB_XOR) {
+    galois_region_xor(src, dst, size);
+  } else if (kn->op == GFB_BY2) {
+    switch (kn->w) {
+      case 8:  reed_sol_galois_w08_region_multby_2(dst, size); break;
+      case 16: reed_sol_galois_w16_region_multby_2(dst, size); break;
+      case 32: reed_sol_galois_w32_region_multby_2(dst, size); break;
+    }
+  } else if (p->kernel != NULL) {
+    if (coef != gfk_c) {
+      gf_coef_init(&gfk_coef, coef);
+      gfk_c = coef;
+    }
+    gfk->dot(1, 1, &gfk_coef, &src, &dst, 0, size, add);
+  } else if (p->mult_type < 0) {
+    switch (kn->w) {
+      case 8:  galois_w08_region_multiply(src, coef, size, dst, add); break;
+      case 16: galois_w16_region_multiply(src, coef, size, dst, add); break;
+      case 32: galois_w32_region_multiply(src, coef, size, dst, add); break;
+    }
+  } else {
+    gf->multiply_region.w32(gf, src, dst, coef, size, add);
+  }
+}
+
+static int compare_double(const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+
+  return (x < y) ? -1 : (x > y);
+}
+
+static void measure(struct gfb_kernel *kn, struct gfb_path *p, gf_t *gf, char *src, char *dst,
+                    int64_t size, int align, int coef, int add)
+{
+  double *gbs, *cpb;
+  uint64_t t0, t1, c0, c1;
+  int64_t calls;
+  int t;
+
+  gbs = talloc(double, trials);
+  cpb = talloc(double, trials);
+  run_kernel(kn, p, gf, src, dst, coef, add, (int) size);
+  for (t = 0; t < trials; t++) {
+    calls = 0;
+    t0 = instr_now();
+    c0 = cycles();
+    do {
+      run_kernel(kn, p, gf, src, dst, coef, add, (int) size);
+      calls++;
+      t1 = instr_now();
+    } while (t1 - t0 < min_seconds * 1e9);
+    c1 = cycles();
+    gbs[t] = (double) size * calls / (t1 - t0);
+    cpb[t] = (double) (c1 - c0) / ((double) size * calls);
+  }
+  qsort(gbs, trials, sizeof(double), compare_double);
+  qsort(cpb, trials, sizeof(double), compare_double);
+
+  if (csv) {
+    printf("%s,%s,%d,%lld,%d,%d,%.3f,%.3f\n", kn->name, p->name, add, (long long) size, align, coef,
+           gbs[trials/2], cpb[trials/2]);
+  } else {
+    printf("%-9s %-15s %3d %10lld %5d %5d %9.3f %9.3f\n", kn->name, p->name, add, (long long) size, align, coef,
+           gbs[trials/2], cpb[trials/2]);
+  }
+  fflush(stdout);
+  free(gbs);
+  free(cpb);
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: gf_bench [-k kernels] [-s sizes] [-a alignments] [-c coefficients]\n"
+                  "                [-t seconds] [-r trials] [-x seed] [-C]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  int64_t sizes[GFB_MAX_LIST], max_size;
+  int aligns[GFB_MAX_LIST], coefs[GFB_MAX_LIST];
+  int use[NKERNELS];
+  int nsizes, naligns, ncoefs, c, i, j, pi, si, ai, ci, add;
+  char *kl, *tok, *save, *src_base, *dst_base, *src, *dst;
+  unsigned seed;
+  struct gfb_kernel *kn;
+  struct gfb_path *p;
+  gf_t gf;
+
+  nsizes = parse_sizes("4K,8K,16K,32K,64K,128K,256K,512K,1M,2M,4M,8M,16M,32M,64M", sizes);
+  naligns = parse_list("0,1", aligns);
+  ncoefs = parse_list("2,3,0xa5", coefs);
+  kl = NULL;
+  seed = 1;
+
+  while ((c = getopt(argc, argv, "k:s:a:c:t:r:x:C")) != -1) {
+    switch (c) {
+      case 'k': kl = optarg; break;
+      case 's': nsizes = parse_sizes(optarg, sizes); break;
+      case 'a': naligns = parse_list(optarg, aligns); break;
+      case 'c': ncoefs = parse_list(optarg, coefs); break;
+      case 't': min_seconds = atof(optarg); break;
+      case 'r': trials = atoi(optarg); break;
+      case 'x': seed = (unsigned) strtoul(optarg, NULL, 0); break;
+      case 'C': csv = 1; break;
+      default: usage();
+    }
+  }
+  if (optind != argc || trials <= 0 || min_seconds <= 0) usage();
+
+  for (i = 0; i < NKERNELS; i++) use[i] = (kl == NULL);
+  if (kl != NULL) {
+    for (tok = strtok_r(kl, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+      for (i = 0; i < NKERNELS && strcmp(tok, kernels[i].name) != 0; i++) ;
+      if (i == NKERNELS) {
+        fprintf(stderr, "gf_bench: unknown kernel %s\n", tok);
+        exit(1);
+      }
+      use[i] = 1;
+    }
+  }
+
+  max_size = 0;
+  for (i = 0; i < nsizes; i++) {
+    /* Regions must hold whole 32-bit words */
+    sizes[i] &= ~(int64_t) 3;
+    if (sizes[i] <= 0) usage();
+    if (sizes[i] > max_size) max_size = sizes[i];
+  }
+  for (i = 0; i < naligns; i++) {
+    if (aligns[i] < 0 || aligns[i] >= GFB_ALIGN) usage();
+  }
+  if (posix_memalign((void **) &src_base, GFB_ALIGN, max_size + GFB_ALIGN) != 0 ||
+      posix_memalign((void **) &dst_base, GFB_ALIGN, max_size + GFB_ALIGN) != 0) {
+    fprintf(stderr, "gf_bench: out of memory for %lld bytes\n", (long long) max_size);
+    exit(1);
+  }
+  MOA_Seed(seed);
+  MOA_Fill_Random_Region(src_base, (int) (max_size + GFB_ALIGN));
+  MOA_Fill_Random_Region(dst_base, (int) (max_size + GFB_ALIGN));
+
+  printf("# gf_bench seconds=%.3f trials=%d seed=%u clock=%s\n", min_seconds, trials, seed,
+#if defined(__x86_64__)
+         "rdtsc"
+#else
+         "none"
+#endif
+        );
+  if (csv) {
+    printf("kernel,path,add,size,align,coef,gb_per_s,cycles_per_byte\n");
+  } else {
+    printf("%-9s %-15s %3s %10s %5s %5s %9s %9s\n", "kernel", "path", "add", "size", "align", "coef", "GB/s", "cyc/B");
+  }
+
+  for (i = 0; i < NKERNELS; i++) {
+    if (!use[i]) continue;
+    kn = kernels + i;
+    for (pi = 0; pi < kn->npaths; pi++) {
+      p = kn->paths + pi;
+      if (p->kernel != NULL) {
+        gfk = gf_kernel_named(p->kernel);
+        if (gfk == NULL) {
+          fprintf(stderr, "gf_bench: %s path %s is not available; skipped\n", kn->name, p->name);
+          continue;
+        }
+      }
+      if (p->mult_type >= 0) {
+        memset(&gf, 0, sizeof(gf));
+        if (!gf_init_hard(&gf, kn->w, p->mult_type, p->region_type, GF_DIVIDE_DEFAULT, 0,
+                          p->arg1, p->arg2, NULL, NULL)) {
+          fprintf(stderr, "gf_bench: %s path %s is not available; skipped\n", kn->name, p->name);
+          continue;
+        }
+      }
+      for (add = 0; add <= (kn->op == GFB_MULT); add++) {
+        for (si = 0; si < nsizes; si++) {
+          for (ai = 0; ai < naligns; ai++) {
+            /* w=16 and w=32 kernels work on whole words */
+            if (kn->w > 8 && aligns[ai] % (kn->w/8) != 0) continue;
+            src = src_base + aligns[ai];
+            dst = dst_base + aligns[ai];
+            for (ci = 0; ci < ((kn->op == GFB_MULT) ? ncoefs : 1); ci++) {
+              j = (kn->op == GFB_MULT) ? coefs[ci] : ((kn->op == GFB_BY2) ? 2 : 1);
+              if (kn->w < 32 && (j < 0 || j >= (1 << kn->w))) continue;
+              measure(kn, p, &gf, src, dst, sizes[si], aligns[ai], j, add);
+            }
+          }
+        }
+      }
+      if (p->mult_type >= 0) gf_free(&gf, 1);
+    }
+  }
+
+  free(src_base);
+  free(dst_base);
+  return 0;
+}
@@ -0,0 +1,1079 @@
+/* gf_kernel.c - GF(2^8) region kernels with runtime CPU dispatch.  See
+   gf_kernel.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "galois.h"
+#include "gf_kernel.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define GF_KERNEL_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/* GF2P8AFFINEQB's qword for the 8 x 8 bit matrix whose column j is
+   col[j]: row i, bit i of every column, goes in byte 7-i */
+static uint64_t affine_of(const uint8_t *col)
+{
+  uint64_t a;
+  int i, j, row;
+
+  a = 0;
+  for (i = 0; i < 8; i++) {
+    row = 0;
+    for (j = 0; j < 8; j++) row |= ((col[j] >> i) & 1) << j;
+    a |= (uint64_t) row << (8*(7-i));
+  }
+  return a;
+}
+
+void gf_coef_init(struct gf_coef *gc, int c)
+{
+  uint8_t col[8];
+  int x, i, j;
+
+  for (x = 0; x < 16; x++) {
+    gc->lo[x] = galois_single_multiply(c, x, 8);
+    gc->hi[x] = galois_single_multiply(c, x << 4, 8);
+  }
+
+  /* Column j of the bit matrix is c * 2^j */
+  for (j = 0; j < 8; j++) col[j] = (j < 4) ? gc->lo[1 << j] : gc->hi[1 << (j-4)];
+  gc->affine = affine_of(col);
+
+  gc->c = (uint8_t) c;
+  gc->log = 0;
+  for (i = 1; i < 8; i++) {
+    if (c == (1 << i)) gc->log = (uint8_t) i;
+  }
+  gc->prim = (uint8_t) galois_single_multiply(0x80, 2, 8);
+}
+
+void gf16_coef_init(struct gf16_coef *gc, int c)
+{
+  uint8_t col[8];
+  int x, i, j, p, q, v;
+
+  for (i = 0; i < 4; i++) {
+    for (x = 0; x < 16; x++) {
+      v = galois_single_multiply(c, x << (4*i), 16);
+      gc->lo[i][x] = (uint8_t) (v & 0xff);
+      gc->hi[i][x] = (uint8_t) (v >> 8);
+    }
+  }
+
+  /* Block 2q+p takes byte q of a word to byte p of its product; its
+     column j is that byte of c * 2^(8q+j) */
+  for (q = 0; q < 2; q++) {
+    for (p = 0; p < 2; p++) {
+      for (j = 0; j < 8; j++) col[j] = (uint8_t) (galois_single_multiply(c, 1 << (8*q+j), 16) >> (8*p));
+      gc->affine[2*q+p] = affine_of(col);
+    }
+  }
+  gc->c = (uint16_t) c;
+}
+
+/* Column order: by the column's constants, row 0 first */
+static int column_cmp(int k, int nr, const int *matrix, int a, int b)
+{
+  int r;
+
+  for (r = 0; r < nr; r++) {
+    if (matrix[r*k+a] != matrix[r*k+b]) return matrix[r*k+a] - matrix[r*k+b];
+  }
+  return a - b;
+}
+
+void gf_column_order(int k, int nr, const int *matrix, int *order)
+{
+  int i, j, t;
+
+  for (j = 0; j < k; j++) order[j] = j;
+  for (i = 1; i < k; i++) {
+    t = order[i];
+    for (j = i; j > 0 && column_cmp(k, nr, matrix, order[j-1], t) > 0; j--) order[j] = order[j-1];
+    order[j] = t;
+  }
+}
+
+/* Every kernel is written for a variable row count and inlined into a
+   wrapper per count, so the row accumulators stay in registers */
+#define DOT_ROWS(attr, name, body) \
+attr static void name(int k, int nr, const struct gf_coef *coefs, char **srcs, char **dsts, \
+                      int off, int len, int add) \
+{ \
+  switch (nr) { \
+    case 1:  body(k, 1, coefs, srcs, dsts, off, len, add); break; \
+    case 2:  body(k, 2, coefs, srcs, dsts, off, len, add); break; \
+    case 3:  body(k, 3, coefs, srcs, dsts, off, len, add); break; \
+    default: body(k, GF_KERNEL_ROWS, coefs, srcs, dsts, off, len, add); break; \
+  } \
+}
+
+static inline void scalar_rows(int k, int nr, const struct gf_coef *coefs, char **srcs, char **dsts,
+                               int off, int len, int add)
+{
+  const struct gf_coef *gc;
+  uint8_t b, acc[GF_KERNEL_ROWS];
+  int x, j, r;
+
+  for (x = off; x < off+len; x++) {
+    for (r = 0; r < nr; r++) acc[r] = add ? (uint8_t) dsts[r][x] : 0;
+    for (j = 0; j < k; j++) {
+      b = (uint8_t) srcs[j][x];
+      for (r = 0; r < nr; r++) {
+        gc = coefs + r*k + j;
+        acc[r] ^= gc->lo[b & 0x0f] ^ gc->hi[b >> 4];
+      }
+    }
+    for (r = 0; r < nr; r++) dsts[r][x] = (char) acc[r];
+  }
+}
+
+DOT_ROWS(, dot_scalar, scalar_rows)
+
+/* And the same for GF(2^16) */
+#define DOT16_ROWS(attr, name, body) \
+attr static void name(int k, int nr, const struct gf16_coef *coefs, char **srcs, char **dsts, \
+                      int off, int len, int add) \
+{ \
+  switch (nr) { \
+    case 1:  body(k, 1, coefs, srcs, dsts, off, len, add); break; \
+    case 2:  body(k, 2, coefs, srcs, dsts, off, len, add); break; \
+    case 3:  body(k, 3, coefs, srcs, dsts, off, len, add); break; \
+    default: body(k, GF_KERNEL_ROWS, coefs, srcs, dsts, off, len, add); break; \
+  } \
+}
+
+static inline void scalar16_rows(int k, int nr, const struct gf16_coef *coefs, char **srcs, char **dsts,
+                                 int off, int len, int add)
+{
+  const struct gf16_coef *gc;
+  uint16_t v, acc[GF_KERNEL_ROWS];
+  int x, j, r;
+
+  for (x = off; x < off+len; x += 2) {
+    for (r = 0; r < nr; r++) {
+      acc[r] = 0;
+      if (add) memcpy(&acc[r], dsts[r]+x, 2);
+    }
+    for (j = 0; j < k; j++) {
+      memcpy(&v, srcs[j]+x, 2);
+      for (r = 0; r < nr; r++) {
+        gc = coefs + r*k + j;
+        acc[r] ^= (uint16_t) ((gc->lo[0][v & 15] ^ gc->lo[1][(v >> 4) & 15] ^ gc->lo[2][(v >> 8) & 15] ^ gc->lo[3][v >> 12]) |
+                              ((gc->hi[0][v & 15] ^ gc->hi[1][(v >> 4) & 15] ^ gc->hi[2][(v >> 8) & 15] ^ gc->hi[3][v >> 12]) << 8));
+      }
+    }
+    for (r = 0; r < nr; r++) memcpy(dsts[r]+x, &acc[r], 2);
+  }
+}
+
+DOT16_ROWS(, dot16_scalar, scalar16_rows)
+
+/* Every run kernel leaves its sums of sources in x, and then does one of
+   these to it */
+#define RUN_XOR(ru)      ((ru)->gc.c == 1)
+#define RUN_BY2(ru)      ((ru)->by2 > 0)
+
+static inline void scalar_runs(int nruns, const struct gf_run *runs, const int *idx, char **srcs, char *dst,
+                               int off, int len, int add)
+{
+  const struct gf_run *ru;
+  uint8_t v, b;
+  int i, g, j, n;
+
+  for (i = off; i < off+len; i++) {
+    v = add ? (uint8_t) dst[i] : 0;
+    for (g = 0; g < nruns; g++) {
+      ru = runs + g;
+      b = 0;
+      for (j = ru->first; j < ru->first + ru->n; j++) b ^= (uint8_t) srcs[idx[j]][i];
+      if (RUN_BY2(ru)) {
+        for (n = 0; n < ru->by2; n++) b = (uint8_t) ((b << 1) ^ ((b & 0x80) ? ru->gc.prim : 0));
+      } else if (!RUN_XOR(ru)) {
+        b = ru->gc.lo[b & 0x0f] ^ ru->gc.hi[b >> 4];
+      }
+      v ^= b;
+    }
+    dst[i] = (char) v;
+  }
+}
+
+static void runs_scalar(int nruns, const struct gf_run *runs, const int *idx, char **srcs, char *dst,
+                        int off, int len, int add)
+{
+  scalar_runs(nruns, runs, idx, srcs, dst, off, len, add);
+}
+
+/* Bytes [off, off+len) of dst become srcs[0] ^ .. ^ srcs[n-1], eight
+   at a time.  dst may be one of the srcs, as each word is read from all
+   of them before it is stored. */
+static void xors_scalar(int n, char **srcs, char *dst, int off, int len)
+{
+  uint64_t v, s;
+  int i, j, b;
+
+  for (i = off; i < off+len; i += 8) {
+    b = (off+len-i < 8) ? off+len-i : 8;
+    v = 0;
+    for (j = 0; j < n; j++) {
+      s = 0;
+      memcpy(&s, srcs[j]+i, b);
+      v ^= s;
+    }
+    memcpy(dst+i, &v, b);
+  }
+}
+
+/* The RAID-6 kernels likewise get a wrapper per word size */
+#define R6_WORDS(attr, name, body) \
+attr static void name(int k, int w, uint32_t prim, char **data, char *p, char *q, int off, int len) \
+{ \
+  switch (w) { \
+    case 8:  body(k, 8, prim, data, p, q, off, len); break; \
+    case 16: body(k, 16, prim, data, p, q, off, len); break; \
+    default: body(k, 32, prim, data, p, q, off, len); break; \
+  } \
+}
+
+/* Eight bytes at a time in a uint64_t, as w-bit lanes.  The top bit of
+   each lane is shifted out and, where it was set, prim XORed in. */
+static inline uint64_t by2_words(uint64_t v, int w, uint64_t prim)
+{
+  uint64_t top;
+
+  top = v & ((w == 8) ? 0x8080808080808080ULL : (w == 16) ? 0x8000800080008000ULL : 0x8000000080000000ULL);
+  return ((v ^ top) << 1) ^ ((top >> (w-1)) * prim);
+}
+
+/* The tail, if len is not a multiple of 8, is padded with zeros */
+static inline void scalar_r6(int k, int w, uint32_t prim, char **data, char *p, char *q, int off, int len)
+{
+  uint64_t s, vp, vq;
+  int x, i, n;
+
+  for (x = off; x < off+len; x += 8) {
+    n = (off+len-x < 8) ? off+len-x : 8;
+    vp = 0;
+    if (n == 8) memcpy(&vp, data[k-1]+x, 8); else memcpy(&vp, data[k-1]+x, n);
+    vq = vp;
+    for (i = k-2; i >= 0; i--) {
+      s = 0;
+      if (n == 8) memcpy(&s, data[i]+x, 8); else memcpy(&s, data[i]+x, n);
+      vp ^= s;
+      vq = by2_words(vq, w, prim) ^ s;
+    }
+    memcpy(p+x, &vp, n);
+    memcpy(q+x, &vq, n);
+  }
+}
+
+R6_WORDS(, r6_scalar, scalar_r6)
+
+#ifdef GF_KERNEL_X86
+
+__attribute__((target("ssse3")))
+static inline void ssse3_rows(int k, int nr, const struct gf_coef *coefs, char **srcs, char **dsts,
+                              int off, int len, int add)
+{
+  const struct gf_coef *gc;
+  __m128i mask, s, lo, hi, v[GF_KERNEL_ROWS];
+  int x, j, r, end;
+
+  mask = _mm_set1_epi8(0x0f);
+  end = off + len - len % 16;
+  for (x = off; x < end; x += 16) {
+    for (r = 0; r < nr; r++) v[r] = add ? _mm_loadu_si128((__m128i *) (dsts[r]+x)) : _mm_setzero_si128();
+    for (j = 0; j < k; j++) {
+      s = _mm_loadu_si128((__m128i *) (srcs[j]+x));
+      lo = _mm_and_si128(s, mask);
+      hi = _mm_and_si128(_mm_srli_epi64(s, 4), mask);
+      for (r = 0; r < nr; r++) {
+        gc = coefs + r*k + j;
+        v[r] = _mm_xor_si128(v[r], _mm_shuffle_epi8(_mm_loadu_si128((__m128i *) gc->lo), lo));
+        v[r] = _mm_xor_si128(v[r], _mm_shuffle_epi8(_mm_loadu_si128((__m128i *) gc->hi), hi));
+      }
+    }
+    for (r = 0; r < nr; r++) _mm_storeu_si128((__m128i *) (dsts[r]+x), v[r]);
+  }
+  scalar_rows(k, nr, coefs, srcs, dsts, end, off+len-end, add);
+}
+
+DOT_ROWS(__attribute__((target("ssse3"))), dot_ssse3, ssse3_rows)
+
+/* SSE2 has no byte shifts, so for w=8 the byte is doubled with an add and
+   its top bit found with a signed compare */
+__attribute__((target("ssse3")))
+static inline __m128i by2_sse(__m128i v, int w, __m128i prim)
+{
+  switch (w) {
+    case 8:  return _mm_xor_si128(_mm_add_epi8(v, v), _mm_and_si128(_mm_cmplt_epi8(v, _mm_setzero_si128()), prim));
+    case 16: return _mm_xor_si128(_mm_slli_epi16(v, 1), _mm_and_si128(_mm_srai_epi16(v, 15), prim));
+    default: return _mm_xor_si128(_mm_slli_epi32(v, 1), _mm_and_si128(_mm_srai_epi32(v, 31), prim));
+  }
+}
+
+__attribute__((target("ssse3")))
+static inline void ssse3_r6(int k, int w, uint32_t prim, char **data, char *p, char *q, int off, int len)
+{
+  __m128i s, vp, vq, pv;
+  int x, i, end;
+
+  pv = (w == 8) ? _mm_set1_epi8((char) prim) : (w == 16) ? _mm_set1_epi16((short) prim) : _mm_set1_epi32((int) prim);
+  end = off + len - len % 16;
+  for (x = off; x < end; x += 16) {
+    vp = vq = _mm_loadu_si128((__m128i *) (data[k-1]+x));
+    for (i = k-2; i >= 0; i--) {
+      s = _mm_loadu_si128((__m128i *) (data[i]+x));
+      vp = _mm_xor_si128(vp, s);
+      vq = _mm_xor_si128(by2_sse(vq, w, pv), s);
+    }
+    _mm_storeu_si128((__m128i *) (p+x), vp);
+    _mm_storeu_si128((__m128i *) (q+x), vq);
+  }
+  scalar_r6(k, w, prim, data, p, q, end, off+len-end);
+}
+
+R6_WORDS(__attribute__((target("ssse3"))), r6_ssse3, ssse3_r6)
+
+__attribute__((target("ssse3")))
+static void runs_ssse3(int nruns, const struct gf_run *runs, const int *idx, char **srcs, char *dst,
+                       int off, int len, int add)
+{
+  const struct gf_run *ru;
+  __m128i mask, x, v;
+  int i, g, j, n, end;
+
+  mask = _mm_set1_epi8(0x0f);
+  end = off + len - len % 16;
+  for (i = off; i < end; i += 16) {
+    v = add ? _mm_loadu_si128((__m128i *) (dst+i)) : _mm_setzero_si128();
+    for (g = 0; g < nruns; g++) {
+      ru = runs + g;
+      x = _mm_loadu_si128((__m128i *) (srcs[idx[ru->first]]+i));
+      for (j = ru->first+1; j < ru->first + ru->n; j++) x = _mm_xor_si128(x, _mm_loadu_si128((__m128i *) (srcs[idx[j]]+i)));
+      if (RUN_BY2(ru)) {
+        for (n = 0; n < ru->by2; n++) x = by2_sse(x, 8, _mm_set1_epi8((char) ru->gc.prim));
+      } else if (!RUN_XOR(ru)) {
+        x = _mm_xor_si128(_mm_shuffle_epi8(_mm_loadu_si128((__m128i *) ru->gc.lo), _mm_and_si128(x, mask)),
+                          _mm_shuffle_epi8(_mm_loadu_si128((__m128i *) ru->gc.hi), _mm_and_si128(_mm_srli_epi64(x, 4), mask)));
+      }
+      v = _mm_xor_si128(v, x);
+    }
+    _mm_storeu_si128((__m128i *) (dst+i), v);
+  }
+  scalar_runs(nruns, runs, idx, srcs, dst, end, off+len-end, add);
+}
+
+__attribute__((target("avx2")))
+static inline void avx2_rows(int k, int nr, const struct gf_coef *coefs, char **srcs, char **dsts,
+                             int off, int len, int add)
+{
+  const struct gf_coef *gc;
+  __m256i mask, s, lo, hi, v[GF_KERNEL_ROWS];
+  int x, j, r, end;
+
+  mask = _mm256_set1_epi8(0x0f);
+  end = off + len - len % 32;
+  for (x = off; x < end; x += 32) {
+    for (r = 0; r < nr; r++) v[r] = add ? _mm256_loadu_si256((__m256i *) (dsts[r]+x)) : _mm256_setzero_si256();
+    for (j = 0; j < k; j++) {
+      s = _mm256_loadu_si256((__m256i *) (srcs[j]+x));
+      lo = _mm256_and_si256(s, mask);
+      hi = _mm256_and_si256(_mm256_srli_epi64(s, 4), mask);
+      for (r = 0; r < nr; r++) {
+        gc = coefs + r*k + j;
+        v[r] = _mm256_xor_si256(v[r], _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *) gc->lo)), lo));
+        v[r] = _mm256_xor_si256(v[r], _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *) gc->hi)), hi));
+      }
+    }
+    for (r = 0; r < nr; r++) _mm256_storeu_si256((__m256i *) (dsts[r]+x), v[r]);
+  }
+  scalar_rows(k, nr, coefs, srcs, dsts, end, off+len-end, add);
+}
+
+DOT_ROWS(__attribute__((target("avx2"))), dot_avx2, avx2_rows)
+
+__attribute__((target("avx2")))
+static inline __m256i by2_avx2(__m256i v, int w, __m256i prim)
+{
+  switch (w) {
+    case 8:  return _mm256_xor_si256(_mm256_add_epi8(v, v), _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_setzero_si256(), v), prim));
+    case 16: return _mm256_xor_si256(_mm256_slli_epi16(v, 1), _mm256_and_si256(_mm256_srai_epi16(v, 15), prim));
+    default: return _mm256_xor_si256(_mm256_slli_epi32(v, 1), _mm256_and_si256(_mm256_srai_epi32(v, 31), prim));
+  }
+}
+
+__attribute__((target("avx2")))
+static inline void avx2_r6(int k, int w, uint32_t prim, char **data, char *p, char *q, int off, int len)
+{
+  __m256i s, vp, vq, pv;
+  int x, i, end;
+
+  pv = (w == 8) ? _mm256_set1_epi8((char) prim) : (w == 16) ? _mm256_set1_epi16((short) prim) : _mm256_set1_epi32((int) prim);
+  end = off + len - len % 32;
+  for (x = off; x < end; x += 32) {
+    vp = vq = _mm256_loadu_si256((__m256i *) (data[k-1]+x));
+    for (i = k-2; i >= 0; i--) {
+      s = _mm256_loadu_si256((__m256i *) (data[i]+x));
+      vp = _mm256_xor_si256(vp, s);
+      vq = _mm256_xor_si256(by2_avx2(vq, w, pv), s);
+    }
+    _mm256_storeu_si256((__m256i *) (p+x), vp);
+    _mm256_storeu_si256((__m256i *) (q+x), vq);
+  }
+  scalar_r6(k, w, prim, data, p, q, end, off+len-end);
+}
+
+R6_WORDS(__attribute__((target("avx2"))), r6_avx2, avx2_r6)
+
+__attribute__((target("avx2")))
+static void runs_avx2(int nruns, const struct gf_run *runs, const int *idx, char **srcs, char *dst,
+                      int off, int len, int add)
+{
+  const struct gf_run *ru;
+  __m256i mask, x, v;
+  int i, g, j, n, end;
+
+  mask = _mm256_set1_epi8(0x0f);
+  end = off + len - len % 32;
+  for (i = off; i < end; i += 32) {
+    v = add ? _mm256_loadu_si256((__m256i *) (dst+i)) : _mm256_setzero_si256();
+    for (g = 0; g < nruns; g++) {
+      ru = runs + g;
+      x = _mm256_loadu_si256((__m256i *) (srcs[idx[ru->first]]+i));
+      for (j = ru->first+1; j < ru->first + ru->n; j++) x = _mm256_xor_si256(x, _mm256_loadu_si256((__m256i *) (srcs[idx[j]]+i)));
+      if (RUN_BY2(ru)) {
+        for (n = 0; n < ru->by2; n++) x = by2_avx2(x, 8, _mm256_set1_epi8((char) ru->gc.prim));
+      } else if (!RUN_XOR(ru)) {
+        x = _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *) ru->gc.lo)), _mm256_and_si256(x, mask)),
+                             _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *) ru->gc.hi)),
+                                                 _mm256_and_si256(_mm256_srli_epi64(x, 4), mask)));
+      }
+      v = _mm256_xor_si256(v, x);
+    }
+    _mm256_storeu_si256((__m256i *) (dst+i), v);
+  }
+  scalar_runs(nruns, runs, idx, srcs, dst, end, off+len-end, add);
+}
+
+__attribute__((target("avx2,gfni")))
+static void runs_avx2_gfni(int nruns, const struct gf_run *runs, const int *idx, char **srcs, char *dst,
+                           int off, int len, int add)
+{
+  const struct gf_run *ru;
+  __m256i x, v;
+  int i, g, j, end;
+
+  end = off + len - len % 32;
+  for (i = off; i < end; i += 32) {
+    v = add ? _mm256_loadu_si256((__m256i *) (dst+i)) : _mm256_setzero_si256();
+    for (g = 0; g < nruns; g++) {
+      ru = runs + g;
+      x = _mm256_loadu_si256((__m256i *) (srcs[idx[ru->first]]+i));
+      for (j = ru->first+1; j < ru->first + ru->n; j++) x = _mm256_xor_si256(x, _mm256_loadu_si256((__m256i *) (srcs[idx[j]]+i)));
+      if (!RUN_XOR(ru)) x = _mm256_gf2p8affine_epi64_epi8(x, _mm256_set1_epi64x((long long) ru->gc.affine), 0);
+      v = _mm256_xor_si256(v, x);
+    }
+    _mm256_storeu_si256((__m256i *) (dst+i), v);
+  }
+  scalar_runs(nruns, runs, idx, srcs, dst, end, off+len-end, add);
+}
+
+/* GFNI without AVX-512, as on client cores */
+__attribute__((target("avx2,gfni")))
+static inline void avx2_gfni_rows(int k, int nr, const struct gf_coef *coefs, char **srcs, char **dsts,
+                                  int off, int len, int add)
+{
+  __m256i s, v[GF_KERNEL_ROWS];
+  int x, j, r, end;
+
+  end = off + len - len % 32;
+  for (x = off; x < end; x += 32) {
+    for (r = 0; r < nr; r++) v[r] = add ? _mm256_loadu_si256((__m256i *) (dsts[r]+x)) : _mm256_setzero_si256();
+    for (j = 0; j < k; j++) {
+      s = _mm256_loadu_si256((__m256i *) (srcs[j]+x));
+      for (r = 0; r < nr; r++) {
+        v[r] = _mm256_xor_si256(v[r], _mm256_gf2p8affine_epi64_epi8(s, _mm256_set1_epi64x((long long) coefs[r*k+j].affine), 0));
+      }
+    }
+    for (r = 0; r < nr; r++) _mm256_storeu_si256((__m256i *) (dsts[r]+x), v[r]);
+  }
+  scalar_rows(k, nr, coefs, srcs, dsts, end, off+len-end, add);
+}
+
+DOT_ROWS(__attribute__((target("avx2,gfni"))), dot_avx2_gfni, avx2_gfni_rows)
+
+/* The tail is done with masked loads and stores */
+__attribute__((target("avx512f,avx512bw,gfni")))
+static inline void avx512_gfni_rows(int k, int nr, const struct gf_coef *coefs, char **srcs, char **dsts,
+                                    int off, int len, int add)
+{
+  __m512i s, v[GF_KERNEL_ROWS];
+  __mmask64 m;
+  int x, j, r;
+
+  for (x = off; x < off+len; x += 64) {
+    m = (off+len-x >= 64) ? ~(__mmask64) 0 : ((__mmask64) 1 << (off+len-x)) - 1;
+    for (r = 0; r < nr; r++) v[r] = add ? _mm512_maskz_loadu_epi8(m, dsts[r]+x) : _mm512_setzero_si512();
+    for (j = 0; j < k; j++) {
+      s = _mm512_maskz_loadu_epi8(m, srcs[j]+x);
+      for (r = 0; r < nr; r++) {
+        v[r] = _mm512_xor_si512(v[r], _mm512_gf2p8affine_epi64_epi8(s, _mm512_set1_epi64((long long) coefs[r*k+j].affine), 0));
+      }
+    }
+    for (r = 0; r < nr; r++) _mm512_mask_storeu_epi8(dsts[r]+x, m, v[r]);
+  }
+}
+
+DOT_ROWS(__attribute__((target("avx512f,avx512bw,gfni"))), dot_avx512_gfni, avx512_gfni_rows)
+
+/* Multiplying by 2 needs no GFNI, only AVX-512BW for the byte and word
+   forms.  The tail is masked as above. */
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i by2_avx512(__m512i v, int w, __m512i prim)
+{
+  switch (w) {
+    case 8:  return _mm512_xor_si512(_mm512_add_epi8(v, v), _mm512_maskz_mov_epi8(_mm512_movepi8_mask(v), prim));
+    case 16: return _mm512_xor_si512(_mm512_slli_epi16(v, 1), _mm512_and_si512(_mm512_srai_epi16(v, 15), prim));
+    default: return _mm512_xor_si512(_mm512_slli_epi32(v, 1), _mm512_and_si512(_mm512_srai_epi32(v, 31), prim));
+  }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline void avx512_r6(int k, int w, uint32_t prim, char **data, char *p, char *q, int off, int len)
+{
+  __m512i s, vp, vq, pv;
+  __mmask64 m;
+  int x, i;
+
+  pv = (w == 8) ? _mm512_set1_epi8((char) prim) : (w == 16) ? _mm512_set1_epi16((short) prim) : _mm512_set1_epi32((int) prim);
+  for (x = off; x < off+len; x += 64) {
+    m = (off+len-x >= 64) ? ~(__mmask64) 0 : ((__mmask64) 1 << (off+len-x)) - 1;
+    vp = vq = _mm512_maskz_loadu_epi8(m, data[k-1]+x);
+    for (i = k-2; i >= 0; i--) {
+      s = _mm512_maskz_loadu_epi8(m, data[i]+x);
+      vp = _mm512_xor_si512(vp, s);
+      vq = _mm512_xor_si512(by2_avx512(vq, w, pv), s);
+    }
+    _mm512_mask_storeu_epi8(p+x, m, vp);
+    _mm512_mask_storeu_epi8(q+x, m, vq);
+  }
+}
+
+R6_WORDS(__attribute__((target("avx512f,avx512bw"))), r6_avx512, avx512_r6)
+
+__attribute__((target("avx512f,avx512bw,gfni")))
+static void runs_avx512_gfni(int nruns, const struct gf_run *runs, const int *idx, char **srcs, char *dst,
+                             int off, int len, int add)
+{
+  const struct gf_run *ru;
+  __m512i x, v;
+  __mmask64 m;
+  int i, g, j;
+
+  for (i = off; i < off+len; i += 64) {
+    m = (off+len-i >= 64) ? ~(__mmask64) 0 : ((__mmask64) 1 << (off+len-i)) - 1;
+    v = add ? _mm512_maskz_loadu_epi8(m, dst+i) : _mm512_setzero_si512();
+    for (g = 0; g < nruns; g++) {
+      ru = runs + g;
+      x = _mm512_maskz_loadu_epi8(m, srcs[idx[ru->first]]+i);
+      for (j = ru->first+1; j < ru->first + ru->n; j++) x = _mm512_xor_si512(x, _mm512_maskz_loadu_epi8(m, srcs[idx[j]]+i));
+      if (!RUN_XOR(ru)) x = _mm512_gf2p8affine_epi64_epi8(x, _mm512_set1_epi64((long long) ru->gc.affine), 0);
+      v = _mm512_xor_si512(v, x);
+    }
+    _mm512_mask_storeu_epi8(dst+i, m, v);
+  }
+}
+
+/* GF(2^16): two vectors of words become one of their low bytes and one
+   of their high bytes.  The packs work within 128-bit lanes, and so do
+   the unpacks that put the words back together, so the lane order they
+   leave needs no fixing. */
+__attribute__((target("ssse3")))
+static inline void split16_sse(const char *p, __m128i *l, __m128i *h)
+{
+  __m128i a, b, m8;
+
+  m8 = _mm_set1_epi16(0x00ff);
+  a = _mm_loadu_si128((__m128i *) p);
+  b = _mm_loadu_si128((__m128i *) (p+16));
+  *l = _mm_packus_epi16(_mm_and_si128(a, m8), _mm_and_si128(b, m8));
+  *h = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+}
+
+#define TABLE_SSE(t)   _mm_loadu_si128((__m128i *) (t))
+
+__attribute__((target("ssse3")))
+static inline void ssse3_rows16(int k, int nr, const struct gf16_coef *coefs, char **srcs, char **dsts,
+                                int off, int len, int add)
+{
+  const struct gf16_coef *gc;
+  __m128i mask, l, h, n0, n1, n2, n3, vl[GF_KERNEL_ROWS], vh[GF_KERNEL_ROWS];
+  int x, j, r, end;
+
+  mask = _mm_set1_epi8(0x0f);
+  end = off + len - len % 32;
+  for (x = off; x < end; x += 32) {
+    for (r = 0; r < nr; r++) {
+      if (add) split16_sse(dsts[r]+x, &vl[r], &vh[r]); else vl[r] = vh[r] = _mm_setzero_si128();
+    }
+    for (j = 0; j < k; j++) {
+      split16_sse(srcs[j]+x, &l, &h);
+      n0 = _mm_and_si128(l, mask);
+      n1 = _mm_and_si128(_mm_srli_epi64(l, 4), mask);
+      n2 = _mm_and_si128(h, mask);
+      n3 = _mm_and_si128(_mm_srli_epi64(h, 4), mask);
+      for (r = 0; r < nr; r++) {
+        gc = coefs + r*k + j;
+        vl[r] = _mm_xor_si128(vl[r], _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(TABLE_SSE(gc->lo[0]), n0), _mm_shuffle_epi8(TABLE_SSE(gc->lo[1]), n1)),
+                                                   _mm_xor_si128(_mm_shuffle_epi8(TABLE_SSE(gc->lo[2]), n2), _mm_shuffle_epi8(TABLE_SSE(gc->lo[3]), n3))));
+        vh[r] = _mm_xor_si128(vh[r], _mm_xor_si128(_mm_xor_si128(_mm_shuffle_epi8(TABLE_SSE(gc->hi[0]), n0), _mm_shuffle_epi8(TABLE_SSE(gc->hi[1]), n1)),
+                                                   _mm_xor_si128(_mm_shuffle_epi8(TABLE_SSE(gc->hi[2]), n2), _mm_shuffle_epi8(TABLE_SSE(gc->hi[3]), n3))));
+      }
+    }
+    for (r = 0; r < nr; r++) {
+      _mm_storeu_si128((__m128i *) (dsts[r]+x), _mm_unpacklo_epi8(vl[r], vh[r]));
+      _mm_storeu_si128((__m128i *) (dsts[r]+x+16), _mm_unpackhi_epi8(vl[r], vh[r]));
+    }
+  }
+  scalar16_rows(k, nr, coefs, srcs, dsts, end, off+len-end, add);
+}
+
+DOT16_ROWS(__attribute__((target("ssse3"))), dot16_ssse3, ssse3_rows16)
+
+__attribute__((target("avx2")))
+static inline void split16_avx2(const char *p, __m256i *l, __m256i *h)
+{
+  __m256i a, b, m8;
+
+  m8 = _mm256_set1_epi16(0x00ff);
+  a = _mm256_loadu_si256((__m256i *) p);
+  b = _mm256_loadu_si256((__m256i *) (p+32));
+  *l = _mm256_packus_epi16(_mm256_and_si256(a, m8), _mm256_and_si256(b, m8));
+  *h = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+}
+
+#define TABLE_AVX2(t)  _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *) (t)))
+
+__attribute__((target("avx2")))
+static inline void avx2_rows16(int k, int nr, const struct gf16_coef *coefs, char **srcs, char **dsts,
+                               int off, int len, int add)
+{
+  const struct gf16_coef *gc;
+  __m256i mask, l, h, n0, n1, n2, n3, vl[GF_KERNEL_ROWS], vh[GF_KERNEL_ROWS];
+  int x, j, r, end;
+
+  mask = _mm256_set1_epi8(0x0f);
+  end = off + len - len % 64;
+  for (x = off; x < end; x += 64) {
+    for (r = 0; r < nr; r++) {
+      if (add) split16_avx2(dsts[r]+x, &vl[r], &vh[r]); else vl[r] = vh[r] = _mm256_setzero_si256();
+    }
+    for (j = 0; j < k; j++) {
+      split16_avx2(srcs[j]+x, &l, &h);
+      n0 = _mm256_and_si256(l, mask);
+      n1 = _mm256_and_si256(_mm256_srli_epi64(l, 4), mask);
+      n2 = _mm256_and_si256(h, mask);
+      n3 = _mm256_and_si256(_mm256_srli_epi64(h, 4), mask);
+      for (r = 0; r < nr; r++) {
+        gc = coefs + r*k + j;
+        vl[r] = _mm256_xor_si256(vl[r], _mm256_xor_si256(_mm256_xor_si256(_mm256_shuffle_epi8(TABLE_AVX2(gc->lo[0]), n0), _mm256_shuffle_epi8(TABLE_AVX2(gc->lo[1]), n1)),
+                                                         _mm256_xor_si256(_mm256_shuffle_epi8(TABLE_AVX2(gc->lo[2]), n2), _mm256_shuffle_epi8(TABLE_AVX2(gc->lo[3]), n3))));
+        vh[r] = _mm256_xor_si256(vh[r], _mm256_xor_si256(_mm256_xor_si256(_mm256_shuffle_epi8(TABLE_AVX2(gc->hi[0]), n0), _mm256_shuffle_epi8(TABLE_AVX2(gc->hi[1]), n1)),
+                                                         _mm256_xor_si256(_mm256_shuffle_epi8(TABLE_AVX2(gc->hi[2]), n2), _mm256_shuffle_epi8(TABLE_AVX2(gc->hi[3]), n3))));
+      }
+    }
+    for (r = 0; r < nr; r++) {
+      _mm256_storeu_si256((__m256i *) (dsts[r]+x), _mm256_unpacklo_epi8(vl[r], vh[r]));
+      _mm256_storeu_si256((__m256i *) (dsts[r]+x+32), _mm256_unpackhi_epi8(vl[r], vh[r]));
+    }
+  }
+  ssse3_rows16(k, nr, coefs, srcs, dsts, end, off+len-end, add);
+}
+
+DOT16_ROWS(__attribute__((target("avx2"))), dot16_avx2, avx2_rows16)
+
+/* With GFNI the product's low and high bytes are each two affine
+   transforms of the source's, one per 8 x 8 block */
+#define AFFINE_AVX2(x, a)   _mm256_gf2p8affine_epi64_epi8((x), _mm256_set1_epi64x((long long) (a)), 0)
+
+__attribute__((target("avx2,gfni")))
+static inline void avx2_gfni_rows16(int k, int nr, const struct gf16_coef *coefs, char **srcs, char **dsts,
+                                    int off, int len, int add)
+{
+  const struct gf16_coef *gc;
+  __m256i l, h, vl[GF_KERNEL_ROWS], vh[GF_KERNEL_ROWS];
+  int x, j, r, end;
+
+  end = off + len - len % 64;
+  for (x = off; x < end; x += 64) {
+    for (r = 0; r < nr; r++) {
+      if (add) split16_avx2(dsts[r]+x, &vl[r], &vh[r]); else vl[r] = vh[r] = _mm256_setzero_si256();
+    }
+    for (j = 0; j < k; j++) {
+      split16_avx2(srcs[j]+x, &l, &h);
+      for (r = 0; r < nr; r++) {
+        gc = coefs + r*k + j;
+        vl[r] = _mm256_xor_si256(vl[r], _mm256_xor_si256(AFFINE_AVX2(l, gc->affine[0]), AFFINE_AVX2(h, gc->affine[2])));
+        vh[r] = _mm256_xor_si256(vh[r], _mm256_xor_si256(AFFINE_AVX2(l, gc->affine[1]), AFFINE_AVX2(h, gc->affine[3])));
+      }
+    }
+    for (r = 0; r < nr; r++) {
+      _mm256_storeu_si256((__m256i *) (dsts[r]+x), _mm256_unpacklo_epi8(vl[r], vh[r]));
+      _mm256_storeu_si256((__m256i *) (dsts[r]+x+32), _mm256_unpackhi_epi8(vl[r], vh[r]));
+    }
+  }
+  ssse3_rows16(k, nr, coefs, srcs, dsts, end, off+len-end, add);
+}
+
+DOT16_ROWS(__attribute__((target("avx2,gfni"))), dot16_avx2_gfni, avx2_gfni_rows16)
+
+#define AFFINE_AVX512(x, a) _mm512_gf2p8affine_epi64_epi8((x), _mm512_set1_epi64((long long) (a)), 0)
+
+__attribute__((target("avx512f,avx512bw,gfni")))
+static inline void split16_avx512(const char *p, __m512i *l, __m512i *h)
+{
+  __m512i a, b, m8;
+
+  m8 = _mm512_set1_epi16(0x00ff);
+  a = _mm512_loadu_si512((void *) p);
+  b = _mm512_loadu_si512((void *) (p+64));
+  *l = _mm512_packus_epi16(_mm512_and_si512(a, m8), _mm512_and_si512(b, m8));
+  *h = _mm512_packus_epi16(_mm512_srli_epi16(a, 8), _mm512_srli_epi16(b, 8));
+}
+
+__attribute__((target("avx512f,avx512bw,gfni")))
+static inline void avx512_gfni_rows16(int k, int nr, const struct gf16_coef *coefs, char **srcs, char **dsts,
+                                      int off, int len, int add)
+{
+  const struct gf16_coef *gc;
+  __m512i l, h, vl[GF_KERNEL_ROWS], vh[GF_KERNEL_ROWS];
+  int x, j, r, end;
+
+  end = off + len - len % 128;
+  for (x = off; x < end; x += 128) {
+    for (r = 0; r < nr; r++) {
+      if (add) split16_avx512(dsts[r]+x, &vl[r], &vh[r]); else vl[r] = vh[r] = _mm512_setzero_si512();
+    }
+    for (j = 0; j < k; j++) {
+      split16_avx512(srcs[j]+x, &l, &h);
+      for (r = 0; r < nr; r++) {
+        gc = coefs + r*k + j;
+        vl[r] = _mm512_xor_si512(vl[r], _mm512_xor_si512(AFFINE_AVX512(l, gc->affine[0]), AFFINE_AVX512(h, gc->affine[2])));
+        vh[r] = _mm512_xor_si512(vh[r], _mm512_xor_si512(AFFINE_AVX512(l, gc->affine[1]), AFFINE_AVX512(h, gc->affine[3])));
+      }
+    }
+    for (r = 0; r < nr; r++) {
+      _mm512_storeu_si512((void *) (dsts[r]+x), _mm512_unpacklo_epi8(vl[r], vh[r]));
+      _mm512_storeu_si512((void *) (dsts[r]+x+64), _mm512_unpackhi_epi8(vl[r], vh[r]));
+    }
+  }
+  avx2_gfni_rows16(k, nr, coefs, srcs, dsts, end, off+len-end, add);
+}
+
+DOT16_ROWS(__attribute__((target("avx512f,avx512bw,gfni"))), dot16_avx512_gfni, avx512_gfni_rows16)
+
+/* The XOR kernels keep two vectors of dst in registers while every
+   source is XORed in, then store them once */
+__attribute__((target("ssse3")))
+static void xors_ssse3(int n, char **srcs, char *dst, int off, int len)
+{
+  __m128i a, b;
+  int i, j, end;
+
+  end = off + len - len % 32;
+  for (i = off; i < end; i += 32) {
+    a = _mm_loadu_si128((__m128i *) (srcs[0]+i));
+    b = _mm_loadu_si128((__m128i *) (srcs[0]+i+16));
+    for (j = 1; j < n; j++) {
+      a = _mm_xor_si128(a, _mm_loadu_si128((__m128i *) (srcs[j]+i)));
+      b = _mm_xor_si128(b, _mm_loadu_si128((__m128i *) (srcs[j]+i+16)));
+    }
+    _mm_storeu_si128((__m128i *) (dst+i), a);
+    _mm_storeu_si128((__m128i *) (dst+i+16), b);
+  }
+  xors_scalar(n, srcs, dst, end, off+len-end);
+}
+
+__attribute__((target("avx2")))
+static void xors_avx2(int n, char **srcs, char *dst, int off, int len)
+{
+  __m256i a, b;
+  int i, j, end;
+
+  end = off + len - len % 64;
+  for (i = off; i < end; i += 64) {
+    a = _mm256_loadu_si256((__m256i *) (srcs[0]+i));
+    b = _mm256_loadu_si256((__m256i *) (srcs[0]+i+32));
+    for (j = 1; j < n; j++) {
+      a = _mm256_xor_si256(a, _mm256_loadu_si256((__m256i *) (srcs[j]+i)));
+      b = _mm256_xor_si256(b, _mm256_loadu_si256((__m256i *) (srcs[j]+i+32)));
+    }
+    _mm256_storeu_si256((__m256i *) (dst+i), a);
+    _mm256_storeu_si256((__m256i *) (dst+i+32), b);
+  }
+  xors_ssse3(n, srcs, dst, end, off+len-end);
+}
+
+/* The tail is masked, as in the RAID-6 kernel */
+__attribute__((target("avx512f,avx512bw")))
+static void xors_avx512(int n, char **srcs, char *dst, int off, int len)
+{
+  __m512i a, b;
+  __mmask64 m;
+  int i, j, end;
+
+  end = off + len - len % 128;
+  for (i = off; i < end; i += 128) {
+    a = _mm512_loadu_si512((void *) (srcs[0]+i));
+    b = _mm512_loadu_si512((void *) (srcs[0]+i+64));
+    for (j = 1; j < n; j++) {
+      a = _mm512_xor_si512(a, _mm512_loadu_si512((void *) (srcs[j]+i)));
+      b = _mm512_xor_si512(b, _mm512_loadu_si512((void *) (srcs[j]+i+64)));
+    }
+    _mm512_storeu_si512((void *) (dst+i), a);
+    _mm512_storeu_si512((void *) (dst+i+64), b);
+  }
+  for (; i < off+len; i += 64) {
+    m = (off+len-i >= 64) ? ~(__mmask64) 0 : ((__mmask64) 1 << (off+len-i)) - 1;
+    a = _mm512_maskz_loadu_epi8(m, srcs[0]+i);
+    for (j = 1; j < n; j++) a = _mm512_xor_si512(a, _mm512_maskz_loadu_epi8(m, srcs[j]+i));
+    _mm512_mask_storeu_epi8(dst+i, m, a);
+  }
+}
+
+#endif
+
+/* Best first.  The last column is the rough cost, in instructions per
+   vector, of multiplying a source into a row: a GFNI multiply is one
+   instruction plus the XOR, a split-table one about eight. */
+static const struct gf_kernel kernels[] = {
+#ifdef GF_KERNEL_X86
+  { "avx512-gfni", dot_avx512_gfni, dot16_avx512_gfni, r6_avx512, runs_avx512_gfni, xors_avx512, 3 },
+  { "avx2-gfni",   dot_avx2_gfni,   dot16_avx2_gfni,   r6_avx2,   runs_avx2_gfni,   xors_avx2,   3 },
+  { "avx2",        dot_avx2,        dot16_avx2,        r6_avx2,   runs_avx2,        xors_avx2,   8 },
+  { "ssse3",       dot_ssse3,       dot16_ssse3,       r6_ssse3,  runs_ssse3,       xors_ssse3,  8 },
+#endif
+  { "scalar",      dot_scalar,      dot16_scalar,      r6_scalar, runs_scalar,      xors_scalar, 6 },
+};
+#define NKERNELS  (int) (sizeof(kernels)/sizeof(kernels[0]))
+
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+static int usable[NKERNELS];
+static const struct gf_kernel *chosen;
+
+#ifdef GF_KERNEL_X86
+static uint64_t xgetbv0(void)
+{
+  uint32_t lo, hi;
+
+  __asm__ __volatile__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+  return ((uint64_t) hi << 32) | lo;
+}
+#endif
+
+static void detect(void)
+{
+  const struct gf_kernel *gk;
+  char *s;
+  int i;
+
+  for (i = 0; i < NKERNELS; i++) usable[i] = (strcmp(kernels[i].name, "scalar") == 0);
+#ifdef GF_KERNEL_X86
+  {
+    unsigned a, b, c, d;
+    uint64_t xcr0;
+    int ssse3, avx2, avx512, gfni;
+
+    ssse3 = avx2 = avx512 = gfni = 0;
+    xcr0 = 0;
+    if (__get_cpuid(1, &a, &b, &c, &d)) {
+      ssse3 = (c >> 9) & 1;
+      if ((c >> 27) & 1) xcr0 = xgetbv0();           /* OSXSAVE */
+    }
+    if (__get_cpuid_max(0, NULL) >= 7) {
+      __cpuid_count(7, 0, a, b, c, d);
+      /* The OS must save the YMM state, and the ZMM and mask state for AVX-512 */
+      avx2 = ((b >> 5) & 1) && (xcr0 & 0x06) == 0x06;
+      avx512 = ((b >> 16) & 1) && ((b >> 30) & 1) && (xcr0 & 0xe6) == 0xe6;
+      gfni = (c >> 8) & 1;
+    }
+    for (i = 0; i < NKERNELS; i++) {
+      if (strcmp(kernels[i].name, "avx512-gfni") == 0) usable[i] = avx512 && gfni;
+      if (strcmp(kernels[i].name, "avx2-gfni") == 0) usable[i] = avx2 && gfni;
+      if (strcmp(kernels[i].name, "avx2") == 0) usable[i] = avx2;
+      if (strcmp(kernels[i].name, "ssse3") == 0) usable[i] = ssse3;
+    }
+  }
+#endif
+
+  for (i = 0; !usable[i]; i++) ;
+  chosen = &kernels[i];
+  s = getenv("SWIFTER_GF_KERNEL");
+  if (s != NULL) {
+    for (i = 0; i < NKERNELS && strcmp(kernels[i].name, s) != 0; i++) ;
+    gk = (i < NKERNELS && usable[i]) ? &kernels[i] : NULL;
+    if (gk == NULL) fprintf(stderr, "SWIFTER_GF_KERNEL=%s is not available; using %s\n", s, chosen->name);
+    else chosen = gk;
+  }
+}
+
+const struct gf_kernel *gf_kernel(void)
+{
+  pthread_once(&detect_once, detect);
+  return chosen;
+}
+
+const struct gf_kernel *gf_kernel_named(const char *name)
+{
+  int i;
+
+  pthread_once(&detect_once, detect);
+  for (i = 0; i < NKERNELS; i++) {
+    if (strcmp(kernels[i].name, name) == 0) return usable[i] ? &kernels[i] : NULL;
+  }
+  return NULL;
+}
+
+/* The last constant a thread multiplied by, as callers such as the RAID-6
+   encoder use the same one over and over */
+static __thread int last_c = -1;
+static __thread struct gf_coef last_gc;
+
+void gf_kernel_multiply(char *src, int c, int len, char *dst, int add)
+{
+  if (c == 0) {
+    if (!add) memset(dst, 0, len);
+    return;
+  }
+  if (c == 1) {
+    if (add) galois_region_xor(src, dst, len); else if (dst != src) memcpy(dst, src, len);
+    return;
+  }
+  if (c != last_c) {
+    gf_coef_init(&last_gc, c);
+    last_c = c;
+  }
+  gf_kernel()->dot(1, 1, &last_gc, &src, &dst, 0, len, add);
+}
+
+/* Cost, as with mul_cost, of the other things a plan can do per vector */
+#define COST_LOAD   1
+#define COST_XOR    1
+#define COST_BY2    4              /* shift, compare, mask and XOR */
+#define COST_RUN    2              /* the loop and branches around a run */
+
+struct gf_rows {
+  const struct gf_kernel *gk;
+  int k, nr;
+  struct gf_coef *coefs;           /* dense: nr x k, or NULL */
+  struct gf_run *runs;             /* runs: row r's are runs[r*k ...] ... */
+  int *nruns;                      /* ... nruns[r] of them ... */
+  int *idx;                        /* ... over sources idx[r*k ...] */
+};
+
+/* Sorts row's nonzero terms by constant into runs.  Returns the number
+   of runs and sets *cost to what the kernel would spend on them. */
+static int row_runs(const struct gf_kernel *gk, int k, const int *row, struct gf_run *runs, int *idx, int *cost)
+{
+  struct gf_run *ru;
+  int j, n, nruns;
+
+  gf_column_order(k, 1, row, idx);
+  n = 0;
+  for (j = 0; j < k; j++) {
+    if (row[idx[j]] != 0) idx[n++] = idx[j];
+  }
+
+  /* Each source costs its address, its data and an XOR */
+  nruns = 0;
+  *cost = 2*COST_LOAD + n*(2*COST_LOAD + COST_XOR);
+  for (j = 0; j < n; j++) {
+    if (j > 0 && row[idx[j]] == row[idx[j-1]]) {
+      runs[nruns-1].n++;
+      continue;
+    }
+    ru = &runs[nruns++];
+    gf_coef_init(&ru->gc, row[idx[j]]);
+    ru->first = j;
+    ru->n = 1;
+    ru->by2 = (ru->gc.log > 0 && ru->gc.log*COST_BY2 < gk->mul_cost) ? ru->gc.log : 0;
+    *cost += COST_RUN;
+    if (ru->gc.c != 1) *cost += (ru->by2 > 0) ? ru->by2*COST_BY2 : gk->mul_cost - COST_XOR;
+  }
+  return nruns;
+}
+
+gf_rows_t *gf_rows_new(int k, int nr, const int *matrix)
+{
+  gf_rows_t *gr;
+  int r, i, cost, runs_cost;
+
+  gr = (gf_rows_t *) malloc(sizeof(gf_rows_t));
+  if (gr == NULL) return NULL;
+  gr->gk = gf_kernel();
+  gr->k = k;
+  gr->nr = nr;
+  gr->coefs = NULL;
+  gr->runs = (struct gf_run *) malloc(sizeof(struct gf_run)*nr*k);
+  gr->nruns = (int *) malloc(sizeof(int)*nr);
+  gr->idx = (int *) malloc(sizeof(int)*nr*k);
+  if (gr->runs == NULL || gr->nruns == NULL || gr->idx == NULL) {
+    gf_rows_free(gr);
+    return NULL;
+  }
+
+  runs_cost = 0;
+  for (r = 0; r < nr; r++) {
+    gr->nruns[r] = row_runs(gr->gk, k, matrix + r*k, gr->runs + r*k, gr->idx + r*k, &cost);
+    runs_cost += cost;
+  }
+
+  /* The dense kernel loads each source once for all the rows but
+     multiplies every term */
+  if (k*COST_LOAD + nr*k*gr->gk->mul_cost < runs_cost) {
+    free(gr->runs);
+    free(gr->nruns);
+    free(gr->idx);
+    gr->runs = NULL;
+    gr->nruns = NULL;
+    gr->idx = NULL;
+    gr->coefs = (struct gf_coef *) malloc(sizeof(struct gf_coef)*nr*k);
+    if (gr->coefs == NULL) {
+      gf_rows_free(gr);
+      return NULL;
+    }
+    for (i = 0; i < nr*k; i++) gf_coef_init(gr->coefs + i, matrix[i]);
+  }
+  return gr;
+}
+
+void gf_rows_run(const gf_rows_t *gr, char **srcs, char **dsts, int off, int len, int add)
+{
+  int r;
+
+  if (gr->coefs != NULL) {
+    gr->gk->dot(gr->k, gr->nr, gr->coefs, srcs, dsts, off, len, add);
+    return;
+  }
+  for (r = 0; r < gr->nr; r++) {
+    gr->gk->runs(gr->nruns[r], gr->runs + r*gr->k, gr->idx + r*gr->k, srcs, dsts[r], off, len, add);
+  }
+}
+
+void gf_rows_free(gf_rows_t *gr)
+{
+  if (gr == NULL) return;
+  free(gr->coefs);
+  free(gr->runs);
+  free(gr->nruns);
+  free(gr->idx);
+  free(gr);
+}
@@ -0,0 +1,152 @@
+/* gf_kernel.h - GF(2^8) and GF(2^16) region kernels with runtime CPU dispatch.
+ *
+ * gf-complete picks its region code when a field is initialized and has
+ * no GFNI path.  These kernels compute dot products of GF(2^8) constants
+ * with regions, several output rows at a time, in one of five ways:
+ *
+ *   avx512-gfni  VGF2P8AFFINEQB on 64-byte vectors.  The affine form of
+ *                multiplication by a constant works for any polynomial.
+ *   avx2-gfni    VGF2P8AFFINEQB on 32-byte vectors, for GFNI CPUs
+ *                without AVX-512
+ *   avx2         VPSHUFB split 4-bit tables on 32-byte vectors
+ *   ssse3        PSHUFB split 4-bit tables on 16-byte vectors
+ *   scalar       the same tables, a byte at a time
+ *
+ * gf_kernel() returns the best one cpuid reports (and the OS has enabled
+ * the registers for), chosen once per process.  SWIFTER_GF_KERNEL=
+ * avx512-gfni|avx2-gfni|avx2|ssse3|scalar asks for a particular one, if
+ * the CPU has it.  Each kernel is compiled for its own instruction set,
+ * so no special compiler flags are needed.
+ *
+ * The products are those of galois_single_multiply() with w=8, so output
+ * matches jerasure byte for byte.
+ *
+ * gf_rows_new() plans a few rows of a matrix for the kernel in use.  The
+ * dense form multiplies every term, loading each source once for all the
+ * rows.  The other takes each row alone, with its sources sorted by
+ * constant: 0 is skipped, sources sharing a constant are XORed together
+ * and multiplied once, 1 costs only the XOR, and the table kernels double
+ * instead of looking up small powers of two.  Whichever the kernel's cost
+ * estimate says is cheaper is used, so rows of small, repeated constants,
+ * such as the first rows of the extended Vandermonde matrix, take the
+ * second form, and rows of distinct large ones the first.
+ *
+ * Each kernel also has a fused RAID-6 encoder for w=8, 16 and 32, which
+ * reads every data region once and keeps P and Q in registers: P is the
+ * XOR of the data, Q is Horner's rule (..(D[k-1]*2 + D[k-2])*2 ..)*2 + D[0],
+ * multiplying by 2 with a shift and a conditional XOR of the reduction
+ * polynomial per word.  The GFNI kernels use the AVX-512 and AVX2 ones.
+ *
+ * GF(2^16) has dot kernels too.  Each pair of vectors of words is split
+ * into a vector of low bytes and one of high bytes, and the product's two
+ * halves are built from those: by eight lookups in split 4-bit tables,
+ * or on GFNI by four VGF2P8AFFINEQB, one per 8 x 8 block of the 16 x 16
+ * bit matrix.  The halves are interleaved back into words on the store.
+ *
+ * The XOR kernels, for the schedules of the bitmatrix codes, XOR any
+ * number of regions into one, 128, 64 or 32 bytes at a time.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GF_KERNEL_ROWS   4
+
+/* Multiplication by one constant, in each kernel's form */
+struct gf_coef {
+  uint8_t  lo[16];                 /* c * x, x = 0..15 */
+  uint8_t  hi[16];                 /* c * (x << 4) */
+  uint64_t affine;                 /* bit matrix of x -> c * x for GF2P8AFFINEQB */
+  uint8_t  c;
+  uint8_t  log;                    /* n if c = 2^n, else 0 */
+  uint8_t  prim;                   /* 2 * 0x80, for doubling by shift-and-reduce */
+};
+
+/* Multiplication by one constant of GF(2^16).  The kernels split each
+   word into its low and high bytes, and those into nibbles. */
+struct gf16_coef {
+  uint8_t  lo[4][16];              /* low byte of c * (x << 4i), x = 0..15 */
+  uint8_t  hi[4][16];              /* ... and its high byte */
+  uint64_t affine[4];              /* byte to byte bit matrices: low and high byte of the
+                                      product from the low byte, then from the high */
+  uint16_t c;
+};
+
+/* Sources idx[first .. first+n-1] of a row, which share the constant gc */
+struct gf_run {
+  struct gf_coef gc;
+  int      first, n;
+  int      by2;                    /* doublings that replace the multiply, or 0 */
+};
+
+/* For r < nr <= GF_KERNEL_ROWS, bytes [off, off+len) of dsts[r] become
+   sum_j coefs[r*k+j] * srcs[j], XORed into dsts[r] if add.  A dst may be
+   a src only when k = 1. */
+typedef void (*gf_dot_fn)(int k, int nr, const struct gf_coef *coefs, char **srcs, char **dsts,
+                          int off, int len, int add);
+
+/* As gf_dot_fn over GF(2^16); off and len are even */
+typedef void (*gf_dot16_fn)(int k, int nr, const struct gf16_coef *coefs, char **srcs, char **dsts,
+                            int off, int len, int add);
+
+/* Bytes [off, off+len) of p and q become the RAID-6 parities of the k
+   data regions over GF(2^w).  prim is the low w bits of the field's
+   polynomial, which is 2 * 2^(w-1). */
+typedef void (*gf_r6_fn)(int k, int w, uint32_t prim, char **data, char *p, char *q, int off, int len);
+
+/* Bytes [off, off+len) of dst become the sum over the runs of gc.c times
+   the XOR of the run's sources, XORed into dst if add */
+typedef void (*gf_runs_fn)(int nruns, const struct gf_run *runs, const int *idx, char **srcs, char *dst,
+                           int off, int len, int add);
+
+/* Bytes [off, off+len) of dst become the XOR of srcs[0..n-1], n >= 1.
+   dst may be one of the srcs. */
+typedef void (*gf_xor_fn)(int n, char **srcs, char *dst, int off, int len);
+
+struct gf_kernel {
+  const char *name;
+  gf_dot_fn   dot;
+  gf_dot16_fn dot16;
+  gf_r6_fn    r6;
+  gf_runs_fn  runs;
+  gf_xor_fn   xors;
+  int         mul_cost;            /* rough instructions per vector to multiply a source in */
+};
+
+typedef struct gf_rows gf_rows_t;
+
+extern void gf_coef_init(struct gf_coef *gc, int c);
+extern void gf16_coef_init(struct gf16_coef *gc, int c);
+
+/* The kernel this process uses */
+extern const struct gf_kernel *gf_kernel(void);
+
+/* The named kernel, or NULL if the CPU does not have it */
+extern const struct gf_kernel *gf_kernel_named(const char *name);
+
+/* order[0..k-1] becomes the sources sorted by their constants in the nr x
+   k matrix, row 0 first */
+extern void gf_column_order(int k, int nr, const int *matrix, int *order);
+
+/* The nr x k matrix, nr <= GF_KERNEL_ROWS, planned for gf_kernel() */
+extern gf_rows_t *gf_rows_new(int k, int nr, const int *matrix);
+
+/* As the dot kernel: bytes [off, off+len) of dsts[r] become row r of the
+   matrix times srcs, XORed in if add */
+extern void gf_rows_run(const gf_rows_t *gr, char **srcs, char **dsts, int off, int len, int add);
+
+extern void gf_rows_free(gf_rows_t *gr);
+
+/* dst (^)= c * src over len bytes with gf_kernel(), as
+   galois_w08_region_multiply(src, c, len, dst, add).  dst may be src.
+   0 and 1 are a clear and a copy or XOR. */
+extern void gf_kernel_multiply(char *src, int c, int len, char *dst, int add);
+
+#ifdef __cplusplus
+}
+#endif
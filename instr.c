@@ -0,0 +1,556 @@
+/* instr.c - per-phase timing.  See instr.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "instr.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define INSTR_HASH   512
+
+struct instr_stat {
+  int      phase;
+  int      node;
+  int      frag;
+  int64_t  count;
+  int64_t  bytes;
+  uint64_t sum;
+  uint64_t max;
+  uint32_t hist[INSTR_BUCKETS];
+  struct instr_stat *next;
+};
+
+/* One per thread, plus a scratch one when reports merge them */
+struct instr_table {
+  struct instr_stat  *heads[INSTR_HASH];
+  struct instr_table *next;
+};
+
+static pthread_mutex_t instr_lock = PTHREAD_MUTEX_INITIALIZER;
+static char phase_names[INSTR_MAX_PHASES][INSTR_NAME_MAX];
+static int nphases;
+static int64_t output_bytes[INSTR_MAX_PHASES];   /* per phase group, see instr_output() */
+static char output_groups[INSTR_MAX_PHASES][INSTR_NAME_MAX];
+static int noutputs;
+static struct instr_table *threads;
+static __thread struct instr_table *my_table;
+
+static pthread_once_t clock_once = PTHREAD_ONCE_INIT;
+static int use_tsc;
+static double ns_per_tick;
+
+/* ---------------------------------------------------------------------- */
+/* Clocks                                                                  */
+
+static uint64_t monotonic_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#if defined(__x86_64__)
+static uint64_t rdtsc(void)
+{
+  uint32_t lo, hi;
+
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+#endif
+
+static void clock_init(void)
+{
+  char *s;
+#if defined(__x86_64__)
+  struct timespec ts;
+  uint64_t t0, c0, t1, c1;
+#endif
+
+  s = getenv("SWIFTER_INSTR_CLOCK");
+  use_tsc = 0;
+  if (s == NULL || strcmp(s, "tsc") != 0) return;
+#if defined(__x86_64__)
+  /* Calibrate the counter against the monotonic clock over 20 ms */
+  ts.tv_sec = 0;
+  ts.tv_nsec = 20000000;
+  t0 = monotonic_ns();
+  c0 = rdtsc();
+  nanosleep(&ts, NULL);
+  t1 = monotonic_ns();
+  c1 = rdtsc();
+  if (c1 > c0) {
+    ns_per_tick = (double) (t1 - t0) / (double) (c1 - c0);
+    use_tsc = 1;
+  }
+#else
+  fprintf(stderr, "Warning: SWIFTER_INSTR_CLOCK=tsc needs x86-64; using the monotonic clock\n");
+#endif
+}
+
+uint64_t instr_now(void)
+{
+  pthread_once(&clock_once, clock_init);
+#if defined(__x86_64__)
+  if (use_tsc) return (uint64_t) (rdtsc() * ns_per_tick);
+#endif
+  return monotonic_ns();
+}
+
+/* ---------------------------------------------------------------------- */
+/* Statistics                                                              */
+
+int instr_phase(const char *name)
+{
+  int i;
+
+  pthread_mutex_lock(&instr_lock);
+  for (i = 0; i < nphases; i++) {
+    if (strcmp(phase_names[i], name) == 0) break;
+  }
+  if (i == nphases) {
+    if (nphases == INSTR_MAX_PHASES) {
+      pthread_mutex_unlock(&instr_lock);
+      fprintf(stderr, "instr: more than %d phases\n", INSTR_MAX_PHASES);
+      exit(1);
+    }
+    strncpy(phase_names[i], name, INSTR_NAME_MAX-1);
+    nphases++;
+  }
+  pthread_mutex_unlock(&instr_lock);
+  return i;
+}
+
+/* Values below 4 get a bucket each; above that, four buckets per power of two */
+static int bucket(uint64_t ns)
+{
+  int e;
+
+  if (ns < 4) return (int) ns;
+  e = 63 - __builtin_clzll(ns);
+  return 4*(e-1) + (int) ((ns >> (e-2)) & 3);
+}
+
+static uint64_t bucket_value(int b)
+{
+  int e;
+
+  if (b < 4) return b;
+  e = b/4 + 1;
+  return ((uint64_t) (4 + b%4) << (e-2)) + ((uint64_t) 1 << (e-2)) / 2;
+}
+
+static struct instr_stat *table_get(struct instr_table *t, int phase, int node, int frag)
+{
+  struct instr_stat *st;
+  unsigned h;
+
+  h = ((unsigned) phase * 31u + (unsigned) node) * 31u + (unsigned) frag;
+  h %= INSTR_HASH;
+  for (st = t->heads[h]; st != NULL; st = st->next) {
+    if (st->phase == phase && st->node == node && st->frag == frag) return st;
+  }
+  st = talloc(struct instr_stat, 1);
+  if (st == NULL) return NULL;
+  memset(st, 0, sizeof(*st));
+  st->phase = phase;
+  st->node = node;
+  st->frag = frag;
+  st->next = t->heads[h];
+  t->heads[h] = st;
+  return st;
+}
+
+static struct instr_table *thread_table(void)
+{
+  if (my_table == NULL) {
+    my_table = talloc(struct instr_table, 1);
+    if (my_table == NULL) return NULL;
+    memset(my_table, 0, sizeof(*my_table));
+    pthread_mutex_lock(&instr_lock);
+    my_table->next = threads;
+    threads = my_table;
+    pthread_mutex_unlock(&instr_lock);
+  }
+  return my_table;
+}
+
+void instr_record(int phase, int node, int frag, uint64_t ns, int64_t bytes)
+{
+  struct instr_table *t;
+  struct instr_stat *st;
+
+  t = thread_table();
+  if (t == NULL) return;
+  st = table_get(t, phase, node, frag);
+  if (st == NULL) return;
+  st->count++;
+  st->bytes += bytes;
+  st->sum += ns;
+  if (ns > st->max) st->max = ns;
+  st->hist[bucket(ns)]++;
+}
+
+void instr_begin(struct instr_scope *s, int phase, int node, int frag)
+{
+  s->phase = phase;
+  s->node = node;
+  s->frag = frag;
+  s->start = instr_now();
+}
+
+uint64_t instr_end_bytes(struct instr_scope *s, int64_t bytes)
+{
+  uint64_t ns, now;
+
+  now = instr_now();
+  ns = (now > s->start) ? now - s->start : 0;
+  instr_record(s->phase, s->node, s->frag, ns, bytes);
+  return ns;
+}
+
+uint64_t instr_end(struct instr_scope *s)
+{
+  return instr_end_bytes(s, 0);
+}
+
+void instr_output(const char *group, int64_t bytes)
+{
+  int i;
+
+  pthread_mutex_lock(&instr_lock);
+  for (i = 0; i < noutputs && strcmp(output_groups[i], group) != 0; i++) ;
+  if (i < INSTR_MAX_PHASES) {
+    if (i == noutputs) {
+      strncpy(output_groups[i], group, INSTR_NAME_MAX-1);
+      noutputs++;
+    }
+    output_bytes[i] = bytes;
+  }
+  pthread_mutex_unlock(&instr_lock);
+}
+
+/* Output bytes of the group a phase belongs to ("encode" for
+   "encode.read"), or 0 if none was set.  Called with instr_lock held. */
+static int64_t phase_output(int phase)
+{
+  const char *dot;
+  size_t len;
+  int i;
+
+  dot = strchr(phase_names[phase], '.');
+  len = (dot == NULL) ? strlen(phase_names[phase]) : (size_t) (dot - phase_names[phase]);
+  for (i = 0; i < noutputs; i++) {
+    if (strlen(output_groups[i]) == len && strncmp(output_groups[i], phase_names[phase], len) == 0) {
+      return output_bytes[i];
+    }
+  }
+  return 0;
+}
+
+double instr_seconds(int phase)
+{
+  struct instr_table *t;
+  struct instr_stat *st;
+  uint64_t sum;
+  int h;
+
+  sum = 0;
+  pthread_mutex_lock(&instr_lock);
+  for (t = threads; t != NULL; t = t->next) {
+    for (h = 0; h < INSTR_HASH; h++) {
+      for (st = t->heads[h]; st != NULL; st = st->next) {
+        if (st->phase == phase) sum += st->sum;
+      }
+    }
+  }
+  pthread_mutex_unlock(&instr_lock);
+  return sum / 1e9;
+}
+
+int64_t instr_calls(int phase)
+{
+  struct instr_table *t;
+  struct instr_stat *st;
+  int64_t count;
+  int h;
+
+  count = 0;
+  pthread_mutex_lock(&instr_lock);
+  for (t = threads; t != NULL; t = t->next) {
+    for (h = 0; h < INSTR_HASH; h++) {
+      for (st = t->heads[h]; st != NULL; st = st->next) {
+        if (st->phase == phase) count += st->count;
+      }
+    }
+  }
+  pthread_mutex_unlock(&instr_lock);
+  return count;
+}
+
+int64_t instr_bytes(int phase)
+{
+  struct instr_table *t;
+  struct instr_stat *st;
+  int64_t bytes;
+  int h;
+
+  bytes = 0;
+  pthread_mutex_lock(&instr_lock);
+  for (t = threads; t != NULL; t = t->next) {
+    for (h = 0; h < INSTR_HASH; h++) {
+      for (st = t->heads[h]; st != NULL; st = st->next) {
+        if (st->phase == phase) bytes += st->bytes;
+      }
+    }
+  }
+  pthread_mutex_unlock(&instr_lock);
+  return bytes;
+}
+
+void instr_reset(void)
+{
+  struct instr_table *t;
+  struct instr_stat *st;
+  struct instr_stat *next;
+  int h;
+
+  pthread_mutex_lock(&instr_lock);
+  for (t = threads; t != NULL; t = t->next) {
+    for (h = 0; h < INSTR_HASH; h++) {
+      for (st = t->heads[h]; st != NULL; st = next) {
+        next = st->next;
+        free(st);
+      }
+      t->heads[h] = NULL;
+    }
+  }
+  noutputs = 0;
+  pthread_mutex_unlock(&instr_lock);
+}
+
+/* ---------------------------------------------------------------------- */
+/* Reports                                                                 */
+
+static void merge(struct instr_table *dst, struct instr_stat *src, int node, int frag)
+{
+  struct instr_stat *st;
+  int i;
+
+  st = table_get(dst, src->phase, node, frag);
+  if (st == NULL) return;
+  st->count += src->count;
+  st->bytes += src->bytes;
+  st->sum += src->sum;
+  if (src->max > st->max) st->max = src->max;
+  for (i = 0; i < INSTR_BUCKETS; i++) st->hist[i] += src->hist[i];
+}
+
+static uint64_t percentile(struct instr_stat *st, double p)
+{
+  int64_t target, seen;
+  uint64_t v;
+  int i;
+
+  target = (int64_t) (p * st->count + 0.999999);
+  if (target < 1) target = 1;
+  seen = 0;
+  for (i = 0; i < INSTR_BUCKETS; i++) {
+    seen += st->hist[i];
+    if (seen >= target) break;
+  }
+  v = bucket_value(i);
+  return (v > st->max) ? st->max : v;
+}
+
+static int stat_compare(const void *a, const void *b)
+{
+  const struct instr_stat *x = *(const struct instr_stat **) a;
+  const struct instr_stat *y = *(const struct instr_stat **) b;
+
+  if (x->phase != y->phase) return x->phase - y->phase;
+  if (x->node != y->node) return x->node - y->node;
+  return x->frag - y->frag;
+}
+
+static double mb_per_sec(struct instr_stat *st)
+{
+  return (st->sum == 0) ? 0.0 : (st->bytes / 1048576.0) / (st->sum / 1e9);
+}
+
+static double amplification(struct instr_stat *st, int64_t output)
+{
+  return (output <= 0) ? 0.0 : (double) st->bytes / output;
+}
+
+/* Folds every thread into *merged, adding per-node and overall rows, and
+   returns the rows sorted by phase, node and fragment.  *outputs gets
+   each row's output bytes. */
+static struct instr_stat **merged_rows(struct instr_table *merged, int *nrows, int64_t **outputs)
+{
+  struct instr_table *t;
+  struct instr_stat *st, **rows;
+  int h, n, i;
+
+  memset(merged, 0, sizeof(*merged));
+  pthread_mutex_lock(&instr_lock);
+  for (t = threads; t != NULL; t = t->next) {
+    for (h = 0; h < INSTR_HASH; h++) {
+      for (st = t->heads[h]; st != NULL; st = st->next) {
+        merge(merged, st, st->node, st->frag);
+        if (st->frag >= 0 && st->node >= 0) merge(merged, st, st->node, -1);
+        if (st->frag >= 0 || st->node >= 0) merge(merged, st, -1, -1);
+      }
+    }
+  }
+
+  n = 0;
+  for (h = 0; h < INSTR_HASH; h++) {
+    for (st = merged->heads[h]; st != NULL; st = st->next) n++;
+  }
+  rows = talloc(struct instr_stat *, n+1);
+  *outputs = talloc(int64_t, n+1);
+  if (rows == NULL || *outputs == NULL) {
+    pthread_mutex_unlock(&instr_lock);
+    free(rows);
+    free(*outputs);
+    return NULL;
+  }
+  n = 0;
+  for (h = 0; h < INSTR_HASH; h++) {
+    for (st = merged->heads[h]; st != NULL; st = st->next) rows[n++] = st;
+  }
+  qsort(rows, n, sizeof(rows[0]), stat_compare);
+  for (i = 0; i < n; i++) (*outputs)[i] = phase_output(rows[i]->phase);
+  pthread_mutex_unlock(&instr_lock);
+
+  *nrows = n;
+  return rows;
+}
+
+static void free_rows(struct instr_table *merged, struct instr_stat **rows, int64_t *outputs)
+{
+  struct instr_stat *st, *next;
+  int h;
+
+  for (h = 0; h < INSTR_HASH; h++) {
+    for (st = merged->heads[h]; st != NULL; st = next) {
+      next = st->next;
+      free(st);
+    }
+  }
+  free(rows);
+  free(outputs);
+}
+
+void instr_report(FILE *f, int format)
+{
+  struct instr_table merged;
+  struct instr_stat *st, **rows;
+  int64_t *outputs;
+  int n, i;
+
+  rows = merged_rows(&merged, &n, &outputs);
+  if (rows == NULL) return;
+
+  if (format == INSTR_JSON) {
+    fprintf(f, "{\"clock\": \"%s\", \"phases\": [", use_tsc ? "tsc" : "monotonic");
+  } else if (format == INSTR_CSV) {
+    fprintf(f, "phase,node,fragment,count,total_s,mean_us,p50_us,p99_us,max_us,bytes,mb_per_s,bytes_per_output_byte\n");
+  } else {
+    fprintf(f, "%-24s %5s %5s %10s %12s %10s %10s %10s %10s %14s %10s %8s\n",
+            "phase", "node", "frag", "count", "total_s", "mean_us", "p50_us", "p99_us", "max_us",
+            "bytes", "MB/s", "amp");
+  }
+
+  for (i = 0; i < n; i++) {
+    st = rows[i];
+    if (format == INSTR_JSON) {
+      fprintf(f, "%s\n  {\"phase\": \"%s\", \"node\": %d, \"fragment\": %d, \"count\": %lld, "
+                 "\"total_s\": %.9f, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f, "
+                 "\"bytes\": %lld, \"mb_per_s\": %.3f, \"bytes_per_output_byte\": %.4f}",
+              (i == 0) ? "" : ",", phase_names[st->phase], st->node, st->frag, (long long) st->count,
+              st->sum / 1e9, st->sum / 1e3 / st->count,
+              percentile(st, 0.50) / 1e3, percentile(st, 0.99) / 1e3, st->max / 1e3,
+              (long long) st->bytes, mb_per_sec(st), amplification(st, outputs[i]));
+    } else if (format == INSTR_CSV) {
+      fprintf(f, "%s,%d,%d,%lld,%.9f,%.3f,%.3f,%.3f,%.3f,%lld,%.3f,%.4f\n",
+              phase_names[st->phase], st->node, st->frag, (long long) st->count,
+              st->sum / 1e9, st->sum / 1e3 / st->count,
+              percentile(st, 0.50) / 1e3, percentile(st, 0.99) / 1e3, st->max / 1e3,
+              (long long) st->bytes, mb_per_sec(st), amplification(st, outputs[i]));
+    } else {
+      fprintf(f, "%-24s %5d %5d %10lld %12.6f %10.3f %10.3f %10.3f %10.3f %14lld %10.1f %8.3f\n",
+              phase_names[st->phase], st->node, st->frag, (long long) st->count,
+              st->sum / 1e9, st->sum / 1e3 / st->count,
+              percentile(st, 0.50) / 1e3, percentile(st, 0.99) / 1e3, st->max / 1e3,
+              (long long) st->bytes, mb_per_sec(st), amplification(st, outputs[i]));
+    }
+  }
+  if (format == INSTR_JSON) fprintf(f, "\n]}\n");
+
+  free_rows(&merged, rows, outputs);
+}
+
+void instr_summary(FILE *f, const char *group)
+{
+  struct instr_table merged;
+  struct instr_stat *st, **rows;
+  int64_t *outputs;
+  size_t len;
+  int n, i;
+
+  rows = merged_rows(&merged, &n, &outputs);
+  if (rows == NULL) return;
+
+  len = strlen(group);
+  for (i = 0; i < n; i++) {
+    st = rows[i];
+    if (st->bytes == 0 || st->frag >= 0) continue;
+    if (strncmp(phase_names[st->phase], group, len) != 0 || phase_names[st->phase][len] != '.') continue;
+    if (st->node < 0) {
+      fprintf(f, "%s: %.3f MB at %.1f MB/s", phase_names[st->phase], st->bytes / 1048576.0, mb_per_sec(st));
+    } else {
+      fprintf(f, "  node %d: %.3f MB at %.1f MB/s", st->node, st->bytes / 1048576.0, mb_per_sec(st));
+    }
+    if (outputs[i] > 0) fprintf(f, ", %.3f bytes per output byte", amplification(st, outputs[i]));
+    fprintf(f, "\n");
+  }
+  free_rows(&merged, rows, outputs);
+}
+
+void instr_finish(void)
+{
+  char *s, *colon;
+  FILE *f;
+  int format;
+
+  s = getenv("SWIFTER_INSTR");
+  if (s == NULL || *s == '\0') return;
+  if (strncmp(s, "json", 4) == 0) format = INSTR_JSON;
+  else if (strncmp(s, "csv", 3) == 0) format = INSTR_CSV;
+  else if (strncmp(s, "text", 4) == 0) format = INSTR_TEXT;
+  else {
+    fprintf(stderr, "Warning: SWIFTER_INSTR=%s is not text, json or csv\n", s);
+    return;
+  }
+
+  colon = strchr(s, ':');
+  if (colon == NULL) {
+    instr_report(stdout, format);
+    fflush(stdout);
+    return;
+  }
+  f = fopen(colon+1, "w");
+  if (f == NULL) {
+    perror(colon+1);
+    return;
+  }
+  instr_report(f, format);
+  fclose(f);
+}
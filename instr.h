@@ -0,0 +1,80 @@
+/* instr.h - per-phase timing for the encoder, decoder and tools.
+ *
+ * A phase is a name such as "encode.read".  Code brackets work with
+ * instr_begin()/instr_end(), tagging it with the node and fragment it
+ * touched (-1 for neither).  Every thread keeps its own table of
+ * (phase, node, fragment) statistics -- count, total, max and a
+ * log-linear histogram -- so recording takes no locks.  Reports merge
+ * all threads and list each phase overall, per node and per fragment
+ * with p50/p99/max.  Histogram buckets are 1/4 of a power of two wide,
+ * so percentiles are accurate to about 12%.  Reports and instr_reset()
+ * expect the recording threads to be idle.
+ *
+ * Scopes may also carry a byte count -- read, written, computed or
+ * transferred, depending on the phase -- giving MB/s per phase and node.
+ * instr_output() sets the bytes a group of phases ("encode" for
+ * "encode.read", ...) produced; each row then also reports bytes moved
+ * per output byte, i.e. the I/O or network amplification.
+ *
+ * Environment:
+ *   SWIFTER_INSTR        text | json | csv, optionally followed by
+ *                        ":<path>" (default stdout); instr_finish()
+ *                        writes the report there.  Unset: no report.
+ *   SWIFTER_INSTR_CLOCK  monotonic (default, clock_gettime) or tsc
+ *                        (rdtsc, calibrated against the monotonic
+ *                        clock; x86-64 only).
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INSTR_MAX_PHASES   64
+#define INSTR_NAME_MAX     48
+#define INSTR_BUCKETS      252
+
+enum instr_format { INSTR_TEXT = 0, INSTR_JSON = 1, INSTR_CSV = 2 };
+
+struct instr_scope {
+  int      phase;
+  int      node;
+  int      frag;
+  uint64_t start;
+};
+
+/* Id of the named phase, registering it on first use */
+extern int instr_phase(const char *name);
+
+/* Nanoseconds on the selected clock */
+extern uint64_t instr_now(void);
+
+extern void instr_begin(struct instr_scope *s, int phase, int node, int frag);
+/* Records the scope and returns its length in nanoseconds */
+extern uint64_t instr_end(struct instr_scope *s);
+extern uint64_t instr_end_bytes(struct instr_scope *s, int64_t bytes);
+/* Records an interval measured elsewhere, e.g. reported by a node agent */
+extern void instr_record(int phase, int node, int frag, uint64_t ns, int64_t bytes);
+
+extern void instr_output(const char *group, int64_t bytes);
+
+/* Totals of a phase over all threads, nodes and fragments */
+extern double instr_seconds(int phase);
+extern int64_t instr_calls(int phase);
+extern int64_t instr_bytes(int phase);
+
+extern void instr_report(FILE *f, int format);
+/* Bytes and MB/s of each phase of group, overall and per node */
+extern void instr_summary(FILE *f, const char *group);
+/* Writes the report SWIFTER_INSTR asks for, if any */
+extern void instr_finish(void);
+/* Forgets everything recorded so far; phase ids stay valid */
+extern void instr_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
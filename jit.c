@@ -0,0 +1,354 @@
+/* jit.c - machine code generated per coding matrix.  See jit.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "gf_kernel.h"
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define JIT_X86
+#include <sys/mman.h>
+#endif
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define JIT_VEC         32         /* bytes per vector */
+#define JIT_CACHE_MAX   1024       /* matrices kept */
+
+typedef void (*jit_fn)(char **srcs, char **dsts, long off, long end);
+
+struct jit_code {
+  int      k, nr;
+  int     *matrix;                 /* nr x k, the cache key */
+  struct gf_coef *coefs;           /* for the tail */
+  jit_fn   fn;
+  struct jit_code *next;
+};
+
+static pthread_once_t jit_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t jit_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct jit_code *cache;
+static int ncached;
+
+enum jit_form { JIT_OFF, JIT_GFNI, JIT_PSHUFB };
+static enum jit_form form;
+
+/* The code multiplies the way gf_kernel() does, so SWIFTER_GF_KERNEL
+   picks between the two forms */
+static void jit_init(void)
+{
+  const char *name;
+  char *s;
+
+  form = JIT_OFF;
+  s = getenv("SWIFTER_JIT");
+  if (s == NULL || strcmp(s, "on") != 0) return;
+  name = gf_kernel()->name;
+#ifdef JIT_X86
+  if (strstr(name, "gfni") != NULL && gf_kernel_named("avx2-gfni") != NULL) {
+    form = JIT_GFNI;
+  } else if (strcmp(name, "ssse3") != 0 && strcmp(name, "scalar") != 0 && gf_kernel_named("avx2") != NULL) {
+    form = JIT_PSHUFB;
+  }
+#endif
+  if (form == JIT_OFF) fprintf(stderr, "SWIFTER_JIT=on needs x86-64 with AVX2; using %s\n", name);
+}
+
+#ifdef JIT_X86
+
+/* Vector registers: accumulators from 0, and */
+#define R_SRC     15
+#define R_LO      14               /* low and high nibbles of the source */
+#define R_HI      13
+#define R_MASK    12
+#define R_T0      11
+#define R_T1      10
+
+/* Constants, 32 bytes each after the code */
+enum jit_const { C_MASK, C_AFFINE, C_LO, C_HI };
+
+struct jit_fixup {
+  int at;                          /* where the disp32 goes */
+  int end;                         /* end of the instruction it is relative to */
+  int slot;                        /* constant slot */
+};
+
+struct jit_asm {
+  uint8_t *code;
+  int      n, cap;
+  struct jit_fixup *fix;
+  int      nfix, capfix;
+  int      slot_of[4][256];        /* by kind and constant, or -1 */
+  uint8_t (*pool)[JIT_VEC];
+  int      nslots;
+};
+
+static void emit(struct jit_asm *a, int b)
+{
+  if (a->n == a->cap) {
+    a->cap = (a->cap == 0) ? 4096 : 2*a->cap;
+    a->code = (uint8_t *) realloc(a->code, a->cap);
+  }
+  a->code[a->n++] = (uint8_t) b;
+}
+
+static void emit32(struct jit_asm *a, int32_t v)
+{
+  int i;
+
+  for (i = 0; i < 4; i++) emit(a, (v >> (8*i)) & 0xff);
+}
+
+static void patch32(struct jit_asm *a, int at, int32_t v)
+{
+  int i;
+
+  for (i = 0; i < 4; i++) a->code[at+i] = (uint8_t) ((v >> (8*i)) & 0xff);
+}
+
+/* The constant slot for kind and c, filled in on first use */
+static int slot(struct jit_asm *a, enum jit_const kind, const struct gf_coef *gc)
+{
+  int c, i;
+
+  c = (gc == NULL) ? 0 : gc->c;
+  if (a->slot_of[kind][c] >= 0) return a->slot_of[kind][c];
+  a->pool = (uint8_t (*)[JIT_VEC]) realloc(a->pool, (a->nslots+1)*JIT_VEC);
+  for (i = 0; i < JIT_VEC; i++) {
+    switch (kind) {
+      case C_MASK:   a->pool[a->nslots][i] = 0x0f; break;
+      case C_AFFINE: a->pool[a->nslots][i] = (uint8_t) (gc->affine >> (8*(i%8))); break;
+      case C_LO:     a->pool[a->nslots][i] = gc->lo[i%16]; break;
+      case C_HI:     a->pool[a->nslots][i] = gc->hi[i%16]; break;
+    }
+  }
+  a->slot_of[kind][c] = a->nslots;
+  return a->nslots++;
+}
+
+/* Three-byte VEX prefix, 256-bit.  map: 1 = 0F, 2 = 0F38, 3 = 0F3A;
+   pp: 1 = 66, 2 = F3. */
+static void vex(struct jit_asm *a, int map, int pp, int w, int reg, int vvvv, int rm_ext)
+{
+  emit(a, 0xc4);
+  emit(a, ((reg & 8) ? 0 : 0x80) | 0x40 | (rm_ext ? 0 : 0x20) | map);
+  emit(a, (w << 7) | ((~vvvv & 15) << 3) | 0x04 | pp);
+}
+
+/* op reg, vvvv, rm with register operands */
+static void vex_rr(struct jit_asm *a, int map, int pp, int w, int op, int reg, int vvvv, int rm)
+{
+  vex(a, map, pp, w, reg, vvvv, rm & 8);
+  emit(a, op);
+  emit(a, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+/* op reg, [rax+rdx] */
+static void vex_src(struct jit_asm *a, int map, int pp, int op, int reg)
+{
+  vex(a, map, pp, 0, reg, 0, 0);
+  emit(a, op);
+  emit(a, 0x04 | ((reg & 7) << 3));
+  emit(a, 0x10);                   /* SIB: base rax, index rdx */
+}
+
+/* op reg, vvvv, [rip + constant slot], with nimm immediate bytes after */
+static void vex_const(struct jit_asm *a, int map, int pp, int w, int op, int reg, int vvvv, int s, int nimm)
+{
+  vex(a, map, pp, w, reg, vvvv, 0);
+  emit(a, op);
+  emit(a, 0x05 | ((reg & 7) << 3));
+  if (a->nfix == a->capfix) {
+    a->capfix = (a->capfix == 0) ? 256 : 2*a->capfix;
+    a->fix = (struct jit_fixup *) realloc(a->fix, sizeof(struct jit_fixup)*a->capfix);
+  }
+  a->fix[a->nfix].at = a->n;
+  a->fix[a->nfix].end = a->n + 4 + nimm;
+  a->fix[a->nfix].slot = s;
+  a->nfix++;
+  emit32(a, 0);
+}
+
+static void vpxor(struct jit_asm *a, int d, int x, int y)   { vex_rr(a, 1, 1, 0, 0xef, d, x, y); }
+static void vpand(struct jit_asm *a, int d, int x, int y)   { vex_rr(a, 1, 1, 0, 0xdb, d, x, y); }
+static void vpshufb(struct jit_asm *a, int d, int x, int y) { vex_rr(a, 2, 1, 0, 0x00, d, x, y); }
+static void vmovdqa(struct jit_asm *a, int d, int x)        { vex_rr(a, 1, 1, 0, 0x6f, d, 0, x); }
+
+static void vpsrlq4(struct jit_asm *a, int d, int x)
+{
+  vex_rr(a, 1, 1, 0, 0x73, 2, d, x);
+  emit(a, 4);
+}
+
+static void load_const(struct jit_asm *a, int d, int s)      { vex_const(a, 1, 2, 0, 0x6f, d, 0, s, 0); }
+
+static void vgf2p8affineqb(struct jit_asm *a, int d, int x, int s)
+{
+  vex_const(a, 3, 1, 1, 0xce, d, x, s, 1);
+  emit(a, 0);
+}
+
+/* rax = [base + 8*i], base 7 = rdi (srcs) or 6 = rsi (dsts) */
+static void load_ptr(struct jit_asm *a, int base, int i)
+{
+  emit(a, 0x48);
+  emit(a, 0x8b);
+  emit(a, 0x80 | base);
+  emit32(a, 8*i);
+}
+
+static void assemble(struct jit_asm *a, int k, int nr, const struct gf_coef *coefs)
+{
+  const struct gf_coef *gc;
+  int started[JIT_ROWS];
+  int r, j, any, mult, top, skip;
+
+  /* rcx = end; nothing to do if off >= end */
+  emit(a, 0x48); emit(a, 0x39); emit(a, 0xca);                     /* cmp rdx, rcx */
+  emit(a, 0x0f); emit(a, 0x83);                                   /* jae done */
+  skip = a->n;
+  emit32(a, 0);
+  if (form == JIT_PSHUFB) load_const(a, R_MASK, slot(a, C_MASK, NULL));
+
+  top = a->n;
+  for (r = 0; r < nr; r++) started[r] = 0;
+  for (j = 0; j < k; j++) {
+    any = mult = 0;
+    for (r = 0; r < nr; r++) {
+      any |= (coefs[r*k+j].c != 0);
+      mult |= (coefs[r*k+j].c > 1);
+    }
+    if (!any) continue;
+    load_ptr(a, 7, j);
+    vex_src(a, 1, 2, 0x6f, R_SRC);                                /* vmovdqu src, [rax+rdx] */
+    if (form == JIT_PSHUFB && mult) {
+      vpand(a, R_LO, R_SRC, R_MASK);
+      vpsrlq4(a, R_HI, R_SRC);
+      vpand(a, R_HI, R_HI, R_MASK);
+    }
+    for (r = 0; r < nr; r++) {
+      gc = coefs + r*k + j;
+      if (gc->c == 0) continue;
+      if (gc->c == 1) {
+        if (started[r]) vpxor(a, r, r, R_SRC); else vmovdqa(a, r, R_SRC);
+      } else if (form == JIT_GFNI) {
+        if (started[r]) {
+          vgf2p8affineqb(a, R_T0, R_SRC, slot(a, C_AFFINE, gc));
+          vpxor(a, r, r, R_T0);
+        } else {
+          vgf2p8affineqb(a, r, R_SRC, slot(a, C_AFFINE, gc));
+        }
+      } else {
+        load_const(a, R_T0, slot(a, C_LO, gc));
+        vpshufb(a, R_T0, R_T0, R_LO);
+        load_const(a, R_T1, slot(a, C_HI, gc));
+        vpshufb(a, R_T1, R_T1, R_HI);
+        if (started[r]) {
+          vpxor(a, r, r, R_T0);
+          vpxor(a, r, r, R_T1);
+        } else {
+          vpxor(a, r, R_T0, R_T1);
+        }
+      }
+      started[r] = 1;
+    }
+  }
+  for (r = 0; r < nr; r++) {
+    if (!started[r]) vpxor(a, r, r, r);
+    load_ptr(a, 6, r);
+    vex_src(a, 1, 2, 0x7f, r);                                    /* vmovdqu [rax+rdx], acc */
+  }
+
+  emit(a, 0x48); emit(a, 0x83); emit(a, 0xc2); emit(a, JIT_VEC);  /* add rdx, 32 */
+  emit(a, 0x48); emit(a, 0x39); emit(a, 0xca);                     /* cmp rdx, rcx */
+  emit(a, 0x0f); emit(a, 0x82);                                   /* jb top */
+  emit32(a, top - (a->n + 4));
+  patch32(a, skip, a->n - (skip + 4));
+  emit(a, 0xc5); emit(a, 0xf8); emit(a, 0x77);                     /* vzeroupper */
+  emit(a, 0xc3);                                                  /* ret */
+}
+
+/* Assembles the rows into fresh executable memory */
+static jit_fn compile(int k, int nr, const struct gf_coef *coefs)
+{
+  struct jit_asm a;
+  uint8_t *mem;
+  size_t size;
+  int pool, i;
+
+  memset(&a, 0, sizeof(a));
+  memset(a.slot_of, 0xff, sizeof(a.slot_of));
+  assemble(&a, k, nr, coefs);
+
+  pool = (a.n + JIT_VEC - 1) / JIT_VEC * JIT_VEC;
+  size = pool + (size_t) a.nslots*JIT_VEC;
+  mem = (uint8_t *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem != MAP_FAILED) {
+    for (i = 0; i < a.nfix; i++) patch32(&a, a.fix[i].at, pool + a.fix[i].slot*JIT_VEC - a.fix[i].end);
+    memcpy(mem, a.code, a.n);
+    memset(mem + a.n, 0xcc, pool - a.n);
+    if (a.nslots > 0) memcpy(mem + pool, a.pool, (size_t) a.nslots*JIT_VEC);
+    if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+      munmap(mem, size);
+      mem = (uint8_t *) MAP_FAILED;
+    }
+  }
+  free(a.code);
+  free(a.fix);
+  free(a.pool);
+  return (mem == MAP_FAILED) ? NULL : (jit_fn) (void *) mem;
+}
+
+#endif
+
+jit_code_t *jit_code_get(int k, int nr, const int *matrix)
+{
+  jit_code_t *jc;
+  int i;
+
+  pthread_once(&jit_once, jit_init);
+  if (form == JIT_OFF || nr < 1 || nr > JIT_ROWS) return NULL;
+
+  pthread_mutex_lock(&jit_lock);
+  for (jc = cache; jc != NULL; jc = jc->next) {
+    if (jc->k == k && jc->nr == nr && memcmp(jc->matrix, matrix, sizeof(int)*k*nr) == 0) break;
+  }
+  if (jc == NULL && ncached < JIT_CACHE_MAX) {
+    jc = talloc(jit_code_t, 1);
+    jc->k = k;
+    jc->nr = nr;
+    jc->matrix = talloc(int, k*nr);
+    jc->coefs = talloc(struct gf_coef, k*nr);
+    memcpy(jc->matrix, matrix, sizeof(int)*k*nr);
+    for (i = 0; i < k*nr; i++) gf_coef_init(jc->coefs + i, matrix[i]);
+    jc->fn = NULL;
+#ifdef JIT_X86
+    jc->fn = compile(k, nr, jc->coefs);
+#endif
+    if (jc->fn == NULL) {
+      free(jc->matrix);
+      free(jc->coefs);
+      free(jc);
+      jc = NULL;
+    } else {
+      jc->next = cache;
+      cache = jc;
+      ncached++;
+    }
+  }
+  pthread_mutex_unlock(&jit_lock);
+  return jc;
+}
+
+void jit_run(jit_code_t *jc, char **srcs, char **dsts, int off, int len)
+{
+  int end;
+
+  end = off + len - len % JIT_VEC;
+  jc->fn(srcs, dsts, off, end);
+  if (end < off+len) gf_kernel()->dot(jc->k, jc->nr, jc->coefs, srcs, dsts, end, off+len-end, 0);
+}
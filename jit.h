@@ -0,0 +1,39 @@
+/* jit.h - machine code generated per coding matrix.
+ *
+ * Once a coding matrix, or the rows inverted for an erasure pattern, is
+ * fixed, every coefficient is a constant, yet the region kernels still
+ * read them from memory for every vector.  jit_code_get() emits x86-64
+ * code for a few rows of such a matrix over GF(2^8): one loop over
+ * 32-byte vectors, each source loaded once, with the multiplications
+ * unrolled and their constants baked into the code.  Terms of 0 are left
+ * out and terms of 1 are a plain XOR.  The multiplies are VGF2P8AFFINEQB
+ * when gf_kernel() is a GFNI kernel, and VPSHUFB split tables otherwise;
+ * on CPUs without AVX2 there is no code.
+ *
+ * The code is cached by matrix contents for the life of the process, so
+ * the tile_code_t of each stripe, or of each erasure pattern met again,
+ * finds its code already built.  It is off unless SWIFTER_JIT=on; it is
+ * meant for long-running services, where the compile time is spread over
+ * many stripes.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct jit_code jit_code_t;
+
+/* Code for the nr x k matrix, nr <= JIT_ROWS, or NULL if the JIT is off,
+   the CPU cannot run it or the cache is full.  Not to be freed. */
+#define JIT_ROWS   4
+extern jit_code_t *jit_code_get(int k, int nr, const int *matrix);
+
+/* As gf_rows_run() with add = 0: bytes [off, off+len) of dsts[r] become
+   row r of the matrix times srcs */
+extern void jit_run(jit_code_t *jc, char **srcs, char **dsts, int off, int len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,385 @@
+/* matrix_search.c - offline search for cheap MDS coding matrices.
+ *
+ *   matrix_search [-k k] [-m m] [-n m_new] [-w w] [-o mults|xors]
+ *                 [-i iterations] [-x seed] [-p patterns] [-c]
+ *
+ * The rows reed_sol_vandermonde_coding_matrix() and
+ * reed_sol_vandermonde_decoding_matrix() return were typed in by hand, for
+ * k=24.  Many of their coefficients are large and distinct, and some
+ * k-subsets of the code's fragments do not invert.  This searches for the
+ * m+m_new parity rows of a systematic code with k data fragments instead.
+ *
+ * Every square submatrix of a Cauchy matrix, 1/(x_i + y_j) for distinct
+ * points x_0..x_{m+n-1} and y_0..y_{k-1} of GF(2^w), is nonsingular, so
+ * every k-subset of the fragments inverts, for the first m rows alone (the
+ * code as ingested) as well as for all of them (after scale-out adds the
+ * m_new rows).  Scaling a row or a column by a nonzero constant keeps
+ * this.  The columns are scaled so that row 0 is all ones, and every other
+ * row by whichever of its coefficients' inverses makes it cheapest.  The
+ * points are then improved by hill climbing: -i times (default 2000), one
+ * point is swapped for an unused field element, and the swap kept unless
+ * the cost goes up.  -x seeds the random choices (default 1).
+ *
+ * The cost (-o) is either the number of distinct coefficients other than
+ * 1 in each row, which is how many multiplies the region kernels do, since
+ * they XOR together the sources that share a coefficient (mults, the
+ * default), or the number of ones in the equivalent bitmatrix, which is
+ * what the XOR schedules of the bitmatrix codes pay for (xors).  Every
+ * 2 x 2 submatrix of an MDS code inverts, so with row 0 all ones no other
+ * row can repeat a coefficient: mults cannot go below (m+n-1)(k-1), which
+ * every scaled Cauchy matrix reaches, and it is the bitmatrix ones, as the
+ * tie-break, that the search then lowers.  Rows 1..m+n-1 are finally sorted by
+ * cost, so the code as ingested gets the cheapest.
+ *
+ * The result is printed as the vdm[] assignments of reed_sol.c: rows
+ * 0..m-1 for reed_sol_vandermonde_coding_matrix(), rows 0..m+n-1 for
+ * reed_sol_vandermonde_decoding_matrix().  Both are checked by inverting
+ * -p random k-subsets of the fragments (default 1000).  -c also costs and
+ * checks the built-in matrix, if k is 24, m at most 6 and m+n at most 12,
+ * and, for any k, that the first m' rows of the built-in decoding matrix
+ * of an object encoded with m' rows are its coding matrix, for every
+ * m' <= rows' <= m+n.  It exits with 1 if they are not.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <gf_rand.h>
+#include "galois.h"
+#include "jerasure.h"
+#include "reed_sol.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+enum ms_cost { MS_MULTS, MS_XORS };
+
+static int k, rows, w;
+static enum ms_cost cost_type = MS_MULTS;
+static int *ones_table;                 /* w <= 16: bitmatrix ones of each constant */
+
+/* Ones in the w x w bitmatrix of multiplication by c: column j is c * 2^j */
+static int count_bit_ones(int c)
+{
+  int j, n, x;
+
+  n = 0;
+  x = c;
+  for (j = 0; j < w; j++) {
+    n += __builtin_popcount((unsigned) x);
+    x = galois_single_multiply(x, 2, w);
+  }
+  return n;
+}
+
+static int bit_ones(int c)
+{
+  return (ones_table != NULL) ? ones_table[c] : count_bit_ones(c);
+}
+
+static int int_cmp(const void *a, const void *b)
+{
+  return (*(const int *) a > *(const int *) b) - (*(const int *) a < *(const int *) b);
+}
+
+static int row_ones(int *row)
+{
+  int j, n;
+
+  n = 0;
+  for (j = 0; j < k; j++) n += bit_ones(row[j]);
+  return n;
+}
+
+/* The distinct coefficients other than 1, as the region kernels XOR the
+   sources that share one before multiplying */
+static int row_mults(int *row)
+{
+  static int *sorted;
+  int j, n;
+
+  if (sorted == NULL) sorted = talloc(int, k);
+  memcpy(sorted, row, sizeof(int)*k);
+  qsort(sorted, k, sizeof(int), int_cmp);
+  n = 0;
+  for (j = 0; j < k; j++) n += (sorted[j] != 1 && (j == 0 || sorted[j] != sorted[j-1]));
+  return n;
+}
+
+/* mults are compared first and bitmatrix ones break ties */
+static int row_cost(int *row)
+{
+  if (cost_type == MS_XORS) return row_ones(row);
+  return row_mults(row)*(k*w*w+1) + row_ones(row);
+}
+
+/* The normalized Cauchy matrix of the points x (rows) and y (k) into a.
+   Returns its cost. */
+static int build(int *x, int *y, int *a)
+{
+  int *row, *best;
+  int i, j, f, c, t, total;
+
+  for (i = 0; i < rows; i++) {
+    for (j = 0; j < k; j++) a[i*k+j] = galois_inverse(x[i] ^ y[j], w);
+  }
+  for (j = 0; j < k; j++) {
+    f = a[j];
+    for (i = 0; i < rows; i++) a[i*k+j] = galois_single_divide(a[i*k+j], f, w);
+  }
+
+  row = talloc(int, k);
+  best = talloc(int, k);
+  total = row_cost(a);
+  for (i = 1; i < rows; i++) {
+    c = -1;
+    for (f = 0; f < k; f++) {
+      for (j = 0; j < k; j++) row[j] = galois_single_divide(a[i*k+j], a[i*k+f], w);
+      t = row_cost(row);
+      if (c < 0 || t < c) {
+        c = t;
+        memcpy(best, row, sizeof(int)*k);
+      }
+    }
+    memcpy(a + i*k, best, sizeof(int)*k);
+    total += c;
+  }
+  free(row);
+  free(best);
+  return total;
+}
+
+static int random_element(void)
+{
+  uint32_t r;
+
+  r = MOA_Random_32();
+  return (w == 32) ? (int) r : (int) (r & ((1U << w) - 1));
+}
+
+static int used(int *pts, int n, int v)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    if (pts[i] == v) return 1;
+  }
+  return 0;
+}
+
+/* Number of nsub-row subsets of [I; a] out of p random ones that do not
+   invert */
+static int singular_subsets(int *a, int nsub, int p)
+{
+  int *pick, *mat, *inv;
+  int i, j, t, n, r, bad;
+
+  pick = talloc(int, k+nsub);
+  mat = talloc(int, k*k);
+  inv = talloc(int, k*k);
+  bad = 0;
+  for (t = 0; t < p; t++) {
+    n = k+nsub;
+    for (i = 0; i < n; i++) pick[i] = i;
+    for (i = 0; i < k; i++) {
+      r = i + (int) (MOA_Random_32() % (uint32_t) (n-i));
+      j = pick[i];
+      pick[i] = pick[r];
+      pick[r] = j;
+    }
+    for (i = 0; i < k; i++) {
+      for (j = 0; j < k; j++) {
+        mat[i*k+j] = (pick[i] < k) ? (pick[i] == j) : a[(pick[i]-k)*k+j];
+      }
+    }
+    if (jerasure_invert_matrix(mat, inv, k, w) != 0) bad++;
+  }
+  free(pick);
+  free(mat);
+  free(inv);
+  return bad;
+}
+
+static int count_mults(int *a)
+{
+  int i, n;
+
+  n = 0;
+  for (i = 0; i < rows; i++) n += row_mults(a + i*k);
+  return n;
+}
+
+static int count_ones(int *a)
+{
+  int i, n;
+
+  n = 0;
+  for (i = 0; i < rows; i++) n += row_ones(a + i*k);
+  return n;
+}
+
+static void report(const char *what, int *a, int m, int patterns)
+{
+  printf("   %s: %d multiplies (distinct coefficients other than 1 per row), %d bitmatrix ones; %d of %d random k-subsets singular with m=%d,"
+         " %d with m=%d\n", what, count_mults(a), count_ones(a), singular_subsets(a, m, patterns), patterns, m,
+         singular_subsets(a, rows, patterns), rows);
+}
+
+/* Mismatches between reed_sol_vandermonde_coding_matrix(k, mi) and the
+   first mi rows of reed_sol_vandermonde_decoding_matrix(k, mi, r), for
+   1 <= mi <= r <= rows.  Geometries the built-in matrix has no rows for
+   are skipped. */
+static int prefix_mismatches(void)
+{
+  int *cm, *dm;
+  int mi, r, bad;
+
+  bad = 0;
+  for (mi = 1; mi <= rows; mi++) {
+    cm = reed_sol_vandermonde_coding_matrix(k, mi, w);
+    if (cm == NULL) continue;
+    for (r = mi; r <= rows; r++) {
+      dm = reed_sol_vandermonde_decoding_matrix(k, mi, r, w);
+      if (dm == NULL) continue;
+      if (memcmp(cm, dm, sizeof(int)*mi*k) != 0) {
+        printf("   built-in: decoding matrix rows 0-%d for m=%d, %d rows, differ from the coding matrix\n",
+               mi-1, mi, r);
+        bad++;
+      }
+      free(dm);
+    }
+    free(cm);
+  }
+  return bad;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: matrix_search [-k k] [-m m] [-n m_new] [-w w] [-o mults|xors]\n"
+                  "                     [-i iterations] [-x seed] [-p patterns] [-c]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  int *x, *y, *a, *best, *cur, *builtin;
+  int m, m_new, iters, patterns, check, c, i, j, it, v, cost, best_cost, order_cost, bad;
+  unsigned seed;
+
+  k = 24;
+  m = 6;
+  m_new = 6;
+  w = 8;
+  iters = 2000;
+  patterns = 1000;
+  check = 0;
+  seed = 1;
+
+  while ((c = getopt(argc, argv, "k:m:n:w:o:i:x:p:c")) != -1) {
+    switch (c) {
+      case 'k': k = atoi(optarg); break;
+      case 'm': m = atoi(optarg); break;
+      case 'n': m_new = atoi(optarg); break;
+      case 'w': w = atoi(optarg); break;
+      case 'o':
+        if (strcmp(optarg, "mults") == 0) cost_type = MS_MULTS;
+        else if (strcmp(optarg, "xors") == 0) cost_type = MS_XORS;
+        else usage();
+        break;
+      case 'i': iters = atoi(optarg); break;
+      case 'x': seed = (unsigned) strtoul(optarg, NULL, 0); break;
+      case 'p': patterns = atoi(optarg); break;
+      case 'c': check = 1; break;
+      default: usage();
+    }
+  }
+  rows = m + m_new;
+  if (optind != argc || k <= 0 || m <= 0 || m_new < 0 || iters < 0 || patterns < 0) usage();
+  if (w != 8 && w != 16 && w != 32) {
+    fprintf(stderr, "matrix_search: w must be 8, 16 or 32\n");
+    exit(1);
+  }
+  if (w < 32 && k + rows > (1 << w)) {
+    fprintf(stderr, "matrix_search: GF(2^%d) has too few elements for k+m+m_new = %d\n", w, k+rows);
+    exit(1);
+  }
+
+  if (w <= 16) {
+    ones_table = talloc(int, 1 << w);
+    for (v = 0; v < (1 << w); v++) ones_table[v] = count_bit_ones(v);
+  }
+
+  MOA_Seed(seed);
+  x = talloc(int, rows);
+  y = talloc(int, k);
+  a = talloc(int, rows*k);
+  best = talloc(int, rows*k);
+  cur = talloc(int, k+rows);
+
+  /* Start from x = 0..rows-1 and y = rows..rows+k-1 */
+  for (i = 0; i < rows; i++) x[i] = i;
+  for (j = 0; j < k; j++) y[j] = rows + j;
+  best_cost = build(x, y, best);
+
+  for (it = 0; it < iters; it++) {
+    memcpy(cur, x, sizeof(int)*rows);
+    memcpy(cur+rows, y, sizeof(int)*k);
+    i = (int) (MOA_Random_32() % (uint32_t) (k+rows));
+    do {
+      v = random_element();
+    } while (used(cur, k+rows, v));
+    cur[i] = v;
+    cost = build(cur, cur+rows, a);
+    if (cost <= best_cost) {
+      best_cost = cost;
+      memcpy(x, cur, sizeof(int)*rows);
+      memcpy(y, cur+rows, sizeof(int)*k);
+      memcpy(best, a, sizeof(int)*rows*k);
+    }
+  }
+
+  /* Cheapest rows first, after the all-ones row */
+  for (i = 2; i < rows; i++) {
+    memcpy(cur, best + i*k, sizeof(int)*k);
+    order_cost = row_cost(cur);
+    for (j = i; j > 1 && row_cost(best + (j-1)*k) > order_cost; j--) memcpy(best + j*k, best + (j-1)*k, sizeof(int)*k);
+    memcpy(best + j*k, cur, sizeof(int)*k);
+  }
+
+  printf("/* matrix_search -k %d -m %d -n %d -w %d -o %s -i %d -x %u\n", k, m, m_new, w,
+         (cost_type == MS_XORS) ? "xors" : "mults", iters, seed);
+  printf("   rows 0-%d: reed_sol_vandermonde_coding_matrix(), rows 0-%d: reed_sol_vandermonde_decoding_matrix()\n",
+         m-1, rows-1);
+  report("found", best, m, patterns);
+  bad = 0;
+  if (check) {
+    if (k == 24 && m <= 6 && rows <= 12) {
+      builtin = reed_sol_vandermonde_decoding_matrix(k, m, rows, w);
+      report("built-in", builtin, m, patterns);
+      free(builtin);
+    } else {
+      printf("   built-in: typed for k=24, m at most 6 and at most 12 rows only\n");
+    }
+    bad = prefix_mismatches();
+    if (bad == 0) printf("   built-in: decoding matrices start with the coding matrix for m=1-%d\n", rows);
+  }
+  printf("*/\n");
+
+  for (j = 0; j < k; j++) {
+    for (i = 0; i < rows; i++) {
+      if (i == 0) printf("vdm[%d]=%d;\n", j, best[j]);
+      else if (j == 0) printf("vdm[%d*%d]=%d;\n", k, i, best[i*k]);
+      else printf("vdm[%d*%d+%d]=%d;\n", k, i, j, best[i*k+j]);
+    }
+    printf("\n");
+  }
+
+  free(x);
+  free(y);
+  free(a);
+  free(best);
+  free(cur);
+  free(ones_table);
+  return (bad > 0) ? 1 : 0;
+}
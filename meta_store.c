@@ -0,0 +1,432 @@
+/* meta_store.c - binary per-node object metadata index.
+ *
+ * Layout of the index file:
+ *
+ *   [ header, padded to META_HEADER_SIZE ]
+ *   [ slot 0 ][ slot 1 ] ... [ slot nslots-1 ]
+ *
+ * Each slot is two struct meta_record copies.  The table is open addressed
+ * with linear probing on an FNV-1a hash of the object name, and it is
+ * rebuilt into a file twice the size (then renamed over the old one) once
+ * it is 70% full.  Writers serialize on flock(); readers just map the file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "meta_store.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define META_MAGIC          "SWMETA01"
+#define META_VERSION        2
+#define META_HEADER_SIZE    4096
+#define META_INITIAL_SLOTS  1024
+
+struct meta_header {
+  char     magic[8];
+  uint32_t version;
+  uint32_t slot_size;
+  uint64_t nslots;
+  uint64_t count;
+};
+
+struct meta_slot {
+  struct meta_record copy[2];
+};
+
+struct meta_store {
+  char     *path;
+  int       fd;
+  int       writable;
+  ino_t     ino;
+  size_t    maplen;
+  char     *map;
+  struct meta_header *hdr;
+  struct meta_slot   *slots;
+};
+
+static uint32_t crc_table[256];
+static int crc_table_ready = 0;
+
+uint32_t meta_store_crc32(uint32_t crc, const void *buf, uint64_t len)
+{
+  const unsigned char *p;
+  uint32_t c;
+  int i, j;
+
+  if (!crc_table_ready) {
+    for (i = 0; i < 256; i++) {
+      c = i;
+      for (j = 0; j < 8; j++) c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+      crc_table[i] = c;
+    }
+    crc_table_ready = 1;
+  }
+
+  p = (const unsigned char *) buf;
+  crc = ~crc;
+  while (len-- > 0) crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static uint64_t name_hash(const char *name)
+{
+  uint64_t h;
+
+  h = 14695981039346656037ULL;
+  while (*name != '\0') {
+    h ^= (unsigned char) *name++;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static uint32_t record_crc(const struct meta_record *rec)
+{
+  return meta_store_crc32(0, &rec->seq, sizeof(*rec) - sizeof(rec->crc));
+}
+
+/* Returns the newest valid copy in the slot, or NULL. */
+
+static const struct meta_record *slot_current(const struct meta_slot *s)
+{
+  const struct meta_record *best;
+  int i;
+
+  best = NULL;
+  for (i = 0; i < 2; i++) {
+    if (s->copy[i].seq == 0 || s->copy[i].crc != record_crc(&s->copy[i])) continue;
+    if (best == NULL || s->copy[i].seq > best->seq) best = &s->copy[i];
+  }
+  return best;
+}
+
+static int slot_empty(const struct meta_slot *s)
+{
+  return s->copy[0].seq == 0 && s->copy[1].seq == 0;
+}
+
+static void store_unmap(meta_store_t *ms)
+{
+  if (ms->map != NULL) munmap(ms->map, ms->maplen);
+  if (ms->fd >= 0) close(ms->fd);
+  ms->map = NULL;
+  ms->fd = -1;
+}
+
+static int store_init_file(int fd, uint64_t nslots)
+{
+  struct meta_header hdr;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, META_MAGIC, 8);
+  hdr.version = META_VERSION;
+  hdr.slot_size = sizeof(struct meta_slot);
+  hdr.nslots = nslots;
+  hdr.count = 0;
+
+  if (ftruncate(fd, META_HEADER_SIZE + nslots * sizeof(struct meta_slot)) != 0) return -1;
+  if (pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) return -1;
+  return 0;
+}
+
+static int store_map(meta_store_t *ms)
+{
+  struct stat st;
+  int flags;
+
+  flags = ms->writable ? O_RDWR | O_CREAT : O_RDONLY;
+  ms->fd = open(ms->path, flags, 0644);
+  if (ms->fd < 0) return -1;
+
+  if (fstat(ms->fd, &st) != 0) { store_unmap(ms); return -1; }
+  if (st.st_size == 0) {
+    if (!ms->writable || flock(ms->fd, LOCK_EX) != 0) { store_unmap(ms); return -1; }
+    if (fstat(ms->fd, &st) == 0 && st.st_size == 0 && store_init_file(ms->fd, META_INITIAL_SLOTS) != 0) {
+      flock(ms->fd, LOCK_UN);
+      store_unmap(ms);
+      return -1;
+    }
+    flock(ms->fd, LOCK_UN);
+    if (fstat(ms->fd, &st) != 0) { store_unmap(ms); return -1; }
+  }
+  ms->ino = st.st_ino;
+  ms->maplen = st.st_size;
+
+  ms->map = mmap(NULL, ms->maplen, ms->writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                 MAP_SHARED, ms->fd, 0);
+  if (ms->map == MAP_FAILED) {
+    ms->map = NULL;
+    store_unmap(ms);
+    return -1;
+  }
+  ms->hdr = (struct meta_header *) ms->map;
+  ms->slots = (struct meta_slot *) (ms->map + META_HEADER_SIZE);
+
+  if (memcmp(ms->hdr->magic, META_MAGIC, 8) != 0 || ms->hdr->version != META_VERSION ||
+      ms->hdr->slot_size != sizeof(struct meta_slot) ||
+      ms->maplen < META_HEADER_SIZE + ms->hdr->nslots * sizeof(struct meta_slot)) {
+    fprintf(stderr, "meta_store: %s is not a valid metadata index\n", ms->path);
+    store_unmap(ms);
+    return -1;
+  }
+  return 0;
+}
+
+/* Another writer may have grown the table and renamed a new file over
+   ours; if so, map the new one. */
+
+static int store_refresh(meta_store_t *ms)
+{
+  struct stat st;
+
+  if (stat(ms->path, &st) == 0 && st.st_ino == ms->ino) return 0;
+  store_unmap(ms);
+  return store_map(ms);
+}
+
+meta_store_t *meta_store_open(const char *path, int writable)
+{
+  meta_store_t *ms;
+
+  ms = talloc(meta_store_t, 1);
+  if (ms == NULL) return NULL;
+  memset(ms, 0, sizeof(*ms));
+  ms->fd = -1;
+  ms->writable = writable;
+  ms->path = strdup(path);
+  if (ms->path == NULL || store_map(ms) != 0) {
+    free(ms->path);
+    free(ms);
+    return NULL;
+  }
+  return ms;
+}
+
+void meta_store_close(meta_store_t *ms)
+{
+  if (ms == NULL) return;
+  store_unmap(ms);
+  free(ms->path);
+  free(ms);
+}
+
+static struct meta_slot *store_find(meta_store_t *ms, const char *name, int *found)
+{
+  const struct meta_record *cur;
+  struct meta_slot *s;
+  uint64_t i, mask, n;
+
+  mask = ms->hdr->nslots - 1;
+  i = name_hash(name) & mask;
+  for (n = 0; n < ms->hdr->nslots; n++) {
+    s = &ms->slots[i];
+    if (slot_empty(s)) {
+      *found = 0;
+      return s;
+    }
+    cur = slot_current(s);
+    if (cur != NULL && strncmp(cur->name, name, META_NAME_MAX) == 0) {
+      *found = 1;
+      return s;
+    }
+    i = (i + 1) & mask;
+  }
+  *found = 0;
+  return NULL;
+}
+
+int meta_store_get(meta_store_t *ms, const char *name, struct meta_record *rec)
+{
+  const struct meta_record *cur;
+  struct meta_slot *s;
+  int found;
+
+  if (strlen(name) >= META_NAME_MAX) return -1;
+  if (store_refresh(ms) != 0) return -1;
+  s = store_find(ms, name, &found);
+  if (s == NULL || !found) return -1;
+  cur = slot_current(s);
+  if (cur == NULL) return -1;
+  memcpy(rec, cur, sizeof(*rec));
+  return 0;
+}
+
+static int store_write_slot(struct meta_slot *s, struct meta_record *rec)
+{
+  const struct meta_record *cur;
+  struct meta_record *dst;
+  char *page;
+  long pagesize;
+
+  cur = slot_current(s);
+  if (cur == NULL) {
+    dst = &s->copy[0];
+    rec->seq = (s->copy[0].seq > s->copy[1].seq ? s->copy[0].seq : s->copy[1].seq) + 1;
+  } else {
+    dst = (cur == &s->copy[0]) ? &s->copy[1] : &s->copy[0];
+    rec->seq = cur->seq + 1;
+  }
+  rec->crc = record_crc(rec);
+  memcpy(dst, rec, sizeof(*rec));
+
+  pagesize = sysconf(_SC_PAGESIZE);
+  page = (char *) ((uintptr_t) dst & ~(uintptr_t) (pagesize - 1));
+  return msync(page, ((char *) (dst + 1)) - page, MS_SYNC);
+}
+
+/* fsync of the directory holding path, so that a rename() into it
+   survives a crash */
+static int sync_dir(const char *path)
+{
+  char *dir, *slash;
+  int fd, rv;
+
+  dir = strdup(path);
+  if (dir == NULL) return -1;
+  slash = strrchr(dir, '/');
+  if (slash == NULL) strcpy(dir, ".");
+  else if (slash == dir) slash[1] = '\0';
+  else *slash = '\0';
+  fd = open(dir, O_RDONLY | O_DIRECTORY);
+  free(dir);
+  if (fd < 0) return -1;
+  rv = fsync(fd);
+  close(fd);
+  return rv;
+}
+
+/* Rebuilds the table with twice the slots into path.tmp and renames it
+   over the index.  Called with the lock held. */
+
+static int store_grow(meta_store_t *ms)
+{
+  const struct meta_record *cur;
+  struct meta_header *nhdr;
+  struct meta_slot *nslots_p, *s;
+  uint64_t nslots, i, j, mask;
+  size_t len;
+  char *tmp, *map;
+  int fd, rv;
+
+  nslots = ms->hdr->nslots * 2;
+  len = META_HEADER_SIZE + nslots * sizeof(struct meta_slot);
+
+  tmp = talloc(char, strlen(ms->path) + 5);
+  if (tmp == NULL) return -1;
+  sprintf(tmp, "%s.tmp", ms->path);
+
+  fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || store_init_file(fd, nslots) != 0) {
+    if (fd >= 0) close(fd);
+    free(tmp);
+    return -1;
+  }
+  map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    close(fd);
+    unlink(tmp);
+    free(tmp);
+    return -1;
+  }
+  nhdr = (struct meta_header *) map;
+  nslots_p = (struct meta_slot *) (map + META_HEADER_SIZE);
+  mask = nslots - 1;
+
+  for (i = 0; i < ms->hdr->nslots; i++) {
+    cur = slot_current(&ms->slots[i]);
+    if (cur == NULL) continue;
+    j = name_hash(cur->name) & mask;
+    while (!slot_empty(&nslots_p[j])) j = (j + 1) & mask;
+    s = &nslots_p[j];
+    memcpy(&s->copy[0], cur, sizeof(*cur));
+    nhdr->count++;
+  }
+
+  if (msync(map, len, MS_SYNC) != 0 || fsync(fd) != 0 || rename(tmp, ms->path) != 0) {
+    munmap(map, len);
+    close(fd);
+    unlink(tmp);
+    free(tmp);
+    return -1;
+  }
+  munmap(map, len);
+  close(fd);
+  free(tmp);
+  rv = sync_dir(ms->path);
+
+  /* Dropping the old descriptor also drops our lock */
+  store_unmap(ms);
+  if (store_map(ms) != 0) return -1;
+  return rv;
+}
+
+/* Takes the writer lock on the file currently at ms->path. */
+
+static int store_lock(meta_store_t *ms)
+{
+  struct stat st;
+
+  for (;;) {
+    if (store_refresh(ms) != 0) return -1;
+    if (flock(ms->fd, LOCK_EX) != 0) return -1;
+    if (stat(ms->path, &st) == 0 && st.st_ino == ms->ino) return 0;
+    flock(ms->fd, LOCK_UN);
+  }
+}
+
+int meta_store_put(meta_store_t *ms, struct meta_record *rec)
+{
+  struct meta_slot *s;
+  int found, rv;
+
+  if (!ms->writable) return -1;
+  if (memchr(rec->name, '\0', META_NAME_MAX) == NULL) return -1;
+  if (store_lock(ms) != 0) return -1;
+
+  s = store_find(ms, rec->name, &found);
+  if (!found && (s == NULL || (ms->hdr->count + 1) * 10 > ms->hdr->nslots * 7)) {
+    if (store_grow(ms) != 0) {
+      if (ms->fd >= 0) flock(ms->fd, LOCK_UN);
+      return -1;
+    }
+    if (store_lock(ms) != 0) return -1;
+    s = store_find(ms, rec->name, &found);
+  }
+  if (s == NULL) {
+    flock(ms->fd, LOCK_UN);
+    return -1;
+  }
+
+  rv = store_write_slot(s, rec);
+  if (rv == 0 && !found) {
+    ms->hdr->count++;
+    msync(ms->map, META_HEADER_SIZE, MS_SYNC);
+  }
+  flock(ms->fd, LOCK_UN);
+  return rv;
+}
+
+int meta_store_iterate(meta_store_t *ms, int (*fn)(const struct meta_record *rec, void *arg), void *arg)
+{
+  const struct meta_record *cur;
+  uint64_t i;
+  int rv;
+
+  if (store_refresh(ms) != 0) return -1;
+  for (i = 0; i < ms->hdr->nslots; i++) {
+    cur = slot_current(&ms->slots[i]);
+    if (cur == NULL) continue;
+    rv = fn(cur, arg);
+    if (rv != 0) return rv;
+  }
+  return 0;
+}
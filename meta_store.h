@@ -0,0 +1,67 @@
+/* meta_store.h - binary per-node object metadata index.
+ *
+ * Replaces the per-object Coding/<name>_meta.txt text files with one
+ * mmap-able index file.  The file is a page-sized header followed by an
+ * open-addressed hash table of fixed-size slots.  Every slot holds two
+ * copies of a record; a writer always overwrites the older copy, so a
+ * reader that validates the checksum and picks the higher sequence number
+ * sees either the old or the new record, never a torn one.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define META_STORE_FILE       "Coding/swifter.meta"
+#define META_NAME_MAX         128
+#define META_EXT_MAX          32
+#define META_TECH_MAX         16
+#define META_MAX_FRAGMENTS    256
+
+/* One object.  Fragment indices are 0..k-1 for data, k..k+m_total-1 for
+   parity; location[] holds the node number each fragment lives on. */
+
+struct meta_record {
+  uint32_t crc;                        /* crc32 of everything after this field */
+  uint32_t seq;                        /* 0 means the copy is unused */
+  char     name[META_NAME_MAX];        /* object key (file name without extension) */
+  char     extension[META_EXT_MAX];
+  char     technique[META_TECH_MAX];
+  int64_t  origsize;                   /* size before padding */
+  int64_t  fragment_size;              /* bytes in each fragment */
+  int32_t  k, m, w;                    /* m is the parity count written at encode time */
+  int32_t  packetsize, buffersize;
+  int32_t  tech, readins, blocksize;
+  int32_t  m_total;                    /* parity fragments currently present */
+  int32_t  generation;                 /* 0 = as encoded, +1 per scale-out */
+  int32_t  nfragments;                 /* k + m_total */
+  int32_t  store;                      /* enum frag_store_kind holding the fragments */
+  uint16_t location[META_MAX_FRAGMENTS];
+};
+
+typedef struct meta_store meta_store_t;
+
+/* Opens (and with writable != 0, creates) the index at path. */
+extern meta_store_t *meta_store_open(const char *path, int writable);
+extern void meta_store_close(meta_store_t *ms);
+
+/* Returns 0 and fills rec if name is present, -1 otherwise.  Names of
+   META_NAME_MAX characters or more are never present. */
+extern int meta_store_get(meta_store_t *ms, const char *name, struct meta_record *rec);
+
+/* Inserts or atomically replaces the record keyed by rec->name.
+   rec->crc and rec->seq are filled in by the store.  Returns 0 or -1. */
+extern int meta_store_put(meta_store_t *ms, struct meta_record *rec);
+
+/* Calls fn on every live record until fn returns non-zero. */
+extern int meta_store_iterate(meta_store_t *ms, int (*fn)(const struct meta_record *rec, void *arg), void *arg);
+
+extern uint32_t meta_store_crc32(uint32_t crc, const void *buf, uint64_t len);
+
+#ifdef __cplusplus
+}
+#endif
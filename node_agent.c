@@ -0,0 +1,373 @@
+/* node_agent.c - serves one node's fragments to the encoder and decoder.
+ *
+ *   node_agent <node-id> [unix:<path>|tcp:<host>:<port>]
+ *
+ * The address defaults to the node's agent= entry in the placement map.
+ * Several agents can run on one machine, one per /mnt/nodeN, to stand in
+ * for a cluster.  Each connection is served by its own child process; the
+ * fragment stores coordinate between processes the same way they do for
+ * concurrent encoders.  See transport.h for the protocol.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "frag_store.h"
+#include "placement.h"
+#include "transport.h"
+#include "elastic.h"
+#include "instr.h"
+#include "buf_pool.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+static int my_node;
+static struct placement *pl;
+static frag_store_t *stores[FRAG_STORE_SEGMENT+1];
+
+/* Scratch buffers from the pool, grown as requests need them */
+static char **bufs;
+static int64_t *buf_len;
+static int nbufs;
+
+/* Connection to the last agent a partial parity was sent to */
+static int dest_fd = -1;
+static char dest_addr[TRANSPORT_ADDR_MAX];
+
+/* Plan of the last partial parity; the encoder sends every read-in of a
+   new row in turn, so the next request usually reuses it */
+static elastic_partial_t *plan;
+static int plan_w, plan_packetsize, plan_nsrc;
+static int *plan_coefs;
+
+static frag_store_t *store_get(int kind)
+{
+  if (kind < 0 || kind > FRAG_STORE_SEGMENT) return NULL;
+  if (stores[kind] == NULL) stores[kind] = frag_store_open(kind, pl);
+  return stores[kind];
+}
+
+static char *buf_get(int i, int64_t len)
+{
+  char **nb;
+  int64_t *nl;
+  int j;
+
+  if (i >= nbufs) {
+    nb = (char **) realloc(bufs, sizeof(char *) * (i+1));
+    nl = (int64_t *) realloc(buf_len, sizeof(int64_t) * (i+1));
+    if (nb == NULL || nl == NULL) {
+      fprintf(stderr, "node_agent: out of memory\n");
+      exit(1);
+    }
+    for (j = nbufs; j <= i; j++) {
+      nb[j] = NULL;
+      nl[j] = 0;
+    }
+    bufs = nb;
+    buf_len = nl;
+    nbufs = i+1;
+  }
+  if (buf_len[i] < len) {
+    buf_pool_put(bufs[i]);
+    bufs[i] = buf_pool_get(len);
+    if (bufs[i] == NULL) {
+      fprintf(stderr, "node_agent: out of memory\n");
+      exit(1);
+    }
+    buf_len[i] = len;
+  }
+  return bufs[i];
+}
+
+static int send_partial(struct transport_msg *msg, char *partial)
+{
+  int tries;
+
+  for (tries = 0; tries < 2; tries++) {
+    if (dest_fd < 0 || strcmp(dest_addr, msg->dest) != 0) {
+      if (dest_fd >= 0) close(dest_fd);
+      strcpy(dest_addr, msg->dest);
+      dest_fd = transport_connect(dest_addr);
+      if (dest_fd < 0) return -ECONNREFUSED;
+    }
+    if (transport_put(dest_fd, msg->store, msg->dest_node, msg->key, msg->offset, partial, msg->len) == msg->len) {
+      return 0;
+    }
+    /* The cached connection may have gone stale; retry once on a fresh one */
+    close(dest_fd);
+    dest_fd = -1;
+  }
+  return -EIO;
+}
+
+static elastic_partial_t *plan_get(struct transport_msg *msg, int *coefs)
+{
+  if (plan != NULL && plan_w == msg->w && plan_packetsize == msg->packetsize && plan_nsrc == msg->nsrc &&
+      memcmp(plan_coefs, coefs, sizeof(int) * msg->nsrc) == 0) {
+    return plan;
+  }
+  elastic_partial_free(plan);
+  free(plan_coefs);
+  plan = elastic_partial_new(msg->w, msg->packetsize, msg->nsrc, coefs);
+  plan_coefs = talloc(int, msg->nsrc);
+  if (plan == NULL || plan_coefs == NULL) {
+    elastic_partial_free(plan);
+    free(plan_coefs);
+    plan = NULL;
+    plan_coefs = NULL;
+    return NULL;
+  }
+  memcpy(plan_coefs, coefs, sizeof(int) * msg->nsrc);
+  plan_w = msg->w;
+  plan_packetsize = msg->packetsize;
+  plan_nsrc = msg->nsrc;
+  return plan;
+}
+
+/* PARTIAL and AGGREGATE: read the sources, combine them, deliver the result */
+
+static int combine(struct transport_msg *msg, struct transport_msg *reply, struct transport_src *srcs)
+{
+  frag_store_t *fs;
+  elastic_partial_t *ep;
+  uint64_t t;
+  char **src;
+  char *dst;
+  int *coefs;
+  int i, rv;
+
+  fs = store_get(msg->store);
+  if (fs == NULL) return -EINVAL;
+
+  src = talloc(char *, msg->nsrc);
+  coefs = talloc(int, msg->nsrc);
+  if (src == NULL || coefs == NULL) {
+    free(src);
+    free(coefs);
+    return -ENOMEM;
+  }
+
+  rv = 0;
+  t = instr_now();
+  for (i = 0; i < msg->nsrc && rv == 0; i++) {
+    srcs[i].key[FRAG_KEY_MAX-1] = '\0';
+    src[i] = buf_get(i+1, msg->len);
+    coefs[i] = srcs[i].coef;
+    if (fs->read(fs, my_node, srcs[i].key, msg->offset, src[i], msg->len) != msg->len) rv = -ENOENT;
+  }
+  reply->read_ns = instr_now() - t;
+
+  if (rv == 0) {
+    dst = buf_get(0, msg->len);
+    t = instr_now();
+    if (msg->op == XPORT_PARTIAL) {
+      ep = plan_get(msg, coefs);
+      if (ep != NULL) elastic_partial_run(ep, src, dst, msg->len);
+      else rv = -EINVAL;
+    } else {
+      elastic_aggregate(msg->nsrc, src, dst, msg->len);
+    }
+    reply->cal_ns = instr_now() - t;
+  }
+
+  if (rv == 0) {
+    t = instr_now();
+    if (msg->op == XPORT_PARTIAL) {
+      rv = send_partial(msg, dst);
+    } else if (fs->write(fs, my_node, msg->key, msg->offset, dst, msg->len) != msg->len) {
+      rv = -EIO;
+    }
+    reply->io_ns = instr_now() - t;
+  }
+
+  free(src);
+  free(coefs);
+  return rv;
+}
+
+/* Answers a GET straight from the file holding the fragment.  Returns 0
+   once the reply is on its way, 1 if the caller should copy instead, and
+   -1 if the connection broke part way. */
+
+static int send_located(int fd, frag_store_t *fs, struct transport_msg *msg, struct transport_msg *reply)
+{
+  int64_t file_offset, contig;
+  int ffd, rv;
+
+  if (fs->locate == NULL || msg->len == 0) return 1;
+  ffd = fs->locate(fs, my_node, msg->key, msg->offset, msg->len, &file_offset, &contig);
+  if (ffd < 0) return 1;
+  if (contig != msg->len) {
+    close(ffd);
+    return 1;
+  }
+  reply->payload = msg->len;
+  rv = 0;
+  if (transport_send(fd, reply, NULL) != 0 || transport_send_file(fd, ffd, file_offset, msg->len) != 0) rv = -1;
+  close(ffd);
+  return rv;
+}
+
+static void serve(int fd)
+{
+  struct transport_msg msg, reply;
+  struct transport_src *srcs;
+  frag_store_t *fs;
+  char *payload;
+  int64_t n;
+  int sent, rv;
+
+  srcs = NULL;
+  while (transport_recv(fd, &msg) == 0) {
+    reply = msg;
+    reply.payload = 0;
+    reply.status = 0;
+    payload = NULL;
+    sent = 0;
+
+    /* Read any payload before deciding whether the request is valid, so
+       the stream stays in step even when the request is refused. */
+    if (msg.payload > 0) {
+      if (msg.payload > INT_MAX) break;
+      payload = buf_get(0, msg.payload);
+      if (transport_read_all(fd, payload, msg.payload) != 0) break;
+    }
+
+    fs = store_get(msg.store);
+    if (msg.op != XPORT_PING && msg.node != my_node) {
+      reply.status = -EINVAL;
+    } else if (msg.op != XPORT_PING && fs == NULL) {
+      reply.status = -EINVAL;
+    } else if (msg.len < 0 || msg.len > INT_MAX) {
+      reply.status = -EINVAL;
+    } else {
+      switch (msg.op) {
+        case XPORT_PING:
+          break;
+        case XPORT_PUT:
+          if (msg.payload != msg.len || fs->write(fs, my_node, msg.key, msg.offset, payload, msg.len) != msg.len) {
+            reply.status = -EIO;
+          }
+          break;
+        case XPORT_GET:
+          /* A fragment lying contiguously in one file goes out with sendfile() */
+          rv = send_located(fd, fs, &msg, &reply);
+          if (rv <= 0) {
+            sent = (rv == 0) ? 1 : -1;
+            break;
+          }
+          payload = buf_get(0, msg.len);
+          n = fs->read(fs, my_node, msg.key, msg.offset, payload, msg.len);
+          if (n < 0) {
+            reply.status = -ENOENT;
+          } else {
+            reply.payload = n;
+          }
+          break;
+        case XPORT_SIZE:
+          reply.len = fs->size(fs, my_node, msg.key);
+          if (reply.len < 0) reply.status = -ENOENT;
+          break;
+        case XPORT_SYNC:
+          if (fs->sync(fs) != 0) reply.status = -EIO;
+          break;
+        case XPORT_DELETE:
+          if (fs->remove(fs, my_node, msg.key) != 0) reply.status = -ENOENT;
+          break;
+        case XPORT_PARTIAL:
+        case XPORT_AGGREGATE:
+          if (msg.nsrc <= 0 || msg.payload != (int64_t) msg.nsrc * (int64_t) sizeof(struct transport_src)) {
+            reply.status = -EINVAL;
+            break;
+          }
+          /* A bitmatrix partial covers whole packet groups */
+          if (msg.op == XPORT_PARTIAL && msg.packetsize != 0 &&
+              (msg.packetsize < 0 || msg.w <= 0 || msg.w > 32 || msg.len % ((int64_t) msg.w * msg.packetsize) != 0)) {
+            reply.status = -EINVAL;
+            break;
+          }
+          /* The source list lives in scratch buffer 0, which combine() reuses */
+          srcs = (struct transport_src *) realloc(srcs, msg.payload);
+          if (srcs == NULL) {
+            reply.status = -ENOMEM;
+            break;
+          }
+          memcpy(srcs, payload, msg.payload);
+          reply.status = combine(&msg, &reply, srcs);
+          break;
+        default:
+          reply.status = -EINVAL;
+          break;
+      }
+    }
+    if (sent) {
+      if (sent < 0) break;
+      continue;
+    }
+    if (transport_send(fd, &reply, payload) != 0) break;
+  }
+  free(srcs);
+}
+
+int main(int argc, char **argv)
+{
+  const char *addr;
+  char root[PLACEMENT_PATH_MAX];
+  int lfd, fd;
+  pid_t pid;
+
+  if (argc < 2 || argc > 3 || sscanf(argv[1], "%d", &my_node) != 1 || my_node <= 0 ||
+      my_node > PLACEMENT_MAX_NODE_ID) {
+    fprintf(stderr, "usage: node_agent <node-id> [unix:<path>|tcp:<host>:<port>]\n");
+    exit(1);
+  }
+
+  pl = placement_load(NULL);
+  if (pl == NULL) {
+    fprintf(stderr, "node_agent: unable to load the placement map\n");
+    exit(1);
+  }
+  addr = (argc == 3) ? argv[2] : placement_node_agent(pl, my_node);
+  if (addr == NULL) {
+    fprintf(stderr, "node_agent: node %d has no agent address\n", my_node);
+    exit(1);
+  }
+
+  lfd = transport_listen(addr);
+  if (lfd < 0) {
+    perror(addr);
+    exit(1);
+  }
+  signal(SIGCHLD, SIG_IGN);
+  signal(SIGPIPE, SIG_IGN);
+
+  placement_node_root(pl, my_node, root);
+  printf("node_agent: node %d (%s) listening on %s\n", my_node, root, addr);
+  fflush(stdout);
+
+  while (1) {
+    fd = accept(lfd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      perror("accept");
+      exit(1);
+    }
+    pid = fork();
+    if (pid == 0) {
+      close(lfd);
+      serve(fd);
+      close(fd);
+      exit(0);
+    }
+    close(fd);
+    if (pid < 0) perror("fork");
+  }
+  return 0;
+}
@@ -0,0 +1,288 @@
+/* placement.c - fragment placement map.  See placement.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frag_store.h"
+#include "placement.h"
+#include "topo.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define DEFAULT_NODES               12
+#define DEFAULT_FRAGMENTS_PER_NODE  3
+
+static const char *role_names[] = { "data", "parity", "scaleout" };
+
+static int find_domain(struct placement *pl, const char *name)
+{
+  int i;
+
+  for (i = 0; i < pl->ndomains; i++) {
+    if (strcmp(pl->domains[i], name) == 0) return i;
+  }
+  snprintf(pl->domains[pl->ndomains], PLACEMENT_NAME_MAX, "%s", name);
+  return pl->ndomains++;
+}
+
+static void placement_default(struct placement *pl)
+{
+  struct placement_node *pn;
+  char name[PLACEMENT_NAME_MAX];
+  int i;
+
+  for (i = 1; i <= DEFAULT_NODES; i++) {
+    pn = &pl->nodes[pl->nnodes++];
+    pn->id = i;
+    pn->role = (i <= 8) ? PLACE_DATA : (i <= 10) ? PLACE_PARITY : PLACE_SCALEOUT;
+    pn->slots = DEFAULT_FRAGMENTS_PER_NODE;
+    sprintf(pn->root, FRAG_STORE_ROOT, i);
+    sprintf(name, "node%d", i);
+    pn->domain = find_domain(pl, name);
+    pn->numa = -1;
+  }
+}
+
+/* Nodes without numa= get the node sysfs reports for their disk */
+static void placement_numa(struct placement *pl)
+{
+  int i;
+
+  for (i = 0; i < pl->nnodes; i++) {
+    if (pl->nodes[i].numa < 0) pl->nodes[i].numa = topo_path_node(pl->nodes[i].root);
+  }
+}
+
+static void conf_error(const char *path, int line, const char *msg)
+{
+  fprintf(stderr, "%s:%d: %s\n", path, line, msg);
+  exit(1);
+}
+
+static void parse_node(struct placement *pl, char *args, const char *path, int line)
+{
+  struct placement_node *pn;
+  char *tok, *save;
+  char name[PLACEMENT_NAME_MAX];
+  char msg[64];
+  int i;
+
+  if (pl->nnodes == PLACEMENT_MAX_NODES) conf_error(path, line, "too many nodes");
+  pn = &pl->nodes[pl->nnodes];
+  memset(pn, 0, sizeof(*pn));
+  pn->domain = -1;
+  pn->numa = -1;
+  pn->role = PLACE_DATA;
+
+  tok = strtok_r(args, " \t", &save);
+  if (tok == NULL || sscanf(tok, "%d", &pn->id) != 1 || pn->id <= 0 || pn->id > PLACEMENT_MAX_NODE_ID) {
+    snprintf(msg, sizeof(msg), "node needs an id from 1 to %d", PLACEMENT_MAX_NODE_ID);
+    conf_error(path, line, msg);
+  }
+  for (i = 0; i < pl->nnodes; i++) {
+    if (pl->nodes[i].id == pn->id) conf_error(path, line, "duplicate node id");
+  }
+  tok = strtok_r(NULL, " \t", &save);
+  if (tok == NULL || strlen(tok) >= PLACEMENT_PATH_MAX) conf_error(path, line, "node needs a root path");
+  strcpy(pn->root, tok);
+
+  while ((tok = strtok_r(NULL, " \t", &save)) != NULL) {
+    if (strncmp(tok, "role=", 5) == 0) {
+      for (i = 0; i < 3 && strcmp(tok+5, role_names[i]) != 0; i++) ;
+      if (i == 3) conf_error(path, line, "role must be data, parity or scaleout");
+      pn->role = i;
+    } else if (strncmp(tok, "domain=", 7) == 0) {
+      if (strlen(tok+7) >= PLACEMENT_NAME_MAX) conf_error(path, line, "domain name too long");
+      pn->domain = find_domain(pl, tok+7);
+    } else if (strncmp(tok, "agent=", 6) == 0) {
+      if (strlen(tok+6) >= PLACEMENT_ADDR_MAX) conf_error(path, line, "agent address too long");
+      strcpy(pn->agent, tok+6);
+    } else if (strncmp(tok, "slots=", 6) == 0) {
+      if (sscanf(tok+6, "%d", &pn->slots) != 1 || pn->slots <= 0) conf_error(path, line, "bad slots");
+    } else if (strncmp(tok, "numa=", 5) == 0) {
+      if (sscanf(tok+5, "%d", &pn->numa) != 1 || pn->numa < 0) conf_error(path, line, "bad numa");
+    } else {
+      conf_error(path, line, "unknown node attribute");
+    }
+  }
+
+  /* A node without a domain is a failure domain of its own */
+  if (pn->domain < 0) {
+    sprintf(name, "node%d", pn->id);
+    pn->domain = find_domain(pl, name);
+  }
+  pl->nnodes++;
+}
+
+struct placement *placement_load(const char *path)
+{
+  struct placement *pl;
+  FILE *f;
+  char buf[512], key[64], val[PLACEMENT_PATH_MAX];
+  char *s, *args;
+  int line, fpn, i;
+
+  pl = talloc(struct placement, 1);
+  if (pl == NULL) return NULL;
+  memset(pl, 0, sizeof(*pl));
+  pl->strategy = PLACE_PACKED;
+  pl->store = -1;
+  sprintf(pl->output, FRAG_STORE_ROOT, 11);
+
+  if (path == NULL) path = getenv("SWIFTER_CONF");
+  if (path == NULL || *path == '\0') path = PLACEMENT_CONF;
+  f = fopen(path, "r");
+  if (f == NULL) {
+    placement_default(pl);
+    placement_numa(pl);
+    return pl;
+  }
+
+  fpn = DEFAULT_FRAGMENTS_PER_NODE;
+  line = 0;
+  while (fgets(buf, sizeof(buf), f) != NULL) {
+    line++;
+    s = strchr(buf, '#');
+    if (s != NULL) *s = '\0';
+    s = buf + strlen(buf);
+    while (s > buf && (s[-1] == '\n' || s[-1] == '\r' || s[-1] == ' ' || s[-1] == '\t')) *--s = '\0';
+    for (s = buf; *s == ' ' || *s == '\t'; s++) ;
+    if (*s == '\0') continue;
+
+    if (strncmp(s, "node", 4) == 0 && (s[4] == ' ' || s[4] == '\t')) {
+      args = s+5;
+      parse_node(pl, args, path, line);
+      continue;
+    }
+    if (sscanf(s, "%63s %159s", key, val) != 2) conf_error(path, line, "expected <directive> <value>");
+    if (strcmp(key, "fragments_per_node") == 0) {
+      if (sscanf(val, "%d", &fpn) != 1 || fpn <= 0) conf_error(path, line, "bad fragments_per_node");
+    } else if (strcmp(key, "strategy") == 0) {
+      if (strcmp(val, "packed") == 0) pl->strategy = PLACE_PACKED;
+      else if (strcmp(val, "spread") == 0) pl->strategy = PLACE_SPREAD;
+      else conf_error(path, line, "strategy must be packed or spread");
+    } else if (strcmp(key, "store") == 0) {
+      pl->store = frag_store_kind_by_name(val);
+      if (pl->store < 0) conf_error(path, line, "unknown store");
+    } else if (strcmp(key, "io") == 0) {
+      if (strcmp(val, "local") == 0) pl->io = PLACE_IO_LOCAL;
+      else if (strcmp(val, "agent") == 0) pl->io = PLACE_IO_AGENT;
+      else conf_error(path, line, "io must be local or agent");
+    } else if (strcmp(key, "output") == 0) {
+      strcpy(pl->output, val);
+    } else {
+      conf_error(path, line, "unknown directive");
+    }
+  }
+  fclose(f);
+
+  if (pl->nnodes == 0) conf_error(path, line, "no nodes");
+  for (i = 0; i < pl->nnodes; i++) {
+    if (pl->nodes[i].slots == 0) pl->nodes[i].slots = fpn;
+  }
+  placement_numa(pl);
+  return pl;
+}
+
+void placement_free(struct placement *pl)
+{
+  free(pl);
+}
+
+/* Places n fragments of one role, appending node ids to location[]. */
+
+static int place_role(struct placement *pl, int role, int n, int *used, int *dom_used, uint16_t *location)
+{
+  struct placement_node *pn;
+  int f, i, best;
+  double load, best_load;
+
+  for (f = 0; f < n; f++) {
+    best = -1;
+    best_load = 0;
+    for (i = 0; i < pl->nnodes; i++) {
+      pn = &pl->nodes[i];
+      if (pn->role != role || used[i] >= pn->slots) continue;
+      if (pl->strategy == PLACE_PACKED) {
+        best = i;
+        break;
+      }
+      load = (double) used[i] / pn->slots;
+      if (best < 0 || dom_used[pn->domain] < dom_used[pl->nodes[best].domain] ||
+          (dom_used[pn->domain] == dom_used[pl->nodes[best].domain] && load < best_load)) {
+        best = i;
+        best_load = load;
+      }
+    }
+    if (best < 0) {
+      fprintf(stderr, "placement: not enough %s slots for %d fragments\n", role_names[role], n);
+      return -1;
+    }
+    used[best]++;
+    dom_used[pl->nodes[best].domain]++;
+    location[f] = pl->nodes[best].id;
+  }
+  return 0;
+}
+
+int placement_place(struct placement *pl, int k, int m, int m_new, uint16_t *location)
+{
+  int *used, *dom_used;
+  int rv;
+
+  used = talloc(int, pl->nnodes);
+  dom_used = talloc(int, pl->ndomains);
+  if (used == NULL || dom_used == NULL) {
+    free(used);
+    free(dom_used);
+    return -1;
+  }
+  memset(used, 0, sizeof(int)*pl->nnodes);
+  memset(dom_used, 0, sizeof(int)*pl->ndomains);
+
+  rv = place_role(pl, PLACE_DATA, k, used, dom_used, location);
+  if (rv == 0) rv = place_role(pl, PLACE_PARITY, m, used, dom_used, location+k);
+  if (rv == 0) rv = place_role(pl, PLACE_SCALEOUT, m_new, used, dom_used, location+k+m);
+
+  free(used);
+  free(dom_used);
+  return rv;
+}
+
+void placement_node_root(struct placement *pl, int id, char *path)
+{
+  int i;
+
+  if (pl != NULL) {
+    for (i = 0; i < pl->nnodes; i++) {
+      if (pl->nodes[i].id == id) {
+        strcpy(path, pl->nodes[i].root);
+        return;
+      }
+    }
+  }
+  sprintf(path, FRAG_STORE_ROOT, id);
+}
+
+const char *placement_node_agent(struct placement *pl, int id)
+{
+  int i;
+
+  if (pl == NULL) return NULL;
+  for (i = 0; i < pl->nnodes; i++) {
+    if (pl->nodes[i].id == id) return (pl->nodes[i].agent[0] == '\0') ? NULL : pl->nodes[i].agent;
+  }
+  return NULL;
+}
+
+int placement_node_numa(struct placement *pl, int id)
+{
+  int i;
+
+  if (pl == NULL) return -1;
+  for (i = 0; i < pl->nnodes; i++) {
+    if (pl->nodes[i].id == id) return pl->nodes[i].numa;
+  }
+  return -1;
+}
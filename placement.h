@@ -0,0 +1,99 @@
+/* placement.h - which node every fragment of an object goes to.
+ *
+ * Placement is read from a small config file (SWIFTER_CONF, or
+ * ./swifter.conf).  Without one, the built-in map is the original layout:
+ * twelve nodes /mnt/node1../mnt/node12, three fragments per node, data on
+ * node1..node8, parity on node9..node10 and scale-out parity on
+ * node11..node12.  Config syntax, one directive per line, '#' comments:
+ *
+ *   fragments_per_node 3
+ *   strategy packed|spread
+ *   store file|segment|mem
+ *   output /mnt/node11
+ *   io local|agent
+ *   node <id> <root> [role=data|parity|scaleout] [domain=<name>] [slots=<n>]
+ *        [agent=unix:<path>|tcp:<host>:<port>] [numa=<n>]
+ *
+ * Node ids run from 1 to PLACEMENT_MAX_NODE_ID; the fragment stores keep
+ * per-node state in tables indexed by id, sized by that limit.
+ *
+ * "packed" fills each node's slots before moving to the next node, in
+ * config order.  "spread" puts each fragment on the node whose failure
+ * domain holds the fewest fragments of the object so far, then the node
+ * with the lowest used/slots ratio, so racks and bigger disks share the
+ * load evenly.
+ *
+ * "mem" keeps fragments in process memory (frag_mem.c); it is for timing
+ * encode and decode without a disk, and nothing outlives the process.
+ *
+ * A node with an agent address is served by a node_agent process (see
+ * transport.h); scale-out then computes partial parities on the agents.
+ * With "io agent" the encoder and decoder also write and read fragments
+ * of such nodes through their agents instead of the local mount.
+ *
+ * numa= names the NUMA node of the socket closest to the node's disk.
+ * Without it the loader asks sysfs about the device under the root (see
+ * topo.h).  Parallel work on a node's fragments runs on that socket.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLACEMENT_CONF        "swifter.conf"
+#define PLACEMENT_MAX_NODES   256
+#define PLACEMENT_MAX_NODE_ID 1023
+#define PLACEMENT_PATH_MAX    160
+#define PLACEMENT_NAME_MAX    32
+#define PLACEMENT_ADDR_MAX    108
+
+enum placement_role { PLACE_DATA = 0, PLACE_PARITY = 1, PLACE_SCALEOUT = 2 };
+enum placement_strategy { PLACE_PACKED = 0, PLACE_SPREAD = 1 };
+enum placement_io { PLACE_IO_LOCAL = 0, PLACE_IO_AGENT = 1 };
+
+struct placement_node {
+  int  id;
+  int  role;
+  int  slots;
+  int  domain;                           /* index into domains[] */
+  int  numa;                             /* NUMA node of the disk, or -1 */
+  char root[PLACEMENT_PATH_MAX];
+  char agent[PLACEMENT_ADDR_MAX];        /* "" if the node has no agent */
+};
+
+struct placement {
+  int  nnodes;
+  int  strategy;
+  int  store;                            /* enum frag_store_kind, or -1 */
+  int  io;                               /* enum placement_io */
+  int  ndomains;
+  char domains[PLACEMENT_MAX_NODES][PLACEMENT_NAME_MAX];
+  char output[PLACEMENT_PATH_MAX];       /* where the decoder writes */
+  struct placement_node nodes[PLACEMENT_MAX_NODES];
+};
+
+/* Loads path, or SWIFTER_CONF / ./swifter.conf when path is NULL, falling
+   back to the built-in map if no file exists.  Exits on a malformed file. */
+extern struct placement *placement_load(const char *path);
+extern void placement_free(struct placement *pl);
+
+/* Fills location[0..k+m+m_new-1]: k data, m parity, then m_new scale-out
+   parity fragments.  Returns 0, or -1 if the roles lack the slots. */
+extern int placement_place(struct placement *pl, int k, int m, int m_new, uint16_t *location);
+
+/* Root directory of node id; nodes missing from the map use /mnt/node<id> */
+extern void placement_node_root(struct placement *pl, int id, char *path);
+
+/* Agent address of node id, or NULL if it has none */
+extern const char *placement_node_agent(struct placement *pl, int id);
+
+/* NUMA node closest to the disk of node id, or -1 if unknown */
+extern int placement_node_numa(struct placement *pl, int id);
+
+#ifdef __cplusplus
+}
+#endif
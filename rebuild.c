@@ -0,0 +1,198 @@
+/* rebuild.c - data rebuild from one inverted matrix.  See rebuild.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jerasure.h"
+#include "rebuild.h"
+#include "slices.h"
+#include "tile_encode.h"
+#include "topo.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+struct rebuild_job {
+  struct rebuild *rb;
+  int             lost;        /* index into rb->lost */
+  char          **ptrs;        /* k sources, then the lost fragment */
+  int             len;
+};
+
+/* Inverts the rows of the survivors not hidden.  Fills dm and ids. */
+static int invert(struct rebuild *rb, int *matrix, int *bitmatrix, int *hide, int *dm)
+{
+  if (bitmatrix != NULL) return jerasure_make_decoding_bitmatrix(rb->k, rb->m, rb->w, bitmatrix, hide, dm, rb->ids);
+  return jerasure_make_decoding_matrix(rb->k, rb->m, rb->w, matrix, hide, dm, rb->ids);
+}
+
+/* Finds nlost surviving parities whose rows, with the surviving data,
+   invert.  Tries combinations of the surviving parities in order, so the
+   first attempt is jerasure's own choice.  Returns 0 with dm and ids
+   filled, or -1. */
+static int choose_survivors(struct rebuild *rb, int *matrix, int *bitmatrix, int *erased, int *dm)
+{
+  int *avail, *pick, *hide;
+  int navail, i, j, rv;
+
+  avail = talloc(int, rb->m);
+  pick = talloc(int, rb->nlost+1);
+  hide = talloc(int, rb->k+rb->m);
+  navail = 0;
+  for (i = 0; i < rb->m; i++) {
+    if (!erased[rb->k+i]) avail[navail++] = i;
+  }
+  rv = -1;
+  if (navail >= rb->nlost) {
+    for (i = 0; i < rb->nlost; i++) pick[i] = i;
+    for (;;) {
+      memcpy(hide, erased, sizeof(int)*(rb->k+rb->m));
+      for (i = 0; i < navail; i++) hide[rb->k+avail[i]] = 1;
+      for (i = 0; i < rb->nlost; i++) hide[rb->k+avail[pick[i]]] = 0;
+      if (invert(rb, matrix, bitmatrix, hide, dm) == 0) {
+        rv = 0;
+        break;
+      }
+      /* Next combination of nlost out of navail */
+      for (i = rb->nlost-1; i >= 0 && pick[i] == navail-rb->nlost+i; i--) ;
+      if (i < 0) break;
+      pick[i]++;
+      for (j = i+1; j < rb->nlost; j++) pick[j] = pick[j-1]+1;
+    }
+  }
+  free(avail);
+  free(pick);
+  free(hide);
+  return rv;
+}
+
+struct rebuild *rebuild_plan(int k, int m, int w, int *matrix, int *bitmatrix, int packetsize, int *erased)
+{
+  struct rebuild *rb;
+  int *dm;
+  int i, kw;
+
+  rb = talloc(struct rebuild, 1);
+  if (rb == NULL) return NULL;
+  memset(rb, 0, sizeof(*rb));
+  rb->k = k;
+  rb->m = m;
+  rb->w = w;
+  rb->packetsize = packetsize;
+  rb->lost = talloc(int, k);
+  rb->ids = talloc(int, k);
+  for (i = 0; i < k; i++) {
+    rb->ids[i] = i;
+    if (erased[i]) rb->lost[rb->nlost++] = i;
+  }
+  rb->align = (bitmatrix != NULL) ? w*packetsize : w*(int) sizeof(long);
+  if (rb->nlost == 0) return rb;
+
+  kw = (bitmatrix != NULL) ? k*w : k;
+  dm = talloc(int, kw*kw);
+  if (dm == NULL || choose_survivors(rb, matrix, bitmatrix, erased, dm) != 0) {
+    free(dm);
+    rebuild_free(rb);
+    return NULL;
+  }
+
+  /* Keep only the rows that produce lost fragments */
+  if (bitmatrix != NULL) {
+    rb->schedules = talloc(int **, rb->nlost);
+    rb->xors = talloc(xor_sched_t *, rb->nlost);
+    for (i = 0; i < rb->nlost; i++) {
+      rb->schedules[i] = jerasure_smart_bitmatrix_to_schedule(k, 1, w, dm + rb->lost[i]*w*kw);
+      rb->xors[i] = xor_sched_new(k, 1, w, packetsize, rb->schedules[i]);
+    }
+  } else {
+    rb->rows = talloc(int *, rb->nlost);
+    rb->tiles = talloc(tile_code_t *, rb->nlost);
+    for (i = 0; i < rb->nlost; i++) {
+      rb->rows[i] = talloc(int, k);
+      memcpy(rb->rows[i], dm + rb->lost[i]*k, sizeof(int)*k);
+      rb->tiles[i] = tile_code_new(k, 1, w, rb->rows[i]);
+    }
+  }
+  free(dm);
+  return rb;
+}
+
+static void rebuild_slice(struct rebuild *rb, int lost, char **ptrs, int len)
+{
+  if (rb->schedules != NULL && rb->xors[lost] != NULL) {
+    xor_sched_encode(rb->xors[lost], ptrs, ptrs+rb->k, len);
+  } else if (rb->schedules != NULL) {
+    jerasure_schedule_encode(rb->k, 1, rb->w, rb->schedules[lost], ptrs, ptrs+rb->k, len, rb->packetsize);
+  } else if (rb->tiles[lost] != NULL) {
+    tile_encode(rb->tiles[lost], ptrs, ptrs+rb->k, len);
+  } else {
+    jerasure_matrix_encode(rb->k, 1, rb->w, rb->rows[lost], ptrs, ptrs+rb->k, len);
+  }
+}
+
+static void rebuild_job_run(void *arg)
+{
+  struct rebuild_job *rj;
+
+  rj = (struct rebuild_job *) arg;
+  rebuild_slice(rj->rb, rj->lost, rj->ptrs, rj->len);
+}
+
+void rebuild_run(struct rebuild *rb, workers_t *wk, char **data, char **coding, int size)
+{
+  struct rebuild_job *jobs, *rj;
+  char **src, **p;
+  int slice, nslices, njobs, i, j, s, off;
+
+  if (rb->nlost == 0) return;
+  src = talloc(char *, rb->k+1);
+  for (j = 0; j < rb->k; j++) src[j] = (rb->ids[j] < rb->k) ? data[rb->ids[j]] : coding[rb->ids[j]-rb->k];
+
+  slice = (wk == NULL) ? size : slices_size(wk, rb->k+1, size, rb->align);
+  nslices = (size + slice - 1) / slice;
+  njobs = nslices * rb->nlost;
+  jobs = talloc(struct rebuild_job, njobs);
+  p = talloc(char *, (long) njobs*(rb->k+1));
+  if (jobs == NULL || p == NULL) {
+    fprintf(stderr, "rebuild_run: out of memory\n");
+    exit(1);
+  }
+
+  /* All jobs of a slice go to one NUMA node, so its sources are read
+     into that node's caches once */
+  for (s = 0; s < nslices; s++) {
+    off = s*slice;
+    for (i = 0; i < rb->nlost; i++) {
+      rj = &jobs[s*rb->nlost+i];
+      rj->rb = rb;
+      rj->lost = i;
+      rj->ptrs = p + (long) (s*rb->nlost+i)*(rb->k+1);
+      rj->len = (size - off < slice) ? size - off : slice;
+      for (j = 0; j < rb->k; j++) rj->ptrs[j] = src[j] + off;
+      rj->ptrs[rb->k] = data[rb->lost[i]] + off;
+      workers_submit(wk, s % topo_nodes(), rebuild_job_run, rj);
+    }
+  }
+  workers_wait(wk);
+  free(p);
+  free(jobs);
+  free(src);
+}
+
+void rebuild_free(struct rebuild *rb)
+{
+  int i;
+
+  if (rb == NULL) return;
+  for (i = 0; rb->rows != NULL && i < rb->nlost; i++) free(rb->rows[i]);
+  for (i = 0; rb->tiles != NULL && i < rb->nlost; i++) tile_code_free(rb->tiles[i]);
+  for (i = 0; rb->schedules != NULL && i < rb->nlost; i++) jerasure_free_schedule(rb->schedules[i]);
+  for (i = 0; rb->xors != NULL && i < rb->nlost; i++) xor_sched_free(rb->xors[i]);
+  free(rb->rows);
+  free(rb->tiles);
+  free(rb->schedules);
+  free(rb->xors);
+  free(rb->lost);
+  free(rb->ids);
+  free(rb);
+}
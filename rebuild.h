@@ -0,0 +1,52 @@
+/* rebuild.h - rebuilding erased data fragments from one inverted matrix.
+ *
+ * rebuild_plan() inverts the decoding matrix once for an erasure pattern
+ * and keeps the rows of the lost data fragments: an nlost x k matrix for
+ * the Reed-Solomon techniques, an XOR schedule of the nlost*w x k*w
+ * bitmatrix rows for the bitmatrix ones.  Rebuilding a stripe is then an
+ * encode of the k surviving fragments it reads into the nlost lost ones,
+ * which rebuild_run() cuts into (lost fragment, column slice) jobs for
+ * the worker pool.  Erased parity is not rebuilt; readers only need data.
+ *
+ * jerasure_make_decoding_matrix() reads the first k survivors.  Not every
+ * set of k rows of the extended Vandermonde matrix is invertible, so when
+ * that choice is singular the plan tries the other choices of surviving
+ * parity before giving up.
+ */
+
+#pragma once
+
+#include "workers.h"
+#include "tile_encode.h"
+#include "xor_sched.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rebuild {
+  int    k, m, w, packetsize;
+  int    nlost;
+  int   *lost;                 /* erased data fragments */
+  int   *ids;                  /* the k fragments read: <k data, >=k parity */
+  int  **rows;                 /* per lost fragment: 1 x k matrix row, ... */
+  tile_code_t **tiles;         /* ... with its blocked kernel, ... */
+  int ***schedules;            /* ... or XOR schedule of its w bitmatrix rows, ... */
+  xor_sched_t **xors;          /* ... with its vector executor */
+  int    align;                /* slice granularity */
+};
+
+/* Plan for the erased[0..k+m-1] pattern.  Pass matrix (m x k) for the
+   Reed-Solomon techniques, or bitmatrix (m*w x k*w) and packetsize for
+   the bitmatrix ones.  NULL if the survivors cannot rebuild the data. */
+extern struct rebuild *rebuild_plan(int k, int m, int w, int *matrix, int *bitmatrix, int packetsize, int *erased);
+
+/* Rebuilds the lost fragments of data[] from data[] and coding[], size
+   bytes each, on the pool if there is one */
+extern void rebuild_run(struct rebuild *rb, workers_t *wk, char **data, char **coding, int size);
+
+extern void rebuild_free(struct rebuild *rb);
+
+#ifdef __cplusplus
+}
+#endif
@@ -52,6 +52,7 @@
 #include "galois.h"
 #include "jerasure.h"
 #include "reed_sol.h"
+#include "gf_kernel.h"
 
 #define talloc(type, num) (type *) malloc(sizeof(type)*(num))
 
@@ -76,6 +77,39 @@ int *reed_sol_r6_coding_matrix(int k, int w)
 }
 
 
+/* The matrices below are typed in for k = 24, 12 rows: an object encoded
+   with up to 6 of them, and the six scale-out adds.  Whether an object
+   uses them depends on the rows it was encoded with only, so its encoder
+   and its decoder agree before and after scale-out. */
+static int hand_typed(int k, int m)
+{
+  return k == 24 && m <= 6;
+}
+
+/* Any other stripe, wide ones in particular, gets the Cauchy matrix
+   y_j / (i + y_j) with y_j = 2^w-1-j: row 0 is all ones, every square
+   submatrix is invertible, and row i does not depend on m, so the m rows
+   an object was encoded with stay the first m rows when it is scaled out
+   and decoded with more.  NULL if k+m > 2^w. */
+static int *wide_coding_matrix(int k, int m, int w)
+{
+  int *matrix;
+  unsigned int y;
+  int i, j;
+
+  if (w != 8 && w != 16 && w != 32) return NULL;
+  if (w < 32 && k + m > (1 << w)) return NULL;
+  matrix = talloc(int, m*k);
+  if (matrix == NULL) return NULL;
+  for (j = 0; j < k; j++) {
+    y = ((w == 32) ? 0xffffffffU : (1U << w) - 1) - j;
+    for (i = 0; i < m; i++) {
+      matrix[i*k+j] = galois_single_divide((int) y, (int) (i ^ y), w);
+    }
+  }
+  return matrix;
+}
+
 // for encoding 
 int *reed_sol_vandermonde_coding_matrix(int k, int m, int w)
 {
@@ -83,6 +117,8 @@ int *reed_sol_vandermonde_coding_matrix(int k, int m, int w)
   int i, j, index;
   int *vdm, *dist;
 
+  if (!hand_typed(k, m)) return wide_coding_matrix(k, m, w);
+
 //whcho added
   /*vdm = reed_sol_big_vandermonde_distribution_matrix(k+m, k, w);
   if (vdm == NULL) return NULL;
@@ -308,12 +344,16 @@ vdm[24*5+23]=7;
 
 
 //for decoding 
-int *reed_sol_vandermonde_decoding_matrix(int k, int m, int w)
+int *reed_sol_vandermonde_decoding_matrix(int k, int m, int rows, int w)
 {
   int tmp;
   int i, j, index;
   int *vdm, *dist;
 
+  if (rows < m) return NULL;
+  if (!hand_typed(k, m)) return wide_coding_matrix(k, rows, w);
+  if (rows > 12) return NULL;
+
 //whcho added
   /*vdm = reed_sol_big_vandermonde_distribution_matrix(k+m, k, w);
   if (vdm == NULL) return NULL;
@@ -325,8 +365,8 @@ int *reed_sol_vandermonde_decoding_matrix(int k, int m, int w)
 
 //whcho added
   //whcho added
-  dist = talloc(int, m*k);
-  vdm = talloc(int, (k+m)*k );
+  dist = talloc(int, rows*k);
+  vdm = talloc(int, (k+rows)*k );
   
   //for (j=0; j<k ;j++){
     //vdm[j]=1;
@@ -676,7 +716,7 @@ vdm[24*11+23]=60;
 
 
   //i = k*k;
-  for (j = 0; j < m*k; j++) {
+  for (j = 0; j < rows*k; j++) {
     dist[j] = vdm[j];
     //i++;
   }
@@ -694,20 +734,10 @@ vdm[24*11+23]=60;
 }
 
 
-static int prim08 = -1;
-static gf_t GF08;
-
+/* w=8 runs on the gf_kernel.h kernel the CPU supports best */
 void reed_sol_galois_w08_region_multby_2(char *region, int nbytes)
 {
-  if (prim08 == -1) {
-    prim08 = galois_single_multiply((1 << 7), 2, 8);
-    if (!gf_init_hard(&GF08, 8, GF_MULT_BYTWO_b, GF_REGION_DEFAULT, GF_DIVIDE_DEFAULT,
-                      prim08, 0, 0, NULL, NULL)) {
-      fprintf(stderr, "Error: Can't initialize the GF for reed_sol_galois_w08_region_multby_2\n");
-      exit(1);
-    }
-  }
-  GF08.multiply_region.w32(&GF08, region, region, 2, nbytes, 0);
+  gf_kernel_multiply(region, 2, nbytes, region, 0);
 }
 
 static int prim16 = -1;
@@ -744,28 +774,16 @@ void reed_sol_galois_w32_region_multby_2(char *region, int nbytes)
 
 int reed_sol_r6_encode(int k, int w, char **data_ptrs, char **coding_ptrs, int size)
 {
-  int i;
-
-  /* First, put the XOR into coding region 0 */
-
-  memcpy(coding_ptrs[0], data_ptrs[0], size);
-
-  for (i = 1; i < k; i++) galois_region_xor(data_ptrs[i], coding_ptrs[0], size);
+  uint32_t prim;
 
-  /* Next, put the sum of (2^j)*Dj into coding region 1 */
+  if (w != 8 && w != 16 && w != 32) return 0;
 
-  memcpy(coding_ptrs[1], data_ptrs[k-1], size);
+  /* One pass over the data: coding region 0 is the XOR, and coding
+     region 1 the sum of (2^j)*Dj by Horner's rule, both built in
+     registers a vector at a time */
 
-  for (i = k-2; i >= 0; i--) {
-    switch (w) {
-      case 8:  reed_sol_galois_w08_region_multby_2(coding_ptrs[1], size); break;
-      case 16: reed_sol_galois_w16_region_multby_2(coding_ptrs[1], size); break;
-      case 32: reed_sol_galois_w32_region_multby_2(coding_ptrs[1], size); break;
-      default: return 0;
-    }
-
-    galois_region_xor(data_ptrs[i], coding_ptrs[1], size);
-  }
+  prim = (uint32_t) galois_single_multiply(1 << (w-1), 2, w);
+  gf_kernel()->r6(k, w, prim, data_ptrs, coding_ptrs[0], coding_ptrs[1], 0, size);
   return 1;
 }
 
@@ -44,7 +44,11 @@ extern "C" {
 #endif
 
 extern int *reed_sol_vandermonde_coding_matrix(int k, int m, int w);
-extern int *reed_sol_vandermonde_decoding_matrix(int k, int m, int w);// whcho added
+/* The first rows rows of the matrix of an object encoded with m coding
+   rows, m of them from reed_sol_vandermonde_coding_matrix(k, m, w) and
+   the rest added by scale-out.  NULL if rows < m or the hand-typed k=24
+   matrix has fewer than rows rows. */
+extern int *reed_sol_vandermonde_decoding_matrix(int k, int m, int rows, int w);// whcho added
 extern int *reed_sol_extended_vandermonde_matrix(int rows, int cols, int w);
 extern int *reed_sol_big_vandermonde_distribution_matrix(int rows, int cols, int w);
 
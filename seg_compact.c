@@ -0,0 +1,63 @@
+/* seg_compact.c - reclaims the space of a segment store.
+ *
+ *   seg_compact [node-id ...]
+ *
+ * The segment store only ever appends: a fragment written again, and
+ * one removed (scale-out removes its partial parities once they are
+ * aggregated), keep their old bytes in the segments.  This rewrites
+ * each node's live extents into new segments with frag_segment_compact()
+ * and deletes the old ones.  Nodes are those of the placement map, or
+ * the ones named.  Stop the node's agent, and any encoder or decoder
+ * using the node, first: the store must not be open elsewhere.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frag_store.h"
+#include "placement.h"
+
+int main(int argc, char **argv)
+{
+  struct placement *pl;
+  frag_store_t *fs;
+  char root[PLACEMENT_PATH_MAX];
+  int i, n, node, failed;
+
+  for (i = 1; i < argc; i++) {
+    if (sscanf(argv[i], "%d", &node) != 1 || node <= 0 || node > PLACEMENT_MAX_NODE_ID) {
+      fprintf(stderr, "usage: seg_compact [node-id ...]\n");
+      exit(1);
+    }
+  }
+
+  pl = placement_load(NULL);
+  if (pl == NULL) {
+    fprintf(stderr, "seg_compact: unable to load the placement map\n");
+    exit(1);
+  }
+  unsetenv("SWIFTER_THROTTLE");          /* compaction needs the store itself */
+  fs = frag_store_open(FRAG_STORE_SEGMENT, pl);
+  if (fs == NULL) {
+    fprintf(stderr, "seg_compact: unable to open the segment store\n");
+    exit(1);
+  }
+
+  failed = 0;
+  n = (argc > 1) ? argc - 1 : pl->nnodes;
+  for (i = 0; i < n; i++) {
+    node = (argc > 1) ? atoi(argv[i+1]) : pl->nodes[i].id;
+    placement_node_root(pl, node, root);
+    if (frag_segment_compact(fs, node) != 0) {
+      fprintf(stderr, "seg_compact: unable to compact node %d (%s)\n", node, root);
+      failed = 1;
+      continue;
+    }
+    printf("seg_compact: node %d (%s) compacted\n", node, root);
+  }
+
+  fs->close(fs);
+  placement_free(pl);
+  return failed;
+}
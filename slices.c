@@ -0,0 +1,103 @@
+/* slices.c - column slices of a stripe on the worker pool.  See slices.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "slices.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define SLICES_PER_THREAD   4
+#define SLICES_MIN          4096
+
+struct slice_job {
+  slices_fn  fn;
+  void      *ctx;
+  char     **ptrs;
+  int        len;
+};
+
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+static long cache_bytes;
+
+static void cache_init(void)
+{
+  char *s;
+
+  s = getenv("SWIFTER_SLICE");
+  if (s != NULL && atol(s) > 0) {
+    cache_bytes = atol(s) << 10;
+    return;
+  }
+  /* Half of L2 leaves room for the multiply tables and the stack */
+  cache_bytes = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+  cache_bytes = sysconf(_SC_LEVEL2_CACHE_SIZE) / 2;
+#endif
+  if (cache_bytes <= 0) cache_bytes = 512 << 10;
+}
+
+int slices_size(workers_t *wk, int nptrs, int size, int align)
+{
+  long slice, share;
+
+  pthread_once(&cache_once, cache_init);
+  slice = cache_bytes / nptrs;
+  share = (long) size / ((long) SLICES_PER_THREAD * workers_threads(wk));
+  if (share < slice) slice = share;
+  if (slice < SLICES_MIN) slice = SLICES_MIN;
+  slice -= slice % align;
+  if (slice < align) slice = align;
+  if (slice > size) slice = size;
+  return (int) slice;
+}
+
+static void slice_job_run(void *arg)
+{
+  struct slice_job *sj;
+
+  sj = (struct slice_job *) arg;
+  sj->fn(sj->ctx, sj->ptrs, sj->len);
+}
+
+void slices_run(workers_t *wk, char **ptrs, int nptrs, int size, int align, slices_fn fn, void *ctx)
+{
+  struct slice_job *jobs;
+  char **p;
+  int slice, nslices, s, i, off;
+
+  if (wk == NULL) {
+    fn(ctx, ptrs, size);
+    return;
+  }
+  slice = slices_size(wk, nptrs, size, align);
+  nslices = (size + slice - 1) / slice;
+  if (nslices <= 1) {
+    fn(ctx, ptrs, size);
+    return;
+  }
+
+  jobs = talloc(struct slice_job, nslices);
+  p = talloc(char *, (long) nslices*nptrs);
+  if (jobs == NULL || p == NULL) {
+    free(jobs);
+    free(p);
+    fn(ctx, ptrs, size);
+    return;
+  }
+  for (s = 0; s < nslices; s++) {
+    off = s*slice;
+    jobs[s].fn = fn;
+    jobs[s].ctx = ctx;
+    jobs[s].ptrs = p + (long) s*nptrs;
+    jobs[s].len = (size - off < slice) ? size - off : slice;
+    for (i = 0; i < nptrs; i++) jobs[s].ptrs[i] = ptrs[i] + off;
+    workers_submit(wk, -1, slice_job_run, &jobs[s]);
+  }
+  workers_wait(wk);
+  free(p);
+  free(jobs);
+}
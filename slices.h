@@ -0,0 +1,37 @@
+/* slices.h - coding a stripe in column slices on the worker pool.
+ *
+ * Erasure coding works column by column: byte range [a, b) of every
+ * output region depends only on bytes [a, b) of the inputs (for the
+ * bitmatrix codes, as long as a and b are multiples of w*packetsize).
+ * A stripe of nptrs regions -- data, then coding -- can therefore be cut
+ * into slices that threads code independently, with output identical to
+ * coding the whole stripe at once.
+ *
+ * A slice is sized so that its nptrs pieces fit in the L2 cache of one
+ * core, and small enough that every thread gets several; the pool hands
+ * slices to whichever threads are free.  SWIFTER_SLICE=<KB> overrides
+ * the cache-derived size.
+ */
+
+#pragma once
+
+#include "workers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* fn codes len bytes at ptrs[0..nptrs-1] */
+typedef void (*slices_fn)(void *ctx, char **ptrs, int len);
+
+/* Slice length for a stripe of nptrs regions of size bytes, a multiple
+   of align.  The last slice of a stripe takes what is left. */
+extern int slices_size(workers_t *wk, int nptrs, int size, int align);
+
+/* Calls fn over the whole stripe in slices and returns when all are
+   done.  Without a pool it is a single call over size bytes. */
+extern void slices_run(workers_t *wk, char **ptrs, int nptrs, int size, int align, slices_fn fn, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,217 @@
+/* tile_encode.c - cache-blocked, register-tiled matrix encode.  See
+   tile_encode.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "galois.h"
+#include "gf_kernel.h"
+#include "jit.h"
+#include "tile_encode.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define TILE_MIN    64
+
+struct tile_code {
+  int      k, m, w;
+  int     *matrix;                 /* m x k copy */
+  gf_rows_t **rows;                /* w=8: each group of TILE_ROWS rows planned for this CPU */
+  jit_code_t **jit;                /* w=8: the group's generated code, or NULL */
+  struct gf16_coef *coefs16;       /* w=16: m x k, for gf_kernel()'s dot16 */
+  int     *order;                  /* w=32: each row's sources by constant */
+  int      tile;                   /* column tile width in bytes */
+};
+
+static pthread_once_t l1_once = PTHREAD_ONCE_INIT;
+static long l1_bytes;
+static long tile_override;
+static int tile_off;
+
+static void l1_init(void)
+{
+  char *s;
+
+  s = getenv("SWIFTER_TILE");
+  if (s != NULL && strcmp(s, "off") == 0) tile_off = 1;
+  if (s != NULL && atol(s) > 0) tile_override = atol(s);
+  l1_bytes = 0;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+  l1_bytes = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+#endif
+  if (l1_bytes <= 0) l1_bytes = 32 << 10;
+}
+
+/* Three quarters of L1 for the k data pieces and the pieces of the rows
+   being built; the product tables take most of the rest */
+static int tile_width(int k)
+{
+  long tile;
+
+  pthread_once(&l1_once, l1_init);
+  tile = (tile_override > 0) ? tile_override : (l1_bytes * 3 / 4) / (k + TILE_ROWS);
+  tile -= tile % TILE_MIN;
+  if (tile < TILE_MIN) tile = TILE_MIN;
+  return (int) tile;
+}
+
+tile_code_t *tile_code_new(int k, int m, int w, int *matrix)
+{
+  tile_code_t *tc;
+  int r;
+
+  if (w != 8 && w != 16 && w != 32) return NULL;
+  pthread_once(&l1_once, l1_init);
+  if (tile_off) return NULL;
+  tc = talloc(tile_code_t, 1);
+  if (tc == NULL) return NULL;
+  tc->k = k;
+  tc->m = m;
+  tc->w = w;
+  tc->tile = tile_width(k);
+  tc->rows = NULL;
+  tc->jit = NULL;
+  tc->coefs16 = NULL;
+  tc->order = NULL;
+  tc->matrix = talloc(int, m*k);
+  if (tc->matrix == NULL) {
+    free(tc);
+    return NULL;
+  }
+  memcpy(tc->matrix, matrix, sizeof(int)*m*k);
+
+  if (w == 8) {
+    tc->rows = talloc(gf_rows_t *, m);
+    tc->jit = talloc(jit_code_t *, m);
+    if (tc->rows == NULL || tc->jit == NULL) {
+      tile_code_free(tc);
+      return NULL;
+    }
+    for (r = 0; r < m; r += TILE_ROWS) {
+      tc->rows[r] = gf_rows_new(k, (m - r < TILE_ROWS) ? m - r : TILE_ROWS, matrix + r*k);
+      if (tc->rows[r] == NULL) {
+        tile_code_free(tc);
+        return NULL;
+      }
+      tc->jit[r] = jit_code_get(k, (m - r < TILE_ROWS) ? m - r : TILE_ROWS, matrix + r*k);
+    }
+  } else if (w == 16) {
+    tc->coefs16 = talloc(struct gf16_coef, m*k);
+    if (tc->coefs16 == NULL) {
+      tile_code_free(tc);
+      return NULL;
+    }
+    for (r = 0; r < m*k; r++) gf16_coef_init(tc->coefs16 + r, matrix[r]);
+  } else {
+    tc->order = talloc(int, m*k);
+    if (tc->order == NULL) {
+      tile_code_free(tc);
+      return NULL;
+    }
+    for (r = 0; r < m; r++) gf_column_order(k, 1, matrix + r*k, tc->order + r*k);
+  }
+  return tc;
+}
+
+void tile_code_free(tile_code_t *tc)
+{
+  int r;
+
+  if (tc == NULL) return;
+  for (r = 0; tc->rows != NULL && r < tc->m; r += TILE_ROWS) gf_rows_free(tc->rows[r]);
+  free(tc->rows);
+  free(tc->jit);
+  free(tc->coefs16);
+  free(tc->order);
+  free(tc->matrix);
+  free(tc);
+}
+
+/* w=32: the scratch tile of rows_wide(), one per thread since a
+   tile_code_t is shared, kept across calls and grown to the widest tile */
+static __thread char *wide_sum;
+static __thread int wide_sum_len;
+
+static char *wide_scratch(int len)
+{
+  if (len > wide_sum_len) {
+    free(wide_sum);
+    wide_sum = talloc(char, len);
+    if (wide_sum == NULL) {
+      fprintf(stderr, "tile_encode: out of memory\n");
+      exit(1);
+    }
+    wide_sum_len = len;
+  }
+  return wide_sum;
+}
+
+/* One row over GF(2^32), with its sources sorted by constant.  0 is
+   skipped, 1 only XORed, and the sources of a run of equal constants are
+   XORed into sum and multiplied once. */
+static void rows_wide(tile_code_t *tc, int r, char **data, char **coding, char *sum, int off, int len)
+{
+  int *order;
+  char *x;
+  int j, c, started, summed;
+
+  order = tc->order + r*tc->k;
+  started = 0;
+  summed = 0;
+  for (j = 0; j < tc->k; j++) {
+    c = tc->matrix[r*tc->k+order[j]];
+    if (c == 0) continue;
+    x = data[order[j]]+off;
+    if (c != 1 && j+1 < tc->k && tc->matrix[r*tc->k+order[j+1]] == c) {
+      if (summed) galois_region_xor(x, sum, len); else memcpy(sum, x, len);
+      summed = 1;
+      continue;
+    }
+    if (summed) {
+      galois_region_xor(x, sum, len);
+      x = sum;
+      summed = 0;
+    }
+    if (c == 1) {
+      if (started) galois_region_xor(x, coding[r]+off, len); else memcpy(coding[r]+off, x, len);
+    } else {
+      galois_w32_region_multiply(x, c, len, coding[r]+off, started);
+    }
+    started = 1;
+  }
+  if (!started) memset(coding[r]+off, 0, len);
+}
+
+void tile_encode(tile_code_t *tc, char **data, char **coding, int size)
+{
+  char *sum;
+  int off, len, r0;
+
+  sum = (tc->w == 32) ? wide_scratch(tc->tile) : NULL;
+
+  for (off = 0; off < size; off += tc->tile) {
+    len = (size - off < tc->tile) ? size - off : tc->tile;
+    if (tc->w == 32) {
+      for (r0 = 0; r0 < tc->m; r0++) rows_wide(tc, r0, data, coding, sum, off, len);
+      continue;
+    }
+    if (tc->w == 16) {
+      for (r0 = 0; r0 < tc->m; r0 += TILE_ROWS) {
+        gf_kernel()->dot16(tc->k, (tc->m - r0 < TILE_ROWS) ? tc->m - r0 : TILE_ROWS, tc->coefs16 + r0*tc->k,
+                           data, coding + r0, off, len, 0);
+      }
+      continue;
+    }
+    for (r0 = 0; r0 < tc->m; r0 += TILE_ROWS) {
+      if (tc->jit[r0] != NULL) {
+        jit_run(tc->jit[r0], data, coding + r0, off, len);
+      } else {
+        gf_rows_run(tc->rows[r0], data, coding + r0, off, len, 0);
+      }
+    }
+  }
+}
@@ -0,0 +1,48 @@
+/* tile_encode.h - cache-blocked, register-tiled matrix encode.
+ *
+ * jerasure_matrix_encode() computes each coding region in its own pass
+ * over all k data regions, so with k=24 and m=12 every data byte is
+ * streamed from memory twelve times.  tile_encode() instead walks the
+ * regions in column tiles sized so that the k data pieces of a tile stay
+ * in L1, and produces the coding pieces of the tile TILE_ROWS rows at a
+ * time with their accumulators in registers.  Each data word then comes
+ * from memory once, and from L1 once per group of rows.
+ *
+ * w=8 and w=16 run on the best gf_kernel.h kernels this CPU has.  w=32
+ * is blocked the same way but multiplies each tile with
+ * galois_w32_region_multiply(), skipping constants of 0, XORing those of
+ * 1, and XORing together the sources of a run of equal constants before
+ * multiplying them once.  Coding regions are byte-for-byte those of
+ * jerasure_matrix_encode().
+ *
+ * A tile_code_t is read-only once built, so threads coding different
+ * slices of a stripe can share one.  SWIFTER_TILE=<bytes> overrides the
+ * tile width derived from the L1 data cache size; SWIFTER_TILE=off makes
+ * tile_code_new() return NULL, so callers fall back to jerasure.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gf_kernel.h"
+
+#define TILE_ROWS   GF_KERNEL_ROWS
+
+typedef struct tile_code tile_code_t;
+
+/* For the m x k matrix over GF(2^w).  NULL if w is not 8, 16 or 32 or
+   the kernel is turned off. */
+extern tile_code_t *tile_code_new(int k, int m, int w, int *matrix);
+
+/* coding[0..m-1] = matrix * data[0..k-1], size bytes each (a multiple
+   of w/8) */
+extern void tile_encode(tile_code_t *tc, char **data, char **coding, int size);
+
+extern void tile_code_free(tile_code_t *tc);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,145 @@
+/* topo.c - NUMA topology from sysfs.  See topo.h. */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+
+#include "topo.h"
+
+#define TOPO_SYS        "/sys/devices/system/node"
+
+/* From <numaif.h>, which comes with libnuma rather than libc */
+#define TOPO_MPOL_PREFERRED   1
+#define TOPO_MPOL_MF_MOVE     (1 << 1)
+
+static pthread_once_t topo_once = PTHREAD_ONCE_INIT;
+static int nnodes = 1;
+static cpu_set_t node_cpus[TOPO_MAX_NODES];
+static __thread int thread_node = -1;
+
+/* Reads a sysfs list such as "0-7,16-23" from path into set.  Returns
+   the highest member, or -1. */
+static int read_list(const char *path, cpu_set_t *set)
+{
+  FILE *f;
+  char buf[1024], *s, *end;
+  long lo, hi, i;
+  int max;
+
+  CPU_ZERO(set);
+  f = fopen(path, "r");
+  if (f == NULL) return -1;
+  if (fgets(buf, sizeof(buf), f) == NULL) buf[0] = '\0';
+  fclose(f);
+
+  max = -1;
+  s = buf;
+  while (*s >= '0' && *s <= '9') {
+    lo = strtol(s, &end, 10);
+    hi = lo;
+    if (*end == '-') hi = strtol(end+1, &end, 10);
+    for (i = lo; i <= hi && i < CPU_SETSIZE; i++) {
+      CPU_SET(i, set);
+      if (i > max) max = i;
+    }
+    if (*end != ',') break;
+    s = end+1;
+  }
+  return max;
+}
+
+static void topo_init(void)
+{
+  cpu_set_t online;
+  char path[128];
+  char *s;
+  int max, i;
+
+  s = getenv("SWIFTER_NUMA");
+  if (s != NULL && strcmp(s, "off") == 0) return;
+  max = read_list(TOPO_SYS "/online", &online);
+  if (max < 1) return;
+  if (max >= TOPO_MAX_NODES) max = TOPO_MAX_NODES-1;
+  for (i = 0; i <= max; i++) {
+    sprintf(path, TOPO_SYS "/node%d/cpulist", i);
+    if (CPU_ISSET(i, &online)) read_list(path, &node_cpus[i]);
+    else CPU_ZERO(&node_cpus[i]);
+  }
+  nnodes = max+1;
+}
+
+int topo_nodes(void)
+{
+  pthread_once(&topo_once, topo_init);
+  return nnodes;
+}
+
+static int read_int(const char *path, int *v)
+{
+  FILE *f;
+  int rv;
+
+  f = fopen(path, "r");
+  if (f == NULL) return -1;
+  rv = (fscanf(f, "%d", v) == 1) ? 0 : -1;
+  fclose(f);
+  return rv;
+}
+
+int topo_path_node(const char *path)
+{
+  /* The whole disk for a partition is its parent directory; NVMe
+     namespaces report through their controller */
+  static const char *tries[] = { "device/numa_node", "../device/numa_node", "device/device/numa_node" };
+  struct stat st;
+  char sys[128];
+  int i, node;
+
+  if (topo_nodes() == 1) return 0;
+  if (stat(path, &st) != 0) return -1;
+  for (i = 0; i < (int) (sizeof(tries)/sizeof(tries[0])); i++) {
+    sprintf(sys, "/sys/dev/block/%u:%u/%s", major(st.st_dev), minor(st.st_dev), tries[i]);
+    if (read_int(sys, &node) == 0) return (node >= 0 && node < nnodes) ? node : -1;
+  }
+  return -1;
+}
+
+int topo_bind_thread(int node)
+{
+  if (topo_nodes() == 1 || node < 0 || node >= nnodes || CPU_COUNT(&node_cpus[node]) == 0) return -1;
+  if (sched_setaffinity(0, sizeof(cpu_set_t), &node_cpus[node]) != 0) return -1;
+  thread_node = node;
+  return 0;
+}
+
+int topo_thread_node(void)
+{
+  return thread_node;
+}
+
+void topo_bind_memory(void *addr, int64_t len, int node)
+{
+  unsigned long mask[TOPO_MAX_NODES/(8*sizeof(unsigned long))+1];
+  uintptr_t start, end, page;
+
+  if (topo_nodes() == 1 || node < 0 || node >= nnodes) return;
+  page = sysconf(_SC_PAGESIZE);
+  start = ((uintptr_t) addr + page - 1) & ~(page - 1);
+  end = ((uintptr_t) addr + len) & ~(page - 1);
+  if (end <= start) return;
+
+  memset(mask, 0, sizeof(mask));
+  mask[node / (8*sizeof(unsigned long))] |= 1UL << (node % (8*sizeof(unsigned long)));
+#ifdef SYS_mbind
+  syscall(SYS_mbind, (void *) start, end - start, TOPO_MPOL_PREFERRED, mask,
+          8*sizeof(mask), TOPO_MPOL_MF_MOVE);
+#endif
+}
@@ -0,0 +1,38 @@
+/* topo.h - which NUMA node a thread, a buffer or a disk belongs to.
+ *
+ * Nodes and their CPUs come from /sys/devices/system/node.  The node of
+ * a disk is the numa_node sysfs reports for the controller of the block
+ * device holding a directory, so /mnt/nodeN resolves to the socket its
+ * HBA or NVMe drive hangs off.  A machine with one node, no sysfs, or
+ * SWIFTER_NUMA=off looks like a single node 0, and binding does nothing.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TOPO_MAX_NODES   64
+
+/* Number of NUMA nodes, at least 1 */
+extern int topo_nodes(void);
+
+/* Node of the disk holding path, or -1 if it cannot be told */
+extern int topo_path_node(const char *path);
+
+/* Pins the calling thread to the CPUs of node.  Returns 0 or -1. */
+extern int topo_bind_thread(int node);
+
+/* Node the calling thread was pinned to, or -1 */
+extern int topo_thread_node(void);
+
+/* Asks for the pages of [addr, addr+len) to live on node.  Best effort:
+   only whole pages are bound, and failures are ignored. */
+extern void topo_bind_memory(void *addr, int64_t len, int node);
+
+#ifdef __cplusplus
+}
+#endif
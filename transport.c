@@ -0,0 +1,501 @@
+/* transport.c - socket transport between the encoder/decoder and node
+   agents.  See transport.h. */
+
+#define _GNU_SOURCE                      /* splice() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
+
+#include "transport.h"
+
+/* Older C libraries lack the zerocopy constants */
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+#define SPLICE_CHUNK   (1 << 20)
+#define ZEROCOPY_WAIT_MS  10000
+
+static struct transport_counters counters;
+
+/* Splits "tcp:host:port" (or "host:port") into host and port */
+static int split_tcp(const char *addr, char *host, char *port)
+{
+  const char *colon;
+
+  if (strncmp(addr, "tcp:", 4) == 0) addr += 4;
+  colon = strrchr(addr, ':');
+  if (colon == NULL || colon == addr || colon - addr >= TRANSPORT_ADDR_MAX) return -1;
+  memcpy(host, addr, colon - addr);
+  host[colon - addr] = '\0';
+  strcpy(port, colon+1);
+  return 0;
+}
+
+static int unix_addr(const char *addr, struct sockaddr_un *sun)
+{
+  if (strlen(addr+5) >= sizeof(sun->sun_path)) return -1;
+  memset(sun, 0, sizeof(*sun));
+  sun->sun_family = AF_UNIX;
+  strcpy(sun->sun_path, addr+5);
+  return 0;
+}
+
+int transport_connect(const char *addr)
+{
+  struct sockaddr_un sun;
+  struct addrinfo hints, *res, *ai;
+  char host[TRANSPORT_ADDR_MAX], port[TRANSPORT_ADDR_MAX];
+  int fd, one;
+
+  if (strncmp(addr, "unix:", 5) == 0) {
+    if (unix_addr(addr, &sun) != 0) return -1;
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *) &sun, sizeof(sun)) != 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  if (split_tcp(addr, host, port) != 0) return -1;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+
+  fd = -1;
+  for (ai = res; ai != NULL; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) continue;
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  if (fd < 0) return -1;
+
+  /* Requests are small and answered one at a time */
+  one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+int transport_listen(const char *addr)
+{
+  struct sockaddr_un sun;
+  struct addrinfo hints, *res;
+  char host[TRANSPORT_ADDR_MAX], port[TRANSPORT_ADDR_MAX];
+  int fd, one;
+
+  if (strncmp(addr, "unix:", 5) == 0) {
+    if (unix_addr(addr, &sun) != 0) return -1;
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    unlink(sun.sun_path);
+    if (bind(fd, (struct sockaddr *) &sun, sizeof(sun)) != 0 || listen(fd, 64) != 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  if (split_tcp(addr, host, port) != 0) return -1;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+  fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd < 0) {
+    freeaddrinfo(res);
+    return -1;
+  }
+  one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if (bind(fd, res->ai_addr, res->ai_addrlen) != 0 || listen(fd, 64) != 0) {
+    freeaddrinfo(res);
+    close(fd);
+    return -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+int transport_read_all(int fd, void *buf, int64_t len)
+{
+  char *p;
+  ssize_t rv;
+
+  p = (char *) buf;
+  while (len > 0) {
+    rv = read(fd, p, len);
+    if (rv < 0 && errno == EINTR) continue;
+    if (rv <= 0) return -1;
+    p += rv;
+    len -= rv;
+  }
+  return 0;
+}
+
+int transport_write_all(int fd, const void *buf, int64_t len)
+{
+  const char *p;
+  ssize_t rv;
+
+  p = (const char *) buf;
+  counters.copy_bytes += len;
+  while (len > 0) {
+    rv = send(fd, p, len, MSG_NOSIGNAL);
+    if (rv < 0 && errno == EINTR) continue;
+    if (rv <= 0) return -1;
+    p += rv;
+    len -= rv;
+  }
+  return 0;
+}
+
+int transport_send(int fd, struct transport_msg *msg, const void *payload)
+{
+  msg->magic = TRANSPORT_MAGIC;
+  if (transport_write_all(fd, msg, sizeof(*msg)) != 0) return -1;
+  if (msg->payload > 0 && payload != NULL && transport_write_all(fd, payload, msg->payload) != 0) return -1;
+  return 0;
+}
+
+void transport_get_counters(struct transport_counters *c)
+{
+  *c = counters;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Zero-copy sends                                                         */
+
+static int zerocopy_enabled(void)
+{
+  static int enabled = -1;
+  char *s;
+
+  if (enabled < 0) {
+    s = getenv("SWIFTER_ZEROCOPY");
+    enabled = (s == NULL || strcmp(s, "0") != 0);
+  }
+  return enabled;
+}
+
+/* Sends buf with MSG_ZEROCOPY if the socket supports it, counting in
+   *nsends the send calls whose completion must be reaped before buf may
+   be reused.  Falls back to copying sends if the kernel refuses. */
+static int send_zerocopy(int fd, const char *buf, int64_t len, int *nsends)
+{
+  ssize_t rv;
+  int one;
+
+  *nsends = 0;
+  one = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) {
+    return transport_write_all(fd, buf, len);
+  }
+  while (len > 0) {
+    rv = send(fd, buf, len, MSG_ZEROCOPY | MSG_NOSIGNAL);
+    if (rv < 0 && errno == EINTR) continue;
+    if (rv < 0 && errno == ENOBUFS) return transport_write_all(fd, buf, len);   /* optmem exhausted */
+    if (rv <= 0) return -1;
+    (*nsends)++;
+    counters.zerocopy_bytes += rv;
+    buf += rv;
+    len -= rv;
+  }
+  return 0;
+}
+
+/* Waits until the kernel reports all nsends zerocopy sends complete */
+static int reap_zerocopy(int fd, int nsends)
+{
+  char control[128];
+  struct msghdr msg;
+  struct cmsghdr *cm;
+  struct sock_extended_err *serr;
+  struct pollfd pfd;
+  int done, waited;
+
+  done = 0;
+  waited = 0;
+  while (done < nsends) {
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN || waited >= ZEROCOPY_WAIT_MS) return -1;
+      /* An empty events mask still reports POLLERR when the queue fills */
+      pfd.fd = fd;
+      pfd.events = 0;
+      poll(&pfd, 1, 100);
+      waited += 100;
+      continue;
+    }
+    for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) continue;
+      serr = (struct sock_extended_err *) CMSG_DATA(cm);
+      if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0) continue;
+      done += serr->ee_data - serr->ee_info + 1;
+      if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) counters.zerocopy_copied++;
+    }
+  }
+  return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+/* File-backed sends                                                       */
+
+static int splice_file(int fd, int file_fd, int64_t file_offset, int64_t len)
+{
+  loff_t off;
+  ssize_t in, out;
+  int pfd[2], rv;
+
+  if (pipe(pfd) != 0) return -1;
+  off = file_offset;
+  rv = 0;
+  while (len > 0 && rv == 0) {
+    in = splice(file_fd, &off, pfd[1], NULL, (len < SPLICE_CHUNK) ? len : SPLICE_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (in < 0 && errno == EINTR) continue;
+    if (in <= 0) {
+      rv = -1;
+      break;
+    }
+    len -= in;
+    while (in > 0) {
+      out = splice(pfd[0], NULL, fd, NULL, in, SPLICE_F_MOVE | SPLICE_F_MORE);
+      if (out < 0 && errno == EINTR) continue;
+      if (out <= 0) {
+        rv = -1;
+        break;
+      }
+      counters.splice_bytes += out;
+      in -= out;
+    }
+  }
+  close(pfd[0]);
+  close(pfd[1]);
+  return rv;
+}
+
+int transport_send_file(int fd, int file_fd, int64_t file_offset, int64_t len)
+{
+  char buf[65536];
+  off_t off;
+  ssize_t rv;
+  int64_t n;
+
+  off = file_offset;
+  while (len > 0) {
+    rv = sendfile(fd, file_fd, &off, len);
+    if (rv < 0 && errno == EINTR) continue;
+    if (rv < 0 && (errno == EINVAL || errno == ENOSYS)) break;
+    if (rv <= 0) return -1;
+    counters.sendfile_bytes += rv;
+    len -= rv;
+  }
+  if (len == 0) return 0;
+
+  /* sendfile() refused this pair of descriptors; try splice(), then copy */
+  if (splice_file(fd, file_fd, off, len) == 0) return 0;
+  while (len > 0) {
+    n = (len < (int64_t) sizeof(buf)) ? len : (int64_t) sizeof(buf);
+    rv = pread(file_fd, buf, n, off);
+    if (rv < 0 && errno == EINTR) continue;
+    if (rv <= 0 || transport_write_all(fd, buf, rv) != 0) return -1;
+    off += rv;
+    len -= rv;
+  }
+  return 0;
+}
+
+int transport_recv(int fd, struct transport_msg *msg)
+{
+  if (transport_read_all(fd, msg, sizeof(*msg)) != 0) return -1;
+  if (msg->magic != TRANSPORT_MAGIC || msg->payload < 0) return -1;
+  msg->key[FRAG_KEY_MAX-1] = '\0';
+  msg->dest[TRANSPORT_ADDR_MAX-1] = '\0';
+  return 0;
+}
+
+void transport_init_msg(struct transport_msg *msg, int op, int store, int node, const char *key, int64_t offset, int64_t len)
+{
+  memset(msg, 0, sizeof(*msg));
+  msg->op = op;
+  msg->store = store;
+  msg->node = node;
+  msg->offset = offset;
+  msg->len = len;
+  if (key != NULL) strncpy(msg->key, key, FRAG_KEY_MAX-1);
+}
+
+/* Reads and drops len bytes of payload, so the next message is in sync */
+static int drain(int fd, int64_t len)
+{
+  char buf[4096];
+  int64_t n;
+
+  for (; len > 0; len -= n) {
+    n = (len < (int64_t) sizeof(buf)) ? len : (int64_t) sizeof(buf);
+    if (transport_read_all(fd, buf, n) != 0) return -1;
+  }
+  return 0;
+}
+
+/* Reads the reply and discards any payload the caller did not ask for */
+static int reply_status(int fd, struct transport_msg *reply)
+{
+  if (transport_recv(fd, reply) != 0) return TRANSPORT_BROKEN;
+  if (drain(fd, reply->payload) != 0) return TRANSPORT_BROKEN;
+  return reply->status;
+}
+
+/* The agent's status as a client call returns it: 0, -1, or
+   TRANSPORT_BROKEN as is */
+static int client_status(int rv)
+{
+  return (rv == 0 || rv == TRANSPORT_BROKEN) ? rv : -1;
+}
+
+int transport_ping(int fd)
+{
+  struct transport_msg msg;
+
+  transport_init_msg(&msg, XPORT_PING, 0, 0, NULL, 0, 0);
+  if (transport_send(fd, &msg, NULL) != 0) return TRANSPORT_BROKEN;
+  return client_status(reply_status(fd, &msg));
+}
+
+int64_t transport_put(int fd, int store, int node, const char *key, int64_t offset, const char *buf, int64_t len)
+{
+  struct transport_msg msg;
+
+  int nsends, rv;
+
+  transport_init_msg(&msg, XPORT_PUT, store, node, key, offset, len);
+  msg.payload = len;
+  if (len < TRANSPORT_ZEROCOPY_MIN || !zerocopy_enabled()) {
+    if (transport_send(fd, &msg, buf) != 0) return TRANSPORT_BROKEN;
+    rv = client_status(reply_status(fd, &msg));
+    return (rv != 0) ? rv : msg.len;
+  }
+
+  /* The reply means the agent has the bytes, so the completions are due
+     by then; reap them whatever the status so buf is free on return. */
+  if (transport_send(fd, &msg, NULL) != 0 || send_zerocopy(fd, buf, len, &nsends) != 0) return TRANSPORT_BROKEN;
+  rv = client_status(reply_status(fd, &msg));
+  if (nsends > 0 && reap_zerocopy(fd, nsends) != 0) return TRANSPORT_BROKEN;
+  return (rv != 0) ? rv : msg.len;
+}
+
+int64_t transport_get(int fd, int store, int node, const char *key, int64_t offset, char *buf, int64_t len)
+{
+  struct transport_msg msg;
+
+  transport_init_msg(&msg, XPORT_GET, store, node, key, offset, len);
+  if (transport_send(fd, &msg, NULL) != 0) return TRANSPORT_BROKEN;
+  if (transport_recv(fd, &msg) != 0) return TRANSPORT_BROKEN;
+
+  /* More than was asked for is dropped, not half read */
+  if (msg.payload > len) return (drain(fd, msg.payload) != 0) ? TRANSPORT_BROKEN : -1;
+  if (transport_read_all(fd, buf, msg.payload) != 0) return TRANSPORT_BROKEN;
+  if (msg.status != 0) return -1;
+  return msg.payload;
+}
+
+int64_t transport_size(int fd, int store, int node, const char *key)
+{
+  struct transport_msg msg;
+  int rv;
+
+  transport_init_msg(&msg, XPORT_SIZE, store, node, key, 0, 0);
+  if (transport_send(fd, &msg, NULL) != 0) return TRANSPORT_BROKEN;
+  rv = client_status(reply_status(fd, &msg));
+  return (rv != 0) ? rv : msg.len;
+}
+
+int transport_sync(int fd, int store, int node)
+{
+  struct transport_msg msg;
+
+  transport_init_msg(&msg, XPORT_SYNC, store, node, NULL, 0, 0);
+  if (transport_send(fd, &msg, NULL) != 0) return TRANSPORT_BROKEN;
+  return client_status(reply_status(fd, &msg));
+}
+
+int transport_delete(int fd, int store, int node, const char *key)
+{
+  struct transport_msg msg;
+
+  if (strlen(key) >= FRAG_KEY_MAX) return -1;
+  transport_init_msg(&msg, XPORT_DELETE, store, node, key, 0, 0);
+  if (transport_send(fd, &msg, NULL) != 0) return TRANSPORT_BROKEN;
+  return client_status(reply_status(fd, &msg));
+}
+
+int transport_partial_start(int fd, int store, int node, int w, int packetsize, int64_t offset, int64_t len,
+                            int nsrc, struct transport_src *srcs,
+                            const char *dest, int dest_node, const char *dest_key)
+{
+  struct transport_msg msg;
+
+  if (strlen(dest) >= TRANSPORT_ADDR_MAX) return -1;
+  transport_init_msg(&msg, XPORT_PARTIAL, store, node, dest_key, offset, len);
+  msg.w = w;
+  msg.packetsize = packetsize;
+  msg.nsrc = nsrc;
+  msg.dest_node = dest_node;
+  strcpy(msg.dest, dest);
+  msg.payload = (int64_t) nsrc * sizeof(struct transport_src);
+  return transport_send(fd, &msg, srcs);
+}
+
+int transport_aggregate_start(int fd, int store, int node, int64_t offset, int64_t len,
+                              int nsrc, struct transport_src *srcs, const char *key)
+{
+  struct transport_msg msg;
+
+  transport_init_msg(&msg, XPORT_AGGREGATE, store, node, key, offset, len);
+  msg.nsrc = nsrc;
+  msg.payload = (int64_t) nsrc * sizeof(struct transport_src);
+  return transport_send(fd, &msg, srcs);
+}
+
+int transport_finish(int fd, struct transport_msg *reply)
+{
+  struct transport_msg msg;
+  int rv;
+
+  memset(&msg, 0, sizeof(msg));
+  rv = reply_status(fd, &msg);
+  if (reply != NULL) *reply = msg;
+  return rv;
+}
@@ -0,0 +1,132 @@
+/* transport.h - moving fragments between nodes over sockets.
+ *
+ * Every node that has "agent=<addr>" in the placement map runs a
+ * node_agent serving its own fragment store.  addr is "unix:<path>" or
+ * "tcp:<host>:<port>".  A request is one struct transport_msg, optionally
+ * followed by msg.payload bytes; the agent answers each request in order
+ * with one transport_msg (status 0 or -errno) and its payload.
+ *
+ * The interesting request is XPORT_PARTIAL: the agent reads the listed
+ * fragments from its own store, multiplies them by their coefficients,
+ * and PUTs the resulting partial parity straight to the agent named in
+ * msg.dest.  The data fragments never leave the node; only the partial
+ * parity crosses the wire.
+ *
+ * Fragment bytes avoid user-space copies where the kernel allows it:
+ * agents answer GET of a file-backed fragment with sendfile() (splice()
+ * through a pipe if sendfile refuses the pair of descriptors), and large
+ * PUT payloads, which are computed buffers such as partial parities or
+ * coding blocks, go out with MSG_ZEROCOPY on TCP sockets.  The PUT does
+ * not return until the kernel has released the buffer, so callers may
+ * reuse it at once.  SWIFTER_ZEROCOPY=0 turns MSG_ZEROCOPY off.
+ *
+ * Messages are sent in host byte order: all nodes are expected to share
+ * one architecture, as they do on a local cluster.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "frag_store.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRANSPORT_MAGIC      0x31585753    /* "SWX1" */
+#define TRANSPORT_ADDR_MAX   108
+#define TRANSPORT_ZEROCOPY_MIN  (16 << 10)   /* smaller sends are cheaper to copy */
+
+enum transport_op {
+  XPORT_PING = 1,
+  XPORT_PUT,         /* payload -> key at offset */
+  XPORT_GET,         /* len bytes of key at offset -> reply payload */
+  XPORT_SIZE,        /* reply len = fragment size, or status -ENOENT */
+  XPORT_SYNC,
+  XPORT_PARTIAL,     /* sum coef*src -> PUT dest_key on dest_node at dest */
+  XPORT_AGGREGATE,   /* XOR of the sources -> key at offset */
+  XPORT_DELETE       /* removes key, or status -ENOENT */
+};
+
+struct transport_msg {
+  uint32_t magic;
+  uint16_t op;
+  int16_t  status;
+  int32_t  store;                        /* enum frag_store_kind */
+  int32_t  node;
+  int32_t  w;                            /* PARTIAL: word size of the field */
+  int32_t  nsrc;                         /* PARTIAL, AGGREGATE: sources in the payload */
+  int64_t  offset;
+  int64_t  len;                          /* fragment bytes addressed */
+  int64_t  payload;                      /* bytes following this header */
+  int64_t  read_ns, cal_ns, io_ns;       /* reply: where the agent spent its time */
+  int32_t  dest_node;
+  int32_t  packetsize;                   /* PARTIAL: bitmatrix codes' packet size, or 0 */
+  char     key[FRAG_KEY_MAX];            /* PARTIAL: key written on dest_node */
+  char     dest[TRANSPORT_ADDR_MAX];
+};
+
+/* Payload of PARTIAL and AGGREGATE: nsrc of these */
+struct transport_src {
+  int32_t coef;                          /* ignored by AGGREGATE */
+  char    key[FRAG_KEY_MAX];
+};
+
+/* Bytes sent by each method, summed over the process */
+struct transport_counters {
+  int64_t copy_bytes;                    /* plain send() */
+  int64_t zerocopy_bytes;                /* send(MSG_ZEROCOPY) */
+  int64_t zerocopy_copied;               /* completions where the kernel copied anyway */
+  int64_t sendfile_bytes;
+  int64_t splice_bytes;
+};
+
+/* Socket setup.  Both return a file descriptor, or -1. */
+extern int transport_connect(const char *addr);
+extern int transport_listen(const char *addr);
+
+extern int transport_read_all(int fd, void *buf, int64_t len);
+extern int transport_write_all(int fd, const void *buf, int64_t len);
+
+/* One message plus msg->payload bytes of payload.  With payload NULL
+   only the header is sent and the caller sends the payload.  0 or -1. */
+extern int transport_send(int fd, struct transport_msg *msg, const void *payload);
+
+/* Sends len bytes of file_fd starting at file_offset.  0 or -1. */
+extern int transport_send_file(int fd, int file_fd, int64_t file_offset, int64_t len);
+
+extern void transport_get_counters(struct transport_counters *c);
+
+/* Reads a message header; the caller reads msg->payload bytes after it. */
+extern int transport_recv(int fd, struct transport_msg *msg);
+
+/* Fills in a request header */
+extern void transport_init_msg(struct transport_msg *msg, int op, int store, int node, const char *key, int64_t offset, int64_t len);
+
+/* Blocking client calls; each returns what the agent replied: bytes
+   moved, size, or 0 on success, and -1 on failure.  TRANSPORT_BROKEN
+   means the connection failed or went out of step part way through a
+   request; nothing more can be sent on it, and the caller should close
+   it.  transport_finish() returns it as well. */
+#define TRANSPORT_BROKEN   (-4096)       /* below every -errno status of an agent */
+extern int transport_ping(int fd);
+extern int64_t transport_put(int fd, int store, int node, const char *key, int64_t offset, const char *buf, int64_t len);
+extern int64_t transport_get(int fd, int store, int node, const char *key, int64_t offset, char *buf, int64_t len);
+extern int64_t transport_size(int fd, int store, int node, const char *key);
+extern int transport_sync(int fd, int store, int node);
+extern int transport_delete(int fd, int store, int node, const char *key);
+
+/* Pipelined calls: send the request to several agents, then collect the
+   replies with transport_finish(), which returns the reply status and
+   copies the reply header into *reply if it is not NULL. */
+extern int transport_partial_start(int fd, int store, int node, int w, int packetsize, int64_t offset, int64_t len,
+                                   int nsrc, struct transport_src *srcs,
+                                   const char *dest, int dest_node, const char *dest_key);
+extern int transport_aggregate_start(int fd, int store, int node, int64_t offset, int64_t len,
+                                     int nsrc, struct transport_src *srcs, const char *key);
+extern int transport_finish(int fd, struct transport_msg *reply);
+
+#ifdef __cplusplus
+}
+#endif
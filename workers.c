@@ -0,0 +1,193 @@
+/* workers.c - NUMA-pinned thread pool.  See workers.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "topo.h"
+#include "workers.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define WORKERS_MAX   1024
+
+struct workers_job {
+  workers_fn          fn;
+  void               *arg;
+  struct workers_job *next;
+};
+
+struct workers_queue {
+  struct workers_job *head, *tail;
+};
+
+struct workers_thread {
+  workers_t *wk;
+  int        node;
+  pthread_t  tid;
+};
+
+struct workers {
+  int                    nthreads;
+  int                    nqueues;         /* one per NUMA node */
+  int                    next_queue;      /* for jobs without a node */
+  int                    pending;         /* submitted and not finished */
+  int                    stopping;
+  pthread_mutex_t        lock;
+  pthread_cond_t         work;
+  pthread_cond_t         done;
+  struct workers_queue  *queues;
+  struct workers_thread *threads;
+};
+
+/* The oldest job of the thread's own node, else of the next node that
+   has one.  Called with the lock held. */
+static struct workers_job *take(workers_t *wk, int node)
+{
+  struct workers_queue *q;
+  struct workers_job *job;
+  int i;
+
+  for (i = 0; i < wk->nqueues; i++) {
+    q = &wk->queues[(node + i) % wk->nqueues];
+    job = q->head;
+    if (job == NULL) continue;
+    q->head = job->next;
+    if (q->head == NULL) q->tail = NULL;
+    return job;
+  }
+  return NULL;
+}
+
+static void *worker_main(void *arg)
+{
+  struct workers_thread *t;
+  struct workers_job *job;
+  workers_t *wk;
+
+  t = (struct workers_thread *) arg;
+  wk = t->wk;
+  topo_bind_thread(t->node);
+
+  pthread_mutex_lock(&wk->lock);
+  for (;;) {
+    job = take(wk, t->node);
+    if (job == NULL) {
+      if (wk->stopping) break;
+      pthread_cond_wait(&wk->work, &wk->lock);
+      continue;
+    }
+    pthread_mutex_unlock(&wk->lock);
+    job->fn(job->arg);
+    free(job);
+    pthread_mutex_lock(&wk->lock);
+    if (--wk->pending == 0) pthread_cond_broadcast(&wk->done);
+  }
+  pthread_mutex_unlock(&wk->lock);
+  return NULL;
+}
+
+workers_t *workers_start(int nthreads)
+{
+  workers_t *wk;
+  char *s;
+  int i;
+
+  if (nthreads <= 0) {
+    s = getenv("SWIFTER_THREADS");
+    nthreads = (s == NULL) ? 1 : atoi(s);
+  }
+  if (nthreads <= 1) return NULL;
+  if (nthreads > WORKERS_MAX) nthreads = WORKERS_MAX;
+
+  wk = talloc(workers_t, 1);
+  if (wk == NULL) return NULL;
+  memset(wk, 0, sizeof(*wk));
+  wk->nqueues = topo_nodes();
+  wk->queues = talloc(struct workers_queue, wk->nqueues);
+  wk->threads = talloc(struct workers_thread, nthreads);
+  if (wk->queues == NULL || wk->threads == NULL) {
+    free(wk->queues);
+    free(wk->threads);
+    free(wk);
+    return NULL;
+  }
+  memset(wk->queues, 0, sizeof(struct workers_queue)*wk->nqueues);
+  pthread_mutex_init(&wk->lock, NULL);
+  pthread_cond_init(&wk->work, NULL);
+  pthread_cond_init(&wk->done, NULL);
+
+  for (i = 0; i < nthreads; i++) {
+    wk->threads[i].wk = wk;
+    wk->threads[i].node = i % wk->nqueues;
+    if (pthread_create(&wk->threads[i].tid, NULL, worker_main, &wk->threads[i]) != 0) break;
+  }
+  wk->nthreads = i;
+  if (i == 0) {
+    workers_stop(wk);
+    return NULL;
+  }
+  return wk;
+}
+
+void workers_submit(workers_t *wk, int node, workers_fn fn, void *arg)
+{
+  struct workers_job *job;
+  struct workers_queue *q;
+
+  if (wk == NULL) {
+    fn(arg);
+    return;
+  }
+  job = talloc(struct workers_job, 1);
+  if (job == NULL) {
+    fn(arg);
+    return;
+  }
+  job->fn = fn;
+  job->arg = arg;
+  job->next = NULL;
+
+  pthread_mutex_lock(&wk->lock);
+  if (node < 0 || node >= wk->nqueues) node = wk->next_queue++ % wk->nqueues;
+  q = &wk->queues[node];
+  if (q->tail == NULL) q->head = job;
+  else q->tail->next = job;
+  q->tail = job;
+  wk->pending++;
+  pthread_cond_broadcast(&wk->work);
+  pthread_mutex_unlock(&wk->lock);
+}
+
+void workers_wait(workers_t *wk)
+{
+  if (wk == NULL) return;
+  pthread_mutex_lock(&wk->lock);
+  while (wk->pending > 0) pthread_cond_wait(&wk->done, &wk->lock);
+  pthread_mutex_unlock(&wk->lock);
+}
+
+int workers_threads(workers_t *wk)
+{
+  return (wk == NULL) ? 1 : wk->nthreads;
+}
+
+void workers_stop(workers_t *wk)
+{
+  int i;
+
+  if (wk == NULL) return;
+  pthread_mutex_lock(&wk->lock);
+  wk->stopping = 1;
+  pthread_cond_broadcast(&wk->work);
+  pthread_mutex_unlock(&wk->lock);
+  for (i = 0; i < wk->nthreads; i++) pthread_join(wk->threads[i].tid, NULL);
+
+  pthread_cond_destroy(&wk->work);
+  pthread_cond_destroy(&wk->done);
+  pthread_mutex_destroy(&wk->lock);
+  free(wk->queues);
+  free(wk->threads);
+  free(wk);
+}
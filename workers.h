@@ -0,0 +1,38 @@
+/* workers.h - a pool of threads pinned to NUMA nodes.
+ *
+ * SWIFTER_THREADS sets the size of the pool; unset or 1 means no pool,
+ * and work submitted to a NULL pool runs on the spot, so callers keep a
+ * single code path.  Threads are dealt out to the NUMA nodes round-robin
+ * and pinned to their node's CPUs.  Every node has its own queue: a job
+ * submitted for a node runs on one of that node's threads, and a thread
+ * whose queue is empty takes work from the other nodes' queues rather
+ * than sit idle.  Jobs submitted for node -1 go to the queues in turn.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct workers workers_t;
+typedef void (*workers_fn)(void *arg);
+
+/* A pool of nthreads threads (SWIFTER_THREADS if nthreads <= 0), or NULL
+   when that is 1 or fewer */
+extern workers_t *workers_start(int nthreads);
+
+/* Runs fn(arg) on a thread of the pool, preferring one on node */
+extern void workers_submit(workers_t *wk, int node, workers_fn fn, void *arg);
+
+/* Returns once every job submitted so far has finished */
+extern void workers_wait(workers_t *wk);
+
+/* Threads in the pool; 1 for NULL */
+extern int workers_threads(workers_t *wk);
+
+extern void workers_stop(workers_t *wk);
+
+#ifdef __cplusplus
+}
+#endif
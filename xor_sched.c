@@ -0,0 +1,160 @@
+/* xor_sched.c - vector executor for the XOR schedules of bitmatrix
+   codes.  See xor_sched.h. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "gf_kernel.h"
+#include "xor_sched.h"
+
+#define talloc(type, num) (type *) malloc(sizeof(type)*(num))
+
+#define XS_TILE_MIN   256
+
+/* Packets are numbered device*w + bit.  Destination d is the XOR of
+   packets src[first[d] .. first[d]+n[d]-1]. */
+struct xor_sched {
+  int      k, m, w, packetsize;
+  int      ndst;
+  int     *dst, *first, *n;
+  int     *src;
+  int      maxn;                   /* most sources of any destination */
+  int      tile;                   /* column tile width in bytes */
+};
+
+static pthread_once_t xs_once = PTHREAD_ONCE_INIT;
+static long l1_bytes;
+static long tile_override;
+static int xs_off;
+
+static void xs_init(void)
+{
+  char *s;
+
+  s = getenv("SWIFTER_XOR_SCHED");
+  if (s != NULL && strcmp(s, "off") == 0) xs_off = 1;
+  if (s != NULL && atol(s) > 0) tile_override = atol(s);
+  l1_bytes = 0;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+  l1_bytes = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+#endif
+  if (l1_bytes <= 0) l1_bytes = 32 << 10;
+}
+
+/* Three quarters of L1 for a tile of every packet of a group, but no
+   narrower than XS_TILE_MIN, below which the calls per destination cost
+   more than the misses they save */
+static int tile_width(int k, int m, int w, int packetsize)
+{
+  long tile;
+
+  tile = (tile_override > 0) ? tile_override : (l1_bytes * 3 / 4) / ((k + m) * w);
+  tile -= tile % 64;
+  if (tile < XS_TILE_MIN) tile = XS_TILE_MIN;
+  if (tile > packetsize) tile = packetsize;
+  return (int) tile;
+}
+
+xor_sched_t *xor_sched_new(int k, int m, int w, int packetsize, int **schedule)
+{
+  xor_sched_t *xs;
+  int nops, op, d, s, i, j, x;
+
+  pthread_once(&xs_once, xs_init);
+  if (xs_off) return NULL;
+  for (nops = 0; schedule[nops][0] >= 0; nops++) ;
+  xs = talloc(xor_sched_t, 1);
+  if (xs == NULL) return NULL;
+  xs->k = k;
+  xs->m = m;
+  xs->w = w;
+  xs->packetsize = packetsize;
+  xs->tile = tile_width(k, m, w, packetsize);
+  xs->ndst = 0;
+  xs->maxn = 1;
+  xs->dst = talloc(int, nops+1);
+  xs->first = talloc(int, nops+1);
+  xs->n = talloc(int, nops+1);
+  xs->src = talloc(int, 2*nops+1);
+  if (xs->dst == NULL || xs->first == NULL || xs->n == NULL || xs->src == NULL) {
+    xor_sched_free(xs);
+    return NULL;
+  }
+
+  /* A copy starts a destination, and so does an XOR into a packet other
+     than the current one, with the packet itself as its first source */
+  s = 0;
+  d = -1;
+  for (op = 0; op < nops; op++) {
+    x = schedule[op][2]*w + schedule[op][3];
+    if (schedule[op][4] == 0 || d < 0 || xs->dst[d] != x) {
+      d = xs->ndst++;
+      xs->dst[d] = x;
+      xs->first[d] = s;
+      xs->n[d] = 0;
+      if (schedule[op][4] != 0) {
+        xs->src[s++] = x;
+        xs->n[d]++;
+      }
+    }
+    xs->src[s++] = schedule[op][0]*w + schedule[op][1];
+    xs->n[d]++;
+  }
+
+  /* The first source stays first; it is the one most likely still in
+     cache.  The rest go in address order. */
+  for (d = 0; d < xs->ndst; d++) {
+    if (xs->n[d] > xs->maxn) xs->maxn = xs->n[d];
+    for (i = xs->first[d]+2; i < xs->first[d]+xs->n[d]; i++) {
+      x = xs->src[i];
+      for (j = i; j > xs->first[d]+1 && xs->src[j-1] > x; j--) xs->src[j] = xs->src[j-1];
+      xs->src[j] = x;
+    }
+  }
+  return xs;
+}
+
+void xor_sched_encode(xor_sched_t *xs, char **data, char **coding, int size)
+{
+  const struct gf_kernel *gk;
+  char **base, **p, *dev;
+  int npk, g, t, len, d, i, j;
+
+  gk = gf_kernel();
+  npk = (xs->k + xs->m) * xs->w;
+  base = talloc(char *, npk);
+  p = talloc(char *, xs->maxn);
+  if (base == NULL || p == NULL) {
+    fprintf(stderr, "xor_sched_encode: out of memory\n");
+    exit(1);
+  }
+
+  for (g = 0; g < size; g += xs->w*xs->packetsize) {
+    for (i = 0; i < xs->k + xs->m; i++) {
+      dev = ((i < xs->k) ? data[i] : coding[i-xs->k]) + g;
+      for (j = 0; j < xs->w; j++) base[i*xs->w+j] = dev + j*xs->packetsize;
+    }
+    for (t = 0; t < xs->packetsize; t += xs->tile) {
+      len = (xs->packetsize - t < xs->tile) ? xs->packetsize - t : xs->tile;
+      for (d = 0; d < xs->ndst; d++) {
+        for (j = 0; j < xs->n[d]; j++) p[j] = base[xs->src[xs->first[d]+j]];
+        gk->xors(xs->n[d], p, base[xs->dst[d]], t, len);
+      }
+    }
+  }
+  free(p);
+  free(base);
+}
+
+void xor_sched_free(xor_sched_t *xs)
+{
+  if (xs == NULL) return;
+  free(xs->dst);
+  free(xs->first);
+  free(xs->n);
+  free(xs->src);
+  free(xs);
+}
@@ -0,0 +1,43 @@
+/* xor_sched.h - vector executor for the XOR schedules of bitmatrix codes.
+ *
+ * jerasure_schedule_encode() runs a schedule one operation at a time:
+ * each copy or XOR streams a whole packet, a long at a time, reading and
+ * writing its destination as it goes, so a coding packet built from
+ * twenty sources is stored twenty times, and with k*w packets per group
+ * the group has long left L1 when the last rows reach its first packets.
+ *
+ * xor_sched_new() regroups a schedule by destination packet, the packet
+ * that seeds it (often another coding packet just built) first and the
+ * rest in address order.  xor_sched_encode() then cuts every packet
+ * group into column tiles that fit in L1 with all k+m devices, and runs
+ * the whole schedule over one tile before the next.  Each destination is
+ * produced by gf_kernel()'s XOR kernel, which keeps it in 128, 64 or
+ * 32-byte registers while all of its sources are XORed in and stores it
+ * once.  Output is that of jerasure_schedule_encode().
+ *
+ * An xor_sched_t is read-only once built, so threads coding different
+ * slices can share one.  SWIFTER_XOR_SCHED=<bytes> overrides the tile
+ * width; SWIFTER_XOR_SCHED=off makes xor_sched_new() return NULL, so
+ * callers fall back to jerasure.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct xor_sched xor_sched_t;
+
+/* For a schedule of jerasure_*_to_schedule() over k data and m coding
+   devices.  The schedule is copied. */
+extern xor_sched_t *xor_sched_new(int k, int m, int w, int packetsize, int **schedule);
+
+/* As jerasure_schedule_encode(): size is a multiple of w*packetsize */
+extern void xor_sched_encode(xor_sched_t *xs, char **data, char **coding, int size);
+
+extern void xor_sched_free(xor_sched_t *xs);
+
+#ifdef __cplusplus
+}
+#endif